@@ -1,4 +1,6 @@
 D:\VulkanSDK\Bin\glslangValidator.exe -V ./shader.vert
 D:\VulkanSDK\Bin\glslangValidator.exe -V ./shader.frag
+D:\VulkanSDK\Bin\glslangValidator.exe -V ./shader_vt.frag -o ./frag_vt.spv
+D:\VulkanSDK\Bin\spirv-val.exe ./frag_vt.spv
 pause
 
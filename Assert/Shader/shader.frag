@@ -2,13 +2,21 @@
 
 layout(location = 0) in vec3 fragColor;
 layout(location = 1) in vec2 fragTexCoord;
+layout(location = 2) in vec3 fragNormal;
 
 layout(location = 0) out vec4 outColor;
 
 layout(binding = 1) uniform sampler2D texSampler;
 
+const vec3 LIGHT_DIRECTION = normalize(vec3(0.3, 1.0, 0.5));
+const float AMBIENT = 0.3;
 
 void main() {
     outColor = texture(texSampler, fragTexCoord);
     //outColor = vec4(fragColor,1.0);
+
+    // meshes without normals have zero normals and stay unlit
+    float fLength = length(fragNormal);
+    if (fLength > 0.0)
+        outColor.rgb *= AMBIENT + (1.0 - AMBIENT) * max(dot(fragNormal / fLength, LIGHT_DIRECTION), 0.0);
 }
\ No newline at end of file
@@ -3,21 +3,33 @@
 layout (location = 0) in vec3 inPosition;
 layout (location = 1) in vec3 inColor;
 layout (location = 2) in vec2 inTexCoord;
+layout (location = 3) in vec3 inNormal;
 
 layout (location = 0) out vec3 fragColor;
 layout (location = 1) out vec2 fragTexCoord;
+layout (location = 2) out vec3 fragNormal;
 
-layout (binding = 0) uniform UniformBufferObject
+// mirror PerFrameConstants / PerDrawConstants in ShaderConstants.h
+layout (binding = 0) uniform PerFrameConstants
 {
-	mat4 model;
 	mat4 view;
 	mat4 proj;
-} ubo;
+} perFrame;
+
+// dynamic offset, one slot per object
+layout (binding = 2) uniform PerDrawConstants
+{
+	mat4 model;
+} perDraw;
 
 layout (binding = 1) uniform sampler2D texSampler;
 
 void main() {
-    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPosition, 1.0);
+    gl_Position = perFrame.proj * perFrame.view * perDraw.model * vec4(inPosition, 1.0);
     fragColor = inColor;
 	fragTexCoord = inTexCoord;
+
+	// cofactor matrix: inverse transpose up to a scale, also valid for the non-uniform dequantization scale
+	mat3 model = mat3(perDraw.model);
+	fragNormal = mat3(cross(model[1], model[2]), cross(model[2], model[0]), cross(model[0], model[1])) * inNormal;
 }
\ No newline at end of file
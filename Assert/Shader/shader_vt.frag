@@ -0,0 +1,61 @@
+#version 450
+
+// Fragment shader for the sparse (virtual) texture: samples only resident pages and writes the pages it wants
+layout(early_fragment_tests) in;
+
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec2 fragTexCoord;
+layout(location = 2) in vec3 fragNormal;
+
+layout(location = 0) out vec4 outColor;
+
+layout(binding = 1) uniform sampler2D texSampler;
+
+// One texel per level 0 page: the finest level whose pages are resident there, neighbours included
+layout(binding = 3) uniform usampler2D pageTable;
+
+const int MAX_LEVEL_COUNT = 16;
+
+// Mirrored by VirtualTextureConstants in ShaderConstants.h
+layout(binding = 4) uniform VirtualTextureConstants
+{
+    vec4 levelPageScales[MAX_LEVEL_COUNT];  // xy: level size / page size
+    uvec4 levelPages[MAX_LEVEL_COUNT];      // x: page count x, y: page count y, z: first page of the level
+    uint pagedLevelCount;                   // levels from here on are in the mip tail and always resident
+} vt;
+
+// One flag per page, read and cleared by the CPU once the frame has completed
+layout(binding = 5) buffer VirtualTextureFeedback
+{
+    uint requested[];
+} feedback;
+
+const vec3 LIGHT_DIRECTION = normalize(vec3(0.3, 1.0, 0.5));
+const float AMBIENT = 0.3;
+
+uvec2 GetPage(vec2 uv, uint level)
+{
+    uvec2 page = uvec2(fract(uv) * vt.levelPageScales[level].xy);
+    return min(page, vt.levelPages[level].xy - 1u);
+}
+
+void main() {
+    float lod = textureQueryLod(texSampler, fragTexCoord).y;
+
+    // request the page at the wanted level, the CPU adds its neighbours and the coarser levels
+    uint level = uint(clamp(floor(lod), 0.0, float(vt.pagedLevelCount)));
+    if (level < vt.pagedLevelCount)
+    {
+        uvec2 page = GetPage(fragTexCoord, level);
+        feedback.requested[vt.levelPages[level].z + page.y * vt.levelPages[level].x + page.x] = 1u;
+    }
+
+    // missing pages only make this part of the texture fall back to a coarser level
+    uint minLevel = texelFetch(pageTable, ivec2(GetPage(fragTexCoord, 0u)), 0).r;
+    outColor = textureLod(texSampler, fragTexCoord, max(lod, float(minLevel)));
+
+    // meshes without normals have zero normals and stay unlit
+    float fLength = length(fragNormal);
+    if (fLength > 0.0)
+        outColor.rgb *= AMBIENT + (1.0 - AMBIENT) * max(dot(fragNormal / fLength, LIGHT_DIRECTION), 0.0);
+}
\ No newline at end of file
@@ -0,0 +1,317 @@
+#include "BlockCompression.h"
+#include "ThreadPool.h"
+
+#include <array>
+#include <cfloat>
+#include <climits>
+#include <cstring>
+
+using Color3 = std::array<float, 3>;
+
+static uint16_t QuantizeRGB565(const Color3& color)
+{
+	UINT r = static_cast<UINT>(std::clamp(color[0], 0.f, 255.f) * 31.f / 255.f + 0.5f);
+	UINT g = static_cast<UINT>(std::clamp(color[1], 0.f, 255.f) * 63.f / 255.f + 0.5f);
+	UINT b = static_cast<UINT>(std::clamp(color[2], 0.f, 255.f) * 31.f / 255.f + 0.5f);
+	return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+static Color3 ExpandRGB565(uint16_t uiColor)
+{
+	UINT r = (uiColor >> 11) & 31;
+	UINT g = (uiColor >> 5) & 63;
+	UINT b = uiColor & 31;
+	return { static_cast<float>((r << 3) | (r >> 2)), static_cast<float>((g << 2) | (g >> 4)), static_cast<float>((b << 3) | (b >> 2)) };
+}
+
+static float GetDistanceSquared(const Color3& a, const Color3& b)
+{
+	float dr = a[0] - b[0];
+	float dg = a[1] - b[1];
+	float db = a[2] - b[2];
+	return dr * dr + dg * dg + db * db;
+}
+
+//4色模式的调色板，选出各像素最近的颜色，返回总误差
+static float SelectColorIndices(const Color3* pColors, uint16_t uiColor0, uint16_t uiColor1, std::array<UINT, 16>& aryIndices)
+{
+	Color3 aryPalette[4];
+	aryPalette[0] = ExpandRGB565(uiColor0);
+	aryPalette[1] = ExpandRGB565(uiColor1);
+	for (UINT c = 0; c < 3; ++c)
+	{
+		aryPalette[2][c] = (2.f * aryPalette[0][c] + aryPalette[1][c]) / 3.f;
+		aryPalette[3][c] = (aryPalette[0][c] + 2.f * aryPalette[1][c]) / 3.f;
+	}
+
+	float fTotalError = 0.f;
+	for (UINT i = 0; i < 16; ++i)
+	{
+		float fBestError = FLT_MAX;
+		for (UINT p = 0; p < 4; ++p)
+		{
+			float fError = GetDistanceSquared(pColors[i], aryPalette[p]);
+			if (fError < fBestError)
+			{
+				fBestError = fError;
+				aryIndices[i] = p;
+			}
+		}
+		fTotalError += fBestError;
+	}
+	return fTotalError;
+}
+
+//color0大于color1时为4色模式，相等时只能用单色
+static void OrderEndpoints(uint16_t& uiColor0, uint16_t& uiColor1)
+{
+	if (uiColor0 < uiColor1)
+		std::swap(uiColor0, uiColor1);
+}
+
+void BlockCompression::EncodeColorBlock(const UCHAR* pBlock, UCHAR* pDst)
+{
+	Color3 aryColors[16];
+	Color3 mean{ 0.f, 0.f, 0.f };
+	for (UINT i = 0; i < 16; ++i)
+	{
+		for (UINT c = 0; c < 3; ++c)
+		{
+			aryColors[i][c] = pBlock[i * 4 + c];
+			mean[c] += aryColors[i][c] / 16.f;
+		}
+	}
+
+	//协方差矩阵的主特征向量由幂迭代求得，初始方向取包围盒的对角线
+	float aryCovariance[6]{};	//rr rg rb gg gb bb
+	Color3 minColor{ 255.f, 255.f, 255.f };
+	Color3 maxColor{ 0.f, 0.f, 0.f };
+	for (UINT i = 0; i < 16; ++i)
+	{
+		float r = aryColors[i][0] - mean[0];
+		float g = aryColors[i][1] - mean[1];
+		float b = aryColors[i][2] - mean[2];
+		aryCovariance[0] += r * r;
+		aryCovariance[1] += r * g;
+		aryCovariance[2] += r * b;
+		aryCovariance[3] += g * g;
+		aryCovariance[4] += g * b;
+		aryCovariance[5] += b * b;
+		for (UINT c = 0; c < 3; ++c)
+		{
+			minColor[c] = std::min(minColor[c], aryColors[i][c]);
+			maxColor[c] = std::max(maxColor[c], aryColors[i][c]);
+		}
+	}
+
+	Color3 axis{ maxColor[0] - minColor[0], maxColor[1] - minColor[1], maxColor[2] - minColor[2] };
+	for (UINT uiIter = 0; uiIter < 8; ++uiIter)
+	{
+		Color3 next{
+			aryCovariance[0] * axis[0] + aryCovariance[1] * axis[1] + aryCovariance[2] * axis[2],
+			aryCovariance[1] * axis[0] + aryCovariance[3] * axis[1] + aryCovariance[4] * axis[2],
+			aryCovariance[2] * axis[0] + aryCovariance[4] * axis[1] + aryCovariance[5] * axis[2] };
+		float fLength = std::max({ std::abs(next[0]), std::abs(next[1]), std::abs(next[2]) });
+		if (fLength < 1e-6f)
+			break;
+		axis = { next[0] / fLength, next[1] / fLength, next[2] / fLength };
+	}
+
+	float fMinProjection = FLT_MAX;
+	float fMaxProjection = -FLT_MAX;
+	for (UINT i = 0; i < 16; ++i)
+	{
+		float fProjection = (aryColors[i][0] - mean[0]) * axis[0] + (aryColors[i][1] - mean[1]) * axis[1] + (aryColors[i][2] - mean[2]) * axis[2];
+		fMinProjection = std::min(fMinProjection, fProjection);
+		fMaxProjection = std::max(fMaxProjection, fProjection);
+	}
+
+	float fAxisLengthSquared = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+	Color3 endpoint0 = mean;
+	Color3 endpoint1 = mean;
+	if (fAxisLengthSquared > 0.f)
+	{
+		for (UINT c = 0; c < 3; ++c)
+		{
+			endpoint0[c] += axis[c] * fMaxProjection / fAxisLengthSquared;
+			endpoint1[c] += axis[c] * fMinProjection / fAxisLengthSquared;
+		}
+	}
+
+	uint16_t uiColor0 = QuantizeRGB565(endpoint0);
+	uint16_t uiColor1 = QuantizeRGB565(endpoint1);
+	OrderEndpoints(uiColor0, uiColor1);
+
+	std::array<UINT, 16> aryIndices{};
+	float fError = (uiColor0 == uiColor1) ? FLT_MAX : SelectColorIndices(aryColors, uiColor0, uiColor1, aryIndices);
+
+	//固定各像素的插值权重，用最小二乘重新求两个端点
+	if (uiColor0 != uiColor1)
+	{
+		static constexpr float aryWeights[4] = { 1.f, 0.f, 2.f / 3.f, 1.f / 3.f };
+		float fAA = 0.f, fAB = 0.f, fBB = 0.f;
+		Color3 ax{ 0.f, 0.f, 0.f };
+		Color3 bx{ 0.f, 0.f, 0.f };
+		for (UINT i = 0; i < 16; ++i)
+		{
+			float a = aryWeights[aryIndices[i]];
+			float b = 1.f - a;
+			fAA += a * a;
+			fAB += a * b;
+			fBB += b * b;
+			for (UINT c = 0; c < 3; ++c)
+			{
+				ax[c] += a * aryColors[i][c];
+				bx[c] += b * aryColors[i][c];
+			}
+		}
+
+		float fDeterminant = fAA * fBB - fAB * fAB;
+		if (std::abs(fDeterminant) > 1e-6f)
+		{
+			Color3 refined0, refined1;
+			for (UINT c = 0; c < 3; ++c)
+			{
+				refined0[c] = (ax[c] * fBB - bx[c] * fAB) / fDeterminant;
+				refined1[c] = (bx[c] * fAA - ax[c] * fAB) / fDeterminant;
+			}
+
+			uint16_t uiRefinedColor0 = QuantizeRGB565(refined0);
+			uint16_t uiRefinedColor1 = QuantizeRGB565(refined1);
+			OrderEndpoints(uiRefinedColor0, uiRefinedColor1);
+			if (uiRefinedColor0 != uiRefinedColor1)
+			{
+				std::array<UINT, 16> aryRefinedIndices{};
+				float fRefinedError = SelectColorIndices(aryColors, uiRefinedColor0, uiRefinedColor1, aryRefinedIndices);
+				if (fRefinedError < fError)
+				{
+					uiColor0 = uiRefinedColor0;
+					uiColor1 = uiRefinedColor1;
+					aryIndices = aryRefinedIndices;
+				}
+			}
+		}
+	}
+
+	//两端点量化后相同时整块使用color0
+	if (uiColor0 == uiColor1)
+		aryIndices.fill(0);
+
+	uint32_t uiIndexBits = 0;
+	for (UINT i = 0; i < 16; ++i)
+		uiIndexBits |= aryIndices[i] << (i * 2);
+
+	memcpy(pDst, &uiColor0, 2);
+	memcpy(pDst + 2, &uiColor1, 2);
+	memcpy(pDst + 4, &uiIndexBits, 4);
+}
+
+void BlockCompression::EncodeAlphaBlock(const UCHAR* pBlock, UCHAR* pDst)
+{
+	UCHAR uiMinAlpha = 255;
+	UCHAR uiMaxAlpha = 0;
+	for (UINT i = 0; i < 16; ++i)
+	{
+		uiMinAlpha = std::min(uiMinAlpha, pBlock[i * 4 + 3]);
+		uiMaxAlpha = std::max(uiMaxAlpha, pBlock[i * 4 + 3]);
+	}
+
+	//alpha0 > alpha1时为8值模式，端点之间等分6个插值
+	UINT aryPalette[8];
+	aryPalette[0] = uiMaxAlpha;
+	aryPalette[1] = uiMinAlpha;
+	for (UINT p = 1; p <= 6; ++p)
+		aryPalette[p + 1] = ((7 - p) * uiMaxAlpha + p * uiMinAlpha + 3) / 7;
+
+	uint64_t uiBits = static_cast<uint64_t>(uiMaxAlpha) | (static_cast<uint64_t>(uiMinAlpha) << 8);
+	if (uiMaxAlpha != uiMinAlpha)
+	{
+		for (UINT i = 0; i < 16; ++i)
+		{
+			UINT uiAlpha = pBlock[i * 4 + 3];
+			UINT uiBestIndex = 0;
+			UINT uiBestError = UINT_MAX;
+			for (UINT p = 0; p < 8; ++p)
+			{
+				UINT uiError = (uiAlpha > aryPalette[p]) ? uiAlpha - aryPalette[p] : aryPalette[p] - uiAlpha;
+				if (uiError < uiBestError)
+				{
+					uiBestError = uiError;
+					uiBestIndex = p;
+				}
+			}
+			uiBits |= static_cast<uint64_t>(uiBestIndex) << (16 + i * 3);
+		}
+	}
+
+	memcpy(pDst, &uiBits, 8);
+}
+
+void BlockCompression::EncodeBC1Block(const UCHAR* pBlock, UCHAR* pDst)
+{
+	EncodeColorBlock(pBlock, pDst);
+}
+
+void BlockCompression::EncodeBC3Block(const UCHAR* pBlock, UCHAR* pDst)
+{
+	EncodeAlphaBlock(pBlock, pDst);
+	EncodeColorBlock(pBlock, pDst + 8);
+}
+
+size_t BlockCompression::GetCompressedSize(UINT uiWidth, UINT uiHeight, UINT uiBlockSize)
+{
+	size_t uiBlockCountX = (uiWidth + BLOCK_DIM - 1) / BLOCK_DIM;
+	size_t uiBlockCountY = (uiHeight + BLOCK_DIM - 1) / BLOCK_DIM;
+	return uiBlockCountX * uiBlockCountY * uiBlockSize;
+}
+
+bool BlockCompression::HasTranslucentPixel(const UCHAR* pPixels, size_t uiPixelCount)
+{
+	for (size_t i = 0; i < uiPixelCount; ++i)
+	{
+		if (pPixels[i * 4 + 3] != 255)
+			return true;
+	}
+	return false;
+}
+
+std::vector<UCHAR> BlockCompression::CompressRGBA8(const UCHAR* pPixels, UINT uiWidth, UINT uiHeight, bool bBC3, ThreadPool* pThreadPool)
+{
+	UINT uiBlockSize = bBC3 ? BC3_BLOCK_SIZE : BC1_BLOCK_SIZE;
+	UINT uiBlockCountX = (uiWidth + BLOCK_DIM - 1) / BLOCK_DIM;
+	UINT uiBlockCountY = (uiHeight + BLOCK_DIM - 1) / BLOCK_DIM;
+	std::vector<UCHAR> vecBlocks(GetCompressedSize(uiWidth, uiHeight, uiBlockSize));
+
+	auto CompressBlockRow = [&](size_t uiBlockY)
+	{
+		UCHAR aryBlock[16 * 4];
+		for (UINT uiBlockX = 0; uiBlockX < uiBlockCountX; ++uiBlockX)
+		{
+			for (UINT y = 0; y < BLOCK_DIM; ++y)
+			{
+				UINT uiSrcY = std::min(static_cast<UINT>(uiBlockY) * BLOCK_DIM + y, uiHeight - 1);
+				for (UINT x = 0; x < BLOCK_DIM; ++x)
+				{
+					UINT uiSrcX = std::min(uiBlockX * BLOCK_DIM + x, uiWidth - 1);
+					memcpy(aryBlock + (y * BLOCK_DIM + x) * 4, pPixels + (static_cast<size_t>(uiSrcY) * uiWidth + uiSrcX) * 4, 4);
+				}
+			}
+
+			UCHAR* pDst = vecBlocks.data() + (uiBlockY * uiBlockCountX + uiBlockX) * uiBlockSize;
+			if (bBC3)
+				EncodeBC3Block(aryBlock, pDst);
+			else
+				EncodeBC1Block(aryBlock, pDst);
+		}
+	};
+
+	if (pThreadPool)
+		pThreadPool->ParallelFor(uiBlockCountY, CompressBlockRow);
+	else
+	{
+		for (size_t uiBlockY = 0; uiBlockY < uiBlockCountY; ++uiBlockY)
+			CompressBlockRow(uiBlockY);
+	}
+
+	return vecBlocks;
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include "Core.h"
+
+class ThreadPool;
+
+//RGBA8到BC1/BC3的块压缩，每4x4像素为一个块，供离线的纹理烘焙使用
+//颜色端点取16个像素主轴上的两端，量化为565后按最小二乘再调整一次
+//sRGB纹理直接在编码空间中压缩，与硬件先插值再转换到线性空间的解码方式一致
+class BlockCompression
+{
+public:
+	static constexpr UINT BLOCK_DIM = 4;
+	static constexpr UINT BC1_BLOCK_SIZE = 8;
+	static constexpr UINT BC3_BLOCK_SIZE = 16;
+
+	//pBlock为16个按行排列的RGBA8像素
+	static void EncodeBC1Block(const UCHAR* pBlock, UCHAR* pDst);
+	//8字节alpha块后接8字节颜色块
+	static void EncodeBC3Block(const UCHAR* pBlock, UCHAR* pDst);
+
+	//尺寸不是4的倍数时，边缘的块重复最后一行/列的像素；pThreadPool非空时按块行并行压缩
+	static std::vector<UCHAR> CompressRGBA8(const UCHAR* pPixels, UINT uiWidth, UINT uiHeight, bool bBC3, ThreadPool* pThreadPool = nullptr);
+
+	static size_t GetCompressedSize(UINT uiWidth, UINT uiHeight, UINT uiBlockSize);
+	static bool HasTranslucentPixel(const UCHAR* pPixels, size_t uiPixelCount);
+
+private:
+	static void EncodeColorBlock(const UCHAR* pBlock, UCHAR* pDst);
+	static void EncodeAlphaBlock(const UCHAR* pBlock, UCHAR* pDst);
+};
@@ -34,7 +34,7 @@ public:
 	glm::vec3 GetRightDirection() const;
 	glm::vec3 GetForwardDirection() const;
 
-	const glm::vec3& GetPosition() { return m_Position; }
+	const glm::vec3& GetPosition() const { return m_Position; }
 	glm::quat GetOrientation() const;
 
 	float GetPitch() const { return m_fPitch; }
@@ -0,0 +1,329 @@
+#include "DeviceMemoryAllocator.h"
+
+#include <cstring>
+
+class DeviceMemoryBlock
+{
+public:
+	DeviceMemoryBlock(VkDeviceMemory memory, VkDeviceSize uiSize, void* pMappedData, UINT uiMemoryTypeIndex, MemoryResourceType resourceType)
+		: m_Memory(memory), m_uiSize(uiSize), m_pMappedData(pMappedData), m_uiMemoryTypeIndex(uiMemoryTypeIndex), m_ResourceType(resourceType), m_Allocator(uiSize)
+	{
+	}
+
+	VkDeviceMemory m_Memory;
+	VkDeviceSize m_uiSize;
+	void* m_pMappedData;
+	UINT m_uiMemoryTypeIndex;
+	MemoryResourceType m_ResourceType;
+	TLSFAllocator m_Allocator;
+};
+
+DeviceMemoryAllocator::DeviceMemoryAllocator()
+	: m_PhysicalDevice(VK_NULL_HANDLE), m_Device(VK_NULL_HANDLE), m_MemoryProperties{}, m_uiNonCoherentAtomSize(1), m_bMemoryBudgetSupported(false)
+{
+}
+
+DeviceMemoryAllocator::~DeviceMemoryAllocator()
+{
+	Destroy();
+}
+
+void DeviceMemoryAllocator::Init(VkPhysicalDevice physicalDevice, VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties,
+	const VkPhysicalDeviceLimits& limits, bool bMemoryBudgetSupported)
+{
+	m_PhysicalDevice = physicalDevice;
+	m_Device = device;
+	m_MemoryProperties = memoryProperties;
+	m_uiNonCoherentAtomSize = std::max<VkDeviceSize>(limits.nonCoherentAtomSize, 1);
+	m_aryDedicatedStats.fill({});
+
+	memset(m_aryCategoryBytes, 0, sizeof(m_aryCategoryBytes));
+	m_aryHeapReservedBytes.fill(0);
+	m_aryHeapReservedBytesAtUpdate.fill(0);
+	m_bMemoryBudgetSupported = bMemoryBudgetSupported;
+	UpdateBudget();
+}
+
+void DeviceMemoryAllocator::Destroy()
+{
+	if (m_Device == VK_NULL_HANDLE)
+		return;
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	for (UINT i = 0; i < VK_MAX_MEMORY_TYPES; ++i)
+	{
+		for (auto& vecBlocks : m_aryBlocks[i])
+		{
+			for (auto& pBlock : vecBlocks)
+			{
+				if (!pBlock->m_Allocator.IsEmpty())
+					Log::Warn(std::format("Memory block of type {} destroyed with {} live allocations", i, pBlock->m_Allocator.GetAllocationCount()));
+				FreeDeviceMemory(pBlock->m_Memory, pBlock->m_uiSize, i);
+			}
+			vecBlocks.clear();
+		}
+
+		if (m_aryDedicatedStats[i].uiAllocationCount > 0)
+			Log::Warn(std::format("{} dedicated allocations of memory type {} were not freed", m_aryDedicatedStats[i].uiAllocationCount, i));
+	}
+
+	m_Device = VK_NULL_HANDLE;
+}
+
+VkDeviceSize DeviceMemoryAllocator::GetBlockSize(UINT uiMemoryTypeIndex) const
+{
+	//小于1GB的堆（如256MB的BAR）按堆大小的1/8分块，避免一个块占去过多
+	VkDeviceSize uiHeapSize = m_MemoryProperties.memoryHeaps[m_MemoryProperties.memoryTypes[uiMemoryTypeIndex].heapIndex].size;
+	if (uiHeapSize <= (1ull << 30))
+		return std::min(DEFAULT_BLOCK_SIZE, uiHeapSize / 8);
+	return DEFAULT_BLOCK_SIZE;
+}
+
+bool DeviceMemoryAllocator::AllocateDeviceMemory(VkDeviceSize uiSize, UINT uiMemoryTypeIndex, VkDeviceMemory& memory, void*& pMappedData)
+{
+	VkMemoryAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = uiSize;
+	allocInfo.memoryTypeIndex = uiMemoryTypeIndex;
+
+	VkResult res = vkAllocateMemory(m_Device, &allocInfo, nullptr, &memory);
+	if (res != VK_SUCCESS)
+	{
+		Log::Error(std::format("vkAllocateMemory of {} bytes from memory type {} failed : {}", uiSize, uiMemoryTypeIndex, static_cast<int>(res)));
+		memory = VK_NULL_HANDLE;
+		return false;
+	}
+	m_aryHeapReservedBytes[GetHeapIndex(uiMemoryTypeIndex)] += uiSize;
+
+	//同一VkDeviceMemory不能重复映射，HOST_VISIBLE的内存在这里整体映射一次，子分配直接使用偏移后的指针
+	pMappedData = nullptr;
+	if (m_MemoryProperties.memoryTypes[uiMemoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+		VULKAN_ASSERT(vkMapMemory(m_Device, memory, 0, VK_WHOLE_SIZE, 0, &pMappedData), "Map device memory failed");
+
+	return true;
+}
+
+void DeviceMemoryAllocator::FreeDeviceMemory(VkDeviceMemory memory, VkDeviceSize uiSize, UINT uiMemoryTypeIndex)
+{
+	if (m_MemoryProperties.memoryTypes[uiMemoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+		vkUnmapMemory(m_Device, memory);
+	vkFreeMemory(m_Device, memory, nullptr);
+	m_aryHeapReservedBytes[GetHeapIndex(uiMemoryTypeIndex)] -= uiSize;
+}
+
+bool DeviceMemoryAllocator::Allocate(const VkMemoryRequirements& requirements, UINT uiMemoryTypeIndex, MemoryResourceType resourceType,
+	MemoryCategory category, MemoryAllocation& allocation)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	allocation = {};
+	allocation.uiMemoryTypeIndex = uiMemoryTypeIndex;
+	allocation.category = category;
+	auto& uiCategoryBytes = m_aryCategoryBytes[GetHeapIndex(uiMemoryTypeIndex)][static_cast<UINT>(category)];
+
+	const VkDeviceSize uiBlockSize = GetBlockSize(uiMemoryTypeIndex);
+	if (requirements.size > uiBlockSize / 2)
+	{
+		if (!AllocateDeviceMemory(requirements.size, uiMemoryTypeIndex, allocation.memory, allocation.pMappedData))
+			return false;
+
+		allocation.size = requirements.size;
+		uiCategoryBytes += requirements.size;
+
+		auto& stats = m_aryDedicatedStats[uiMemoryTypeIndex];
+		stats.uiDedicatedAllocationCount++;
+		stats.uiAllocationCount++;
+		stats.uiReservedBytes += requirements.size;
+		stats.uiUsedBytes += requirements.size;
+		return true;
+	}
+
+	auto TryAllocate = [&](DeviceMemoryBlock& block)
+	{
+		VkDeviceSize uiOffset = 0;
+		UINT uiNode = block.m_Allocator.Allocate(requirements.size, requirements.alignment, uiOffset);
+		if (uiNode == TLSFAllocator::INVALID_NODE)
+			return false;
+
+		allocation.memory = block.m_Memory;
+		allocation.offset = uiOffset;
+		allocation.size = requirements.size;
+		allocation.pMappedData = block.m_pMappedData ? static_cast<UCHAR*>(block.m_pMappedData) + uiOffset : nullptr;
+		allocation.pBlock = &block;
+		allocation.uiNode = uiNode;
+		uiCategoryBytes += requirements.size;
+		return true;
+	};
+
+	auto& vecBlocks = m_aryBlocks[uiMemoryTypeIndex][static_cast<UINT>(resourceType)];
+	for (auto& pBlock : vecBlocks)
+	{
+		if (TryAllocate(*pBlock))
+			return true;
+	}
+
+	VkDeviceMemory memory;
+	void* pMappedData;
+	if (!AllocateDeviceMemory(uiBlockSize, uiMemoryTypeIndex, memory, pMappedData))
+		return false;
+
+	vecBlocks.push_back(std::make_unique<DeviceMemoryBlock>(memory, uiBlockSize, pMappedData, uiMemoryTypeIndex, resourceType));
+	return TryAllocate(*vecBlocks.back());
+}
+
+void DeviceMemoryAllocator::Free(MemoryAllocation& allocation)
+{
+	if (allocation.memory == VK_NULL_HANDLE)
+		return;
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	m_aryCategoryBytes[GetHeapIndex(allocation.uiMemoryTypeIndex)][static_cast<UINT>(allocation.category)] -= allocation.size;
+
+	if (allocation.pBlock == nullptr)
+	{
+		FreeDeviceMemory(allocation.memory, allocation.size, allocation.uiMemoryTypeIndex);
+
+		auto& stats = m_aryDedicatedStats[allocation.uiMemoryTypeIndex];
+		stats.uiDedicatedAllocationCount--;
+		stats.uiAllocationCount--;
+		stats.uiReservedBytes -= allocation.size;
+		stats.uiUsedBytes -= allocation.size;
+	}
+	else
+	{
+		DeviceMemoryBlock* pBlock = allocation.pBlock;
+		pBlock->m_Allocator.Free(allocation.uiNode);
+
+		//已有其他空块时释放这个空块，只保留一个空块避免反复申请
+		if (pBlock->m_Allocator.IsEmpty())
+		{
+			auto& vecBlocks = m_aryBlocks[pBlock->m_uiMemoryTypeIndex][static_cast<UINT>(pBlock->m_ResourceType)];
+			size_t uiEmptyCount = std::count_if(vecBlocks.begin(), vecBlocks.end(),
+				[](const std::unique_ptr<DeviceMemoryBlock>& pOther) { return pOther->m_Allocator.IsEmpty(); });
+			if (uiEmptyCount > 1)
+			{
+				FreeDeviceMemory(pBlock->m_Memory, pBlock->m_uiSize, pBlock->m_uiMemoryTypeIndex);
+				vecBlocks.erase(std::find_if(vecBlocks.begin(), vecBlocks.end(),
+					[pBlock](const std::unique_ptr<DeviceMemoryBlock>& pOther) { return pOther.get() == pBlock; }));
+			}
+		}
+	}
+
+	allocation = {};
+}
+
+void DeviceMemoryAllocator::Flush(const MemoryAllocation& allocation, VkDeviceSize uiOffset, VkDeviceSize uiSize)
+{
+	if (allocation.memory == VK_NULL_HANDLE
+		|| (m_MemoryProperties.memoryTypes[allocation.uiMemoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT))
+		return;
+
+	//范围需按nonCoherentAtomSize对齐，末端对齐后不能超出VkDeviceMemory
+	VkDeviceSize uiMemorySize = allocation.pBlock ? allocation.pBlock->m_uiSize : allocation.size;
+	VkDeviceSize uiBegin = allocation.offset + uiOffset;
+	VkDeviceSize uiEnd = (uiSize == VK_WHOLE_SIZE) ? allocation.offset + allocation.size : uiBegin + uiSize;
+	uiBegin = uiBegin / m_uiNonCoherentAtomSize * m_uiNonCoherentAtomSize;
+	uiEnd = std::min((uiEnd + m_uiNonCoherentAtomSize - 1) / m_uiNonCoherentAtomSize * m_uiNonCoherentAtomSize, uiMemorySize);
+
+	VkMappedMemoryRange range{};
+	range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+	range.memory = allocation.memory;
+	range.offset = uiBegin;
+	range.size = uiEnd - uiBegin;
+	VULKAN_ASSERT(vkFlushMappedMemoryRanges(m_Device, 1, &range), "Flush mapped memory failed");
+}
+
+DeviceMemoryStats DeviceMemoryAllocator::GetHeapStats(UINT uiHeapIndex) const
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	DeviceMemoryStats stats;
+	for (UINT i = 0; i < m_MemoryProperties.memoryTypeCount; ++i)
+	{
+		if (m_MemoryProperties.memoryTypes[i].heapIndex != uiHeapIndex)
+			continue;
+
+		stats += m_aryDedicatedStats[i];
+		for (const auto& vecBlocks : m_aryBlocks[i])
+		{
+			for (const auto& pBlock : vecBlocks)
+			{
+				stats.uiBlockCount++;
+				stats.uiAllocationCount += static_cast<UINT>(pBlock->m_Allocator.GetAllocationCount());
+				stats.uiReservedBytes += pBlock->m_uiSize;
+				stats.uiUsedBytes += pBlock->m_Allocator.GetUsedSize();
+			}
+		}
+	}
+	return stats;
+}
+
+DeviceMemoryStats DeviceMemoryAllocator::GetTotalStats() const
+{
+	DeviceMemoryStats stats;
+	for (UINT i = 0; i < m_MemoryProperties.memoryHeapCount; ++i)
+		stats += GetHeapStats(i);
+	return stats;
+}
+
+VkDeviceSize DeviceMemoryAllocator::GetCategoryBytes(UINT uiHeapIndex, MemoryCategory category) const
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_aryCategoryBytes[uiHeapIndex][static_cast<UINT>(category)];
+}
+
+void DeviceMemoryAllocator::UpdateBudget()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	if (m_bMemoryBudgetSupported)
+	{
+		VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+		budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+		VkPhysicalDeviceMemoryProperties2 memoryProperties2{};
+		memoryProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+		memoryProperties2.pNext = &budgetProperties;
+		vkGetPhysicalDeviceMemoryProperties2(m_PhysicalDevice, &memoryProperties2);
+
+		for (UINT i = 0; i < m_MemoryProperties.memoryHeapCount; ++i)
+		{
+			m_aryHeapBudgets[i].uiUsage = budgetProperties.heapUsage[i];
+			m_aryHeapBudgets[i].uiBudget = budgetProperties.heapBudget[i];
+		}
+	}
+	else
+	{
+		//只能统计本分配器申请的量，其他来源（如SwapChain图像）无法计入
+		for (UINT i = 0; i < m_MemoryProperties.memoryHeapCount; ++i)
+		{
+			m_aryHeapBudgets[i].uiUsage = m_aryHeapReservedBytes[i];
+			m_aryHeapBudgets[i].uiBudget = static_cast<VkDeviceSize>(m_MemoryProperties.memoryHeaps[i].size * FALLBACK_BUDGET_RATIO);
+		}
+	}
+
+	m_aryHeapReservedBytesAtUpdate = m_aryHeapReservedBytes;
+}
+
+DeviceMemoryBudget DeviceMemoryAllocator::GetHeapBudget(UINT uiHeapIndex) const
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	//查询之后本分配器的申请与释放尚未反映在驱动的数值中，按差值修正
+	DeviceMemoryBudget budget = m_aryHeapBudgets[uiHeapIndex];
+	VkDeviceSize uiReserved = m_aryHeapReservedBytes[uiHeapIndex];
+	VkDeviceSize uiReservedAtUpdate = m_aryHeapReservedBytesAtUpdate[uiHeapIndex];
+	if (uiReserved >= uiReservedAtUpdate)
+		budget.uiUsage += uiReserved - uiReservedAtUpdate;
+	else
+		budget.uiUsage -= std::min(budget.uiUsage, uiReservedAtUpdate - uiReserved);
+	return budget;
+}
+
+bool DeviceMemoryAllocator::IsWithinBudget(UINT uiMemoryTypeIndex, VkDeviceSize uiSize) const
+{
+	DeviceMemoryBudget budget = GetHeapBudget(GetHeapIndex(uiMemoryTypeIndex));
+	return budget.uiUsage + uiSize <= budget.uiBudget;
+}
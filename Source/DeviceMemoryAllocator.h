@@ -0,0 +1,147 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include "GLFW/glfw3.h"
+
+#include "Core.h"
+#include "TLSFAllocator.h"
+
+#include <mutex>
+
+class DeviceMemoryBlock;
+
+//分配的用途，用于统计显存的去向
+enum class MemoryCategory : UINT
+{
+	Vertex,
+	Index,
+	Uniform,
+	Texture,
+	Depth,
+	Staging,
+	Count,
+};
+
+inline const char* GetMemoryCategoryName(MemoryCategory category)
+{
+	static const char* arySzNames[] = { "Vertex", "Index", "Uniform", "Texture", "Depth", "Staging" };
+	static_assert(std::size(arySzNames) == static_cast<size_t>(MemoryCategory::Count), "Memory category name missing");
+	return arySzNames[static_cast<UINT>(category)];
+}
+
+//从DeviceMemoryAllocator得到的一段显存，资源绑定在memory的offset处
+struct MemoryAllocation
+{
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	VkDeviceSize offset = 0;
+	VkDeviceSize size = 0;
+	void* pMappedData = nullptr;	//HOST_VISIBLE的内存在创建时持久映射，指向offset处
+
+	UINT uiMemoryTypeIndex = 0;
+	MemoryCategory category = MemoryCategory::Count;
+	DeviceMemoryBlock* pBlock = nullptr;	//为空表示独立的vkAllocateMemory
+	UINT uiNode = TLSFAllocator::INVALID_NODE;
+};
+
+//Buffer与OPTIMAL tiling的Image放在不同的块中，避免bufferImageGranularity引起的别名问题
+enum class MemoryResourceType : UINT
+{
+	Linear,		//Buffer与LINEAR tiling的Image
+	Optimal,	//OPTIMAL tiling的Image
+	Count,
+};
+
+struct DeviceMemoryStats
+{
+	UINT uiBlockCount = 0;
+	UINT uiDedicatedAllocationCount = 0;
+	UINT uiAllocationCount = 0;		//含独立分配
+	VkDeviceSize uiReservedBytes = 0;	//向驱动申请的总量
+	VkDeviceSize uiUsedBytes = 0;		//实际分配给资源的量
+
+	DeviceMemoryStats& operator+=(const DeviceMemoryStats& other)
+	{
+		uiBlockCount += other.uiBlockCount;
+		uiDedicatedAllocationCount += other.uiDedicatedAllocationCount;
+		uiAllocationCount += other.uiAllocationCount;
+		uiReservedBytes += other.uiReservedBytes;
+		uiUsedBytes += other.uiUsedBytes;
+		return *this;
+	}
+};
+
+//堆的预算，支持VK_EXT_memory_budget时由驱动给出，否则按堆大小估算
+struct DeviceMemoryBudget
+{
+	VkDeviceSize uiUsage = 0;	//本进程已占用的量，含上次查询后本分配器新申请的部分
+	VkDeviceSize uiBudget = 0;	//本进程可以使用而不影响性能的上限
+};
+
+//按内存类型预留大块VkDeviceMemory，块内用TLSF按VkMemoryRequirements的对齐进行子分配
+//超过块大小一半的请求单独vkAllocateMemory，空块只保留一个以备复用
+//按堆与用途统计使用量，并跟踪各堆的预算
+class DeviceMemoryAllocator
+{
+public:
+	static constexpr VkDeviceSize DEFAULT_BLOCK_SIZE = 64ull << 20;
+	//不支持VK_EXT_memory_budget时，以堆大小的这一比例作为预算
+	static constexpr float FALLBACK_BUDGET_RATIO = 0.8f;
+
+	DeviceMemoryAllocator();
+	~DeviceMemoryAllocator();
+
+	DeviceMemoryAllocator(const DeviceMemoryAllocator&) = delete;
+	DeviceMemoryAllocator& operator=(const DeviceMemoryAllocator&) = delete;
+
+	//bMemoryBudgetSupported表示设备启用了VK_EXT_memory_budget
+	void Init(VkPhysicalDevice physicalDevice, VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties,
+		const VkPhysicalDeviceLimits& limits, bool bMemoryBudgetSupported);
+	void Destroy();
+
+	bool Allocate(const VkMemoryRequirements& requirements, UINT uiMemoryTypeIndex, MemoryResourceType resourceType,
+		MemoryCategory category, MemoryAllocation& allocation);
+	void Free(MemoryAllocation& allocation);
+
+	//非HOST_COHERENT的内存写入后需要Flush，uiSize为VK_WHOLE_SIZE时刷新整个分配
+	void Flush(const MemoryAllocation& allocation, VkDeviceSize uiOffset = 0, VkDeviceSize uiSize = VK_WHOLE_SIZE);
+
+	DeviceMemoryStats GetHeapStats(UINT uiHeapIndex) const;
+	DeviceMemoryStats GetTotalStats() const;
+	UINT GetHeapCount() const { return m_MemoryProperties.memoryHeapCount; }
+	VkMemoryHeapFlags GetHeapFlags(UINT uiHeapIndex) const { return m_MemoryProperties.memoryHeaps[uiHeapIndex].flags; }
+	UINT GetHeapIndex(UINT uiMemoryTypeIndex) const { return m_MemoryProperties.memoryTypes[uiMemoryTypeIndex].heapIndex; }
+
+	//各用途分配给资源的量（不含块中的空闲部分）
+	VkDeviceSize GetCategoryBytes(UINT uiHeapIndex, MemoryCategory category) const;
+
+	//重新查询各堆的预算，驱动的数值会随其他进程的占用变化，需定期调用
+	void UpdateBudget();
+	bool IsMemoryBudgetSupported() const { return m_bMemoryBudgetSupported; }
+	DeviceMemoryBudget GetHeapBudget(UINT uiHeapIndex) const;
+	//在该内存类型上再申请uiSize字节后是否仍在预算内
+	bool IsWithinBudget(UINT uiMemoryTypeIndex, VkDeviceSize uiSize) const;
+
+private:
+	VkDeviceSize GetBlockSize(UINT uiMemoryTypeIndex) const;
+	bool AllocateDeviceMemory(VkDeviceSize uiSize, UINT uiMemoryTypeIndex, VkDeviceMemory& memory, void*& pMappedData);
+	void FreeDeviceMemory(VkDeviceMemory memory, VkDeviceSize uiSize, UINT uiMemoryTypeIndex);
+
+private:
+	VkPhysicalDevice m_PhysicalDevice;
+	VkDevice m_Device;
+	VkPhysicalDeviceMemoryProperties m_MemoryProperties;
+	VkDeviceSize m_uiNonCoherentAtomSize;
+
+	mutable std::mutex m_Mutex;
+
+	std::vector<std::unique_ptr<DeviceMemoryBlock>> m_aryBlocks[VK_MAX_MEMORY_TYPES][static_cast<UINT>(MemoryResourceType::Count)];
+	std::array<DeviceMemoryStats, VK_MAX_MEMORY_TYPES> m_aryDedicatedStats;
+
+	VkDeviceSize m_aryCategoryBytes[VK_MAX_MEMORY_HEAPS][static_cast<UINT>(MemoryCategory::Count)];
+
+	//向驱动申请的总量，上次查询预算时的值用于估算查询之后的占用变化
+	std::array<VkDeviceSize, VK_MAX_MEMORY_HEAPS> m_aryHeapReservedBytes;
+	std::array<VkDeviceSize, VK_MAX_MEMORY_HEAPS> m_aryHeapReservedBytesAtUpdate;
+	std::array<DeviceMemoryBudget, VK_MAX_MEMORY_HEAPS> m_aryHeapBudgets;
+	bool m_bMemoryBudgetSupported;
+};
@@ -0,0 +1,129 @@
+#pragma once
+#include "Core.h"
+
+#include "glm/glm.hpp"
+#include "tiny_gltf.h"
+
+#include <cstring>
+
+//glTF accessor的零拷贝视图
+//按byteStride直接从tinygltf::Buffer::data中解码元素，不经过中间缓冲区
+class GLTFAccessorView
+{
+public:
+	GLTFAccessorView() = default;
+
+	GLTFAccessorView(const tinygltf::Model& model, int nAccessorIdx)
+	{
+		if (nAccessorIdx < 0 || nAccessorIdx >= static_cast<int>(model.accessors.size()))
+			return;
+
+		const auto& accessor = model.accessors[nAccessorIdx];
+		if (accessor.bufferView < 0 || accessor.sparse.isSparse)
+			return;
+
+		const auto& bufferView = model.bufferViews[accessor.bufferView];
+		const auto& buffer = model.buffers[bufferView.buffer];
+
+		int nStride = accessor.ByteStride(bufferView);
+		if (nStride <= 0)
+			return;
+
+		m_uiCount = accessor.count;
+		m_uiStride = static_cast<size_t>(nStride);
+		m_nComponentType = accessor.componentType;
+		m_nComponentCount = tinygltf::GetNumComponentsInType(static_cast<uint32_t>(accessor.type));
+		m_bNormalized = accessor.normalized;
+
+		size_t uiOffset = bufferView.byteOffset + accessor.byteOffset;
+		size_t uiElementSize = static_cast<size_t>(tinygltf::GetComponentSizeInBytes(static_cast<uint32_t>(m_nComponentType))) * m_nComponentCount;
+		if (m_uiCount == 0 || uiOffset + (m_uiCount - 1) * m_uiStride + uiElementSize > buffer.data.size())
+		{
+			m_uiCount = 0;
+			return;
+		}
+
+		m_pData = buffer.data.data() + uiOffset;
+	}
+
+	bool IsValid() const { return m_pData != nullptr; }
+	size_t GetCount() const { return m_uiCount; }
+	int GetComponentCount() const { return m_nComponentCount; }
+
+	//读取第uiIdx个元素的第nComponent个分量，按glTF规则处理normalized整数
+	float ReadFloat(size_t uiIdx, int nComponent) const
+	{
+		const UCHAR* pElement = m_pData + uiIdx * m_uiStride;
+		switch (m_nComponentType)
+		{
+		case TINYGLTF_COMPONENT_TYPE_FLOAT:
+			return Load<float>(pElement, nComponent);
+		case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+		{
+			float fValue = static_cast<float>(Load<uint8_t>(pElement, nComponent));
+			return m_bNormalized ? fValue / 255.f : fValue;
+		}
+		case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+		{
+			float fValue = static_cast<float>(Load<uint16_t>(pElement, nComponent));
+			return m_bNormalized ? fValue / 65535.f : fValue;
+		}
+		case TINYGLTF_COMPONENT_TYPE_BYTE:
+		{
+			float fValue = static_cast<float>(Load<int8_t>(pElement, nComponent));
+			return m_bNormalized ? std::max(fValue / 127.f, -1.f) : fValue;
+		}
+		case TINYGLTF_COMPONENT_TYPE_SHORT:
+		{
+			float fValue = static_cast<float>(Load<int16_t>(pElement, nComponent));
+			return m_bNormalized ? std::max(fValue / 32767.f, -1.f) : fValue;
+		}
+		default:
+			return 0.f;
+		}
+	}
+
+	glm::vec2 ReadVec2(size_t uiIdx) const { return { ReadFloat(uiIdx, 0), ReadFloat(uiIdx, 1) }; }
+	glm::vec3 ReadVec3(size_t uiIdx) const { return { ReadFloat(uiIdx, 0), ReadFloat(uiIdx, 1), ReadFloat(uiIdx, 2) }; }
+
+	UINT ReadIndex(size_t uiIdx) const
+	{
+		const UCHAR* pElement = m_pData + uiIdx * m_uiStride;
+		switch (m_nComponentType)
+		{
+		case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
+			return Load<uint32_t>(pElement, 0);
+		case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+			return Load<uint16_t>(pElement, 0);
+		case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+			return Load<uint8_t>(pElement, 0);
+		default:
+			return 0;
+		}
+	}
+
+	bool IsIndexType() const
+	{
+		return m_nComponentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT
+			|| m_nComponentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT
+			|| m_nComponentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE;
+	}
+
+private:
+	//glTF只保证分量按自身大小对齐，用memcpy读取以避免未对齐访问
+	template<typename T>
+	static T Load(const UCHAR* pElement, int nComponent)
+	{
+		T value;
+		memcpy(&value, pElement + sizeof(T) * nComponent, sizeof(T));
+		return value;
+	}
+
+private:
+	const UCHAR* m_pData = nullptr;
+	size_t m_uiCount = 0;
+	size_t m_uiStride = 0;
+	int m_nComponentType = 0;
+	int m_nComponentCount = 0;
+	bool m_bNormalized = false;
+};
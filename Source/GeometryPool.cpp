@@ -0,0 +1,145 @@
+#include "GeometryPool.h"
+
+#include <numeric>
+
+GeometryPool::GeometryPool()
+	: m_uiLiveCount(0)
+{
+}
+
+void GeometryPool::Init(VkDeviceSize uiVertexCapacity, VkDeviceSize uiIndexCapacity)
+{
+	m_pVertexAllocator = std::make_unique<TLSFAllocator>(uiVertexCapacity);
+	m_pIndexAllocator = std::make_unique<TLSFAllocator>(uiIndexCapacity);
+	m_vecEntries.clear();
+	m_vecFreeHandles.clear();
+	m_uiLiveCount = 0;
+}
+
+VkDeviceSize GeometryPool::GetVertexAlignment(UINT uiVertexStride)
+{
+	//TLSF的节点偏移是16字节的倍数，对齐取与16的最小公倍数，同时满足偏移能被stride整除
+	return std::lcm<VkDeviceSize>(uiVertexStride, 16);
+}
+
+UINT GeometryPool::Allocate(VkDeviceSize uiVertexSize, UINT uiVertexStride, VkDeviceSize uiIndexSize)
+{
+	ASSERT(uiVertexSize > 0 && uiVertexStride > 0, "Geometry pool allocation needs vertices");
+
+	Entry entry{};
+	entry.range.uiVertexSize = uiVertexSize;
+	entry.range.uiVertexStride = uiVertexStride;
+	entry.range.uiIndexSize = uiIndexSize;
+	entry.uiIndexNode = TLSFAllocator::INVALID_NODE;
+	entry.bLive = true;
+
+	entry.uiVertexNode = m_pVertexAllocator->Allocate(uiVertexSize, GetVertexAlignment(uiVertexStride), entry.range.uiVertexByteOffset);
+	if (entry.uiVertexNode == TLSFAllocator::INVALID_NODE)
+		return INVALID_HANDLE;
+
+	if (uiIndexSize > 0)
+	{
+		entry.uiIndexNode = m_pIndexAllocator->Allocate(uiIndexSize, INDEX_ALIGNMENT, entry.range.uiIndexByteOffset);
+		if (entry.uiIndexNode == TLSFAllocator::INVALID_NODE)
+		{
+			m_pVertexAllocator->Free(entry.uiVertexNode);
+			return INVALID_HANDLE;
+		}
+	}
+
+	UINT uiHandle;
+	if (!m_vecFreeHandles.empty())
+	{
+		uiHandle = m_vecFreeHandles.back();
+		m_vecFreeHandles.pop_back();
+		m_vecEntries[uiHandle] = entry;
+	}
+	else
+	{
+		uiHandle = static_cast<UINT>(m_vecEntries.size());
+		m_vecEntries.push_back(entry);
+	}
+
+	m_uiLiveCount++;
+	return uiHandle;
+}
+
+void GeometryPool::Free(UINT uiHandle)
+{
+	ASSERT(IsValid(uiHandle), "Free invalid geometry handle");
+
+	Entry& entry = m_vecEntries[uiHandle];
+	m_pVertexAllocator->Free(entry.uiVertexNode);
+	if (entry.uiIndexNode != TLSFAllocator::INVALID_NODE)
+		m_pIndexAllocator->Free(entry.uiIndexNode);
+
+	entry.bLive = false;
+	m_vecFreeHandles.push_back(uiHandle);
+	m_uiLiveCount--;
+}
+
+const GeometryRange& GeometryPool::GetRange(UINT uiHandle) const
+{
+	ASSERT(IsValid(uiHandle), "Invalid geometry handle");
+	return m_vecEntries[uiHandle].range;
+}
+
+bool GeometryPool::Rebuild(VkDeviceSize uiVertexCapacity, VkDeviceSize uiIndexCapacity,
+	std::vector<VkBufferCopy>& vecVertexCopies, std::vector<VkBufferCopy>& vecIndexCopies)
+{
+	vecVertexCopies.clear();
+	vecIndexCopies.clear();
+
+	std::vector<UINT> vecLiveHandles;
+	vecLiveHandles.reserve(m_uiLiveCount);
+	for (UINT i = 0; i < m_vecEntries.size(); ++i)
+	{
+		if (m_vecEntries[i].bLive)
+			vecLiveHandles.push_back(i);
+	}
+
+	//在空的分配器中依次分配时区间从0开始首尾相接，按原偏移的顺序排列
+	auto pVertexAllocator = std::make_unique<TLSFAllocator>(uiVertexCapacity);
+	std::sort(vecLiveHandles.begin(), vecLiveHandles.end(),
+		[this](UINT a, UINT b) { return m_vecEntries[a].range.uiVertexByteOffset < m_vecEntries[b].range.uiVertexByteOffset; });
+
+	std::vector<Entry> vecNewEntries = m_vecEntries;
+	for (UINT uiHandle : vecLiveHandles)
+	{
+		Entry& entry = vecNewEntries[uiHandle];
+		entry.uiVertexNode = pVertexAllocator->Allocate(entry.range.uiVertexSize, GetVertexAlignment(entry.range.uiVertexStride), entry.range.uiVertexByteOffset);
+		if (entry.uiVertexNode == TLSFAllocator::INVALID_NODE)
+		{
+			vecVertexCopies.clear();
+			return false;
+		}
+
+		vecVertexCopies.push_back({ m_vecEntries[uiHandle].range.uiVertexByteOffset, entry.range.uiVertexByteOffset, entry.range.uiVertexSize });
+	}
+
+	auto pIndexAllocator = std::make_unique<TLSFAllocator>(uiIndexCapacity);
+	std::sort(vecLiveHandles.begin(), vecLiveHandles.end(),
+		[this](UINT a, UINT b) { return m_vecEntries[a].range.uiIndexByteOffset < m_vecEntries[b].range.uiIndexByteOffset; });
+
+	for (UINT uiHandle : vecLiveHandles)
+	{
+		Entry& entry = vecNewEntries[uiHandle];
+		if (entry.range.uiIndexSize == 0)
+			continue;
+
+		entry.uiIndexNode = pIndexAllocator->Allocate(entry.range.uiIndexSize, INDEX_ALIGNMENT, entry.range.uiIndexByteOffset);
+		if (entry.uiIndexNode == TLSFAllocator::INVALID_NODE)
+		{
+			vecVertexCopies.clear();
+			vecIndexCopies.clear();
+			return false;
+		}
+
+		vecIndexCopies.push_back({ m_vecEntries[uiHandle].range.uiIndexByteOffset, entry.range.uiIndexByteOffset, entry.range.uiIndexSize });
+	}
+
+	m_pVertexAllocator = std::move(pVertexAllocator);
+	m_pIndexAllocator = std::move(pIndexAllocator);
+	m_vecEntries = std::move(vecNewEntries);
+	return true;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include "GLFW/glfw3.h"
+
+#include "Core.h"
+#include "TLSFAllocator.h"
+
+//一个网格在几何池中的顶点区间与索引区间
+struct GeometryRange
+{
+	VkDeviceSize uiVertexByteOffset = 0;
+	VkDeviceSize uiVertexSize = 0;
+	UINT uiVertexStride = 0;
+	VkDeviceSize uiIndexByteOffset = 0;
+	VkDeviceSize uiIndexSize = 0;
+
+	//vkCmdDrawIndexed的vertexOffset，再加上SubMesh自身的顶点偏移
+	int32_t GetVertexOffset() const { return static_cast<int32_t>(uiVertexByteOffset / uiVertexStride); }
+	//网格内索引区间的字节偏移换算为共用索引缓冲中的firstIndex
+	UINT GetFirstIndex(VkDeviceSize uiMeshIndexByteOffset, UINT uiIndexSize) const
+	{
+		return static_cast<UINT>((uiIndexByteOffset + uiMeshIndexByteOffset) / uiIndexSize);
+	}
+};
+
+//所有网格共用一个顶点缓冲与一个索引缓冲，这里只管理其中的区间，缓冲本身由调用者创建
+//每个网格得到一个句柄，绘制整个场景只需绑定一次顶点/索引缓冲
+//区间用TLSF分配；Rebuild把存活的区间紧凑地排到新容量的缓冲中，用于整理碎片与扩容，句柄保持不变
+class GeometryPool
+{
+public:
+	static constexpr UINT INVALID_HANDLE = UINT_MAX;
+	static constexpr VkDeviceSize DEFAULT_VERTEX_CAPACITY = 64ull << 20;
+	static constexpr VkDeviceSize DEFAULT_INDEX_CAPACITY = 32ull << 20;
+	//索引区间的对齐，16位与32位索引的firstIndex都能整除
+	static constexpr VkDeviceSize INDEX_ALIGNMENT = 4;
+
+	GeometryPool();
+
+	GeometryPool(const GeometryPool&) = delete;
+	GeometryPool& operator=(const GeometryPool&) = delete;
+
+	void Init(VkDeviceSize uiVertexCapacity, VkDeviceSize uiIndexCapacity);
+
+	//顶点区间按uiVertexStride对齐，使字节偏移能换算为vertexOffset；uiIndexSize可以为0
+	//没有足够大的连续区间时返回INVALID_HANDLE，调用者Rebuild后重试
+	UINT Allocate(VkDeviceSize uiVertexSize, UINT uiVertexStride, VkDeviceSize uiIndexSize);
+	void Free(UINT uiHandle);
+
+	bool IsValid(UINT uiHandle) const { return uiHandle < m_vecEntries.size() && m_vecEntries[uiHandle].bLive; }
+	const GeometryRange& GetRange(UINT uiHandle) const;
+
+	VkDeviceSize GetVertexCapacity() const { return m_pVertexAllocator->GetSize(); }
+	VkDeviceSize GetIndexCapacity() const { return m_pIndexAllocator->GetSize(); }
+	VkDeviceSize GetVertexUsedSize() const { return m_pVertexAllocator->GetUsedSize(); }
+	VkDeviceSize GetIndexUsedSize() const { return m_pIndexAllocator->GetUsedSize(); }
+	UINT GetMeshCount() const { return m_uiLiveCount; }
+
+	//按新容量从0开始紧凑地重新排列所有存活的区间，新容量不足以容纳时返回false且不做修改
+	//输出从旧缓冲复制到新缓冲的区域，调用者创建新缓冲、执行copy后替换旧缓冲
+	bool Rebuild(VkDeviceSize uiVertexCapacity, VkDeviceSize uiIndexCapacity,
+		std::vector<VkBufferCopy>& vecVertexCopies, std::vector<VkBufferCopy>& vecIndexCopies);
+
+private:
+	struct Entry
+	{
+		GeometryRange range;
+		UINT uiVertexNode;
+		UINT uiIndexNode;	//索引区间为空时为INVALID_NODE
+		bool bLive;
+	};
+
+	static VkDeviceSize GetVertexAlignment(UINT uiVertexStride);
+
+private:
+	std::unique_ptr<TLSFAllocator> m_pVertexAllocator;
+	std::unique_ptr<TLSFAllocator> m_pIndexAllocator;
+
+	std::vector<Entry> m_vecEntries;
+	std::vector<UINT> m_vecFreeHandles;
+	UINT m_uiLiveCount;
+};
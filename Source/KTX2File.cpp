@@ -0,0 +1,271 @@
+#include "KTX2File.h"
+
+#include <climits>
+#include <cstring>
+#include <numeric>
+
+static const UCHAR KTX2_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+//Khronos Data Format中用到的常量
+static constexpr UCHAR KHR_DF_MODEL_BC1A = 128;
+static constexpr UCHAR KHR_DF_MODEL_BC3 = 130;
+static constexpr UCHAR KHR_DF_PRIMARIES_BT709 = 1;
+static constexpr UCHAR KHR_DF_TRANSFER_LINEAR = 1;
+static constexpr UCHAR KHR_DF_TRANSFER_SRGB = 2;
+static constexpr UCHAR KHR_DF_CHANNEL_BC1A_COLOR = 0;
+static constexpr UCHAR KHR_DF_CHANNEL_BC3_COLOR = 0;
+static constexpr UCHAR KHR_DF_CHANNEL_BC3_ALPHA = 15;
+static constexpr UCHAR KHR_DF_SAMPLE_DATATYPE_LINEAR = 0x10;
+
+struct KTX2Header
+{
+	UCHAR identifier[12];
+	UINT uiVkFormat;
+	UINT uiTypeSize;
+	UINT uiPixelWidth;
+	UINT uiPixelHeight;
+	UINT uiPixelDepth;
+	UINT uiLayerCount;
+	UINT uiFaceCount;
+	UINT uiLevelCount;
+	UINT uiSupercompressionScheme;
+
+	UINT uiDfdByteOffset;
+	UINT uiDfdByteLength;
+	UINT uiKvdByteOffset;
+	UINT uiKvdByteLength;
+	uint64_t uiSgdByteOffset;
+	uint64_t uiSgdByteLength;
+};
+static_assert(sizeof(KTX2Header) == 80, "KTX2 header must be 80 bytes");
+
+static uint64_t AlignUp(uint64_t uiValue, uint64_t uiAlignment)
+{
+	return (uiValue + uiAlignment - 1) / uiAlignment * uiAlignment;
+}
+
+bool KTX2File::GetFormatBlockInfo(VkFormat format, UINT& uiBlockDim, UINT& uiBlockSize)
+{
+	switch (format)
+	{
+	case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+	case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+	case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+	case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+		uiBlockDim = 4;
+		uiBlockSize = 8;
+		return true;
+	case VK_FORMAT_BC3_UNORM_BLOCK:
+	case VK_FORMAT_BC3_SRGB_BLOCK:
+	case VK_FORMAT_BC7_UNORM_BLOCK:
+	case VK_FORMAT_BC7_SRGB_BLOCK:
+		uiBlockDim = 4;
+		uiBlockSize = 16;
+		return true;
+	case VK_FORMAT_R8G8B8A8_UNORM:
+	case VK_FORMAT_R8G8B8A8_SRGB:
+		uiBlockDim = 1;
+		uiBlockSize = 4;
+		return true;
+	default:
+		return false;
+	}
+}
+
+bool KTX2File::Write(const std::filesystem::path& path, VkFormat format, UINT uiWidth, UINT uiHeight,
+	const std::vector<std::vector<UCHAR>>& vecLevels)
+{
+	bool bBC3 = (format == VK_FORMAT_BC3_UNORM_BLOCK || format == VK_FORMAT_BC3_SRGB_BLOCK);
+	bool bBC1 = (format == VK_FORMAT_BC1_RGB_UNORM_BLOCK || format == VK_FORMAT_BC1_RGB_SRGB_BLOCK);
+	bool bSRGB = (format == VK_FORMAT_BC1_RGB_SRGB_BLOCK || format == VK_FORMAT_BC3_SRGB_BLOCK);
+	if ((!bBC1 && !bBC3) || vecLevels.empty())
+		return false;
+
+	UINT uiBlockDim = 0;
+	UINT uiBlockSize = 0;
+	GetFormatBlockInfo(format, uiBlockDim, uiBlockSize);
+
+	//Data Format Descriptor：一个basic descriptor block，BC1只有颜色一个sample，BC3为alpha与颜色两个sample
+	UINT uiSampleCount = bBC3 ? 2 : 1;
+	std::vector<UCHAR> vecDfd(4 + 24 + 16 * uiSampleCount, 0);
+	auto WriteU16 = [&vecDfd](size_t uiOffset, uint16_t uiValue) { memcpy(vecDfd.data() + uiOffset, &uiValue, 2); };
+	auto WriteU32 = [&vecDfd](size_t uiOffset, UINT uiValue) { memcpy(vecDfd.data() + uiOffset, &uiValue, 4); };
+	WriteU32(0, static_cast<UINT>(vecDfd.size()));
+	WriteU32(4, 0);	//vendorId = KHRONOS, descriptorType = BASICFORMAT
+	WriteU16(8, 2);	//versionNumber
+	WriteU16(10, static_cast<uint16_t>(24 + 16 * uiSampleCount));
+	vecDfd[12] = bBC3 ? KHR_DF_MODEL_BC3 : KHR_DF_MODEL_BC1A;
+	vecDfd[13] = KHR_DF_PRIMARIES_BT709;
+	vecDfd[14] = bSRGB ? KHR_DF_TRANSFER_SRGB : KHR_DF_TRANSFER_LINEAR;
+	vecDfd[15] = 0;	//straight alpha
+	vecDfd[16] = static_cast<UCHAR>(uiBlockDim - 1);
+	vecDfd[17] = static_cast<UCHAR>(uiBlockDim - 1);
+	vecDfd[20] = static_cast<UCHAR>(uiBlockSize);	//bytesPlane0
+
+	auto WriteSample = [&](UINT uiSample, uint16_t uiBitOffset, UCHAR uiChannel)
+	{
+		size_t uiOffset = 28 + 16 * uiSample;
+		WriteU16(uiOffset, uiBitOffset);
+		vecDfd[uiOffset + 2] = 63;	//bitLength - 1
+		vecDfd[uiOffset + 3] = uiChannel;
+		WriteU32(uiOffset + 8, 0);	//sampleLower
+		WriteU32(uiOffset + 12, UINT_MAX);	//sampleUpper
+	};
+	if (bBC3)
+	{
+		//sRGB只作用于颜色，alpha标记为线性
+		WriteSample(0, 0, KHR_DF_CHANNEL_BC3_ALPHA | (bSRGB ? KHR_DF_SAMPLE_DATATYPE_LINEAR : 0));
+		WriteSample(1, 64, KHR_DF_CHANNEL_BC3_COLOR);
+	}
+	else
+	{
+		WriteSample(0, 0, KHR_DF_CHANNEL_BC1A_COLOR);
+	}
+
+	UINT uiLevelCount = static_cast<UINT>(vecLevels.size());
+
+	KTX2Header header{};
+	memcpy(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER));
+	header.uiVkFormat = static_cast<UINT>(format);
+	header.uiTypeSize = 1;
+	header.uiPixelWidth = uiWidth;
+	header.uiPixelHeight = uiHeight;
+	header.uiPixelDepth = 0;
+	header.uiLayerCount = 0;
+	header.uiFaceCount = 1;
+	header.uiLevelCount = uiLevelCount;
+	header.uiSupercompressionScheme = 0;
+	header.uiDfdByteOffset = static_cast<UINT>(sizeof(KTX2Header) + sizeof(LevelIndex) * uiLevelCount);
+	header.uiDfdByteLength = static_cast<UINT>(vecDfd.size());
+
+	//mip数据从最小的一级开始存放，每级按lcm(块大小, 4)对齐
+	const uint64_t uiLevelAlignment = std::lcm<uint64_t>(uiBlockSize, 4);
+	std::vector<LevelIndex> vecLevelIndices(uiLevelCount);
+	uint64_t uiOffset = header.uiDfdByteOffset + header.uiDfdByteLength;
+	for (UINT i = uiLevelCount; i-- > 0;)
+	{
+		uiOffset = AlignUp(uiOffset, uiLevelAlignment);
+		vecLevelIndices[i].uiByteOffset = uiOffset;
+		vecLevelIndices[i].uiByteLength = vecLevels[i].size();
+		vecLevelIndices[i].uiUncompressedByteLength = vecLevels[i].size();
+		uiOffset += vecLevels[i].size();
+	}
+
+	//先写临时文件再重命名，避免中途退出留下不完整的文件
+	auto tempPath = path;
+	tempPath += ".tmp";
+	{
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+			return false;
+
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(vecLevelIndices.data()), static_cast<std::streamsize>(vecLevelIndices.size() * sizeof(LevelIndex)));
+		file.write(reinterpret_cast<const char*>(vecDfd.data()), static_cast<std::streamsize>(vecDfd.size()));
+
+		const char padding[16] = {};
+		for (UINT i = uiLevelCount; i-- > 0;)
+		{
+			uint64_t uiCurrent = static_cast<uint64_t>(file.tellp());
+			file.write(padding, static_cast<std::streamsize>(vecLevelIndices[i].uiByteOffset - uiCurrent));
+			file.write(reinterpret_cast<const char*>(vecLevels[i].data()), static_cast<std::streamsize>(vecLevels[i].size()));
+		}
+
+		if (!file.good())
+			return false;
+	}
+
+	std::error_code errorCode;
+	std::filesystem::rename(tempPath, path, errorCode);
+	return !errorCode;
+}
+
+bool KTX2File::Open(const std::filesystem::path& path)
+{
+	m_vecLevels.clear();
+	if (!m_File.Open(path))
+		return false;
+
+	const char* pData = m_File.GetData();
+	const uint64_t uiFileSize = m_File.GetSize();
+
+	KTX2Header header;
+	if (uiFileSize < sizeof(header))
+	{
+		Close();
+		return false;
+	}
+	memcpy(&header, pData, sizeof(header));
+
+	UINT uiBlockDim = 0;
+	UINT uiBlockSize = 0;
+	bool bValid = memcmp(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) == 0
+		&& GetFormatBlockInfo(static_cast<VkFormat>(header.uiVkFormat), uiBlockDim, uiBlockSize)
+		&& header.uiPixelWidth > 0 && header.uiPixelHeight > 0
+		&& header.uiPixelDepth == 0 && header.uiLayerCount == 0 && header.uiFaceCount == 1
+		&& header.uiLevelCount > 0 && header.uiLevelCount <= 32	//levelCount为0表示需要运行时生成mip，这里不支持
+		&& header.uiSupercompressionScheme == 0
+		&& sizeof(KTX2Header) + sizeof(LevelIndex) * header.uiLevelCount <= uiFileSize;
+
+	if (bValid)
+	{
+		m_vecLevels.resize(header.uiLevelCount);
+		memcpy(m_vecLevels.data(), pData + sizeof(KTX2Header), sizeof(LevelIndex) * header.uiLevelCount);
+
+		//每级的数据量需与该级的块数一致，可以整体拷贝到image
+		for (UINT i = 0; i < header.uiLevelCount && bValid; ++i)
+		{
+			UINT uiLevelWidth = std::max<UINT>(header.uiPixelWidth >> i, 1);
+			UINT uiLevelHeight = std::max<UINT>(header.uiPixelHeight >> i, 1);
+			uint64_t uiExpectedSize = static_cast<uint64_t>((uiLevelWidth + uiBlockDim - 1) / uiBlockDim)
+				* ((uiLevelHeight + uiBlockDim - 1) / uiBlockDim) * uiBlockSize;
+			const LevelIndex& level = m_vecLevels[i];
+			bValid = level.uiByteLength == uiExpectedSize
+				&& level.uiByteOffset <= uiFileSize && level.uiByteLength <= uiFileSize - level.uiByteOffset;
+		}
+	}
+
+	if (!bValid)
+	{
+		Log::Warn(std::format("{} is not a supported KTX2 texture", path.string()));
+		Close();
+		m_vecLevels.clear();
+		return false;
+	}
+
+	m_Format = static_cast<VkFormat>(header.uiVkFormat);
+	m_uiWidth = header.uiPixelWidth;
+	m_uiHeight = header.uiPixelHeight;
+	m_uiBlockDim = uiBlockDim;
+	m_uiBlockSize = uiBlockSize;
+	return true;
+}
+
+VkDeviceSize KTX2File::GetRegionSize(UINT uiWidth, UINT uiHeight) const
+{
+	return static_cast<VkDeviceSize>((uiWidth + m_uiBlockDim - 1) / m_uiBlockDim)
+		* ((uiHeight + m_uiBlockDim - 1) / m_uiBlockDim) * m_uiBlockSize;
+}
+
+VkDeviceSize KTX2File::CopyRegion(UINT uiLevel, UINT uiX, UINT uiY, UINT uiWidth, UINT uiHeight, UCHAR* pDst) const
+{
+	UINT uiLevelWidth = std::max<UINT>(m_uiWidth >> uiLevel, 1);
+	UINT uiLevelHeight = std::max<UINT>(m_uiHeight >> uiLevel, 1);
+	if (uiX >= uiLevelWidth || uiY >= uiLevelHeight)
+		return 0;
+
+	uiWidth = std::min(uiWidth, uiLevelWidth - uiX);
+	uiHeight = std::min(uiHeight, uiLevelHeight - uiY);
+
+	//每行块数据在该级中连续存放，区域的一行块对应一次memcpy
+	size_t uiLevelRowPitch = static_cast<size_t>((uiLevelWidth + m_uiBlockDim - 1) / m_uiBlockDim) * m_uiBlockSize;
+	size_t uiRowSize = static_cast<size_t>((uiWidth + m_uiBlockDim - 1) / m_uiBlockDim) * m_uiBlockSize;
+	UINT uiBlockRowCount = (uiHeight + m_uiBlockDim - 1) / m_uiBlockDim;
+
+	const UCHAR* pSrc = GetLevelData(uiLevel) + static_cast<size_t>(uiY / m_uiBlockDim) * uiLevelRowPitch
+		+ static_cast<size_t>(uiX / m_uiBlockDim) * m_uiBlockSize;
+	for (UINT i = 0; i < uiBlockRowCount; ++i)
+		memcpy(pDst + i * uiRowSize, pSrc + i * uiLevelRowPitch, uiRowSize);
+
+	return static_cast<VkDeviceSize>(uiRowSize) * uiBlockRowCount;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include "GLFW/glfw3.h"
+
+#include "Core.h"
+#include "MappedFile.h"
+
+//KTX2纹理容器，只支持单层、单面、无超压缩的2D纹理
+//读取时内存映射整个文件，各级mip的数据可以直接拷贝进暂存缓冲，无需解码
+class KTX2File
+{
+public:
+	//vecLevels[0]为最大的一级，数据按format的块紧凑排列
+	//DFD只为BC1/BC3生成，其他格式返回false
+	static bool Write(const std::filesystem::path& path, VkFormat format, UINT uiWidth, UINT uiHeight,
+		const std::vector<std::vector<UCHAR>>& vecLevels);
+
+	//块的边长（非压缩格式为1）与每块字节数，不支持的格式返回false
+	static bool GetFormatBlockInfo(VkFormat format, UINT& uiBlockDim, UINT& uiBlockSize);
+
+	bool Open(const std::filesystem::path& path);
+	void Close() { m_File.Close(); }
+
+	VkFormat GetFormat() const { return m_Format; }
+	UINT GetWidth() const { return m_uiWidth; }
+	UINT GetHeight() const { return m_uiHeight; }
+	UINT GetLevelCount() const { return static_cast<UINT>(m_vecLevels.size()); }
+
+	const UCHAR* GetLevelData(UINT uiLevel) const { return reinterpret_cast<const UCHAR*>(m_File.GetData()) + m_vecLevels[uiLevel].uiByteOffset; }
+	VkDeviceSize GetLevelSize(UINT uiLevel) const { return m_vecLevels[uiLevel].uiByteLength; }
+
+	UINT GetBlockDim() const { return m_uiBlockDim; }
+	UINT GetBlockSize() const { return m_uiBlockSize; }
+	//该级中一个矩形区域的数据量，区域按块对齐后计算
+	VkDeviceSize GetRegionSize(UINT uiWidth, UINT uiHeight) const;
+	//把该级中的矩形区域按块紧凑地拷贝到pDst，返回写入的字节数
+	//uiX、uiY需是块边长的整数倍，区域超出该级的部分被裁掉
+	VkDeviceSize CopyRegion(UINT uiLevel, UINT uiX, UINT uiY, UINT uiWidth, UINT uiHeight, UCHAR* pDst) const;
+
+private:
+	struct LevelIndex
+	{
+		uint64_t uiByteOffset;
+		uint64_t uiByteLength;
+		uint64_t uiUncompressedByteLength;
+	};
+
+	MappedFile m_File;
+	VkFormat m_Format = VK_FORMAT_UNDEFINED;
+	UINT m_uiWidth = 0;
+	UINT m_uiHeight = 0;
+	UINT m_uiBlockDim = 0;
+	UINT m_uiBlockSize = 0;
+	std::vector<LevelIndex> m_vecLevels;
+};
@@ -2,9 +2,9 @@
 
 struct PointLight
 {
-	//˥
-	float K_constant; //
-	float K_linear;		//һ 
+	//衰减
+	float K_constant; //常数项
+	float K_linear;		//一次向 
 	float K_quadratic;
 
 };
\ No newline at end of file
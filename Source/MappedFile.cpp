@@ -0,0 +1,104 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+bool MappedFile::Open(const std::filesystem::path& path)
+{
+	Close();
+
+#ifdef _WIN32
+	HANDLE hFile = CreateFileW(path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize{};
+	if (!GetFileSizeEx(hFile, &fileSize) || fileSize.QuadPart == 0)
+	{
+		CloseHandle(hFile);
+		return false;
+	}
+
+	HANDLE hMapping = CreateFileMappingW(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (hMapping == nullptr)
+	{
+		CloseHandle(hFile);
+		return false;
+	}
+
+	void* pView = MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+	if (pView == nullptr)
+	{
+		CloseHandle(hMapping);
+		CloseHandle(hFile);
+		return false;
+	}
+
+	m_hFile = hFile;
+	m_hMapping = hMapping;
+	m_pData = static_cast<const char*>(pView);
+	m_uiSize = static_cast<size_t>(fileSize.QuadPart);
+#else
+	int nFileDescriptor = open(path.c_str(), O_RDONLY);
+	if (nFileDescriptor < 0)
+		return false;
+
+	struct stat fileStat{};
+	if (fstat(nFileDescriptor, &fileStat) != 0 || fileStat.st_size == 0)
+	{
+		close(nFileDescriptor);
+		return false;
+	}
+
+	void* pView = mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, nFileDescriptor, 0);
+	if (pView == MAP_FAILED)
+	{
+		close(nFileDescriptor);
+		return false;
+	}
+	madvise(pView, static_cast<size_t>(fileStat.st_size), MADV_SEQUENTIAL);
+
+	m_nFileDescriptor = nFileDescriptor;
+	m_pData = static_cast<const char*>(pView);
+	m_uiSize = static_cast<size_t>(fileStat.st_size);
+#endif
+
+	return true;
+}
+
+void MappedFile::Close()
+{
+#ifdef _WIN32
+	if (m_pData)
+		UnmapViewOfFile(m_pData);
+	if (m_hMapping)
+		CloseHandle(m_hMapping);
+	if (m_hFile)
+		CloseHandle(m_hFile);
+	m_hFile = nullptr;
+	m_hMapping = nullptr;
+#else
+	if (m_pData)
+		munmap(const_cast<char*>(m_pData), m_uiSize);
+	if (m_nFileDescriptor >= 0)
+		close(m_nFileDescriptor);
+	m_nFileDescriptor = -1;
+#endif
+
+	m_pData = nullptr;
+	m_uiSize = 0;
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include "Core.h"
+
+//只读内存映射文件，析构时自动解除映射
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool Open(const std::filesystem::path& path);
+	void Close();
+
+	bool IsOpen() const { return m_pData != nullptr; }
+	const char* GetData() const { return m_pData; }
+	size_t GetSize() const { return m_uiSize; }
+
+private:
+#ifdef _WIN32
+	void* m_hFile = nullptr;
+	void* m_hMapping = nullptr;
+#else
+	int m_nFileDescriptor = -1;
+#endif
+	const char* m_pData = nullptr;
+	size_t m_uiSize = 0;
+};
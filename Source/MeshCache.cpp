@@ -0,0 +1,308 @@
+#include "MeshCache.h"
+#include "VulkanRenderer.h"
+
+#include <cstring>
+
+static const char MESH_CACHE_MAGIC[8] = { 'V', 'R', 'M', 'E', 'S', 'H', '\0', '\0' };
+static const std::filesystem::path MESH_CACHE_DIRECTORY = "./Cache/Mesh";
+
+//各数据段按16字节对齐，保证映射后可直接按顶点结构/SubMesh访问
+static constexpr uint64_t MESH_CACHE_ALIGNMENT = 16;
+
+struct MeshCacheHeader
+{
+	char magic[8];
+	UINT uiVersion;
+	UINT uiVertexFormat;
+	UINT uiVertexStride;	//顶点结构变化时缓存自动失效
+	UINT uiFlags;
+	float fQuantizationCenter[3];
+	float fQuantizationExtent[3];
+
+	uint64_t uiSourceSize;
+	int64_t nSourceWriteTime;
+	uint64_t uiSourceHash;
+
+	uint64_t uiSourcePathOffset;
+	uint64_t uiSourcePathLength;
+	uint64_t uiVertexOffset;
+	uint64_t uiVertexCount;
+	uint64_t uiIndexOffset;
+	uint64_t uiIndexDataSize;	//打包后的16/32位混合索引，按SubMesh::indexType解释
+	uint64_t uiSubMeshOffset;
+	uint64_t uiSubMeshCount;
+};
+
+static uint64_t AlignUp(uint64_t uiValue, uint64_t uiAlignment)
+{
+	return (uiValue + uiAlignment - 1) & ~(uiAlignment - 1);
+}
+
+//逐8字节混合的64位哈希，用于校验源文件内容，速度接近内存带宽
+static uint64_t HashBytes(const char* pData, size_t uiSize)
+{
+	const uint64_t uiMul = 0x9e3779b97f4a7c15ull;
+	uint64_t uiHash = 0xcbf29ce484222325ull ^ (uiSize * uiMul);
+
+	size_t i = 0;
+	for (; i + 8 <= uiSize; i += 8)
+	{
+		uint64_t uiWord;
+		memcpy(&uiWord, pData + i, sizeof(uiWord));
+		uiHash = (uiHash ^ uiWord) * uiMul;
+		uiHash ^= uiHash >> 29;
+	}
+	for (; i < uiSize; ++i)
+	{
+		uiHash = (uiHash ^ static_cast<UCHAR>(pData[i])) * 0x100000001b3ull;
+	}
+
+	uiHash ^= uiHash >> 32;
+	return uiHash;
+}
+
+static bool HashSourceFile(const std::filesystem::path& sourcePath, uint64_t& uiHash)
+{
+	MappedFile sourceFile;
+	if (!sourceFile.Open(sourcePath))
+		return false;
+
+	uiHash = HashBytes(sourceFile.GetData(), sourceFile.GetSize());
+	return true;
+}
+
+static int64_t GetSourceWriteTime(const std::filesystem::path& sourcePath)
+{
+	std::error_code errorCode;
+	auto writeTime = std::filesystem::last_write_time(sourcePath, errorCode);
+	return errorCode ? 0 : static_cast<int64_t>(writeTime.time_since_epoch().count());
+}
+
+//只改写缓存头中的修改时间，其余内容不变
+static bool RewriteSourceWriteTime(const std::filesystem::path& cachePath, int64_t nSourceWriteTime)
+{
+	std::fstream file(cachePath, std::ios::binary | std::ios::in | std::ios::out);
+	if (!file.is_open())
+		return false;
+
+	file.seekp(offsetof(MeshCacheHeader, nSourceWriteTime));
+	file.write(reinterpret_cast<const char*>(&nSourceWriteTime), sizeof(nSourceWriteTime));
+	return file.good();
+}
+
+//SubMesh及各级LOD的区间都需落在顶点与索引数据之内，损坏的缓存不能产生越界的绘制
+static bool IsSubMeshValid(const SubMesh& subMesh, uint64_t uiVertexCount, uint64_t uiIndexDataSize)
+{
+	if (subMesh.indexType != VK_INDEX_TYPE_UINT16 && subMesh.indexType != VK_INDEX_TYPE_UINT32)
+		return false;
+	if (static_cast<uint64_t>(subMesh.uiVertexOffset) + subMesh.uiVertexCount > uiVertexCount)
+		return false;
+	if (subMesh.uiLODCount > SubMesh::MAX_LOD_COUNT)
+		return false;
+
+	const UINT uiIndexSize = subMesh.GetIndexSize();
+	for (UINT i = 0; i <= subMesh.uiLODCount; ++i)
+	{
+		SubMeshLOD lod = subMesh.GetLOD(i);
+		if (lod.uiIndexByteOffset % uiIndexSize != 0
+			|| static_cast<uint64_t>(lod.uiIndexByteOffset) + static_cast<uint64_t>(lod.uiIndexCount) * uiIndexSize > uiIndexDataSize)
+			return false;
+	}
+	return true;
+}
+
+std::filesystem::path MeshCache::GetCachePath(const std::filesystem::path& sourcePath)
+{
+	std::string strAbsolutePath = std::filesystem::absolute(sourcePath).generic_string();
+	uint64_t uiPathHash = HashBytes(strAbsolutePath.data(), strAbsolutePath.size());
+
+	return MESH_CACHE_DIRECTORY / std::format("{}_{:016x}.vrmesh", sourcePath.stem().string(), uiPathHash);
+}
+
+bool MeshCache::Load(const std::filesystem::path& sourcePath, VertexFormat vertexFormat, UINT uiVertexStride, UINT uiFlags)
+{
+	Release();
+
+	std::error_code errorCode;
+	uint64_t uiSourceSize = std::filesystem::file_size(sourcePath, errorCode);
+	if (errorCode)
+		return false;
+
+	auto cachePath = GetCachePath(sourcePath);
+	if (!std::filesystem::exists(cachePath) || !m_File.Open(cachePath))
+		return false;
+
+	const char* pData = m_File.GetData();
+	const uint64_t uiFileSize = m_File.GetSize();
+
+	MeshCacheHeader header;
+	if (uiFileSize < sizeof(header))
+	{
+		Release();
+		return false;
+	}
+	memcpy(&header, pData, sizeof(header));
+
+	bool bValid = memcmp(header.magic, MESH_CACHE_MAGIC, sizeof(MESH_CACHE_MAGIC)) == 0
+		&& header.uiVersion == VERSION
+		&& header.uiVertexFormat == static_cast<UINT>(vertexFormat)
+		&& header.uiVertexStride == uiVertexStride
+		&& header.uiFlags == uiFlags
+		&& header.uiSourceSize == uiSourceSize
+		&& header.uiVertexCount <= uiFileSize && header.uiIndexDataSize <= uiFileSize
+		&& header.uiSourcePathOffset + header.uiSourcePathLength <= uiFileSize
+		&& header.uiVertexOffset % MESH_CACHE_ALIGNMENT == 0
+		&& header.uiVertexOffset + header.uiVertexCount * uiVertexStride <= uiFileSize
+		&& header.uiIndexOffset % MESH_CACHE_ALIGNMENT == 0
+		&& header.uiIndexOffset + header.uiIndexDataSize <= uiFileSize
+		&& header.uiSubMeshCount <= uiFileSize
+		&& header.uiSubMeshOffset % MESH_CACHE_ALIGNMENT == 0
+		&& header.uiSubMeshOffset + header.uiSubMeshCount * sizeof(SubMesh) <= uiFileSize;
+
+	if (bValid)
+	{
+		std::string strCachedPath(pData + header.uiSourcePathOffset, header.uiSourcePathLength);
+		bValid = strCachedPath == std::filesystem::absolute(sourcePath).generic_string();
+	}
+
+	if (bValid)
+	{
+		const SubMesh* pSubMeshes = reinterpret_cast<const SubMesh*>(pData + header.uiSubMeshOffset);
+		for (uint64_t i = 0; i < header.uiSubMeshCount && bValid; ++i)
+			bValid = IsSubMeshValid(pSubMeshes[i], header.uiVertexCount, header.uiIndexDataSize);
+	}
+
+	//修改时间不一致时（如重新checkout）再比较内容哈希，内容未变则缓存仍然有效
+	const int64_t nSourceWriteTime = GetSourceWriteTime(sourcePath);
+	bool bRehashed = false;
+	if (bValid && header.nSourceWriteTime != nSourceWriteTime)
+	{
+		uint64_t uiSourceHash = 0;
+		bValid = HashSourceFile(sourcePath, uiSourceHash) && uiSourceHash == header.uiSourceHash;
+		bRehashed = true;
+	}
+
+	if (!bValid)
+	{
+		Log::Warn(std::format("Mesh cache {} is stale", cachePath.string()));
+		Release();
+		return false;
+	}
+
+	//记录新的修改时间，之后的启动不必再对整个源文件计算哈希；映射期间不能写入，先关闭再重新映射
+	if (bRehashed)
+	{
+		m_File.Close();
+		if (!RewriteSourceWriteTime(cachePath, nSourceWriteTime))
+			Log::Warn(std::format("Update source write time of mesh cache {} failed", cachePath.string()));
+		if (!m_File.Open(cachePath) || m_File.GetSize() != uiFileSize)
+		{
+			Release();
+			return false;
+		}
+		pData = m_File.GetData();
+	}
+
+	m_pVertexData = pData + header.uiVertexOffset;
+	m_uiVertexCount = static_cast<size_t>(header.uiVertexCount);
+	m_VertexQuantization.center = { header.fQuantizationCenter[0], header.fQuantizationCenter[1], header.fQuantizationCenter[2] };
+	m_VertexQuantization.extent = { header.fQuantizationExtent[0], header.fQuantizationExtent[1], header.fQuantizationExtent[2] };
+	m_pIndexData = reinterpret_cast<const UCHAR*>(pData + header.uiIndexOffset);
+	m_uiIndexDataSize = static_cast<size_t>(header.uiIndexDataSize);
+	m_pSubMeshes = reinterpret_cast<const SubMesh*>(pData + header.uiSubMeshOffset);
+	m_uiSubMeshCount = static_cast<size_t>(header.uiSubMeshCount);
+
+	return true;
+}
+
+void MeshCache::Release()
+{
+	m_File.Close();
+
+	m_pVertexData = nullptr;
+	m_uiVertexCount = 0;
+	m_VertexQuantization = VertexQuantization();
+	m_pIndexData = nullptr;
+	m_uiIndexDataSize = 0;
+	m_pSubMeshes = nullptr;
+	m_uiSubMeshCount = 0;
+}
+
+bool MeshCache::Write(const std::filesystem::path& sourcePath, VertexFormat vertexFormat, UINT uiVertexStride, UINT uiFlags,
+	const void* pVertexData, size_t uiVertexCount, const VertexQuantization& quantization,
+	const std::vector<UCHAR>& vecIndexData, const std::vector<SubMesh>& vecSubMeshes)
+{
+	std::error_code errorCode;
+	uint64_t uiSourceSize = std::filesystem::file_size(sourcePath, errorCode);
+	if (errorCode)
+		return false;
+
+	uint64_t uiSourceHash = 0;
+	if (!HashSourceFile(sourcePath, uiSourceHash))
+		return false;
+
+	std::string strAbsolutePath = std::filesystem::absolute(sourcePath).generic_string();
+
+	MeshCacheHeader header{};
+	memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(MESH_CACHE_MAGIC));
+	header.uiVersion = VERSION;
+	header.uiVertexFormat = static_cast<UINT>(vertexFormat);
+	header.uiVertexStride = uiVertexStride;
+	header.uiFlags = uiFlags;
+	for (int i = 0; i < 3; ++i)
+	{
+		header.fQuantizationCenter[i] = quantization.center[i];
+		header.fQuantizationExtent[i] = quantization.extent[i];
+	}
+	header.uiSourceSize = uiSourceSize;
+	header.nSourceWriteTime = GetSourceWriteTime(sourcePath);
+	header.uiSourceHash = uiSourceHash;
+	header.uiSourcePathOffset = sizeof(MeshCacheHeader);
+	header.uiSourcePathLength = strAbsolutePath.size();
+	header.uiVertexOffset = AlignUp(header.uiSourcePathOffset + header.uiSourcePathLength, MESH_CACHE_ALIGNMENT);
+	header.uiVertexCount = uiVertexCount;
+	header.uiIndexOffset = AlignUp(header.uiVertexOffset + header.uiVertexCount * uiVertexStride, MESH_CACHE_ALIGNMENT);
+	header.uiIndexDataSize = vecIndexData.size();
+	header.uiSubMeshOffset = AlignUp(header.uiIndexOffset + header.uiIndexDataSize, MESH_CACHE_ALIGNMENT);
+	header.uiSubMeshCount = vecSubMeshes.size();
+
+	auto cachePath = GetCachePath(sourcePath);
+	std::filesystem::create_directories(cachePath.parent_path(), errorCode);
+
+	//先写临时文件再重命名，避免中途退出留下不完整的缓存
+	auto tempPath = cachePath;
+	tempPath += ".tmp";
+	{
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+			return false;
+
+		const char padding[MESH_CACHE_ALIGNMENT] = {};
+		auto WritePadding = [&file, &padding](uint64_t uiOffset)
+		{
+			uint64_t uiCurrent = static_cast<uint64_t>(file.tellp());
+			file.write(padding, static_cast<std::streamsize>(uiOffset - uiCurrent));
+		};
+
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(strAbsolutePath.data(), static_cast<std::streamsize>(strAbsolutePath.size()));
+		WritePadding(header.uiVertexOffset);
+		file.write(static_cast<const char*>(pVertexData), static_cast<std::streamsize>(uiVertexCount * uiVertexStride));
+		WritePadding(header.uiIndexOffset);
+		file.write(reinterpret_cast<const char*>(vecIndexData.data()), static_cast<std::streamsize>(vecIndexData.size()));
+		WritePadding(header.uiSubMeshOffset);
+		file.write(reinterpret_cast<const char*>(vecSubMeshes.data()), static_cast<std::streamsize>(vecSubMeshes.size() * sizeof(SubMesh)));
+
+		if (!file.good())
+			return false;
+	}
+
+	std::filesystem::rename(tempPath, cachePath, errorCode);
+	if (errorCode)
+	{
+		std::filesystem::remove(tempPath, errorCode);
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include "Core.h"
+#include "MappedFile.h"
+#include "VertexFormat.h"
+
+struct SubMesh;
+
+//.vrmesh二进制网格缓存
+//首次加载模型后写入最终的顶点/索引数组，之后直接内存映射，数据可不经任何逐顶点处理送入Staging Buffer
+//缓存以源文件路径、修改时间与内容哈希为键，任一不匹配即视为失效
+class MeshCache
+{
+public:
+	static constexpr UINT VERSION = 6;
+
+	//影响缓存内容的加载选项，写入缓存头，与当前选项不一致时缓存失效
+	static constexpr UINT FLAG_OPTIMIZED = 1 << 0;
+	static constexpr UINT FLAG_OPTIMIZED_OVERDRAW = 1 << 1;
+	static constexpr UINT FLAG_LOD = 1 << 2;
+
+	MeshCache() = default;
+
+	//顶点格式、步长或加载选项与缓存不一致时视为失效，重新加载后覆盖
+	bool Load(const std::filesystem::path& sourcePath, VertexFormat vertexFormat, UINT uiVertexStride, UINT uiFlags);
+	void Release();
+
+	static bool Write(const std::filesystem::path& sourcePath, VertexFormat vertexFormat, UINT uiVertexStride, UINT uiFlags,
+		const void* pVertexData, size_t uiVertexCount, const VertexQuantization& quantization,
+		const std::vector<UCHAR>& vecIndexData, const std::vector<SubMesh>& vecSubMeshes);
+
+	static std::filesystem::path GetCachePath(const std::filesystem::path& sourcePath);
+
+	bool IsLoaded() const { return m_File.IsOpen(); }
+
+	const void* GetVertexData() const { return m_pVertexData; }
+	size_t GetVertexCount() const { return m_uiVertexCount; }
+	const VertexQuantization& GetVertexQuantization() const { return m_VertexQuantization; }
+	const UCHAR* GetIndexData() const { return m_pIndexData; }
+	size_t GetIndexDataSize() const { return m_uiIndexDataSize; }
+	const SubMesh* GetSubMeshes() const { return m_pSubMeshes; }
+	size_t GetSubMeshCount() const { return m_uiSubMeshCount; }
+
+private:
+	MappedFile m_File;
+
+	const void* m_pVertexData = nullptr;
+	size_t m_uiVertexCount = 0;
+	VertexQuantization m_VertexQuantization;
+	const UCHAR* m_pIndexData = nullptr;
+	size_t m_uiIndexDataSize = 0;
+	const SubMesh* m_pSubMeshes = nullptr;
+	size_t m_uiSubMeshCount = 0;
+};
@@ -0,0 +1,308 @@
+#include "MeshOptimizer.h"
+#include "VulkanRenderer.h"
+
+#include <climits>
+#include <numeric>
+
+static constexpr UINT INVALID_VERTEX = UINT_MAX;
+
+//以时间戳近似FIFO缓存：顶点的时间戳距当前时间不超过缓存大小即视为命中
+class VertexCacheSimulator
+{
+public:
+	VertexCacheSimulator(size_t uiVertexCount, UINT uiCacheSize)
+		: m_vecTimeStamp(uiVertexCount, 0), m_uiCacheSize(uiCacheSize), m_uiTime(uiCacheSize + 1)
+	{
+	}
+
+	//返回该三角形导致的顶点变换次数
+	UINT Process(const UINT* pTriangle)
+	{
+		UINT uiMissCount = 0;
+		for (int i = 0; i < 3; ++i)
+		{
+			UINT& uiTimeStamp = m_vecTimeStamp[pTriangle[i]];
+			if (m_uiTime - uiTimeStamp > m_uiCacheSize)
+			{
+				uiTimeStamp = m_uiTime++;
+				++uiMissCount;
+			}
+		}
+		return uiMissCount;
+	}
+
+	void Flush() { m_uiTime += m_uiCacheSize + 1; }
+
+private:
+	std::vector<UINT> m_vecTimeStamp;
+	UINT m_uiCacheSize;
+	UINT m_uiTime;
+};
+
+bool MeshOptimizer::IsIndexRangeValid(const UINT* pIndices, size_t uiIndexCount, size_t uiVertexCount)
+{
+	return std::all_of(pIndices, pIndices + uiIndexCount, [uiVertexCount](UINT uiIndex) { return uiIndex < uiVertexCount; });
+}
+
+MeshOptimizer::VertexCacheStats MeshOptimizer::AnalyzeVertexCache(const UINT* pIndices, size_t uiIndexCount, size_t uiVertexCount, UINT uiCacheSize)
+{
+	VertexCacheStats stats;
+	stats.uiTriangleCount = uiIndexCount / 3;
+	stats.uiVertexCount = uiVertexCount;
+
+	//严格的FIFO模拟，与OptimizeVertexCache内部使用的近似无关，以便客观比较优化前后
+	std::vector<UINT> vecCache(uiCacheSize, INVALID_VERTEX);
+	std::vector<bool> vecInCache(uiVertexCount, false);
+	size_t uiHead = 0;
+
+	for (size_t i = 0; i < stats.uiTriangleCount * 3; ++i)
+	{
+		UINT uiVertex = pIndices[i];
+		if (vecInCache[uiVertex])
+			continue;
+
+		if (vecCache[uiHead] != INVALID_VERTEX)
+			vecInCache[vecCache[uiHead]] = false;
+		vecCache[uiHead] = uiVertex;
+		vecInCache[uiVertex] = true;
+		uiHead = (uiHead + 1) % uiCacheSize;
+
+		++stats.uiTransformCount;
+	}
+
+	return stats;
+}
+
+void MeshOptimizer::OptimizeVertexCache(UINT* pIndices, size_t uiIndexCount, size_t uiVertexCount, UINT uiCacheSize, std::vector<UINT>* pClusters)
+{
+	const size_t uiTriangleCount = uiIndexCount / 3;
+
+	if (pClusters)
+	{
+		pClusters->clear();
+		pClusters->push_back(0);
+	}
+
+	if (uiTriangleCount == 0 || uiVertexCount == 0)
+		return;
+
+	//顶点->三角形邻接表，vecLiveCount为顶点尚未输出的三角形数
+	std::vector<UINT> vecLiveCount(uiVertexCount, 0);
+	for (size_t i = 0; i < uiTriangleCount * 3; ++i)
+		vecLiveCount[pIndices[i]]++;
+
+	std::vector<UINT> vecAdjacencyOffset(uiVertexCount + 1, 0);
+	std::partial_sum(vecLiveCount.begin(), vecLiveCount.end(), vecAdjacencyOffset.begin() + 1);
+
+	std::vector<UINT> vecAdjacency(uiTriangleCount * 3);
+	std::vector<UINT> vecFillOffset(vecAdjacencyOffset.begin(), vecAdjacencyOffset.end() - 1);
+	for (size_t i = 0; i < uiTriangleCount * 3; ++i)
+		vecAdjacency[vecFillOffset[pIndices[i]]++] = static_cast<UINT>(i / 3);
+
+	std::vector<UINT> vecTimeStamp(uiVertexCount, 0);
+	std::vector<bool> vecEmitted(uiTriangleCount, false);
+	std::vector<UINT> vecDeadEndStack;
+	std::vector<UINT> vecCandidates;
+	std::vector<UINT> vecResult;
+	vecDeadEndStack.reserve(uiTriangleCount * 3);
+	vecResult.reserve(uiTriangleCount * 3);
+
+	UINT uiTime = uiCacheSize + 1;
+	size_t uiScanCursor = 0;
+	UINT uiFanningVertex = 0;
+
+	while (uiFanningVertex != INVALID_VERTEX)
+	{
+		//输出以当前顶点为扇心的所有剩余三角形
+		vecCandidates.clear();
+		for (UINT j = vecAdjacencyOffset[uiFanningVertex]; j < vecAdjacencyOffset[uiFanningVertex + 1]; ++j)
+		{
+			UINT uiTriangle = vecAdjacency[j];
+			if (vecEmitted[uiTriangle])
+				continue;
+
+			for (int k = 0; k < 3; ++k)
+			{
+				UINT uiVertex = pIndices[uiTriangle * 3 + k];
+				vecResult.push_back(uiVertex);
+				vecDeadEndStack.push_back(uiVertex);
+				vecCandidates.push_back(uiVertex);
+				vecLiveCount[uiVertex]--;
+
+				if (uiTime - vecTimeStamp[uiVertex] > uiCacheSize)
+					vecTimeStamp[uiVertex] = uiTime++;
+			}
+			vecEmitted[uiTriangle] = true;
+		}
+
+		//在刚输出的顶点中选择扇完剩余三角形后仍留在缓存中、且在缓存中最久的顶点
+		UINT uiNextVertex = INVALID_VERTEX;
+		int nBestPriority = -1;
+		for (UINT uiCandidate : vecCandidates)
+		{
+			if (vecLiveCount[uiCandidate] == 0)
+				continue;
+
+			int nPriority = 0;
+			if (uiTime - vecTimeStamp[uiCandidate] + 2 * vecLiveCount[uiCandidate] <= uiCacheSize)
+				nPriority = static_cast<int>(uiTime - vecTimeStamp[uiCandidate]);
+
+			if (nPriority > nBestPriority)
+			{
+				nBestPriority = nPriority;
+				uiNextVertex = uiCandidate;
+			}
+		}
+
+		if (uiNextVertex == INVALID_VERTEX)
+		{
+			//死胡同：先回溯最近输出的顶点，再按顶点顺序扫描，此处缓存局部性中断，作为overdraw的硬边界
+			while (!vecDeadEndStack.empty() && uiNextVertex == INVALID_VERTEX)
+			{
+				UINT uiVertex = vecDeadEndStack.back();
+				vecDeadEndStack.pop_back();
+				if (vecLiveCount[uiVertex] > 0)
+					uiNextVertex = uiVertex;
+			}
+
+			for (; uiScanCursor < uiVertexCount && uiNextVertex == INVALID_VERTEX; ++uiScanCursor)
+			{
+				if (vecLiveCount[uiScanCursor] > 0)
+					uiNextVertex = static_cast<UINT>(uiScanCursor);
+			}
+
+			UINT uiBoundary = static_cast<UINT>(vecResult.size() / 3);
+			if (pClusters && uiNextVertex != INVALID_VERTEX && pClusters->back() != uiBoundary)
+				pClusters->push_back(uiBoundary);
+		}
+
+		uiFanningVertex = uiNextVertex;
+	}
+
+	ASSERT(vecResult.size() == uiTriangleCount * 3, "Vertex cache optimization lost triangles");
+	std::copy(vecResult.begin(), vecResult.end(), pIndices);
+}
+
+void MeshOptimizer::OptimizeOverdraw(UINT* pIndices, size_t uiIndexCount, const Vertex3D* pVertices, size_t uiVertexCount,
+	const std::vector<UINT>& vecClusters, UINT uiCacheSize, float fThreshold)
+{
+	const size_t uiTriangleCount = uiIndexCount / 3;
+	if (uiTriangleCount < 2 || vecClusters.empty())
+		return;
+
+	//在硬边界内，每当当前子簇的ACMR不高于整簇ACMR * fThreshold时切分，使簇变小而不明显损失缓存命中率
+	std::vector<UINT> vecSoftClusters;
+	VertexCacheSimulator simulator(uiVertexCount, uiCacheSize);
+	for (size_t c = 0; c < vecClusters.size(); ++c)
+	{
+		size_t uiBegin = vecClusters[c];
+		size_t uiEnd = (c + 1 < vecClusters.size()) ? vecClusters[c + 1] : uiTriangleCount;
+
+		simulator.Flush();
+		UINT uiClusterMissCount = 0;
+		for (size_t t = uiBegin; t < uiEnd; ++t)
+			uiClusterMissCount += simulator.Process(pIndices + t * 3);
+		float fClusterThreshold = fThreshold * uiClusterMissCount / static_cast<float>(uiEnd - uiBegin);
+
+		vecSoftClusters.push_back(static_cast<UINT>(uiBegin));
+		simulator.Flush();
+		UINT uiRunningMissCount = 0;
+		UINT uiRunningTriangleCount = 0;
+		for (size_t t = uiBegin; t < uiEnd; ++t)
+		{
+			uiRunningMissCount += simulator.Process(pIndices + t * 3);
+			uiRunningTriangleCount++;
+
+			if (t + 1 < uiEnd && uiRunningMissCount <= fClusterThreshold * uiRunningTriangleCount)
+			{
+				vecSoftClusters.push_back(static_cast<UINT>(t + 1));
+				simulator.Flush();
+				uiRunningMissCount = 0;
+				uiRunningTriangleCount = 0;
+			}
+		}
+	}
+
+	//簇的排序依据：簇中心相对网格中心沿簇平均法线的距离，越靠外、越朝外的簇越先绘制，更可能遮挡后绘制的簇
+	const size_t uiClusterCount = vecSoftClusters.size();
+	std::vector<glm::vec3> vecClusterCentroid(uiClusterCount, glm::vec3(0.f));
+	std::vector<glm::vec3> vecClusterNormal(uiClusterCount, glm::vec3(0.f));
+	std::vector<float> vecClusterArea(uiClusterCount, 0.f);
+	glm::vec3 meshCentroid(0.f);
+	float fMeshArea = 0.f;
+
+	for (size_t c = 0; c < uiClusterCount; ++c)
+	{
+		size_t uiBegin = vecSoftClusters[c];
+		size_t uiEnd = (c + 1 < uiClusterCount) ? vecSoftClusters[c + 1] : uiTriangleCount;
+
+		for (size_t t = uiBegin; t < uiEnd; ++t)
+		{
+			const glm::vec3& p0 = pVertices[pIndices[t * 3 + 0]].pos;
+			const glm::vec3& p1 = pVertices[pIndices[t * 3 + 1]].pos;
+			const glm::vec3& p2 = pVertices[pIndices[t * 3 + 2]].pos;
+
+			glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+			float fArea = glm::length(normal);
+			glm::vec3 centroid = (p0 + p1 + p2) * (1.f / 3.f);
+
+			vecClusterCentroid[c] = vecClusterCentroid[c] + centroid * fArea;
+			vecClusterNormal[c] = vecClusterNormal[c] + normal;
+			vecClusterArea[c] += fArea;
+		}
+
+		meshCentroid = meshCentroid + vecClusterCentroid[c];
+		fMeshArea += vecClusterArea[c];
+	}
+
+	if (fMeshArea > 0.f)
+		meshCentroid = meshCentroid * (1.f / fMeshArea);
+
+	std::vector<float> vecSortKey(uiClusterCount, 0.f);
+	for (size_t c = 0; c < uiClusterCount; ++c)
+	{
+		float fNormalLength = glm::length(vecClusterNormal[c]);
+		if (vecClusterArea[c] <= 0.f || fNormalLength <= 0.f)
+			continue;
+
+		glm::vec3 centroid = vecClusterCentroid[c] * (1.f / vecClusterArea[c]);
+		vecSortKey[c] = glm::dot(centroid - meshCentroid, vecClusterNormal[c] * (1.f / fNormalLength));
+	}
+
+	std::vector<UINT> vecClusterOrder(uiClusterCount);
+	std::iota(vecClusterOrder.begin(), vecClusterOrder.end(), 0);
+	std::stable_sort(vecClusterOrder.begin(), vecClusterOrder.end(),
+		[&vecSortKey](UINT a, UINT b) { return vecSortKey[a] > vecSortKey[b]; });
+
+	std::vector<UINT> vecResult;
+	vecResult.reserve(uiTriangleCount * 3);
+	for (UINT c : vecClusterOrder)
+	{
+		size_t uiBegin = vecSoftClusters[c];
+		size_t uiEnd = (c + 1 < uiClusterCount) ? vecSoftClusters[c + 1] : uiTriangleCount;
+		vecResult.insert(vecResult.end(), pIndices + uiBegin * 3, pIndices + uiEnd * 3);
+	}
+
+	std::copy(vecResult.begin(), vecResult.end(), pIndices);
+}
+
+size_t MeshOptimizer::OptimizeVertexFetch(Vertex3D* pVertices, size_t uiVertexCount, UINT* pIndices, size_t uiIndexCount)
+{
+	std::vector<UINT> vecRemap(uiVertexCount, INVALID_VERTEX);
+	std::vector<Vertex3D> vecReordered;
+	vecReordered.reserve(uiVertexCount);
+
+	for (size_t i = 0; i < uiIndexCount; ++i)
+	{
+		UINT& uiRemap = vecRemap[pIndices[i]];
+		if (uiRemap == INVALID_VERTEX)
+		{
+			uiRemap = static_cast<UINT>(vecReordered.size());
+			vecReordered.push_back(pVertices[pIndices[i]]);
+		}
+		pIndices[i] = uiRemap;
+	}
+
+	std::copy(vecReordered.begin(), vecReordered.end(), pVertices);
+	return vecReordered.size();
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include "Core.h"
+
+struct Vertex3D;
+
+//CPU端网格优化，在加载与上传之间对单个submesh的局部索引进行重排
+//1.Tipsy(Sander et al. 2007)三角形重排，提高post-transform顶点缓存命中率
+//2.按簇的朝向重排三角形，降低overdraw
+//3.按索引首次出现的顺序重排顶点，提高顶点读取的局部性
+class MeshOptimizer
+{
+public:
+	static constexpr UINT DEFAULT_CACHE_SIZE = 16;
+	static constexpr float DEFAULT_OVERDRAW_THRESHOLD = 1.05f;
+
+	//ACMR：每个三角形的平均顶点变换次数，下限约0.5
+	//ATVR：每个顶点的平均变换次数，下限1.0
+	struct VertexCacheStats
+	{
+		size_t uiTriangleCount = 0;
+		size_t uiVertexCount = 0;
+		size_t uiTransformCount = 0;
+
+		float GetACMR() const { return uiTriangleCount ? static_cast<float>(uiTransformCount) / uiTriangleCount : 0.f; }
+		float GetATVR() const { return uiVertexCount ? static_cast<float>(uiTransformCount) / uiVertexCount : 0.f; }
+
+		VertexCacheStats& operator+=(const VertexCacheStats& other)
+		{
+			uiTriangleCount += other.uiTriangleCount;
+			uiVertexCount += other.uiVertexCount;
+			uiTransformCount += other.uiTransformCount;
+			return *this;
+		}
+	};
+
+	//按大小为uiCacheSize的FIFO缓存模拟顶点变换次数
+	static VertexCacheStats AnalyzeVertexCache(const UINT* pIndices, size_t uiIndexCount, size_t uiVertexCount,
+		UINT uiCacheSize = DEFAULT_CACHE_SIZE);
+
+	//pClusters非空时输出Tipsy的硬边界（缓存被清空处的三角形序号），供OptimizeOverdraw使用
+	static void OptimizeVertexCache(UINT* pIndices, size_t uiIndexCount, size_t uiVertexCount,
+		UINT uiCacheSize = DEFAULT_CACHE_SIZE, std::vector<UINT>* pClusters = nullptr);
+
+	//在硬边界内按fThreshold进一步切分簇，再按簇的朝向由外向内排序
+	//fThreshold为允许的ACMR上升比例，越大簇越小、overdraw越低、顶点缓存命中率越差
+	static void OptimizeOverdraw(UINT* pIndices, size_t uiIndexCount, const Vertex3D* pVertices, size_t uiVertexCount,
+		const std::vector<UINT>& vecClusters, UINT uiCacheSize = DEFAULT_CACHE_SIZE, float fThreshold = DEFAULT_OVERDRAW_THRESHOLD);
+
+	//返回被引用的顶点数，重排后它们位于数组前部，未被引用的顶点被丢弃
+	static size_t OptimizeVertexFetch(Vertex3D* pVertices, size_t uiVertexCount, UINT* pIndices, size_t uiIndexCount);
+
+	static bool IsIndexRangeValid(const UINT* pIndices, size_t uiIndexCount, size_t uiVertexCount);
+};
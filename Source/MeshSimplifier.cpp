@@ -0,0 +1,448 @@
+#include "MeshSimplifier.h"
+#include "VulkanRenderer.h"
+#include "VertexHashTable.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include <cstring>
+
+static constexpr UINT INVALID_POSITION = UINT_MAX;
+
+//边界平面相对三角形平面的权重，越大越难把边界拉离原位置
+static constexpr float BORDER_WEIGHT = 10.f;
+
+enum class SimplifyVertexKind : UCHAR
+{
+	Manifold,	//可以坍缩到任意相邻顶点
+	Border,		//只能沿开放边界坍缩
+	Locked,		//非流形顶点，不移动
+};
+
+struct PositionHash
+{
+	size_t operator()(const glm::vec3& position) const
+	{
+		UINT aryBits[3];
+		memcpy(aryBits, &position, sizeof(aryBits));
+		return (static_cast<size_t>(aryBits[0]) * 73856093u) ^ (static_cast<size_t>(aryBits[1]) * 19349663u) ^ (static_cast<size_t>(aryBits[2]) * 83492791u);
+	}
+};
+
+//平面集合的二次误差：对称3x3矩阵A、向量b和常数c，Error(p) = p^T A p + 2 b·p + c
+//按三角形面积加权，fWeight累计权重，误差除以权重后为到各平面距离平方的加权平均
+struct Quadric
+{
+	double a00 = 0.0, a11 = 0.0, a22 = 0.0, a01 = 0.0, a02 = 0.0, a12 = 0.0;
+	double b0 = 0.0, b1 = 0.0, b2 = 0.0, c = 0.0;
+	double fWeight = 0.0;
+
+	//平面为dot(normal, p) + fDistance = 0，normal需归一化
+	void AddPlane(const glm::vec3& normal, float fDistance, double fPlaneWeight)
+	{
+		double x = normal.x, y = normal.y, z = normal.z, d = fDistance;
+		a00 += fPlaneWeight * x * x;
+		a11 += fPlaneWeight * y * y;
+		a22 += fPlaneWeight * z * z;
+		a01 += fPlaneWeight * x * y;
+		a02 += fPlaneWeight * x * z;
+		a12 += fPlaneWeight * y * z;
+		b0 += fPlaneWeight * x * d;
+		b1 += fPlaneWeight * y * d;
+		b2 += fPlaneWeight * z * d;
+		c += fPlaneWeight * d * d;
+		fWeight += fPlaneWeight;
+	}
+
+	Quadric& operator+=(const Quadric& other)
+	{
+		a00 += other.a00; a11 += other.a11; a22 += other.a22;
+		a01 += other.a01; a02 += other.a02; a12 += other.a12;
+		b0 += other.b0; b1 += other.b1; b2 += other.b2;
+		c += other.c;
+		fWeight += other.fWeight;
+		return *this;
+	}
+
+	double Evaluate(const glm::vec3& position) const
+	{
+		double x = position.x, y = position.y, z = position.z;
+		return a00 * x * x + a11 * y * y + a22 * z * z
+			+ 2.0 * (a01 * x * y + a02 * x * z + a12 * y * z)
+			+ 2.0 * (b0 * x + b1 * y + b2 * z) + c;
+	}
+};
+
+struct SimplifyCollapse
+{
+	UINT uiFrom;
+	UINT uiTo;
+	float fError;	//距离平方
+};
+
+size_t MeshSimplifier::Simplify(UINT* pDstIndices, const UINT* pIndices, size_t uiIndexCount,
+	const Vertex3D* pVertices, size_t uiVertexCount, size_t uiTargetIndexCount, float fMaxError, float* pResultError)
+{
+	uiIndexCount -= uiIndexCount % 3;
+	if (pDstIndices != pIndices)
+		memcpy(pDstIndices, pIndices, uiIndexCount * sizeof(UINT));
+	if (pResultError)
+		*pResultError = 0.f;
+
+	if (uiIndexCount <= uiTargetIndexCount)
+		return uiIndexCount;
+
+	//按位置合并顶点，UV/法线不同的顶点共享同一个位置编号，误差与拓扑都在位置上计算
+	//加上+0.f把-0.f变为+0.f，使两者的哈希一致
+	std::vector<glm::vec3> vecPositions;
+	std::vector<UINT> vecRemap(uiVertexCount, INVALID_POSITION);
+	{
+		VertexHashTable<glm::vec3, PositionHash> hashTable(uiVertexCount);
+		for (size_t i = 0; i < uiIndexCount; ++i)
+		{
+			UINT uiVertex = pIndices[i];
+			if (vecRemap[uiVertex] == INVALID_POSITION)
+				vecRemap[uiVertex] = hashTable.Insert(pVertices[uiVertex].pos + glm::vec3(0.f), vecPositions);
+		}
+	}
+	const size_t uiPositionCount = vecPositions.size();
+
+	//同一位置上属性不同的各个顶点（wedge），坍缩时每个wedge都要找到目标位置上对应的wedge
+	std::vector<UINT> vecWedgeOffsets(uiPositionCount + 1, 0);
+	std::vector<UINT> vecWedges;
+	for (size_t i = 0; i < uiVertexCount; ++i)
+	{
+		if (vecRemap[i] != INVALID_POSITION)
+			++vecWedgeOffsets[vecRemap[i] + 1];
+	}
+	for (size_t i = 0; i < uiPositionCount; ++i)
+		vecWedgeOffsets[i + 1] += vecWedgeOffsets[i];
+	vecWedges.resize(vecWedgeOffsets[uiPositionCount]);
+	{
+		std::vector<UINT> vecFill(vecWedgeOffsets.begin(), vecWedgeOffsets.end() - 1);
+		for (UINT i = 0; i < uiVertexCount; ++i)
+		{
+			if (vecRemap[i] != INVALID_POSITION)
+				vecWedges[vecFill[vecRemap[i]]++] = i;
+		}
+	}
+
+	std::vector<SimplifyVertexKind> vecKinds(uiPositionCount, SimplifyVertexKind::Manifold);
+
+	//只被一个三角形使用的边为开放边界，vecLoop/vecLoopBack记录边界的走向
+	//一个顶点有多条出边界（非流形）时锁定
+	std::vector<UINT> vecLoop(uiPositionCount, INVALID_POSITION);
+	std::vector<UINT> vecLoopBack(uiPositionCount, INVALID_POSITION);
+	{
+		std::vector<std::pair<uint64_t, uint64_t>> vecEdges;
+		vecEdges.reserve(uiIndexCount);
+		for (size_t i = 0; i < uiIndexCount; i += 3)
+		{
+			for (int k = 0; k < 3; ++k)
+			{
+				uint64_t uiFrom = vecRemap[pIndices[i + k]];
+				uint64_t uiTo = vecRemap[pIndices[i + (k + 1) % 3]];
+				if (uiFrom != uiTo)
+					vecEdges.push_back({ (std::min(uiFrom, uiTo) << 32) | std::max(uiFrom, uiTo), (uiFrom << 32) | uiTo });
+			}
+		}
+		std::sort(vecEdges.begin(), vecEdges.end());
+
+		auto MarkBorder = [&vecKinds](UINT uiPosition)
+		{
+			if (vecKinds[uiPosition] == SimplifyVertexKind::Manifold)
+				vecKinds[uiPosition] = SimplifyVertexKind::Border;
+		};
+
+		for (size_t uiBegin = 0; uiBegin < vecEdges.size();)
+		{
+			size_t uiEnd = uiBegin + 1;
+			while (uiEnd < vecEdges.size() && vecEdges[uiEnd].first == vecEdges[uiBegin].first)
+				++uiEnd;
+
+			UINT uiFrom = static_cast<UINT>(vecEdges[uiBegin].second >> 32);
+			UINT uiTo = static_cast<UINT>(vecEdges[uiBegin].second & 0xFFFFFFFFu);
+			if (uiEnd - uiBegin == 1)
+			{
+				if (vecLoop[uiFrom] != INVALID_POSITION)
+					vecKinds[uiFrom] = SimplifyVertexKind::Locked;
+				if (vecLoopBack[uiTo] != INVALID_POSITION)
+					vecKinds[uiTo] = SimplifyVertexKind::Locked;
+				vecLoop[uiFrom] = uiTo;
+				vecLoopBack[uiTo] = uiFrom;
+				MarkBorder(uiFrom);
+				MarkBorder(uiTo);
+			}
+			else if (uiEnd - uiBegin > 2)
+			{
+				vecKinds[uiFrom] = SimplifyVertexKind::Locked;
+				vecKinds[uiTo] = SimplifyVertexKind::Locked;
+			}
+			uiBegin = uiEnd;
+		}
+	}
+
+	//每个位置累计相邻三角形平面的二次误差，边界边额外加入垂直于三角形的边界平面
+	std::vector<Quadric> vecQuadrics(uiPositionCount);
+	for (size_t i = 0; i < uiIndexCount; i += 3)
+	{
+		UINT aryPositions[3] = { vecRemap[pIndices[i]], vecRemap[pIndices[i + 1]], vecRemap[pIndices[i + 2]] };
+		const glm::vec3& p0 = vecPositions[aryPositions[0]];
+		glm::vec3 normal = glm::cross(vecPositions[aryPositions[1]] - p0, vecPositions[aryPositions[2]] - p0);
+		float fDoubleArea = glm::length(normal);
+		if (fDoubleArea <= 0.f)
+			continue;
+		normal = normal * (1.f / fDoubleArea);
+
+		Quadric quadric;
+		quadric.AddPlane(normal, -glm::dot(normal, p0), fDoubleArea * 0.5);
+		for (int k = 0; k < 3; ++k)
+			vecQuadrics[aryPositions[k]] += quadric;
+
+		for (int k = 0; k < 3; ++k)
+		{
+			UINT uiFrom = aryPositions[k];
+			UINT uiTo = aryPositions[(k + 1) % 3];
+			if (vecLoop[uiFrom] != uiTo)
+				continue;
+
+			glm::vec3 edge = vecPositions[uiTo] - vecPositions[uiFrom];
+			glm::vec3 borderNormal = glm::cross(edge, normal);
+			float fLength = glm::length(borderNormal);
+			if (fLength <= 0.f)
+				continue;
+			borderNormal = borderNormal * (1.f / fLength);
+
+			Quadric borderQuadric;
+			borderQuadric.AddPlane(borderNormal, -glm::dot(borderNormal, vecPositions[uiFrom]), glm::dot(edge, edge) * BORDER_WEIGHT);
+			vecQuadrics[uiFrom] += borderQuadric;
+			vecQuadrics[uiTo] += borderQuadric;
+		}
+	}
+
+	auto CanCollapse = [&](UINT uiFromPosition, UINT uiToPosition)
+	{
+		switch (vecKinds[uiFromPosition])
+		{
+		case SimplifyVertexKind::Manifold:
+			return true;
+		case SimplifyVertexKind::Border:
+			return vecLoop[uiFromPosition] == uiToPosition || vecLoopBack[uiFromPosition] == uiToPosition;
+		default:
+			return false;
+		}
+	};
+
+	auto GetCollapseError = [&](UINT uiFromPosition, UINT uiToPosition)
+	{
+		const Quadric& from = vecQuadrics[uiFromPosition];
+		const Quadric& to = vecQuadrics[uiToPosition];
+		double fWeight = from.fWeight + to.fWeight;
+		if (fWeight <= 0.0)
+			return 0.f;
+		const glm::vec3& position = vecPositions[uiToPosition];
+		return static_cast<float>(std::max(from.Evaluate(position) + to.Evaluate(position), 0.0) / fWeight);
+	};
+
+	const float fMaxErrorSquared = fMaxError * fMaxError;
+	float fResultErrorSquared = 0.f;
+
+	std::vector<UINT> vecAdjacencyOffsets(uiVertexCount + 1);
+	std::vector<UINT> vecAdjacency;
+	std::vector<UINT> vecCollapseTarget(uiVertexCount);
+	std::vector<bool> vecTouched(uiPositionCount);
+	std::vector<SimplifyCollapse> vecCollapses;
+	std::vector<std::pair<UINT, UINT>> vecWedgeTargets;
+
+	//为源位置的每个wedge在其相邻三角形中找到目标位置上的顶点，找不到说明坍缩会破坏UV/法线接缝
+	auto MapWedges = [&](UINT uiFromPosition, UINT uiToPosition)
+	{
+		vecWedgeTargets.clear();
+		for (UINT w = vecWedgeOffsets[uiFromPosition]; w < vecWedgeOffsets[uiFromPosition + 1]; ++w)
+		{
+			UINT uiWedge = vecWedges[w];
+			if (vecAdjacencyOffsets[uiWedge] == vecAdjacencyOffsets[uiWedge + 1])
+				continue;
+
+			UINT uiTarget = INVALID_POSITION;
+			for (UINT a = vecAdjacencyOffsets[uiWedge]; a < vecAdjacencyOffsets[uiWedge + 1] && uiTarget == INVALID_POSITION; ++a)
+			{
+				const UINT* pTriangle = pDstIndices + vecAdjacency[a];
+				for (int k = 0; k < 3; ++k)
+				{
+					if (vecRemap[pTriangle[k]] == uiToPosition)
+						uiTarget = pTriangle[k];
+				}
+			}
+			if (uiTarget == INVALID_POSITION)
+				return false;
+
+			vecWedgeTargets.push_back({ uiWedge, uiTarget });
+		}
+		return true;
+	};
+
+	//源位置移动到目标位置后，相邻三角形的法线翻转超过约75°时放弃这次坍缩
+	auto HasTriangleFlip = [&](UINT uiFromPosition, UINT uiToPosition)
+	{
+		const glm::vec3& target = vecPositions[uiToPosition];
+		for (UINT w = vecWedgeOffsets[uiFromPosition]; w < vecWedgeOffsets[uiFromPosition + 1]; ++w)
+		{
+			UINT uiWedge = vecWedges[w];
+			for (UINT a = vecAdjacencyOffsets[uiWedge]; a < vecAdjacencyOffsets[uiWedge + 1]; ++a)
+			{
+				const UINT* pTriangle = pDstIndices + vecAdjacency[a];
+				UINT aryPositions[3];
+				bool bDegenerate = false;
+				for (int k = 0; k < 3; ++k)
+				{
+					aryPositions[k] = vecRemap[vecCollapseTarget[pTriangle[k]]];
+					bDegenerate |= (aryPositions[k] == uiToPosition);
+				}
+				if (bDegenerate)
+					continue;
+
+				glm::vec3 aryBefore[3];
+				glm::vec3 aryAfter[3];
+				for (int k = 0; k < 3; ++k)
+				{
+					aryBefore[k] = vecPositions[aryPositions[k]];
+					aryAfter[k] = (aryPositions[k] == uiFromPosition) ? target : aryBefore[k];
+				}
+				glm::vec3 normalBefore = glm::cross(aryBefore[1] - aryBefore[0], aryBefore[2] - aryBefore[0]);
+				glm::vec3 normalAfter = glm::cross(aryAfter[1] - aryAfter[0], aryAfter[2] - aryAfter[0]);
+				if (glm::dot(normalBefore, normalAfter) <= 0.25f * glm::length(normalBefore) * glm::length(normalAfter))
+					return true;
+			}
+		}
+		return false;
+	};
+
+	size_t uiCurIndexCount = uiIndexCount;
+	while (uiCurIndexCount > uiTargetIndexCount)
+	{
+		//顶点到三角形的邻接表（CSR）
+		std::fill(vecAdjacencyOffsets.begin(), vecAdjacencyOffsets.end(), 0);
+		for (size_t i = 0; i < uiCurIndexCount; ++i)
+			++vecAdjacencyOffsets[pDstIndices[i] + 1];
+		for (size_t i = 0; i < uiVertexCount; ++i)
+			vecAdjacencyOffsets[i + 1] += vecAdjacencyOffsets[i];
+		vecAdjacency.resize(uiCurIndexCount);
+		{
+			std::vector<UINT> vecFill(vecAdjacencyOffsets.begin(), vecAdjacencyOffsets.end() - 1);
+			for (size_t i = 0; i < uiCurIndexCount; ++i)
+				vecAdjacency[vecFill[pDstIndices[i]]++] = static_cast<UINT>(i - i % 3);
+		}
+
+		//内部边被两个方向相反的三角形各遍历一次，只在uiFromPosition < uiToPosition的方向上收集
+		vecCollapses.clear();
+		for (size_t i = 0; i < uiCurIndexCount; i += 3)
+		{
+			for (int k = 0; k < 3; ++k)
+			{
+				UINT uiVertex0 = pDstIndices[i + k];
+				UINT uiVertex1 = pDstIndices[i + (k + 1) % 3];
+				UINT uiPosition0 = vecRemap[uiVertex0];
+				UINT uiPosition1 = vecRemap[uiVertex1];
+				if (uiPosition0 == uiPosition1)
+					continue;
+				if (uiPosition0 > uiPosition1 && vecLoop[uiPosition0] != uiPosition1)
+					continue;
+
+				float fError01 = CanCollapse(uiPosition0, uiPosition1) ? GetCollapseError(uiPosition0, uiPosition1) : FLT_MAX;
+				float fError10 = CanCollapse(uiPosition1, uiPosition0) ? GetCollapseError(uiPosition1, uiPosition0) : FLT_MAX;
+				if (fError01 == FLT_MAX && fError10 == FLT_MAX)
+					continue;
+
+				if (fError01 <= fError10)
+					vecCollapses.push_back({ uiVertex0, uiVertex1, fError01 });
+				else
+					vecCollapses.push_back({ uiVertex1, uiVertex0, fError10 });
+			}
+		}
+		if (vecCollapses.empty())
+			break;
+
+		std::sort(vecCollapses.begin(), vecCollapses.end(),
+			[](const SimplifyCollapse& lhs, const SimplifyCollapse& rhs) { return lhs.fError < rhs.fError; });
+
+		//每轮中一个位置最多参与一次坍缩，坍缩后不再重新计算相邻边的误差
+		for (UINT i = 0; i < uiVertexCount; ++i)
+			vecCollapseTarget[i] = i;
+		std::fill(vecTouched.begin(), vecTouched.end(), false);
+
+		const size_t uiTriangleGoal = (uiCurIndexCount - uiTargetIndexCount) / 3;
+		size_t uiRemovedTriangleCount = 0;
+		size_t uiCollapseCount = 0;
+		for (const auto& collapse : vecCollapses)
+		{
+			if (collapse.fError > fMaxErrorSquared || uiRemovedTriangleCount >= uiTriangleGoal)
+				break;
+
+			UINT uiFromPosition = vecRemap[collapse.uiFrom];
+			UINT uiToPosition = vecRemap[collapse.uiTo];
+			if (vecTouched[uiFromPosition] || vecTouched[uiToPosition])
+				continue;
+			if (!MapWedges(uiFromPosition, uiToPosition) || HasTriangleFlip(uiFromPosition, uiToPosition))
+				continue;
+
+			for (const auto& wedgeTarget : vecWedgeTargets)
+				vecCollapseTarget[wedgeTarget.first] = wedgeTarget.second;
+			vecQuadrics[uiToPosition] += vecQuadrics[uiFromPosition];
+
+			//沿边界坍缩后把相邻的边界顶点连到目标上
+			if (vecKinds[uiFromPosition] == SimplifyVertexKind::Border)
+			{
+				if (vecLoop[uiFromPosition] == uiToPosition)
+				{
+					UINT uiPrev = vecLoopBack[uiFromPosition];
+					if (uiPrev != INVALID_POSITION)
+						vecLoop[uiPrev] = uiToPosition;
+					vecLoopBack[uiToPosition] = uiPrev;
+				}
+				else
+				{
+					UINT uiNext = vecLoop[uiFromPosition];
+					if (uiNext != INVALID_POSITION)
+						vecLoopBack[uiNext] = uiToPosition;
+					vecLoop[uiToPosition] = uiNext;
+				}
+				uiRemovedTriangleCount += 1;
+			}
+			else
+				uiRemovedTriangleCount += 2;
+
+			vecTouched[uiFromPosition] = true;
+			vecTouched[uiToPosition] = true;
+			fResultErrorSquared = std::max(fResultErrorSquared, collapse.fError);
+			++uiCollapseCount;
+		}
+		if (uiCollapseCount == 0)
+			break;
+
+		//应用坍缩并删除退化的三角形
+		size_t uiWriteCount = 0;
+		for (size_t i = 0; i < uiCurIndexCount; i += 3)
+		{
+			UINT uiVertex0 = vecCollapseTarget[pDstIndices[i]];
+			UINT uiVertex1 = vecCollapseTarget[pDstIndices[i + 1]];
+			UINT uiVertex2 = vecCollapseTarget[pDstIndices[i + 2]];
+			UINT uiPosition0 = vecRemap[uiVertex0];
+			UINT uiPosition1 = vecRemap[uiVertex1];
+			UINT uiPosition2 = vecRemap[uiVertex2];
+			if (uiPosition0 == uiPosition1 || uiPosition1 == uiPosition2 || uiPosition0 == uiPosition2)
+				continue;
+
+			pDstIndices[uiWriteCount++] = uiVertex0;
+			pDstIndices[uiWriteCount++] = uiVertex1;
+			pDstIndices[uiWriteCount++] = uiVertex2;
+		}
+		uiCurIndexCount = uiWriteCount;
+	}
+
+	if (pResultError)
+		*pResultError = std::sqrt(fResultErrorSquared);
+
+	return uiCurIndexCount;
+}
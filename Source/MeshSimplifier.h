@@ -0,0 +1,17 @@
+#pragma once
+#include "Core.h"
+
+struct Vertex3D;
+
+//基于二次误差度量(Garland & Heckbert 1997)的边坍缩简化
+//顶点只会坍缩到相邻顶点上，不产生新顶点，因此简化结果可以与原网格共用同一个顶点缓冲
+class MeshSimplifier
+{
+public:
+	//将三角形列表简化到不超过uiTargetIndexCount个索引，返回结果的索引数
+	//pDstIndices的容量不小于uiIndexCount，可以与pIndices相同
+	//fMaxError为允许的最大几何误差（模型空间中的距离），pResultError输出实际达到的误差
+	//同一位置有多个顶点（UV/法线不连续）时，只有每个顶点都能沿接缝找到对应目标才坍缩；开放边界上的顶点只沿边界坍缩
+	static size_t Simplify(UINT* pDstIndices, const UINT* pIndices, size_t uiIndexCount,
+		const Vertex3D* pVertices, size_t uiVertexCount, size_t uiTargetIndexCount, float fMaxError, float* pResultError = nullptr);
+};
@@ -0,0 +1,430 @@
+#include "ObjParallelParser.h"
+#include "VulkanRenderer.h"
+#include "VertexHashTable.h"
+#include "MappedFile.h"
+#include "ThreadPool.h"
+
+#include <charconv>
+#include <chrono>
+#include <cstring>
+
+//每个切块至少1MB，避免小文件被切得过碎
+static constexpr size_t OBJ_MIN_CHUNK_SIZE = 1 << 20;
+
+enum ObjCornerFlag : UCHAR
+{
+	OBJ_CORNER_POSITION_RELATIVE = 1 << 0,	//负索引，相对于所在切块的起始顶点
+	OBJ_CORNER_TEXCOORD_RELATIVE = 1 << 1,
+	OBJ_CORNER_NORMAL_RELATIVE = 1 << 2,
+	OBJ_CORNER_HAS_TEXCOORD = 1 << 3,
+	OBJ_CORNER_HAS_NORMAL = 1 << 4,
+};
+
+struct ObjCorner
+{
+	int nPosition;
+	int nTexCoord;
+	int nNormal;
+	UCHAR uFlags;
+};
+
+struct ObjChunk
+{
+	const char* pBegin = nullptr;
+	const char* pEnd = nullptr;
+	bool bValid = true;
+
+	std::vector<float> vecPositions;
+	std::vector<float> vecTexCoords;
+	std::vector<float> vecNormals;
+	std::vector<ObjCorner> vecCorners;	//已按扇形三角化
+
+	size_t uiPositionBase = 0;
+	size_t uiTexCoordBase = 0;
+	size_t uiNormalBase = 0;
+
+	std::vector<Vertex3D> vecVertices;
+	std::vector<UINT> vecIndices;
+
+	size_t uiVertexBase = 0;
+	size_t uiIndexBase = 0;
+};
+
+static const char* SkipSpace(const char* p, const char* pEnd)
+{
+	while (p < pEnd && (*p == ' ' || *p == '\t'))
+		++p;
+	return p;
+}
+
+static const char* ParseFloat(const char* p, const char* pEnd, float& fValue, bool& bOk)
+{
+	p = SkipSpace(p, pEnd);
+	if (p < pEnd && *p == '+')
+		++p;
+	auto result = std::from_chars(p, pEnd, fValue);
+	if (result.ec != std::errc())
+	{
+		bOk = false;
+		return p;
+	}
+	return result.ptr;
+}
+
+//行内已没有数值时保留fValue的默认值，与tinyobj对缺省分量的处理一致
+static const char* ParseOptionalFloat(const char* p, const char* pEnd, float& fValue, bool& bOk)
+{
+	p = SkipSpace(p, pEnd);
+	if (p == pEnd || *p == '\r' || *p == '#')
+		return p;
+	return ParseFloat(p, pEnd, fValue, bOk);
+}
+
+static const char* ParseInt(const char* p, const char* pEnd, int& nValue, bool& bOk)
+{
+	if (p < pEnd && *p == '+')
+		++p;
+	auto result = std::from_chars(p, pEnd, nValue);
+	if (result.ec != std::errc())
+	{
+		bOk = false;
+		return p;
+	}
+	return result.ptr;
+}
+
+//将OBJ中从1开始的索引转为从0开始；负索引记为相对当前切块已解析数量的偏移，合并时再加上切块基址
+static bool ResolveObjIndex(int nRaw, size_t uiLocalCount, int& nResolved, bool& bRelative)
+{
+	if (nRaw > 0)
+	{
+		nResolved = nRaw - 1;
+		bRelative = false;
+		return true;
+	}
+	if (nRaw < 0)
+	{
+		nResolved = static_cast<int>(uiLocalCount) + nRaw;
+		bRelative = true;
+		return true;
+	}
+	return false;
+}
+
+static void ParseObjFace(const char* p, const char* pEnd, ObjChunk& chunk, std::vector<ObjCorner>& vecPolygon)
+{
+	vecPolygon.clear();
+
+	bool bOk = true;
+	while (true)
+	{
+		p = SkipSpace(p, pEnd);
+		if (p >= pEnd || *p == '\r' || *p == '#')
+			break;
+
+		ObjCorner corner{};
+		bool bRelative = false;
+
+		int nRaw = 0;
+		p = ParseInt(p, pEnd, nRaw, bOk);
+		if (!bOk || !ResolveObjIndex(nRaw, chunk.vecPositions.size() / 3, corner.nPosition, bRelative))
+		{
+			chunk.bValid = false;
+			return;
+		}
+		if (bRelative)
+			corner.uFlags |= OBJ_CORNER_POSITION_RELATIVE;
+
+		if (p < pEnd && *p == '/')
+		{
+			++p;
+			if (p < pEnd && *p != '/')
+			{
+				p = ParseInt(p, pEnd, nRaw, bOk);
+				if (!bOk || !ResolveObjIndex(nRaw, chunk.vecTexCoords.size() / 2, corner.nTexCoord, bRelative))
+				{
+					chunk.bValid = false;
+					return;
+				}
+				corner.uFlags |= OBJ_CORNER_HAS_TEXCOORD;
+				if (bRelative)
+					corner.uFlags |= OBJ_CORNER_TEXCOORD_RELATIVE;
+			}
+
+			if (p < pEnd && *p == '/')
+			{
+				++p;
+				p = ParseInt(p, pEnd, nRaw, bOk);
+				if (!bOk || !ResolveObjIndex(nRaw, chunk.vecNormals.size() / 3, corner.nNormal, bRelative))
+				{
+					chunk.bValid = false;
+					return;
+				}
+				corner.uFlags |= OBJ_CORNER_HAS_NORMAL;
+				if (bRelative)
+					corner.uFlags |= OBJ_CORNER_NORMAL_RELATIVE;
+			}
+		}
+
+		vecPolygon.push_back(corner);
+	}
+
+	//扇形三角化，与tinyobj对凸多边形的处理一致
+	for (size_t i = 1; i + 1 < vecPolygon.size(); ++i)
+	{
+		chunk.vecCorners.push_back(vecPolygon[0]);
+		chunk.vecCorners.push_back(vecPolygon[i]);
+		chunk.vecCorners.push_back(vecPolygon[i + 1]);
+	}
+}
+
+static void ParseObjChunk(ObjChunk& chunk)
+{
+	std::vector<ObjCorner> vecPolygon;
+
+	const char* p = chunk.pBegin;
+	while (p < chunk.pEnd && chunk.bValid)
+	{
+		const char* pLineEnd = static_cast<const char*>(memchr(p, '\n', chunk.pEnd - p));
+		if (pLineEnd == nullptr)
+			pLineEnd = chunk.pEnd;
+
+		const char* pToken = SkipSpace(p, pLineEnd);
+		if (pLineEnd - pToken >= 2 && pToken[0] == 'v' && (pToken[1] == ' ' || pToken[1] == '\t'))
+		{
+			float x = 0.f, y = 0.f, z = 0.f;
+			bool bOk = true;
+			const char* pCur = ParseFloat(pToken + 2, pLineEnd, x, bOk);
+			pCur = ParseFloat(pCur, pLineEnd, y, bOk);
+			ParseFloat(pCur, pLineEnd, z, bOk);
+			chunk.bValid = bOk;
+
+			chunk.vecPositions.push_back(x);
+			chunk.vecPositions.push_back(y);
+			chunk.vecPositions.push_back(z);
+		}
+		else if (pLineEnd - pToken >= 3 && pToken[0] == 'v' && pToken[1] == 't' && (pToken[2] == ' ' || pToken[2] == '\t'))
+		{
+			float u = 0.f, v = 0.f;
+			bool bOk = true;
+			const char* pCur = ParseFloat(pToken + 3, pLineEnd, u, bOk);
+			ParseOptionalFloat(pCur, pLineEnd, v, bOk);	//一维纹理坐标只有u
+			chunk.bValid = bOk;
+
+			chunk.vecTexCoords.push_back(u);
+			chunk.vecTexCoords.push_back(v);
+		}
+		else if (pLineEnd - pToken >= 3 && pToken[0] == 'v' && pToken[1] == 'n' && (pToken[2] == ' ' || pToken[2] == '\t'))
+		{
+			float x = 0.f, y = 0.f, z = 0.f;
+			bool bOk = true;
+			const char* pCur = ParseFloat(pToken + 3, pLineEnd, x, bOk);
+			pCur = ParseFloat(pCur, pLineEnd, y, bOk);
+			ParseFloat(pCur, pLineEnd, z, bOk);
+			chunk.bValid = bOk;
+
+			chunk.vecNormals.push_back(x);
+			chunk.vecNormals.push_back(y);
+			chunk.vecNormals.push_back(z);
+		}
+		else if (pLineEnd - pToken >= 2 && pToken[0] == 'f' && (pToken[1] == ' ' || pToken[1] == '\t'))
+		{
+			ParseObjFace(pToken + 2, pLineEnd, chunk, vecPolygon);
+		}
+		//o、g、usemtl、mtllib、s等其余行忽略
+
+		p = pLineEnd + 1;
+	}
+}
+
+static void AssembleObjChunk(ObjChunk& chunk, const std::vector<float>& vecPositions, const std::vector<float>& vecTexCoords, const std::vector<float>& vecNormals)
+{
+	const size_t uiPositionCount = vecPositions.size() / 3;
+	const size_t uiTexCoordCount = vecTexCoords.size() / 2;
+	const size_t uiNormalCount = vecNormals.size() / 3;
+
+	VertexHashTable<Vertex3D> uniqueVertices(chunk.vecCorners.size() / 2);
+	chunk.vecVertices.reserve(chunk.vecCorners.size() / 2);
+	chunk.vecIndices.reserve(chunk.vecCorners.size());
+
+	for (const auto& corner : chunk.vecCorners)
+	{
+		int64_t nPosition = corner.nPosition;
+		if (corner.uFlags & OBJ_CORNER_POSITION_RELATIVE)
+			nPosition += static_cast<int64_t>(chunk.uiPositionBase);
+		if (nPosition < 0 || static_cast<size_t>(nPosition) >= uiPositionCount)
+		{
+			chunk.bValid = false;
+			return;
+		}
+
+		Vertex3D vert{};
+		vert.pos = {
+			vecPositions[3 * static_cast<uint64_t>(nPosition) + 0],
+			vecPositions[3 * static_cast<uint64_t>(nPosition) + 1],
+			vecPositions[3 * static_cast<uint64_t>(nPosition) + 2],
+		};
+
+		if (corner.uFlags & OBJ_CORNER_HAS_TEXCOORD)
+		{
+			int64_t nTexCoord = corner.nTexCoord;
+			if (corner.uFlags & OBJ_CORNER_TEXCOORD_RELATIVE)
+				nTexCoord += static_cast<int64_t>(chunk.uiTexCoordBase);
+			if (nTexCoord < 0 || static_cast<size_t>(nTexCoord) >= uiTexCoordCount)
+			{
+				chunk.bValid = false;
+				return;
+			}
+
+			vert.texCoord = {
+				vecTexCoords[2 * static_cast<uint64_t>(nTexCoord) + 0],
+				1.f - vecTexCoords[2 * static_cast<uint64_t>(nTexCoord) + 1],
+			};
+		}
+		if (corner.uFlags & OBJ_CORNER_HAS_NORMAL)
+		{
+			int64_t nNormal = corner.nNormal;
+			if (corner.uFlags & OBJ_CORNER_NORMAL_RELATIVE)
+				nNormal += static_cast<int64_t>(chunk.uiNormalBase);
+			if (nNormal < 0 || static_cast<size_t>(nNormal) >= uiNormalCount)
+			{
+				chunk.bValid = false;
+				return;
+			}
+
+			vert.normal = {
+				vecNormals[3 * static_cast<uint64_t>(nNormal) + 0],
+				vecNormals[3 * static_cast<uint64_t>(nNormal) + 1],
+				vecNormals[3 * static_cast<uint64_t>(nNormal) + 2],
+			};
+		}
+		vert.color = glm::vec3(1.f, 1.f, 1.f);
+
+		chunk.vecIndices.push_back(uniqueVertices.Insert(vert, chunk.vecVertices));
+	}
+
+	//组装完成后corner数据不再需要，尽早释放
+	std::vector<ObjCorner>().swap(chunk.vecCorners);
+}
+
+ObjParallelParser::ObjParallelParser(ThreadPool& threadPool)
+	: m_ThreadPool(threadPool)
+{
+}
+
+bool ObjParallelParser::Parse(const std::filesystem::path& path, std::vector<Vertex3D>& vecVertices, std::vector<UINT>& vecIndices)
+{
+	auto startTimestamp = std::chrono::high_resolution_clock::now();
+
+	MappedFile file;
+	if (!file.Open(path))
+	{
+		Log::Error(std::format("Map obj file {} failed", path.string()));
+		return false;
+	}
+
+	const char* pData = file.GetData();
+	const char* pDataEnd = pData + file.GetSize();
+
+	//按行边界切块，块数为线程数的数倍以平衡负载
+	size_t uiTargetChunkSize = std::max(OBJ_MIN_CHUNK_SIZE, file.GetSize() / (static_cast<size_t>(m_ThreadPool.GetThreadCount()) * 4) + 1);
+
+	std::vector<ObjChunk> vecChunks;
+	const char* pChunkBegin = pData;
+	while (pChunkBegin < pDataEnd)
+	{
+		const char* pChunkEnd = pDataEnd;
+		if (static_cast<size_t>(pDataEnd - pChunkBegin) > uiTargetChunkSize)
+		{
+			const char* pNewLine = static_cast<const char*>(memchr(pChunkBegin + uiTargetChunkSize, '\n', pDataEnd - pChunkBegin - uiTargetChunkSize));
+			pChunkEnd = pNewLine ? pNewLine + 1 : pDataEnd;
+		}
+
+		ObjChunk chunk;
+		chunk.pBegin = pChunkBegin;
+		chunk.pEnd = pChunkEnd;
+		vecChunks.push_back(std::move(chunk));
+
+		pChunkBegin = pChunkEnd;
+	}
+	m_uiChunkCount = vecChunks.size();
+
+	m_ThreadPool.ParallelFor(vecChunks.size(), [&vecChunks](size_t i) { ParseObjChunk(vecChunks[i]); });
+
+	size_t uiPositionCount = 0;
+	size_t uiTexCoordCount = 0;
+	size_t uiNormalCount = 0;
+	m_uiCornerCount = 0;
+	for (auto& chunk : vecChunks)
+	{
+		if (!chunk.bValid)
+		{
+			Log::Error(std::format("Parse obj file {} failed", path.string()));
+			return false;
+		}
+		chunk.uiPositionBase = uiPositionCount;
+		chunk.uiTexCoordBase = uiTexCoordCount;
+		chunk.uiNormalBase = uiNormalCount;
+		uiPositionCount += chunk.vecPositions.size() / 3;
+		uiTexCoordCount += chunk.vecTexCoords.size() / 2;
+		uiNormalCount += chunk.vecNormals.size() / 3;
+		m_uiCornerCount += chunk.vecCorners.size();
+	}
+
+	//各切块的v/vt/vn拼接为全局数组，供任意切块的面索引访问
+	std::vector<float> vecPositions(uiPositionCount * 3);
+	std::vector<float> vecTexCoords(uiTexCoordCount * 2);
+	std::vector<float> vecNormals(uiNormalCount * 3);
+	m_ThreadPool.ParallelFor(vecChunks.size(), [&](size_t i)
+		{
+			auto& chunk = vecChunks[i];
+			std::copy(chunk.vecPositions.begin(), chunk.vecPositions.end(), vecPositions.begin() + chunk.uiPositionBase * 3);
+			std::copy(chunk.vecTexCoords.begin(), chunk.vecTexCoords.end(), vecTexCoords.begin() + chunk.uiTexCoordBase * 2);
+			std::copy(chunk.vecNormals.begin(), chunk.vecNormals.end(), vecNormals.begin() + chunk.uiNormalBase * 3);
+			std::vector<float>().swap(chunk.vecPositions);
+			std::vector<float>().swap(chunk.vecTexCoords);
+			std::vector<float>().swap(chunk.vecNormals);
+		});
+
+	auto parseTimestamp = std::chrono::high_resolution_clock::now();
+
+	//每个切块内独立去重；同一顶点被不同切块的面引用时会在合并结果中重复出现
+	m_ThreadPool.ParallelFor(vecChunks.size(), [&](size_t i) { AssembleObjChunk(vecChunks[i], vecPositions, vecTexCoords, vecNormals); });
+
+	size_t uiVertexCount = 0;
+	size_t uiIndexCount = 0;
+	for (auto& chunk : vecChunks)
+	{
+		if (!chunk.bValid)
+		{
+			Log::Error(std::format("Obj file {} has out of range face index", path.string()));
+			return false;
+		}
+		chunk.uiVertexBase = uiVertexCount;
+		chunk.uiIndexBase = uiIndexCount;
+		uiVertexCount += chunk.vecVertices.size();
+		uiIndexCount += chunk.vecIndices.size();
+	}
+
+	auto assembleTimestamp = std::chrono::high_resolution_clock::now();
+
+	vecVertices.resize(uiVertexCount);
+	vecIndices.resize(uiIndexCount);
+	m_ThreadPool.ParallelFor(vecChunks.size(), [&](size_t i)
+		{
+			const auto& chunk = vecChunks[i];
+			std::copy(chunk.vecVertices.begin(), chunk.vecVertices.end(), vecVertices.begin() + chunk.uiVertexBase);
+
+			const UINT uiVertexBase = static_cast<UINT>(chunk.uiVertexBase);
+			for (size_t j = 0; j < chunk.vecIndices.size(); ++j)
+				vecIndices[chunk.uiIndexBase + j] = chunk.vecIndices[j] + uiVertexBase;
+		});
+
+	auto mergeTimestamp = std::chrono::high_resolution_clock::now();
+
+	m_dParseTime = std::chrono::duration<double, std::milli>(parseTimestamp - startTimestamp).count();
+	m_dAssembleTime = std::chrono::duration<double, std::milli>(assembleTimestamp - parseTimestamp).count();
+	m_dMergeTime = std::chrono::duration<double, std::milli>(mergeTimestamp - assembleTimestamp).count();
+
+	return true;
+}
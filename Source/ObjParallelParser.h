@@ -0,0 +1,32 @@
+#pragma once
+#include "Core.h"
+
+struct Vertex3D;
+class ThreadPool;
+
+//多线程OBJ解析
+//内存映射文件后按行边界切块，各块并行解析v/vt/vn/f，再并行组装去重后的顶点与索引，最后合并
+class ObjParallelParser
+{
+public:
+	explicit ObjParallelParser(ThreadPool& threadPool);
+
+	bool Parse(const std::filesystem::path& path, std::vector<Vertex3D>& vecVertices, std::vector<UINT>& vecIndices);
+
+	size_t GetChunkCount() const { return m_uiChunkCount; }
+	size_t GetCornerCount() const { return m_uiCornerCount; }
+
+	double GetParseTime() const { return m_dParseTime; }
+	double GetAssembleTime() const { return m_dAssembleTime; }
+	double GetMergeTime() const { return m_dMergeTime; }
+
+private:
+	ThreadPool& m_ThreadPool;
+
+	size_t m_uiChunkCount = 0;
+	size_t m_uiCornerCount = 0;
+
+	double m_dParseTime = 0.0;
+	double m_dAssembleTime = 0.0;
+	double m_dMergeTime = 0.0;
+};
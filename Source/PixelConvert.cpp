@@ -0,0 +1,263 @@
+#include "PixelConvert.h"
+
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <intrin.h>
+#include <immintrin.h>
+
+//线性值量化到4096级后查表编码，避免逐像素pow
+static constexpr UINT ENCODE_LEVEL_COUNT = 4096;
+
+//前256项为sRGB解码，后256项为alpha的直接归一化，按通道加上偏移后统一查表（可用AVX2 gather）
+static const std::array<float, 512>& GetDecodeTable()
+{
+	static const std::array<float, 512> aryTable = []()
+	{
+		std::array<float, 512> ary{};
+		for (UINT i = 0; i < 256; ++i)
+		{
+			float fValue = i / 255.f;
+			ary[i] = fValue <= 0.04045f ? fValue / 12.92f : std::pow((fValue + 0.055f) / 1.055f, 2.4f);
+			ary[256 + i] = fValue;
+		}
+		return ary;
+	}();
+	return aryTable;
+}
+
+//前4096项为sRGB编码，后4096项为alpha的直接量化，存为int以便gather
+static const std::array<int, ENCODE_LEVEL_COUNT * 2>& GetEncodeTable()
+{
+	static const std::array<int, ENCODE_LEVEL_COUNT * 2> aryTable = []()
+	{
+		std::array<int, ENCODE_LEVEL_COUNT * 2> ary{};
+		for (UINT i = 0; i < ENCODE_LEVEL_COUNT; ++i)
+		{
+			float fValue = i / static_cast<float>(ENCODE_LEVEL_COUNT - 1);
+			float fEncoded = fValue <= 0.0031308f ? fValue * 12.92f : 1.055f * std::pow(fValue, 1.f / 2.4f) - 0.055f;
+			ary[i] = static_cast<int>(std::clamp(fEncoded * 255.f + 0.5f, 0.f, 255.f));
+			ary[ENCODE_LEVEL_COUNT + i] = static_cast<int>(fValue * 255.f + 0.5f);
+		}
+		return ary;
+	}();
+	return aryTable;
+}
+
+static UINT GetEncodeIndex(float fValue)
+{
+	return static_cast<UINT>(std::clamp(fValue * (ENCODE_LEVEL_COUNT - 1) + 0.5f, 0.f, static_cast<float>(ENCODE_LEVEL_COUNT - 1)));
+}
+
+PixelConvert::SimdLevel PixelConvert::GetSupportedSimdLevel()
+{
+	static const SimdLevel level = []()
+	{
+		int aryInfo[4] = {};
+		__cpuid(aryInfo, 0);
+		int nMaxLeaf = aryInfo[0];
+
+		__cpuid(aryInfo, 1);
+		bool bSSSE3 = (aryInfo[2] & (1 << 9)) != 0;
+		bool bOSXSAVE = (aryInfo[2] & (1 << 27)) != 0;
+		bool bAVX = (aryInfo[2] & (1 << 28)) != 0;
+
+		bool bAVX2 = false;
+		if (nMaxLeaf >= 7 && bOSXSAVE && bAVX && (_xgetbv(0) & 0x6) == 0x6)
+		{
+			__cpuidex(aryInfo, 7, 0);
+			bAVX2 = (aryInfo[1] & (1 << 5)) != 0;
+		}
+
+		return bAVX2 ? SimdLevel::AVX2 : (bSSSE3 ? SimdLevel::SSE : SimdLevel::Scalar);
+	}();
+	return level;
+}
+
+const char* PixelConvert::GetSimdLevelName(SimdLevel level)
+{
+	switch (level)
+	{
+	case SimdLevel::SSE:
+		return "SSE";
+	case SimdLevel::AVX2:
+		return "AVX2";
+	default:
+		return "Scalar";
+	}
+}
+
+void PixelConvert::ExpandToRGBA8(const UCHAR* pSrc, UCHAR* pDst, size_t uiPixelCount, UINT uiChannel)
+{
+	ExpandToRGBA8(pSrc, pDst, uiPixelCount, uiChannel, GetSupportedSimdLevel());
+}
+
+void PixelConvert::ExpandToRGBA8(const UCHAR* pSrc, UCHAR* pDst, size_t uiPixelCount, UINT uiChannel, SimdLevel level)
+{
+	if (uiChannel == 4)
+	{
+		memcpy(pDst, pSrc, uiPixelCount * 4);
+		return;
+	}
+
+	size_t i = 0;
+	if (uiChannel == 3)
+	{
+		//每4个RGB像素（12字节）由pshufb展开为4个RGBA像素，alpha位置填0后再或上255
+		const __m128i shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+		const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xFF000000));
+
+		if (level == SimdLevel::AVX2)
+		{
+			//每次16个像素，第二个128位加载比所需多读4字节，尾部至少多留2个像素
+			const __m256i shuffle256 = _mm256_broadcastsi128_si256(shuffle);
+			const __m256i alpha256 = _mm256_broadcastsi128_si256(alpha);
+			for (; i + 18 <= uiPixelCount; i += 16)
+			{
+				const UCHAR* pIn = pSrc + i * 3;
+				__m256i in0 = _mm256_loadu2_m128i(reinterpret_cast<const __m128i*>(pIn + 12), reinterpret_cast<const __m128i*>(pIn));
+				__m256i in1 = _mm256_loadu2_m128i(reinterpret_cast<const __m128i*>(pIn + 36), reinterpret_cast<const __m128i*>(pIn + 24));
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(pDst + i * 4), _mm256_or_si256(_mm256_shuffle_epi8(in0, shuffle256), alpha256));
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(pDst + i * 4 + 32), _mm256_or_si256(_mm256_shuffle_epi8(in1, shuffle256), alpha256));
+			}
+		}
+
+		if (level != SimdLevel::Scalar)
+		{
+			//每次16个像素，3次加载正好48字节，第2~4组由alignr/移位拼出起始处
+			for (; i + 16 <= uiPixelCount; i += 16)
+			{
+				const UCHAR* pIn = pSrc + i * 3;
+				__m128i in0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pIn));
+				__m128i in1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pIn + 16));
+				__m128i in2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pIn + 32));
+
+				__m128i* pOut = reinterpret_cast<__m128i*>(pDst + i * 4);
+				_mm_storeu_si128(pOut + 0, _mm_or_si128(_mm_shuffle_epi8(in0, shuffle), alpha));
+				_mm_storeu_si128(pOut + 1, _mm_or_si128(_mm_shuffle_epi8(_mm_alignr_epi8(in1, in0, 12), shuffle), alpha));
+				_mm_storeu_si128(pOut + 2, _mm_or_si128(_mm_shuffle_epi8(_mm_alignr_epi8(in2, in1, 8), shuffle), alpha));
+				_mm_storeu_si128(pOut + 3, _mm_or_si128(_mm_shuffle_epi8(_mm_srli_si128(in2, 4), shuffle), alpha));
+			}
+		}
+	}
+
+	for (; i < uiPixelCount; ++i)
+	{
+		const UCHAR* pIn = pSrc + i * uiChannel;
+		UCHAR* pOut = pDst + i * 4;
+		if (uiChannel >= 3)
+		{
+			pOut[0] = pIn[0];
+			pOut[1] = pIn[1];
+			pOut[2] = pIn[2];
+		}
+		else
+		{
+			pOut[0] = pOut[1] = pOut[2] = pIn[0];
+		}
+		pOut[3] = (uiChannel == 2) ? pIn[1] : 255;
+	}
+}
+
+void PixelConvert::SRGBToLinear(const UCHAR* pSrc, float* pDst, size_t uiPixelCount)
+{
+	SRGBToLinear(pSrc, pDst, uiPixelCount, GetSupportedSimdLevel());
+}
+
+void PixelConvert::SRGBToLinear(const UCHAR* pSrc, float* pDst, size_t uiPixelCount, SimdLevel level)
+{
+	const auto& aryDecode = GetDecodeTable();
+
+	size_t i = 0;
+	if (level == SimdLevel::AVX2)
+	{
+		//每次2个像素，8个字节零扩展为int后加上alpha的表偏移，一次gather查表
+		const __m256i alphaOffset = _mm256_setr_epi32(0, 0, 0, 256, 0, 0, 0, 256);
+		for (; i + 2 <= uiPixelCount; i += 2)
+		{
+			__m128i in = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(pSrc + i * 4));
+			__m256i index = _mm256_add_epi32(_mm256_cvtepu8_epi32(in), alphaOffset);
+			_mm256_storeu_ps(pDst + i * 4, _mm256_i32gather_ps(aryDecode.data(), index, 4));
+		}
+	}
+	//SSE没有gather，查表与标量版本相同
+
+	for (; i < uiPixelCount; ++i)
+	{
+		const UCHAR* pIn = pSrc + i * 4;
+		float* pOut = pDst + i * 4;
+		pOut[0] = aryDecode[pIn[0]];
+		pOut[1] = aryDecode[pIn[1]];
+		pOut[2] = aryDecode[pIn[2]];
+		pOut[3] = aryDecode[256 + pIn[3]];
+	}
+}
+
+void PixelConvert::LinearToSRGB(const float* pSrc, UCHAR* pDst, size_t uiPixelCount)
+{
+	LinearToSRGB(pSrc, pDst, uiPixelCount, GetSupportedSimdLevel());
+}
+
+void PixelConvert::LinearToSRGB(const float* pSrc, UCHAR* pDst, size_t uiPixelCount, SimdLevel level)
+{
+	const auto& aryEncode = GetEncodeTable();
+	const float fMaxIndex = static_cast<float>(ENCODE_LEVEL_COUNT - 1);
+
+	size_t i = 0;
+	if (level == SimdLevel::AVX2)
+	{
+		//每次8个像素，分4组计算下标并gather，再由两次饱和pack压到字节；pack在128位lane内进行，最后按lane重排
+		const __m256 scale = _mm256_set1_ps(fMaxIndex);
+		const __m256 half = _mm256_set1_ps(0.5f);
+		const __m256 maxIndex = _mm256_set1_ps(fMaxIndex);
+		const __m256i alphaOffset = _mm256_setr_epi32(0, 0, 0, ENCODE_LEVEL_COUNT, 0, 0, 0, ENCODE_LEVEL_COUNT);
+		const __m256i permute = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+		auto Encode = [&](const float* pIn)
+		{
+			__m256 value = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(pIn), scale), half);
+			value = _mm256_min_ps(_mm256_max_ps(value, _mm256_setzero_ps()), maxIndex);
+			__m256i index = _mm256_add_epi32(_mm256_cvttps_epi32(value), alphaOffset);
+			return _mm256_i32gather_epi32(aryEncode.data(), index, 4);
+		};
+
+		for (; i + 8 <= uiPixelCount; i += 8)
+		{
+			const float* pIn = pSrc + i * 4;
+			__m256i packed01 = _mm256_packus_epi32(Encode(pIn), Encode(pIn + 8));
+			__m256i packed23 = _mm256_packus_epi32(Encode(pIn + 16), Encode(pIn + 24));
+			__m256i bytes = _mm256_packus_epi16(packed01, packed23);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(pDst + i * 4), _mm256_permutevar8x32_epi32(bytes, permute));
+		}
+	}
+	else if (level == SimdLevel::SSE)
+	{
+		//下标的计算向量化，查表为标量
+		const __m128 scale = _mm_set1_ps(fMaxIndex);
+		const __m128 half = _mm_set1_ps(0.5f);
+		const __m128i alphaOffset = _mm_setr_epi32(0, 0, 0, ENCODE_LEVEL_COUNT);
+		alignas(16) int aryIndex[4];
+		for (; i < uiPixelCount; ++i)
+		{
+			__m128 value = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(pSrc + i * 4), scale), half);
+			value = _mm_min_ps(_mm_max_ps(value, _mm_setzero_ps()), scale);
+			_mm_store_si128(reinterpret_cast<__m128i*>(aryIndex), _mm_add_epi32(_mm_cvttps_epi32(value), alphaOffset));
+
+			UCHAR* pOut = pDst + i * 4;
+			pOut[0] = static_cast<UCHAR>(aryEncode[aryIndex[0]]);
+			pOut[1] = static_cast<UCHAR>(aryEncode[aryIndex[1]]);
+			pOut[2] = static_cast<UCHAR>(aryEncode[aryIndex[2]]);
+			pOut[3] = static_cast<UCHAR>(aryEncode[aryIndex[3]]);
+		}
+	}
+
+	for (; i < uiPixelCount; ++i)
+	{
+		const float* pIn = pSrc + i * 4;
+		UCHAR* pOut = pDst + i * 4;
+		pOut[0] = static_cast<UCHAR>(aryEncode[GetEncodeIndex(pIn[0])]);
+		pOut[1] = static_cast<UCHAR>(aryEncode[GetEncodeIndex(pIn[1])]);
+		pOut[2] = static_cast<UCHAR>(aryEncode[GetEncodeIndex(pIn[2])]);
+		pOut[3] = static_cast<UCHAR>(aryEncode[ENCODE_LEVEL_COUNT + GetEncodeIndex(pIn[3])]);
+	}
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include "Core.h"
+
+//纹理导入时的像素格式转换，按CPU支持的指令集选择SSE/AVX2实现
+//Scalar与SSE版本保留用于不支持AVX2的CPU以及基准测试对照
+class PixelConvert
+{
+public:
+	enum class SimdLevel
+	{
+		Scalar,
+		SSE,	//SSSE3，需要pshufb
+		AVX2,
+	};
+
+	//启动后检测一次，AVX2还要求操作系统保存了YMM寄存器
+	static SimdLevel GetSupportedSimdLevel();
+	static const char* GetSimdLevelName(SimdLevel level);
+
+	//uiChannel为1~4的紧凑像素展开为RGBA8，灰度复制到RGB，缺少的alpha补255
+	//3通道使用SIMD，4通道直接拷贝，pSrc与pDst不能重叠
+	static void ExpandToRGBA8(const UCHAR* pSrc, UCHAR* pDst, size_t uiPixelCount, UINT uiChannel);
+	static void ExpandToRGBA8(const UCHAR* pSrc, UCHAR* pDst, size_t uiPixelCount, UINT uiChannel, SimdLevel level);
+
+	//RGBA8的sRGB编码与[0,1]线性浮点之间的转换，alpha始终按线性处理
+	static void SRGBToLinear(const UCHAR* pSrc, float* pDst, size_t uiPixelCount);
+	static void SRGBToLinear(const UCHAR* pSrc, float* pDst, size_t uiPixelCount, SimdLevel level);
+	static void LinearToSRGB(const float* pSrc, UCHAR* pDst, size_t uiPixelCount);
+	static void LinearToSRGB(const float* pSrc, UCHAR* pDst, size_t uiPixelCount, SimdLevel level);
+};
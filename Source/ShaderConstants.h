@@ -0,0 +1,130 @@
+#pragma once
+#include "Core.h"
+#include "glm/glm.hpp"
+
+#include <cstddef>
+#include <cstring>
+
+//std140下各类型的基础对齐：标量4字节，vec2为8字节，vec3/vec4与mat4（按列视为vec4数组）为16字节
+template<typename T> struct Std140Alignment;
+template<> struct Std140Alignment<float> { static constexpr size_t value = 4; };
+template<> struct Std140Alignment<int> { static constexpr size_t value = 4; };
+template<> struct Std140Alignment<UINT> { static constexpr size_t value = 4; };
+template<> struct Std140Alignment<glm::vec2> { static constexpr size_t value = 8; };
+template<> struct Std140Alignment<glm::vec3> { static constexpr size_t value = 16; };
+template<> struct Std140Alignment<glm::vec4> { static constexpr size_t value = 16; };
+template<> struct Std140Alignment<glm::mat4> { static constexpr size_t value = 16; };
+template<> struct Std140Alignment<glm::uvec4> { static constexpr size_t value = 16; };
+//数组的每个元素按16字节对齐
+template<typename T, size_t N> struct Std140Alignment<T[N]> { static constexpr size_t value = 16; };
+
+//编译期检查成员偏移与shader中的声明一致，且满足std140对齐
+#define STD140_CHECK_OFFSET(Block, member, uiOffset)\
+	static_assert(offsetof(Block, member) == (uiOffset), #Block "::" #member " offset does not match the shader");\
+	static_assert(offsetof(Block, member) % Std140Alignment<decltype(Block::member)>::value == 0, #Block "::" #member " breaks std140 alignment")
+
+#define STD140_CHECK_SIZE(Block, uiSize)\
+	static_assert(sizeof(Block) == (uiSize), #Block " size does not match the shader")
+
+//以下结构是shader.vert中同名uniform block的CPU端镜像，修改任一方都要同步修改另一方
+
+//layout(binding = 2) uniform PerDrawConstants，每次绘制变化的数据，放在动态偏移的Uniform Buffer中每个物体一个槽位
+struct PerDrawConstants
+{
+	glm::mat4 model;
+};
+STD140_CHECK_OFFSET(PerDrawConstants, model, 0);
+STD140_CHECK_SIZE(PerDrawConstants, 64);
+
+//layout(binding = 0) uniform PerFrameConstants，每帧只变化一次的数据，所有物体共用
+struct PerFrameConstants
+{
+	glm::mat4 view;
+	glm::mat4 proj;
+};
+STD140_CHECK_OFFSET(PerFrameConstants, view, 0);
+STD140_CHECK_OFFSET(PerFrameConstants, proj, 64);
+STD140_CHECK_SIZE(PerFrameConstants, 128);
+
+//shader_vt.frag中的layout(binding = 4) uniform VirtualTextureConstants，稀疏纹理各级的页划分，创建后不再变化
+struct VirtualTextureConstants
+{
+	static constexpr UINT MAX_LEVEL_COUNT = 16;
+
+	glm::vec4 aryLevelPageScales[MAX_LEVEL_COUNT];	//xy为该级尺寸 / 页尺寸
+	glm::uvec4 aryLevelPages[MAX_LEVEL_COUNT];	//x、y为该级的页数，z为该级第一页的编号
+	UINT uiPagedLevelCount;
+	UINT aryPadding[3];
+};
+STD140_CHECK_OFFSET(VirtualTextureConstants, aryLevelPageScales, 0);
+STD140_CHECK_OFFSET(VirtualTextureConstants, aryLevelPages, 256);
+STD140_CHECK_OFFSET(VirtualTextureConstants, uiPagedLevelCount, 512);
+STD140_CHECK_SIZE(VirtualTextureConstants, 528);
+
+//把常量块写入持久映射的内存，每个目标保存一份上次写入的副本
+//只写入与副本相比发生变化的16字节段，并输出覆盖这些段的范围供非COHERENT内存Flush
+template<typename Block>
+class ConstantBlockWriter
+{
+public:
+	static constexpr size_t SEGMENT_SIZE = 16;
+	static_assert(sizeof(Block) % SEGMENT_SIZE == 0, "Constant block size must be a multiple of 16 bytes");
+
+	void Resize(size_t uiTargetCount)
+	{
+		m_vecShadows.assign(uiTargetCount, Block{});
+		m_vecWritten.assign(uiTargetCount, false);
+	}
+
+	//没有任何变化时返回false
+	bool Write(size_t uiTarget, const Block& block, void* pMappedData, size_t& uiDirtyOffset, size_t& uiDirtySize)
+	{
+		const UCHAR* pSrc = reinterpret_cast<const UCHAR*>(&block);
+		UCHAR* pShadow = reinterpret_cast<UCHAR*>(&m_vecShadows[uiTarget]);
+		UCHAR* pDst = static_cast<UCHAR*>(pMappedData);
+
+		//首次写入时映射内存中的内容未知，整体写入
+		if (!m_vecWritten[uiTarget])
+		{
+			memcpy(pDst, pSrc, sizeof(Block));
+			memcpy(pShadow, pSrc, sizeof(Block));
+			m_vecWritten[uiTarget] = true;
+			uiDirtyOffset = 0;
+			uiDirtySize = sizeof(Block);
+			return true;
+		}
+
+		size_t uiDirtyBegin = sizeof(Block);
+		size_t uiDirtyEnd = 0;
+		for (size_t uiOffset = 0; uiOffset < sizeof(Block);)
+		{
+			if (memcmp(pSrc + uiOffset, pShadow + uiOffset, SEGMENT_SIZE) == 0)
+			{
+				uiOffset += SEGMENT_SIZE;
+				continue;
+			}
+
+			//连续变化的段合并为一次memcpy
+			size_t uiRunEnd = uiOffset + SEGMENT_SIZE;
+			while (uiRunEnd < sizeof(Block) && memcmp(pSrc + uiRunEnd, pShadow + uiRunEnd, SEGMENT_SIZE) != 0)
+				uiRunEnd += SEGMENT_SIZE;
+
+			memcpy(pDst + uiOffset, pSrc + uiOffset, uiRunEnd - uiOffset);
+			memcpy(pShadow + uiOffset, pSrc + uiOffset, uiRunEnd - uiOffset);
+			uiDirtyBegin = std::min(uiDirtyBegin, uiOffset);
+			uiDirtyEnd = uiRunEnd;
+			uiOffset = uiRunEnd;
+		}
+
+		if (uiDirtyEnd == 0)
+			return false;
+
+		uiDirtyOffset = uiDirtyBegin;
+		uiDirtySize = uiDirtyEnd - uiDirtyBegin;
+		return true;
+	}
+
+private:
+	std::vector<Block> m_vecShadows;
+	std::vector<bool> m_vecWritten;
+};
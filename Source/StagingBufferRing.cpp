@@ -0,0 +1,368 @@
+#include "StagingBufferRing.h"
+
+static VkDeviceSize AlignUp(VkDeviceSize uiValue, VkDeviceSize uiAlignment)
+{
+	return (uiValue + uiAlignment - 1) / uiAlignment * uiAlignment;
+}
+
+StagingBufferRing::StagingBufferRing()
+	: m_Device(VK_NULL_HANDLE),
+	m_TransferQueue(VK_NULL_HANDLE), m_TransferCommandPool(VK_NULL_HANDLE), m_uiTransferFamilyIdx(0),
+	m_GraphicQueue(VK_NULL_HANDLE), m_GraphicCommandPool(VK_NULL_HANDLE), m_uiGraphicFamilyIdx(0),
+	m_Buffer(VK_NULL_HANDLE), m_pMappedData(nullptr), m_uiSize(0), m_uiHead(0), m_uiTail(0),
+	m_RecordingCommandBuffer(VK_NULL_HANDLE), m_uiSubmittedSerial(0), m_uiCompletedSerial(0), m_PendingAcquireStageMask(0),
+	m_uiWaitSerial(0)
+{
+}
+
+void StagingBufferRing::Init(VkDevice device,
+	VkQueue transferQueue, VkCommandPool transferCommandPool, UINT uiTransferFamilyIdx,
+	VkQueue graphicQueue, VkCommandPool graphicCommandPool, UINT uiGraphicFamilyIdx,
+	VkBuffer buffer, void* pMappedData, VkDeviceSize uiSize)
+{
+	ASSERT(pMappedData, "Staging ring buffer must be host visible");
+
+	m_Device = device;
+	m_TransferQueue = transferQueue;
+	m_TransferCommandPool = transferCommandPool;
+	m_uiTransferFamilyIdx = uiTransferFamilyIdx;
+	m_GraphicQueue = graphicQueue;
+	m_GraphicCommandPool = graphicCommandPool;
+	m_uiGraphicFamilyIdx = uiGraphicFamilyIdx;
+	m_Buffer = buffer;
+	m_pMappedData = static_cast<UCHAR*>(pMappedData);
+	m_uiSize = uiSize;
+	m_uiHead = 0;
+	m_uiTail = 0;
+}
+
+void StagingBufferRing::Destroy()
+{
+	if (m_Device == VK_NULL_HANDLE)
+		return;
+
+	Submit();
+	Retire(true);
+
+	for (auto fence : m_vecFreeFences)
+		vkDestroyFence(m_Device, fence, nullptr);
+	m_vecFreeFences.clear();
+
+	for (auto semaphore : m_vecFreeSemaphores)
+		vkDestroySemaphore(m_Device, semaphore, nullptr);
+	m_vecFreeSemaphores.clear();
+
+	m_Device = VK_NULL_HANDLE;
+}
+
+bool StagingBufferRing::TryAllocate(VkDeviceSize uiSize, VkDeviceSize uiAlignment, VkDeviceSize& uiOffset)
+{
+	VkDeviceSize uiAligned = AlignUp(m_uiHead, uiAlignment);
+
+	if (m_uiHead >= m_uiTail)
+	{
+		if (uiAligned + uiSize <= m_uiSize)
+		{
+			uiOffset = uiAligned;
+			m_uiHead = uiAligned + uiSize;
+			return true;
+		}
+
+		//尾部剩余空间不足时绕回开头，尾部这段空间在m_uiTail越过它之前不再使用
+		if (uiSize < m_uiTail)
+		{
+			uiOffset = 0;
+			m_uiHead = uiSize;
+			return true;
+		}
+		return false;
+	}
+
+	//已绕回时不能追上m_uiTail，否则m_uiHead == m_uiTail无法与空环区分
+	if (uiAligned + uiSize < m_uiTail)
+	{
+		uiOffset = uiAligned;
+		m_uiHead = uiAligned + uiSize;
+		return true;
+	}
+	return false;
+}
+
+VkCommandBuffer StagingBufferRing::Allocate(VkDeviceSize uiSize, VkDeviceSize uiAlignment, VkDeviceSize& uiOffset, void*& pData)
+{
+	ASSERT(uiSize <= GetMaxAllocationSize(), std::format("Staging allocation of {} bytes exceeds ring limit {}", uiSize, GetMaxAllocationSize()));
+
+	Retire();
+
+	while (!TryAllocate(uiSize, uiAlignment, uiOffset))
+	{
+		//当前录制中的命令占用的空间只能在提交后回收
+		Submit();
+
+		ASSERT(!m_dequeInFlight.empty(), "Staging ring buffer has no space but nothing in flight");
+		VULKAN_ASSERT(vkWaitForFences(m_Device, 1, &m_dequeInFlight.front().fence, VK_TRUE, UINT64_MAX), "Wait staging fence failed");
+		RetireFront();
+	}
+
+	pData = m_pMappedData + uiOffset;
+	return GetCommandBuffer();
+}
+
+VkCommandBuffer StagingBufferRing::BeginCommandBuffer(VkCommandPool commandPool)
+{
+	VkCommandBufferAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.commandPool = commandPool;
+	allocInfo.commandBufferCount = 1;
+
+	VkCommandBuffer commandBuffer;
+	VULKAN_ASSERT(vkAllocateCommandBuffers(m_Device, &allocInfo, &commandBuffer), "Allocate staging command buffer failed");
+
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+	return commandBuffer;
+}
+
+VkCommandBuffer StagingBufferRing::GetCommandBuffer()
+{
+	if (m_RecordingCommandBuffer == VK_NULL_HANDLE)
+	{
+		m_RecordingCommandBuffer = BeginCommandBuffer(m_TransferCommandPool);
+
+		//semaphore的等待只约束同一次提交中的命令，之后的提交需用执行依赖排在其后
+		if (m_uiWaitSerial > m_uiCompletedSerial)
+		{
+			vkCmdPipelineBarrier(m_RecordingCommandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0,
+				0, nullptr, 0, nullptr, 0, nullptr);
+		}
+	}
+
+	return m_RecordingCommandBuffer;
+}
+
+void StagingBufferRing::FinishBuffer(VkBuffer buffer, VkAccessFlags dstAccessMask, VkPipelineStageFlags dstStageMask,
+	VkDeviceSize uiOffset, VkDeviceSize uiSize)
+{
+	VkBufferMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = dstAccessMask;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.buffer = buffer;
+	barrier.offset = uiOffset;
+	barrier.size = uiSize;
+
+	//barrier的第一同步范围包含提交顺序在它之前的所有命令，因此也覆盖之前已提交的分块
+	if (!IsDedicatedTransferQueue())
+	{
+		vkCmdPipelineBarrier(GetCommandBuffer(), VK_PIPELINE_STAGE_TRANSFER_BIT, dstStageMask, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+		return;
+	}
+
+	//release：传输队列上的dst阶段与访问会被忽略
+	barrier.dstAccessMask = 0;
+	barrier.srcQueueFamilyIndex = m_uiTransferFamilyIdx;
+	barrier.dstQueueFamilyIndex = m_uiGraphicFamilyIdx;
+	vkCmdPipelineBarrier(GetCommandBuffer(), VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+	//acquire：图形队列上的src访问会被忽略，可见性由Semaphore保证
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = dstAccessMask;
+	m_vecPendingBufferAcquires.push_back(barrier);
+	m_PendingAcquireStageMask |= dstStageMask;
+}
+
+void StagingBufferRing::FinishImage(VkImage image, const VkImageSubresourceRange& subresourceRange, VkImageLayout oldLayout, VkImageLayout newLayout,
+	VkAccessFlags dstAccessMask, VkPipelineStageFlags dstStageMask)
+{
+	VkImageMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = dstAccessMask;
+	barrier.oldLayout = oldLayout;
+	barrier.newLayout = newLayout;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = image;
+	barrier.subresourceRange = subresourceRange;
+
+	if (!IsDedicatedTransferQueue())
+	{
+		vkCmdPipelineBarrier(GetCommandBuffer(), VK_PIPELINE_STAGE_TRANSFER_BIT, dstStageMask, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+		return;
+	}
+
+	//release与acquire需指定相同的layout，转换只发生一次
+	barrier.dstAccessMask = 0;
+	barrier.srcQueueFamilyIndex = m_uiTransferFamilyIdx;
+	barrier.dstQueueFamilyIndex = m_uiGraphicFamilyIdx;
+	vkCmdPipelineBarrier(GetCommandBuffer(), VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = dstAccessMask;
+	m_vecPendingImageAcquires.push_back(barrier);
+	m_PendingAcquireStageMask |= dstStageMask;
+}
+
+VkCommandBuffer StagingBufferRing::RecordAcquireBarriers()
+{
+	if (m_vecPendingBufferAcquires.empty() && m_vecPendingImageAcquires.empty())
+		return VK_NULL_HANDLE;
+
+	//acquire的src阶段与Semaphore等待的阶段相同，构成依赖链
+	VkCommandBuffer commandBuffer = BeginCommandBuffer(m_GraphicCommandPool);
+	vkCmdPipelineBarrier(commandBuffer, m_PendingAcquireStageMask, m_PendingAcquireStageMask, 0,
+		0, nullptr,
+		static_cast<UINT>(m_vecPendingBufferAcquires.size()), m_vecPendingBufferAcquires.data(),
+		static_cast<UINT>(m_vecPendingImageAcquires.size()), m_vecPendingImageAcquires.data());
+	vkEndCommandBuffer(commandBuffer);
+
+	m_vecPendingBufferAcquires.clear();
+	m_vecPendingImageAcquires.clear();
+	return commandBuffer;
+}
+
+void StagingBufferRing::AddWaitSemaphore(VkSemaphore semaphore, VkPipelineStageFlags stageMask)
+{
+	m_vecPendingWaitSemaphores.push_back(semaphore);
+	m_vecPendingWaitStageMasks.push_back(stageMask);
+}
+
+UploadToken StagingBufferRing::Submit()
+{
+	if (m_RecordingCommandBuffer == VK_NULL_HANDLE)
+		return { m_uiSubmittedSerial };
+
+	vkEndCommandBuffer(m_RecordingCommandBuffer);
+
+	VkFence fence;
+	if (!m_vecFreeFences.empty())
+	{
+		fence = m_vecFreeFences.back();
+		m_vecFreeFences.pop_back();
+	}
+	else
+	{
+		VkFenceCreateInfo fenceCreateInfo{};
+		fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		VULKAN_ASSERT(vkCreateFence(m_Device, &fenceCreateInfo, nullptr, &fence), "Create staging fence failed");
+	}
+
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &m_RecordingCommandBuffer;
+	submitInfo.waitSemaphoreCount = static_cast<UINT>(m_vecPendingWaitSemaphores.size());
+	submitInfo.pWaitSemaphores = m_vecPendingWaitSemaphores.data();
+	submitInfo.pWaitDstStageMask = m_vecPendingWaitStageMasks.data();
+	if (!m_vecPendingWaitSemaphores.empty())
+		m_uiWaitSerial = m_uiSubmittedSerial + 1;
+
+	VkCommandBuffer acquireCommandBuffer = RecordAcquireBarriers();
+	VkSemaphore semaphore = VK_NULL_HANDLE;
+	if (acquireCommandBuffer == VK_NULL_HANDLE)
+	{
+		VULKAN_ASSERT(vkQueueSubmit(m_TransferQueue, 1, &submitInfo, fence), "Submit staging command buffer failed");
+	}
+	else
+	{
+		//传输队列完成后signal，图形队列等待后执行acquire，Fence放在后者上，signal时两者都已完成
+		if (!m_vecFreeSemaphores.empty())
+		{
+			semaphore = m_vecFreeSemaphores.back();
+			m_vecFreeSemaphores.pop_back();
+		}
+		else
+		{
+			VkSemaphoreCreateInfo semaphoreCreateInfo{};
+			semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+			VULKAN_ASSERT(vkCreateSemaphore(m_Device, &semaphoreCreateInfo, nullptr, &semaphore), "Create staging semaphore failed");
+		}
+
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores = &semaphore;
+		VULKAN_ASSERT(vkQueueSubmit(m_TransferQueue, 1, &submitInfo, VK_NULL_HANDLE), "Submit staging command buffer failed");
+
+		VkSubmitInfo acquireSubmitInfo{};
+		acquireSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		acquireSubmitInfo.waitSemaphoreCount = 1;
+		acquireSubmitInfo.pWaitSemaphores = &semaphore;
+		acquireSubmitInfo.pWaitDstStageMask = &m_PendingAcquireStageMask;
+		acquireSubmitInfo.commandBufferCount = 1;
+		acquireSubmitInfo.pCommandBuffers = &acquireCommandBuffer;
+		VULKAN_ASSERT(vkQueueSubmit(m_GraphicQueue, 1, &acquireSubmitInfo, fence), "Submit staging acquire command buffer failed");
+
+		m_PendingAcquireStageMask = 0;
+	}
+
+	m_dequeInFlight.push_back({ m_RecordingCommandBuffer, acquireCommandBuffer, semaphore, fence, m_uiHead, ++m_uiSubmittedSerial });
+	m_RecordingCommandBuffer = VK_NULL_HANDLE;
+	m_vecPendingWaitSemaphores.clear();
+	m_vecPendingWaitStageMasks.clear();
+
+	return { m_uiSubmittedSerial };
+}
+
+bool StagingBufferRing::IsComplete(UploadToken token)
+{
+	Retire();
+	return token.uiSerial <= m_uiCompletedSerial;
+}
+
+void StagingBufferRing::Wait(UploadToken token)
+{
+	ASSERT(token.uiSerial <= m_uiSubmittedSerial, "Wait for an upload that has not been submitted");
+
+	while (m_uiCompletedSerial < token.uiSerial)
+	{
+		VULKAN_ASSERT(vkWaitForFences(m_Device, 1, &m_dequeInFlight.front().fence, VK_TRUE, UINT64_MAX), "Wait staging fence failed");
+		RetireFront();
+	}
+}
+
+void StagingBufferRing::RetireFront()
+{
+	InFlightSubmit& submit = m_dequeInFlight.front();
+
+	vkFreeCommandBuffers(m_Device, m_TransferCommandPool, 1, &submit.commandBuffer);
+	if (submit.acquireCommandBuffer != VK_NULL_HANDLE)
+		vkFreeCommandBuffers(m_Device, m_GraphicCommandPool, 1, &submit.acquireCommandBuffer);
+	if (submit.semaphore != VK_NULL_HANDLE)
+		m_vecFreeSemaphores.push_back(submit.semaphore);
+	vkResetFences(m_Device, 1, &submit.fence);
+	m_vecFreeFences.push_back(submit.fence);
+	m_uiTail = submit.uiEnd;
+	m_uiCompletedSerial = submit.uiSerial;
+
+	m_dequeInFlight.pop_front();
+
+	//全部回收后从头开始，减少绕回
+	if (m_dequeInFlight.empty() && m_RecordingCommandBuffer == VK_NULL_HANDLE)
+	{
+		m_uiHead = 0;
+		m_uiTail = 0;
+	}
+}
+
+void StagingBufferRing::Retire(bool bWaitAll)
+{
+	while (!m_dequeInFlight.empty())
+	{
+		VkFence fence = m_dequeInFlight.front().fence;
+		if (bWaitAll)
+		{
+			VULKAN_ASSERT(vkWaitForFences(m_Device, 1, &fence, VK_TRUE, UINT64_MAX), "Wait staging fence failed");
+		}
+		else if (vkGetFenceStatus(m_Device, fence) != VK_SUCCESS)
+		{
+			break;
+		}
+
+		RetireFront();
+	}
+}
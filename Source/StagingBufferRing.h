@@ -0,0 +1,125 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include "GLFW/glfw3.h"
+
+#include "Core.h"
+
+#include <deque>
+
+//一次提交的序号，序号不大于已完成序号的提交都已完成（同一队列上的提交按顺序完成）
+struct UploadToken
+{
+	uint64_t uiSerial = 0;
+};
+
+//持久映射的环形暂存缓冲，上传数据按顺序写入递增的偏移处，所在的提交完成（Fence signal）后回收
+//多个资源的layout转换与copy录制在同一个CommandBuffer中，由Submit一次提交并返回可等待的UploadToken
+//空间不足时先提交当前命令再等待最早的提交完成
+//传输队列与图形队列属于不同队列族时，上传在传输队列上执行，资源通过Finish*做队列族所有权转移后交给图形队列
+class StagingBufferRing
+{
+public:
+	static constexpr VkDeviceSize DEFAULT_SIZE = 32ull << 20;
+	static constexpr VkDeviceSize MIN_SIZE = 4ull << 20;	//超出预算时缩小的下限
+
+	StagingBufferRing();
+
+	StagingBufferRing(const StagingBufferRing&) = delete;
+	StagingBufferRing& operator=(const StagingBufferRing&) = delete;
+
+	//buffer需带TRANSFER_SRC用途并绑定在HOST_VISIBLE | HOST_COHERENT的内存上，pMappedData指向其起始处
+	//两个CommandPool分别属于传输队列与图形队列的队列族，队列族相同时可以传入同一个
+	void Init(VkDevice device,
+		VkQueue transferQueue, VkCommandPool transferCommandPool, UINT uiTransferFamilyIdx,
+		VkQueue graphicQueue, VkCommandPool graphicCommandPool, UINT uiGraphicFamilyIdx,
+		VkBuffer buffer, void* pMappedData, VkDeviceSize uiSize);
+	//等待所有提交完成后释放CommandBuffer、Fence与Semaphore，buffer本身由调用者销毁
+	void Destroy();
+
+	bool IsDedicatedTransferQueue() const { return m_uiTransferFamilyIdx != m_uiGraphicFamilyIdx; }
+
+	//单次可分配的上限，更大的上传需由调用者分块
+	VkDeviceSize GetMaxAllocationSize() const { return m_uiSize / 4; }
+	VkBuffer GetBuffer() const { return m_Buffer; }
+
+	//分配uiSize字节并输出其偏移与映射地址，返回用于录制copy命令的CommandBuffer
+	//之后的Allocate可能会提交并更换CommandBuffer，因此每次都需使用最新返回的CommandBuffer
+	VkCommandBuffer Allocate(VkDeviceSize uiSize, VkDeviceSize uiAlignment, VkDeviceSize& uiOffset, void*& pData);
+
+	//返回当前录制中的CommandBuffer，用于录制不需要暂存空间的命令（如layout转换）
+	//命令在传输队列上执行，只能使用TRANSFER相关的管线阶段
+	VkCommandBuffer GetCommandBuffer();
+
+	//资源的copy录制完成后调用，使之后图形队列上dstStageMask阶段的dstAccessMask访问能看到上传的数据
+	//队列族不同时录制release barrier，并在Submit时于图形队列上执行对应的acquire barrier；相同时只录制普通barrier
+	//多个资源共用的buffer只转移写入的区间，其余区间仍归图形队列所有
+	void FinishBuffer(VkBuffer buffer, VkAccessFlags dstAccessMask, VkPipelineStageFlags dstStageMask,
+		VkDeviceSize uiOffset = 0, VkDeviceSize uiSize = VK_WHOLE_SIZE);
+	//同时把image从oldLayout转换为newLayout
+	void FinishImage(VkImage image, const VkImageSubresourceRange& subresourceRange, VkImageLayout oldLayout, VkImageLayout newLayout,
+		VkAccessFlags dstAccessMask, VkPipelineStageFlags dstStageMask);
+
+	//下一次Submit在传输队列上等待semaphore后再执行stageMask阶段，semaphore由其他队列上的操作signal（如稀疏绑定）
+	//空间不足而提前提交时等待落在那一次提交上，该提交完成之前录制的命令都在开头排在其后
+	void AddWaitSemaphore(VkSemaphore semaphore, VkPipelineStageFlags stageMask);
+
+	//提交已录制的命令，不等待完成；没有录制中的命令时返回上一次提交的Token
+	UploadToken Submit();
+
+	bool IsComplete(UploadToken token);
+	void Wait(UploadToken token);
+
+	//回收已完成的提交，bWaitAll为true时等待全部提交完成
+	void Retire(bool bWaitAll = false);
+
+	UINT GetInFlightCount() const { return static_cast<UINT>(m_dequeInFlight.size()); }
+
+private:
+	struct InFlightSubmit
+	{
+		VkCommandBuffer commandBuffer;
+		VkCommandBuffer acquireCommandBuffer;	//图形队列上执行acquire barrier，不需要时为空
+		VkSemaphore semaphore;	//传输队列完成后通知图形队列，不需要时为空
+		VkFence fence;
+		VkDeviceSize uiEnd;	//该提交写入的数据在环中的结束位置
+		uint64_t uiSerial;
+	};
+
+	bool TryAllocate(VkDeviceSize uiSize, VkDeviceSize uiAlignment, VkDeviceSize& uiOffset);
+	void RetireFront();
+	VkCommandBuffer BeginCommandBuffer(VkCommandPool commandPool);
+	VkCommandBuffer RecordAcquireBarriers();
+
+private:
+	VkDevice m_Device;
+	VkQueue m_TransferQueue;
+	VkCommandPool m_TransferCommandPool;
+	UINT m_uiTransferFamilyIdx;
+	VkQueue m_GraphicQueue;
+	VkCommandPool m_GraphicCommandPool;
+	UINT m_uiGraphicFamilyIdx;
+	VkBuffer m_Buffer;
+	UCHAR* m_pMappedData;
+	VkDeviceSize m_uiSize;
+
+	//[m_uiTail, m_uiHead)为仍在使用的区间，m_uiHead < m_uiTail表示已绕回开头
+	VkDeviceSize m_uiHead;
+	VkDeviceSize m_uiTail;
+
+	VkCommandBuffer m_RecordingCommandBuffer;
+	uint64_t m_uiSubmittedSerial;
+	uint64_t m_uiCompletedSerial;
+	std::deque<InFlightSubmit> m_dequeInFlight;
+	std::vector<VkFence> m_vecFreeFences;
+	std::vector<VkSemaphore> m_vecFreeSemaphores;
+
+	//已录制release、等待Submit时在图形队列上acquire的资源
+	std::vector<VkBufferMemoryBarrier> m_vecPendingBufferAcquires;
+	std::vector<VkImageMemoryBarrier> m_vecPendingImageAcquires;
+	VkPipelineStageFlags m_PendingAcquireStageMask;
+
+	std::vector<VkSemaphore> m_vecPendingWaitSemaphores;
+	std::vector<VkPipelineStageFlags> m_vecPendingWaitStageMasks;
+	uint64_t m_uiWaitSerial;	//最近一次等待外部semaphore的提交
+};
@@ -0,0 +1,213 @@
+#include "TLSFAllocator.h"
+
+#include <bit>
+
+static uint64_t AlignUp(uint64_t uiValue, uint64_t uiAlignment)
+{
+	return (uiValue + uiAlignment - 1) / uiAlignment * uiAlignment;
+}
+
+TLSFAllocator::TLSFAllocator(uint64_t uiSize)
+	: m_uiSize(uiSize / GRANULARITY * GRANULARITY), m_uiUsedSize(0), m_uiAllocationCount(0), m_uiFirstLevelBitmap(0)
+{
+	m_arySecondLevelBitmaps.fill(0);
+	m_aryFreeHeads.fill(INVALID_NODE);
+
+	if (m_uiSize > 0)
+		InsertFreeNode(CreateNode(0, m_uiSize));
+}
+
+void TLSFAllocator::MappingInsert(uint64_t uiSize, UINT& uiFirstLevel, UINT& uiSecondLevel)
+{
+	if (uiSize < SMALL_BLOCK_SIZE)
+	{
+		uiFirstLevel = 0;
+		uiSecondLevel = static_cast<UINT>(uiSize / (SMALL_BLOCK_SIZE / SL_INDEX_COUNT));
+	}
+	else
+	{
+		UINT uiLog2 = static_cast<UINT>(std::bit_width(uiSize)) - 1;
+		uiSecondLevel = static_cast<UINT>(uiSize >> (uiLog2 - SL_INDEX_COUNT_LOG2)) ^ SL_INDEX_COUNT;
+		uiFirstLevel = uiLog2 - (FL_INDEX_SHIFT - 1);
+	}
+}
+
+UINT TLSFAllocator::CreateNode(uint64_t uiOffset, uint64_t uiSize)
+{
+	UINT uiNode;
+	if (!m_vecUnusedNodes.empty())
+	{
+		uiNode = m_vecUnusedNodes.back();
+		m_vecUnusedNodes.pop_back();
+	}
+	else
+	{
+		uiNode = static_cast<UINT>(m_vecNodes.size());
+		m_vecNodes.emplace_back();
+	}
+
+	m_vecNodes[uiNode] = { uiOffset, uiSize, INVALID_NODE, INVALID_NODE, INVALID_NODE, INVALID_NODE, false };
+	return uiNode;
+}
+
+void TLSFAllocator::ReleaseNode(UINT uiNode)
+{
+	m_vecUnusedNodes.push_back(uiNode);
+}
+
+UINT TLSFAllocator::FindFreeNode(uint64_t uiSize) const
+{
+	//向上取整到下一个二级区间的起点，这样该区间中的任意空闲块都能满足请求
+	if (uiSize >= SMALL_BLOCK_SIZE)
+		uiSize += (1ull << (std::bit_width(uiSize) - 1 - SL_INDEX_COUNT_LOG2)) - 1;
+
+	UINT uiFirstLevel, uiSecondLevel;
+	MappingInsert(uiSize, uiFirstLevel, uiSecondLevel);
+	if (uiFirstLevel >= FL_INDEX_COUNT)
+		return INVALID_NODE;
+
+	UINT uiSecondLevelMap = m_arySecondLevelBitmaps[uiFirstLevel] & (~0u << uiSecondLevel);
+	if (uiSecondLevelMap == 0)
+	{
+		uint64_t uiFirstLevelMap = (uiFirstLevel + 1 < 64) ? (m_uiFirstLevelBitmap & (~0ull << (uiFirstLevel + 1))) : 0;
+		if (uiFirstLevelMap == 0)
+			return INVALID_NODE;
+
+		uiFirstLevel = static_cast<UINT>(std::countr_zero(uiFirstLevelMap));
+		uiSecondLevelMap = m_arySecondLevelBitmaps[uiFirstLevel];
+	}
+	uiSecondLevel = static_cast<UINT>(std::countr_zero(uiSecondLevelMap));
+
+	return m_aryFreeHeads[uiFirstLevel * SL_INDEX_COUNT + uiSecondLevel];
+}
+
+void TLSFAllocator::InsertFreeNode(UINT uiNode)
+{
+	Node& node = m_vecNodes[uiNode];
+	UINT uiFirstLevel, uiSecondLevel;
+	MappingInsert(node.uiSize, uiFirstLevel, uiSecondLevel);
+
+	UINT& uiHead = m_aryFreeHeads[uiFirstLevel * SL_INDEX_COUNT + uiSecondLevel];
+	node.bFree = true;
+	node.uiPrevFree = INVALID_NODE;
+	node.uiNextFree = uiHead;
+	if (uiHead != INVALID_NODE)
+		m_vecNodes[uiHead].uiPrevFree = uiNode;
+	uiHead = uiNode;
+
+	m_uiFirstLevelBitmap |= 1ull << uiFirstLevel;
+	m_arySecondLevelBitmaps[uiFirstLevel] |= 1u << uiSecondLevel;
+}
+
+void TLSFAllocator::RemoveFreeNode(UINT uiNode)
+{
+	Node& node = m_vecNodes[uiNode];
+	UINT uiFirstLevel, uiSecondLevel;
+	MappingInsert(node.uiSize, uiFirstLevel, uiSecondLevel);
+
+	if (node.uiPrevFree != INVALID_NODE)
+		m_vecNodes[node.uiPrevFree].uiNextFree = node.uiNextFree;
+	else
+	{
+		UINT& uiHead = m_aryFreeHeads[uiFirstLevel * SL_INDEX_COUNT + uiSecondLevel];
+		uiHead = node.uiNextFree;
+		if (uiHead == INVALID_NODE)
+		{
+			m_arySecondLevelBitmaps[uiFirstLevel] &= ~(1u << uiSecondLevel);
+			if (m_arySecondLevelBitmaps[uiFirstLevel] == 0)
+				m_uiFirstLevelBitmap &= ~(1ull << uiFirstLevel);
+		}
+	}
+	if (node.uiNextFree != INVALID_NODE)
+		m_vecNodes[node.uiNextFree].uiPrevFree = node.uiPrevFree;
+
+	node.bFree = false;
+	node.uiPrevFree = INVALID_NODE;
+	node.uiNextFree = INVALID_NODE;
+}
+
+UINT TLSFAllocator::SplitNode(UINT uiNode, uint64_t uiSize)
+{
+	UINT uiRest = CreateNode(m_vecNodes[uiNode].uiOffset + uiSize, m_vecNodes[uiNode].uiSize - uiSize);
+
+	//CreateNode可能使m_vecNodes扩容，之后再取引用
+	Node& node = m_vecNodes[uiNode];
+	Node& rest = m_vecNodes[uiRest];
+	node.uiSize = uiSize;
+	rest.uiPrevPhysical = uiNode;
+	rest.uiNextPhysical = node.uiNextPhysical;
+	if (node.uiNextPhysical != INVALID_NODE)
+		m_vecNodes[node.uiNextPhysical].uiPrevPhysical = uiRest;
+	node.uiNextPhysical = uiRest;
+
+	return uiRest;
+}
+
+UINT TLSFAllocator::Allocate(uint64_t uiSize, uint64_t uiAlignment, uint64_t& uiOffset)
+{
+	uiSize = AlignUp(std::max(uiSize, GRANULARITY), GRANULARITY);
+	uiAlignment = std::max(uiAlignment, GRANULARITY);
+
+	//节点偏移总是GRANULARITY的倍数，对齐最多需要在前面填充uiAlignment - GRANULARITY字节
+	UINT uiNode = FindFreeNode(uiSize + uiAlignment - GRANULARITY);
+	if (uiNode == INVALID_NODE)
+		return INVALID_NODE;
+
+	RemoveFreeNode(uiNode);
+
+	//前部的对齐填充拆成独立的空闲块，它的物理前驱一定不是空闲块，无需合并
+	uint64_t uiPadding = AlignUp(m_vecNodes[uiNode].uiOffset, uiAlignment) - m_vecNodes[uiNode].uiOffset;
+	if (uiPadding > 0)
+	{
+		UINT uiAligned = SplitNode(uiNode, uiPadding);
+		InsertFreeNode(uiNode);
+		uiNode = uiAligned;
+	}
+
+	if (m_vecNodes[uiNode].uiSize > uiSize)
+		InsertFreeNode(SplitNode(uiNode, uiSize));
+
+	m_uiUsedSize += m_vecNodes[uiNode].uiSize;
+	++m_uiAllocationCount;
+
+	uiOffset = m_vecNodes[uiNode].uiOffset;
+	return uiNode;
+}
+
+void TLSFAllocator::Free(UINT uiNode)
+{
+	ASSERT(uiNode < m_vecNodes.size() && !m_vecNodes[uiNode].bFree, "Free invalid TLSF node");
+
+	m_uiUsedSize -= m_vecNodes[uiNode].uiSize;
+	--m_uiAllocationCount;
+
+	//与物理相邻的空闲块合并
+	UINT uiPrev = m_vecNodes[uiNode].uiPrevPhysical;
+	if (uiPrev != INVALID_NODE && m_vecNodes[uiPrev].bFree)
+	{
+		RemoveFreeNode(uiPrev);
+		Node& prev = m_vecNodes[uiPrev];
+		const Node& node = m_vecNodes[uiNode];
+		prev.uiSize += node.uiSize;
+		prev.uiNextPhysical = node.uiNextPhysical;
+		if (node.uiNextPhysical != INVALID_NODE)
+			m_vecNodes[node.uiNextPhysical].uiPrevPhysical = uiPrev;
+		ReleaseNode(uiNode);
+		uiNode = uiPrev;
+	}
+
+	UINT uiNext = m_vecNodes[uiNode].uiNextPhysical;
+	if (uiNext != INVALID_NODE && m_vecNodes[uiNext].bFree)
+	{
+		RemoveFreeNode(uiNext);
+		Node& node = m_vecNodes[uiNode];
+		const Node& next = m_vecNodes[uiNext];
+		node.uiSize += next.uiSize;
+		node.uiNextPhysical = next.uiNextPhysical;
+		if (next.uiNextPhysical != INVALID_NODE)
+			m_vecNodes[next.uiNextPhysical].uiPrevPhysical = uiNode;
+		ReleaseNode(uiNext);
+	}
+
+	InsertFreeNode(uiNode);
+}
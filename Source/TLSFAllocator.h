@@ -0,0 +1,68 @@
+#pragma once
+#include "Core.h"
+#include <array>
+#include <climits>
+
+//TLSF(Two-Level Segregated Fit)区间分配器，只管理[0, uiSize)内的偏移，不持有实际内存
+//空闲块按大小分为两级索引，分配与释放都是O(1)，释放时与物理相邻的空闲块合并
+class TLSFAllocator
+{
+public:
+	static constexpr UINT INVALID_NODE = UINT_MAX;
+
+	explicit TLSFAllocator(uint64_t uiSize);
+
+	//成功时返回节点号（释放时使用）并输出按uiAlignment对齐的偏移，空间不足返回INVALID_NODE
+	UINT Allocate(uint64_t uiSize, uint64_t uiAlignment, uint64_t& uiOffset);
+	void Free(UINT uiNode);
+
+	uint64_t GetSize() const { return m_uiSize; }
+	uint64_t GetUsedSize() const { return m_uiUsedSize; }
+	size_t GetAllocationCount() const { return m_uiAllocationCount; }
+	bool IsEmpty() const { return m_uiAllocationCount == 0; }
+
+private:
+	//分配粒度16字节；第二级把每个2的幂区间再均分为32份，小于SMALL_BLOCK_SIZE的块线性映射到第一级的0号
+	static constexpr UINT GRANULARITY_LOG2 = 4;
+	static constexpr uint64_t GRANULARITY = 1ull << GRANULARITY_LOG2;
+	static constexpr UINT SL_INDEX_COUNT_LOG2 = 5;
+	static constexpr UINT SL_INDEX_COUNT = 1u << SL_INDEX_COUNT_LOG2;
+	static constexpr UINT FL_INDEX_SHIFT = SL_INDEX_COUNT_LOG2 + GRANULARITY_LOG2;
+	static constexpr UINT FL_INDEX_COUNT = 64 - FL_INDEX_SHIFT + 1;
+	static constexpr uint64_t SMALL_BLOCK_SIZE = 1ull << FL_INDEX_SHIFT;
+
+	struct Node
+	{
+		uint64_t uiOffset;
+		uint64_t uiSize;
+		UINT uiPrevPhysical;
+		UINT uiNextPhysical;
+		UINT uiPrevFree;
+		UINT uiNextFree;
+		bool bFree;
+	};
+
+	static void MappingInsert(uint64_t uiSize, UINT& uiFirstLevel, UINT& uiSecondLevel);
+
+	UINT CreateNode(uint64_t uiOffset, uint64_t uiSize);
+	void ReleaseNode(UINT uiNode);
+
+	UINT FindFreeNode(uint64_t uiSize) const;
+	void InsertFreeNode(UINT uiNode);
+	void RemoveFreeNode(UINT uiNode);
+
+	//把uiNode的前uiSize字节留在uiNode中，剩余部分拆成新节点插入物理链表并返回
+	UINT SplitNode(UINT uiNode, uint64_t uiSize);
+
+private:
+	uint64_t m_uiSize;
+	uint64_t m_uiUsedSize;
+	size_t m_uiAllocationCount;
+
+	std::vector<Node> m_vecNodes;
+	std::vector<UINT> m_vecUnusedNodes;
+
+	uint64_t m_uiFirstLevelBitmap;
+	std::array<UINT, FL_INDEX_COUNT> m_arySecondLevelBitmaps;
+	std::array<UINT, FL_INDEX_COUNT * SL_INDEX_COUNT> m_aryFreeHeads;
+};
@@ -0,0 +1,83 @@
+#include "TextureDecoder.h"
+#include "PixelConvert.h"
+#include "ThreadPool.h"
+
+#include <chrono>
+
+#include "stb_image.h"
+
+//每个并行任务至少展开的像素数，过小时任务调度的开销超过展开本身
+static constexpr size_t EXPAND_PIXELS_PER_TASK = 256 * 1024;
+
+void TextureDecoder::PixelDeleter::operator()(UCHAR* pPixels) const
+{
+	stbi_image_free(pPixels);
+}
+
+void TextureDecoder::Image::ExpandRowsToRGBA8(UINT uiFirstRow, UINT uiRowCount, UCHAR* pDst, ThreadPool* pThreadPool) const
+{
+	const UCHAR* pSrc = pPixels.get() + static_cast<size_t>(uiFirstRow) * uiWidth * uiChannel;
+	size_t uiPixelCount = static_cast<size_t>(uiRowCount) * uiWidth;
+
+	size_t uiTaskCount = pThreadPool ? std::min<size_t>(pThreadPool->GetThreadCount(), uiPixelCount / EXPAND_PIXELS_PER_TASK) : 0;
+	if (uiTaskCount <= 1)
+	{
+		PixelConvert::ExpandToRGBA8(pSrc, pDst, uiPixelCount, uiChannel);
+		return;
+	}
+
+	//按整行分段，各段写入的目标区间互不重叠
+	UINT uiRowsPerTask = static_cast<UINT>((uiRowCount + uiTaskCount - 1) / uiTaskCount);
+	pThreadPool->ParallelFor(uiTaskCount, [&](size_t uiTask)
+	{
+		UINT uiRow = static_cast<UINT>(uiTask) * uiRowsPerTask;
+		if (uiRow >= uiRowCount)
+			return;
+
+		size_t uiTaskPixelCount = static_cast<size_t>(std::min(uiRowsPerTask, uiRowCount - uiRow)) * uiWidth;
+		size_t uiPixelOffset = static_cast<size_t>(uiRow) * uiWidth;
+		PixelConvert::ExpandToRGBA8(pSrc + uiPixelOffset * uiChannel, pDst + uiPixelOffset * 4, uiTaskPixelCount, uiChannel);
+	});
+}
+
+TextureDecoder::Image TextureDecoder::Decode(const std::filesystem::path& path)
+{
+	auto startTimestamp = std::chrono::high_resolution_clock::now();
+
+	Image image;
+	image.path = path;
+
+	int nWidth = 0;
+	int nHeight = 0;
+	int nChannel = 0;
+	//stbi_load可在多个线程中同时调用
+	image.pPixels.reset(stbi_load(path.string().c_str(), &nWidth, &nHeight, &nChannel, 0));
+	if (!image.pPixels)
+	{
+		Log::Error(std::format("Decode image {} failed : {}", path.string(), stbi_failure_reason()));
+		return image;
+	}
+
+	image.uiWidth = static_cast<UINT>(nWidth);
+	image.uiHeight = static_cast<UINT>(nHeight);
+	image.uiChannel = static_cast<UINT>(nChannel);
+
+	auto endTimestamp = std::chrono::high_resolution_clock::now();
+	image.dDecodeTime = std::chrono::duration<double, std::milli>(endTimestamp - startTimestamp).count();
+	return image;
+}
+
+std::future<TextureDecoder::Image> TextureDecoder::DecodeAsync(const std::filesystem::path& path, ThreadPool& threadPool)
+{
+	return threadPool.Submit([path]() { return Decode(path); });
+}
+
+std::vector<TextureDecoder::Image> TextureDecoder::DecodeParallel(const std::vector<std::filesystem::path>& vecPaths, ThreadPool& threadPool)
+{
+	std::vector<Image> vecImages(vecPaths.size());
+	threadPool.ParallelFor(vecPaths.size(), [&](size_t i)
+	{
+		vecImages[i] = Decode(vecPaths[i]);
+	});
+	return vecImages;
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include "Core.h"
+
+#include <future>
+
+class ThreadPool;
+
+//纹理导入时的图像解码，stb按图像原有的通道数解码，不再强制为RGBA
+//展开为RGBA8推迟到写入目标（通常是映射的暂存内存）时进行，省去一张整图的中转缓冲
+class TextureDecoder
+{
+public:
+	struct PixelDeleter
+	{
+		void operator()(UCHAR* pPixels) const;
+	};
+
+	struct Image
+	{
+		std::filesystem::path path;
+		UINT uiWidth = 0;
+		UINT uiHeight = 0;
+		UINT uiChannel = 0;	//1~4，紧凑排列
+		std::unique_ptr<UCHAR, PixelDeleter> pPixels;
+		double dDecodeTime = 0.0;	//毫秒
+
+		bool IsValid() const { return pPixels != nullptr; }
+		size_t GetDecodedSize() const { return static_cast<size_t>(uiWidth) * uiHeight * uiChannel; }
+		size_t GetRGBA8Size() const { return static_cast<size_t>(uiWidth) * uiHeight * 4; }
+
+		//把[uiFirstRow, uiFirstRow + uiRowCount)行展开为紧凑的RGBA8写入pDst
+		//pThreadPool非空时按行分段并行展开，不能在该线程池的worker中调用
+		void ExpandRowsToRGBA8(UINT uiFirstRow, UINT uiRowCount, UCHAR* pDst, ThreadPool* pThreadPool = nullptr) const;
+	};
+
+	//失败时记录错误并返回IsValid()为false的Image
+	static Image Decode(const std::filesystem::path& path);
+	//提交到线程池后立即返回
+	static std::future<Image> DecodeAsync(const std::filesystem::path& path, ThreadPool& threadPool);
+	//多张图像同时解码，阻塞直到全部完成，结果的顺序与vecPaths一致
+	static std::vector<Image> DecodeParallel(const std::vector<std::filesystem::path>& vecPaths, ThreadPool& threadPool);
+};
@@ -0,0 +1,168 @@
+#include "TextureManager.h"
+
+VkDeviceSize TextureManager::TextureInfo::GetSize(UINT uiLevel) const
+{
+	VkDeviceSize uiSize = 0;
+	for (UINT i = uiLevel; i < GetLevelCount(); ++i)
+		uiSize += vecLevelSizes[i];
+	return uiSize;
+}
+
+TextureManager::TextureManager()
+	: m_uiBudget(0)
+	, m_uiResidentBytes(0)
+	, m_uiFrame(0)
+	, m_uiTotalStreamInCount(0)
+	, m_uiTotalEvictionCount(0)
+{
+}
+
+UINT TextureManager::GetInitialLevel(UINT uiWidth, UINT uiHeight, UINT uiLevelCount)
+{
+	UINT uiLevel = 0;
+	while (uiLevel + 1 < uiLevelCount && std::max(uiWidth >> uiLevel, uiHeight >> uiLevel) > INITIAL_LEVEL_SIZE)
+		++uiLevel;
+	return uiLevel;
+}
+
+UINT TextureManager::AddTexture(UINT uiWidth, UINT uiHeight, const std::vector<VkDeviceSize>& vecLevelSizes)
+{
+	ASSERT(!vecLevelSizes.empty(), "Texture must have at least one level");
+
+	TextureInfo texture;
+	texture.vecLevelSizes = vecLevelSizes;
+
+	UINT uiLevel = GetInitialLevel(uiWidth, uiHeight, texture.GetLevelCount());
+	texture.uiInitialLevel = uiLevel;
+	texture.uiResidentLevel = uiLevel;
+	texture.uiRequestedLevel = uiLevel;
+
+	m_uiResidentBytes += texture.GetSize(uiLevel);
+	m_vecTextures.push_back(std::move(texture));
+	return static_cast<UINT>(m_vecTextures.size() - 1);
+}
+
+void TextureManager::RequestLevel(UINT uiTexture, UINT uiLevel)
+{
+	TextureInfo& texture = m_vecTextures[uiTexture];
+	uiLevel = std::min(uiLevel, texture.uiInitialLevel);
+	if (texture.uiLastUsedFrame != m_uiFrame)
+	{
+		texture.uiLastUsedFrame = m_uiFrame;
+		texture.uiRequestedLevel = uiLevel;
+	}
+	else
+		texture.uiRequestedLevel = std::min(texture.uiRequestedLevel, uiLevel);
+}
+
+UINT TextureManager::GetKeepLevel(const TextureInfo& texture) const
+{
+	return (texture.uiLastUsedFrame == m_uiFrame) ? texture.uiRequestedLevel : texture.uiInitialLevel;
+}
+
+bool TextureManager::MakeRoom(VkDeviceSize uiSize, UINT uiExcludeTexture, std::vector<ResidencyChange>& vecChanges)
+{
+	while (m_uiResidentBytes + uiSize > m_uiBudget)
+	{
+		//最久未使用、且驻留了当前不需要的级别的纹理
+		UINT uiVictim = INVALID_HANDLE;
+		for (UINT i = 0; i < m_vecTextures.size(); ++i)
+		{
+			const TextureInfo& texture = m_vecTextures[i];
+			if (i == uiExcludeTexture || texture.bChanging || texture.uiResidentLevel >= GetKeepLevel(texture))
+				continue;
+			if (uiVictim == INVALID_HANDLE || texture.uiLastUsedFrame < m_vecTextures[uiVictim].uiLastUsedFrame)
+				uiVictim = i;
+		}
+		if (uiVictim == INVALID_HANDLE)
+			return false;
+
+		TextureInfo& victim = m_vecTextures[uiVictim];
+		UINT uiKeepLevel = GetKeepLevel(victim);
+		UINT uiPreviousLevel = victim.uiResidentLevel;
+		m_uiResidentBytes -= victim.GetSize(uiPreviousLevel) - victim.GetSize(uiKeepLevel);
+		victim.uiResidentLevel = uiKeepLevel;
+		victim.bChanging = true;
+		++m_uiTotalEvictionCount;
+		vecChanges.push_back({ uiVictim, uiKeepLevel, uiPreviousLevel, true });
+	}
+	return true;
+}
+
+std::vector<TextureManager::ResidencyChange> TextureManager::CollectChanges(UINT uiMaxStreamInCount)
+{
+	std::vector<ResidencyChange> vecChanges;
+
+	std::vector<UINT> vecStreamIns;
+	for (UINT i = 0; i < m_vecTextures.size(); ++i)
+	{
+		const TextureInfo& texture = m_vecTextures[i];
+		if (!texture.bChanging && texture.uiLastUsedFrame == m_uiFrame && texture.uiRequestedLevel < texture.uiResidentLevel)
+			vecStreamIns.push_back(i);
+	}
+	std::stable_sort(vecStreamIns.begin(), vecStreamIns.end(), [this](UINT uiTexture0, UINT uiTexture1)
+	{
+		const TextureInfo& texture0 = m_vecTextures[uiTexture0];
+		const TextureInfo& texture1 = m_vecTextures[uiTexture1];
+		return texture0.uiResidentLevel - texture0.uiRequestedLevel > texture1.uiResidentLevel - texture1.uiRequestedLevel;
+	});
+
+	//逐级流入，画面由粗到细逐步变清晰，每次重建只需多读取一级
+	UINT uiStreamInCount = 0;
+	for (UINT uiTexture : vecStreamIns)
+	{
+		if (uiStreamInCount >= uiMaxStreamInCount)
+			break;
+
+		TextureInfo& texture = m_vecTextures[uiTexture];
+		UINT uiLevel = texture.uiResidentLevel - 1;
+		if (!MakeRoom(texture.vecLevelSizes[uiLevel], uiTexture, vecChanges))
+			break;
+
+		m_uiResidentBytes += texture.vecLevelSizes[uiLevel];
+		texture.uiResidentLevel = uiLevel;
+		texture.bChanging = true;
+		++m_uiTotalStreamInCount;
+		++uiStreamInCount;
+		vecChanges.push_back({ uiTexture, uiLevel, uiLevel + 1, false });
+	}
+
+	//预算在运行时调低后，即使没有流入也要丢弃
+	MakeRoom(0, INVALID_HANDLE, vecChanges);
+	return vecChanges;
+}
+
+void TextureManager::CancelChange(const ResidencyChange& change)
+{
+	TextureInfo& texture = m_vecTextures[change.uiTexture];
+	m_uiResidentBytes = m_uiResidentBytes - texture.GetSize(change.uiResidentLevel) + texture.GetSize(change.uiPreviousLevel);
+	texture.uiResidentLevel = change.uiPreviousLevel;
+	texture.bChanging = false;
+	if (change.bEvict)
+		--m_uiTotalEvictionCount;
+	else
+		--m_uiTotalStreamInCount;
+}
+
+TextureManager::Stats TextureManager::GetStats() const
+{
+	Stats stats;
+	stats.uiTextureCount = GetTextureCount();
+	stats.uiResidentBytes = m_uiResidentBytes;
+	stats.uiBudget = m_uiBudget;
+	stats.uiTotalStreamInCount = m_uiTotalStreamInCount;
+	stats.uiTotalEvictionCount = m_uiTotalEvictionCount;
+
+	for (const TextureInfo& texture : m_vecTextures)
+	{
+		stats.uiFullBytes += texture.GetSize(0);
+		stats.uiFullyResidentCount += (texture.uiResidentLevel == 0) ? 1 : 0;
+		stats.uiChangingCount += texture.bChanging ? 1 : 0;
+		if (texture.uiLastUsedFrame == m_uiFrame && m_uiFrame > 0)
+		{
+			++stats.uiUsedCount;
+			stats.uiMissingLevelCount += texture.uiResidentLevel - std::min(texture.uiResidentLevel, texture.uiRequestedLevel);
+		}
+	}
+	return stats;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include "GLFW/glfw3.h"
+
+#include "Core.h"
+
+//多张纹理的mip驻留管理，只做CPU端的记录，image的重建与上传由调用者完成
+//纹理加入时只驻留尺寸不超过INITIAL_LEVEL_SIZE的低级别mip，可以立即用于渲染
+//之后按每帧屏幕上需要的最细级别逐级流入更细的mip；已驻留的数据量超过预算时，
+//从最久未使用的纹理开始丢弃其当前不需要的级别，低级别mip始终保留
+class TextureManager
+{
+public:
+	static constexpr UINT INVALID_HANDLE = UINT_MAX;
+	static constexpr UINT INITIAL_LEVEL_SIZE = 128;
+
+	//纹理需要重建为从uiResidentLevel开始的mip链，重建完成后调用CompleteChange
+	struct ResidencyChange
+	{
+		UINT uiTexture;
+		UINT uiResidentLevel;
+		UINT uiPreviousLevel;	//变化之前驻留的最细级别，用于CancelChange
+		bool bEvict;	//丢弃级别，否则为流入
+	};
+
+	struct TextureInfo
+	{
+		std::vector<VkDeviceSize> vecLevelSizes;
+		UINT uiInitialLevel = 0;	//始终驻留的最细级别
+		UINT uiResidentLevel = 0;	//已驻留（或正在重建为）的最细级别
+		UINT uiRequestedLevel = 0;	//最近一次使用时需要的最细级别
+		uint64_t uiLastUsedFrame = 0;	//0表示从未使用
+		bool bChanging = false;
+
+		UINT GetLevelCount() const { return static_cast<UINT>(vecLevelSizes.size()); }
+		//从uiLevel到最小一级的总字节数
+		VkDeviceSize GetSize(UINT uiLevel) const;
+	};
+
+	struct Stats
+	{
+		UINT uiTextureCount = 0;
+		UINT uiFullyResidentCount = 0;	//level 0已驻留
+		UINT uiUsedCount = 0;	//本帧使用的纹理
+		UINT uiMissingLevelCount = 0;	//本帧使用的纹理需要但未驻留的级数之和
+		UINT uiChangingCount = 0;
+		VkDeviceSize uiResidentBytes = 0;
+		VkDeviceSize uiFullBytes = 0;	//全部级别都驻留时的字节数
+		VkDeviceSize uiBudget = 0;
+		uint64_t uiTotalStreamInCount = 0;
+		uint64_t uiTotalEvictionCount = 0;
+	};
+
+	TextureManager();
+
+	void SetBudget(VkDeviceSize uiBudget) { m_uiBudget = uiBudget; }
+	VkDeviceSize GetBudget() const { return m_uiBudget; }
+
+	//尺寸不超过INITIAL_LEVEL_SIZE的最细级别，文件中的mip链可能不完整，最多为最小的一级
+	static UINT GetInitialLevel(UINT uiWidth, UINT uiHeight, UINT uiLevelCount);
+
+	//vecLevelSizes[i]为第i级的字节数，初始驻留级别由GetTextureInfo查询
+	UINT AddTexture(UINT uiWidth, UINT uiHeight, const std::vector<VkDeviceSize>& vecLevelSizes);
+	UINT GetTextureCount() const { return static_cast<UINT>(m_vecTextures.size()); }
+	const TextureInfo& GetTextureInfo(UINT uiTexture) const { return m_vecTextures[uiTexture]; }
+
+	void BeginFrame() { ++m_uiFrame; }
+	uint64_t GetFrame() const { return m_uiFrame; }
+	//本帧使用该纹理需要的最细级别，同一帧内多次请求取最细的
+	void RequestLevel(UINT uiTexture, UINT uiLevel);
+
+	//缺少级别最多的纹理优先，每次流入一级，最多uiMaxStreamInCount张；为腾出预算而丢弃级别的纹理也在返回值中
+	//正在重建的纹理不参与，直到调用CompleteChange
+	std::vector<ResidencyChange> CollectChanges(UINT uiMaxStreamInCount);
+	void CompleteChange(UINT uiTexture) { m_vecTextures[uiTexture].bChanging = false; }
+	//调用者无法重建image（如超出显存预算）时撤销该变化，驻留级别恢复为变化之前，之后的CollectChanges会重新请求
+	void CancelChange(const ResidencyChange& change);
+
+	Stats GetStats() const;
+
+private:
+	//本帧使用的纹理保留其需要的级别，未使用的纹理只保留初始级别
+	UINT GetKeepLevel(const TextureInfo& texture) const;
+	//按LRU丢弃级别直到再驻留uiSize字节不超出预算，无法腾出时返回false
+	bool MakeRoom(VkDeviceSize uiSize, UINT uiExcludeTexture, std::vector<ResidencyChange>& vecChanges);
+
+private:
+	VkDeviceSize m_uiBudget;
+	VkDeviceSize m_uiResidentBytes;	//按重建后的驻留级别计算，重建期间新旧image同时存在的部分不计入
+	std::vector<TextureInfo> m_vecTextures;
+
+	uint64_t m_uiFrame;
+	uint64_t m_uiTotalStreamInCount;
+	uint64_t m_uiTotalEvictionCount;
+};
@@ -0,0 +1,85 @@
+#include "TextureMipmap.h"
+#include "PixelConvert.h"
+
+#include <bit>
+
+UINT TextureMipmap::GetMipLevelCount(UINT uiWidth, UINT uiHeight)
+{
+	return static_cast<UINT>(std::bit_width(std::max<UINT>(std::max(uiWidth, uiHeight), 1)));
+}
+
+std::vector<TextureMipmap::Level> TextureMipmap::GenerateRGBA8(const UCHAR* pPixels, UINT uiWidth, UINT uiHeight, bool bSRGB)
+{
+	UINT uiLevelCount = GetMipLevelCount(uiWidth, uiHeight);
+	std::vector<Level> vecLevels(uiLevelCount - 1);
+
+	//sRGB时每次把两行源像素解码到线性空间，平均后整行编码回sRGB，转换由PixelConvert的SIMD版本完成
+	std::vector<float> vecLinearRow0;
+	std::vector<float> vecLinearRow1;
+	std::vector<float> vecLinearDst;
+
+	const UCHAR* pSrc = pPixels;
+	UINT uiSrcWidth = uiWidth;
+	UINT uiSrcHeight = uiHeight;
+	for (UINT uiLevel = 1; uiLevel < uiLevelCount; ++uiLevel)
+	{
+		Level& level = vecLevels[uiLevel - 1];
+		level.uiWidth = GetMipLevelSize(uiWidth, uiLevel);
+		level.uiHeight = GetMipLevelSize(uiHeight, uiLevel);
+		level.vecPixels.resize(static_cast<size_t>(level.uiWidth) * level.uiHeight * 4);
+
+		if (bSRGB)
+		{
+			vecLinearRow0.resize(static_cast<size_t>(uiSrcWidth) * 4);
+			vecLinearRow1.resize(static_cast<size_t>(uiSrcWidth) * 4);
+			vecLinearDst.resize(static_cast<size_t>(level.uiWidth) * 4);
+		}
+
+		for (UINT y = 0; y < level.uiHeight; ++y)
+		{
+			//某一维已经为1时，该方向上重复采样同一行/列
+			const UCHAR* pRow0 = pSrc + static_cast<size_t>(std::min(y * 2, uiSrcHeight - 1)) * uiSrcWidth * 4;
+			const UCHAR* pRow1 = pSrc + static_cast<size_t>(std::min(y * 2 + 1, uiSrcHeight - 1)) * uiSrcWidth * 4;
+			UCHAR* pDst = level.vecPixels.data() + static_cast<size_t>(y) * level.uiWidth * 4;
+
+			if (bSRGB)
+			{
+				PixelConvert::SRGBToLinear(pRow0, vecLinearRow0.data(), uiSrcWidth);
+				PixelConvert::SRGBToLinear(pRow1, vecLinearRow1.data(), uiSrcWidth);
+
+				for (UINT x = 0; x < level.uiWidth; ++x)
+				{
+					size_t uiX0 = static_cast<size_t>(std::min(x * 2, uiSrcWidth - 1)) * 4;
+					size_t uiX1 = static_cast<size_t>(std::min(x * 2 + 1, uiSrcWidth - 1)) * 4;
+					for (UINT c = 0; c < 4; ++c)
+					{
+						vecLinearDst[x * 4 + c] = (vecLinearRow0[uiX0 + c] + vecLinearRow0[uiX1 + c]
+							+ vecLinearRow1[uiX0 + c] + vecLinearRow1[uiX1 + c]) * 0.25f;
+					}
+				}
+
+				PixelConvert::LinearToSRGB(vecLinearDst.data(), pDst, level.uiWidth);
+			}
+			else
+			{
+				for (UINT x = 0; x < level.uiWidth; ++x)
+				{
+					size_t uiX0 = static_cast<size_t>(std::min(x * 2, uiSrcWidth - 1)) * 4;
+					size_t uiX1 = static_cast<size_t>(std::min(x * 2 + 1, uiSrcWidth - 1)) * 4;
+
+					for (UINT c = 0; c < 4; ++c)
+					{
+						UINT uiSum = pRow0[uiX0 + c] + pRow0[uiX1 + c] + pRow1[uiX0 + c] + pRow1[uiX1 + c];
+						pDst[x * 4 + c] = static_cast<UCHAR>((uiSum + 2) / 4);
+					}
+				}
+			}
+		}
+
+		pSrc = level.vecPixels.data();
+		uiSrcWidth = level.uiWidth;
+		uiSrcHeight = level.uiHeight;
+	}
+
+	return vecLevels;
+}
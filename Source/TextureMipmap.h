@@ -0,0 +1,24 @@
+#pragma once
+#include "Core.h"
+
+//RGBA8纹理的mip链，格式不支持线性blit时在CPU上逐级生成
+class TextureMipmap
+{
+public:
+	struct Level
+	{
+		UINT uiWidth = 0;
+		UINT uiHeight = 0;
+		std::vector<UCHAR> vecPixels;	//紧凑排列的RGBA8
+	};
+
+	//完整mip链的层数，最后一级为1x1
+	static UINT GetMipLevelCount(UINT uiWidth, UINT uiHeight);
+
+	//每一级的宽高为上一级的一半（向下取整，最小为1）
+	static UINT GetMipLevelSize(UINT uiSize, UINT uiLevel) { return std::max<UINT>(uiSize >> uiLevel, 1); }
+
+	//以2x2 box滤波由上一级生成下一级，返回第1级到最后一级（不含原图）
+	//bSRGB为true时颜色通道在线性空间中平均，alpha始终直接平均
+	static std::vector<Level> GenerateRGBA8(const UCHAR* pPixels, UINT uiWidth, UINT uiHeight, bool bSRGB);
+};
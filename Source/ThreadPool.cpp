@@ -0,0 +1,66 @@
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(UINT uiThreadCount)
+	: m_bStop(false)
+{
+	if (uiThreadCount == 0)
+		uiThreadCount = std::max(1u, std::thread::hardware_concurrency());
+
+	m_vecWorkers.reserve(uiThreadCount);
+	for (UINT i = 0; i < uiThreadCount; ++i)
+		m_vecWorkers.emplace_back(&ThreadPool::WorkerLoop, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_bStop = true;
+	}
+	m_Condition.notify_all();
+
+	for (auto& worker : m_vecWorkers)
+	{
+		if (worker.joinable())
+			worker.join();
+	}
+}
+
+void ThreadPool::ParallelFor(size_t uiCount, const std::function<void(size_t)>& func)
+{
+	if (uiCount == 0)
+		return;
+
+	if (uiCount == 1)
+	{
+		func(0);
+		return;
+	}
+
+	std::vector<std::future<void>> vecFutures;
+	vecFutures.reserve(uiCount);
+	for (size_t i = 0; i < uiCount; ++i)
+		vecFutures.push_back(Submit([&func, i]() { func(i); }));
+
+	for (auto& future : vecFutures)
+		future.get();
+}
+
+void ThreadPool::WorkerLoop()
+{
+	while (true)
+	{
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_Condition.wait(lock, [this]() { return m_bStop || !m_queTasks.empty(); });
+
+			if (m_bStop && m_queTasks.empty())
+				return;
+
+			task = std::move(m_queTasks.front());
+			m_queTasks.pop();
+		}
+		task();
+	}
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include "Core.h"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <queue>
+
+class ThreadPool
+{
+public:
+	//uiThreadCount为0时使用硬件线程数
+	explicit ThreadPool(UINT uiThreadCount = 0);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	template<typename F>
+	auto Submit(F&& func) -> std::future<decltype(func())>
+	{
+		using ReturnType = decltype(func());
+
+		auto pTask = std::make_shared<std::packaged_task<ReturnType()>>(std::forward<F>(func));
+		std::future<ReturnType> future = pTask->get_future();
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_queTasks.emplace([pTask]() { (*pTask)(); });
+		}
+		m_Condition.notify_one();
+
+		return future;
+	}
+
+	//对[0, uiCount)中的每个下标调用func，阻塞直到全部完成
+	void ParallelFor(size_t uiCount, const std::function<void(size_t)>& func);
+
+	UINT GetThreadCount() const { return static_cast<UINT>(m_vecWorkers.size()); }
+
+private:
+	void WorkerLoop();
+
+private:
+	std::vector<std::thread> m_vecWorkers;
+	std::queue<std::function<void()>> m_queTasks;
+
+	std::mutex m_Mutex;
+	std::condition_variable m_Condition;
+	bool m_bStop;
+};
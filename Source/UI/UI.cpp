@@ -112,7 +112,7 @@ void UI::Init(VulkanRenderer* pRenderer)
         VULKAN_ASSERT(vkCreateFramebuffer(m_pRenderer->GetLogicalDevice(), &frameBufferCreateInfo, nullptr, &g_vecFrameBuffers[i]), "Create ImGui frame buffer failed");
     }
 
-    //ImGui
+    //设置ImGui上下文
     IMGUI_CHECKVERSION();
     ImGui::CreateContext();
     ImGuiIO& io = ImGui::GetIO();
@@ -123,7 +123,7 @@ void UI::Init(VulkanRenderer* pRenderer)
     //io.ConfigViewportsNoAutoMerge = true;
     //io.ConfigViewportsNoTaskBarIcon = true;
 
-    //ImGui
+    //设置ImGui风格
     ImGui::StyleColorsClassic();
 
     // When viewports are enabled we tweak WindowRounding/WindowBg so platform windows can look identical to regular ones.
@@ -143,9 +143,9 @@ void UI::Init(VulkanRenderer* pRenderer)
     init_info.Device = m_pRenderer->GetLogicalDevice();
     init_info.QueueFamily = m_pRenderer->GetGraphicQueueIdx();
     init_info.Queue = m_pRenderer->GetGraphicQueue();
-    init_info.PipelineCache = VK_NULL_HANDLE; //todo:PipelineCacheǷҪ
+    init_info.PipelineCache = VK_NULL_HANDLE; //todo:PipelineCache是否需要
     init_info.DescriptorPool = g_DescriptorPool;
-    init_info.Allocator = VK_NULL_HANDLE; //todo:AllocatorǷҪ
+    init_info.Allocator = VK_NULL_HANDLE; //todo:Allocator是否需要
     init_info.MinImageCount = m_pRenderer->GetSwapChainMinImageCount();
     init_info.ImageCount = m_pRenderer->GetSwapChainImageCount();
     init_info.CheckVkResultFn = nullptr;
@@ -233,6 +233,113 @@ void UI::Draw()
 
     ImGui::Begin("Stat");
     ImGui::Text("FPS: %d", m_pRenderer->GetFPS());
+
+    bool bEnableLOD = m_pRenderer->IsLODEnabled();
+    if (ImGui::Checkbox("LOD", &bEnableLOD))
+        m_pRenderer->SetEnableLOD(bEnableLOD);
+    float fLODPixelError = m_pRenderer->GetLODPixelError();
+    if (ImGui::SliderFloat("LOD pixel error", &fLODPixelError, 0.1f, 16.f))
+        m_pRenderer->SetLODPixelError(fLODPixelError);
+    const auto& aryLODStats = m_pRenderer->GetLODStats();
+    for (size_t i = 0; i < aryLODStats.size(); ++i)
+    {
+        if (aryLODStats[i].uiTriangleCount > 0)
+            ImGui::Text("LOD%zu: %zu tris, drawn %u submeshes / %zu tris", i, aryLODStats[i].uiTriangleCount,
+                aryLODStats[i].uiDrawSubMeshCount, aryLODStats[i].uiDrawTriangleCount);
+    }
+
+    const auto& memoryAllocator = m_pRenderer->GetMemoryAllocator();
+    for (UINT i = 0; i < memoryAllocator.GetHeapCount(); ++i)
+    {
+        auto heapStats = memoryAllocator.GetHeapStats(i);
+        if (heapStats.uiAllocationCount == 0)
+            continue;
+        ImGui::Text("Heap%u (%s): %u blocks, %u dedicated, %u allocations, %.1f / %.1f MB", i,
+            m_pRenderer->GetMemoryHeapName(i).c_str(),
+            heapStats.uiBlockCount, heapStats.uiDedicatedAllocationCount, heapStats.uiAllocationCount,
+            heapStats.uiUsedBytes / (1024.0 * 1024.0), heapStats.uiReservedBytes / (1024.0 * 1024.0));
+
+        //超出预算时标红
+        auto budget = memoryAllocator.GetHeapBudget(i);
+        float fBudgetRatio = budget.uiBudget > 0 ? static_cast<float>(budget.uiUsage) / budget.uiBudget : 0.f;
+        ImGui::TextColored(fBudgetRatio > 1.f ? ImVec4(1.f, 0.3f, 0.3f, 1.f) : ImVec4(1.f, 1.f, 1.f, 1.f),
+            "    %s budget: %.1f / %.1f MB (%.0f%%)", memoryAllocator.IsMemoryBudgetSupported() ? "Driver" : "Estimated",
+            budget.uiUsage / (1024.0 * 1024.0), budget.uiBudget / (1024.0 * 1024.0), fBudgetRatio * 100.f);
+
+        for (UINT uiCategory = 0; uiCategory < static_cast<UINT>(MemoryCategory::Count); ++uiCategory)
+        {
+            VkDeviceSize uiBytes = memoryAllocator.GetCategoryBytes(i, static_cast<MemoryCategory>(uiCategory));
+            if (uiBytes > 0)
+                ImGui::Text("    %s: %.2f MB", GetMemoryCategoryName(static_cast<MemoryCategory>(uiCategory)), uiBytes / (1024.0 * 1024.0));
+        }
+    }
+
+    const auto& geometryPool = m_pRenderer->GetGeometryPool();
+    ImGui::Text("Geometry pool: %u meshes, vertex %.1f / %.1f MB, index %.1f / %.1f MB", geometryPool.GetMeshCount(),
+        geometryPool.GetVertexUsedSize() / (1024.0 * 1024.0), geometryPool.GetVertexCapacity() / (1024.0 * 1024.0),
+        geometryPool.GetIndexUsedSize() / (1024.0 * 1024.0), geometryPool.GetIndexCapacity() / (1024.0 * 1024.0));
+    if (ImGui::Button("Defragment geometry"))
+        m_pRenderer->RequestDefragmentGeometry();
+
+    if (const VirtualTexture* pVirtualTexture = m_pRenderer->GetVirtualTexture())
+    {
+        auto vtStats = pVirtualTexture->GetStats();
+        ImGui::Text("Virtual texture: %u / %u pages resident in %u slots, %u loading", vtStats.uiResidentCount, vtStats.uiPageCount,
+            vtStats.uiSlotCount, vtStats.uiLoadingCount);
+        ImGui::Text("    requested %u, missing %u, retiring %u, %u paged levels", vtStats.uiRequestedCount, vtStats.uiMissingCount,
+            vtStats.uiRetiringCount, pVirtualTexture->GetPagedLevelCount());
+        ImGui::Text("    loaded %llu, evicted %llu", static_cast<unsigned long long>(vtStats.uiTotalLoadCount),
+            static_cast<unsigned long long>(vtStats.uiTotalEvictionCount));
+    }
+
+    const auto& textureManager = m_pRenderer->GetTextureManager();
+    if (textureManager.GetTextureCount() > 0)
+    {
+        auto texStats = textureManager.GetStats();
+        ImGui::Text("Streamed textures: %u / %u fully resident, %u used, %u changing", texStats.uiFullyResidentCount, texStats.uiTextureCount,
+            texStats.uiUsedCount, texStats.uiChangingCount);
+        ImGui::Text("    resident %.2f / %.2f MB, missing %u levels", texStats.uiResidentBytes / (1024.0 * 1024.0),
+            texStats.uiFullBytes / (1024.0 * 1024.0), texStats.uiMissingLevelCount);
+        ImGui::Text("    streamed in %llu, evicted %llu", static_cast<unsigned long long>(texStats.uiTotalStreamInCount),
+            static_cast<unsigned long long>(texStats.uiTotalEvictionCount));
+        int nBudgetMB = static_cast<int>(texStats.uiBudget / (1024 * 1024));
+        if (ImGui::SliderInt("Texture budget (MB)", &nBudgetMB, 1, 1024))
+            m_pRenderer->SetTextureBudget(static_cast<VkDeviceSize>(nBudgetMB) * 1024 * 1024);
+    }
+
+    if (m_pRenderer->IsModelLoading())
+    {
+        ImGui::Text("Loading %s : %s", m_pRenderer->GetLoadingModelPath().filename().string().c_str(), m_pRenderer->GetModelLoadStage());
+        ImGui::ProgressBar(m_pRenderer->GetModelLoadProgress());
+    }
+
+    //运行时切换模型，后台加载完成后在帧开始时替换
+    static std::vector<std::filesystem::path> vecModelPaths;
+    static int selectedModel = 0;
+    if (vecModelPaths.empty())
+    {
+        std::error_code errorCode;
+        for (const auto& entry : std::filesystem::directory_iterator("./Assert/Model", errorCode))
+        {
+            auto extension = entry.path().extension().string();
+            if (extension == ".obj" || extension == ".gltf" || extension == ".glb")
+                vecModelPaths.push_back(entry.path());
+        }
+    }
+    if (!vecModelPaths.empty())
+    {
+        if (ImGui::BeginCombo("Model", vecModelPaths[selectedModel].filename().string().c_str()))
+        {
+            for (int i = 0; i < static_cast<int>(vecModelPaths.size()); ++i)
+            {
+                if (ImGui::Selectable(vecModelPaths[i].filename().string().c_str(), i == selectedModel))
+                    selectedModel = i;
+            }
+            ImGui::EndCombo();
+        }
+        if (ImGui::Button("Load") && !m_pRenderer->IsModelLoading())
+            m_pRenderer->LoadModelAsync(vecModelPaths[selectedModel]);
+    }
     ImGui::End();
 }
 
@@ -0,0 +1,18 @@
+#pragma once
+#include "Core.h"
+#include "glm/glm.hpp"
+
+//顶点缓冲的存储格式，需在LoadModel之前设置
+enum class VertexFormat : UINT
+{
+	Float,	//Vertex3D，全部为32位浮点
+	Packed,	//PackedVertex3D，位置snorm16、UV half、颜色unorm8、法线snorm8
+};
+
+//Packed格式的位置反量化参数：pos = center + snorm16 * extent
+//该变换在UpdateUniformBuffer中并入模型矩阵，shader无需区分两种格式
+struct VertexQuantization
+{
+	glm::vec3 center = glm::vec3(0.f);
+	glm::vec3 extent = glm::vec3(1.f);
+};
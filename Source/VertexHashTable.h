@@ -0,0 +1,92 @@
+#pragma once
+#include "Core.h"
+#include <climits>
+
+//开放寻址（线性探测）哈希表，用于顶点去重
+//表中只保存顶点在vecVertices中的下标，比较时回查顶点数组，避免std::unordered_map逐节点分配
+template<typename TVertex, typename THash = std::hash<TVertex>>
+class VertexHashTable
+{
+public:
+	VertexHashTable() = default;
+	explicit VertexHashTable(size_t uiExpectedCount) { Reserve(uiExpectedCount); }
+
+	//按预计的唯一顶点数分配槽位，负载因子保持在0.5以下
+	void Reserve(size_t uiExpectedCount)
+	{
+		size_t uiCapacity = 16;
+		while (uiCapacity < uiExpectedCount * 2)
+			uiCapacity <<= 1;
+
+		m_vecSlots.assign(uiCapacity, EMPTY_SLOT);
+		m_uiMask = uiCapacity - 1;
+		m_uiCount = 0;
+	}
+
+	//若顶点已存在则返回已有下标，否则追加到vecVertices末尾并返回新下标
+	UINT Insert(const TVertex& vertex, std::vector<TVertex>& vecVertices)
+	{
+		if ((m_uiCount + 1) * 2 > m_vecSlots.size())
+			Grow(vecVertices);
+
+		size_t uiSlot = Mix(THash()(vertex)) & m_uiMask;
+		while (true)
+		{
+			UINT uiIdx = m_vecSlots[uiSlot];
+			if (uiIdx == EMPTY_SLOT)
+			{
+				uiIdx = static_cast<UINT>(vecVertices.size());
+				vecVertices.push_back(vertex);
+				m_vecSlots[uiSlot] = uiIdx;
+				m_uiCount++;
+				return uiIdx;
+			}
+			if (vecVertices[uiIdx] == vertex)
+				return uiIdx;
+
+			uiSlot = (uiSlot + 1) & m_uiMask;
+		}
+	}
+
+	size_t GetCount() const { return m_uiCount; }
+	size_t GetCapacity() const { return m_vecSlots.size(); }
+
+private:
+	static constexpr UINT EMPTY_SLOT = UINT_MAX;
+
+	//std::hash<glm::vec>的低位分布较差，线性探测前再做一次64位混合（splitmix64 finalizer）
+	static size_t Mix(uint64_t uiHash)
+	{
+		uiHash ^= uiHash >> 30;
+		uiHash *= 0xbf58476d1ce4e5b9ull;
+		uiHash ^= uiHash >> 27;
+		uiHash *= 0x94d049bb133111ebull;
+		uiHash ^= uiHash >> 31;
+		return static_cast<size_t>(uiHash);
+	}
+
+	void Grow(const std::vector<TVertex>& vecVertices)
+	{
+		std::vector<UINT> vecOldSlots;
+		vecOldSlots.swap(m_vecSlots);
+
+		m_vecSlots.assign(std::max<size_t>(vecOldSlots.size() * 2, 16), EMPTY_SLOT);
+		m_uiMask = m_vecSlots.size() - 1;
+
+		for (UINT uiIdx : vecOldSlots)
+		{
+			if (uiIdx == EMPTY_SLOT)
+				continue;
+
+			size_t uiSlot = Mix(THash()(vecVertices[uiIdx])) & m_uiMask;
+			while (m_vecSlots[uiSlot] != EMPTY_SLOT)
+				uiSlot = (uiSlot + 1) & m_uiMask;
+			m_vecSlots[uiSlot] = uiIdx;
+		}
+	}
+
+private:
+	std::vector<UINT> m_vecSlots;
+	size_t m_uiMask = 0;
+	size_t m_uiCount = 0;
+};
@@ -0,0 +1,274 @@
+#include "VirtualTexture.h"
+
+VirtualTexture::VirtualTexture()
+	: m_uiPageWidth(0)
+	, m_uiPageHeight(0)
+	, m_uiGuardRounds(0)
+	, m_bPageTableDirty(false)
+	, m_uiRound(0)
+	, m_uiTotalLoadCount(0)
+	, m_uiTotalEvictionCount(0)
+{
+}
+
+void VirtualTexture::Init(UINT uiWidth, UINT uiHeight, UINT uiPagedLevelCount, UINT uiPageWidth, UINT uiPageHeight, UINT uiSlotCount, UINT uiGuardRounds)
+{
+	m_uiPageWidth = uiPageWidth;
+	m_uiPageHeight = uiPageHeight;
+	m_uiGuardRounds = uiGuardRounds;
+
+	m_vecLevels.resize(uiPagedLevelCount);
+	UINT uiPageCount = 0;
+	for (UINT i = 0; i < uiPagedLevelCount; ++i)
+	{
+		Level& level = m_vecLevels[i];
+		level.uiWidth = std::max<UINT>(uiWidth >> i, 1);
+		level.uiHeight = std::max<UINT>(uiHeight >> i, 1);
+		level.uiPageCountX = (level.uiWidth + uiPageWidth - 1) / uiPageWidth;
+		level.uiPageCountY = (level.uiHeight + uiPageHeight - 1) / uiPageHeight;
+		level.uiFirstPage = uiPageCount;
+		uiPageCount += level.uiPageCountX * level.uiPageCountY;
+	}
+
+	m_vecPages.assign(uiPageCount, Page{});
+	m_vecSlots.assign(uiSlotCount, INVALID_INDEX);
+	//初始只有mip tail常驻
+	m_vecPageTable.assign(GetPageTableWidth() * GetPageTableHeight(), static_cast<UCHAR>(uiPagedLevelCount));
+	m_bPageTableDirty = false;
+
+	m_uiRound = 0;
+	m_uiTotalLoadCount = 0;
+	m_uiTotalEvictionCount = 0;
+}
+
+VirtualTexture::PageRect VirtualTexture::GetPageRect(UINT uiPage) const
+{
+	//各级的页按级别从细到粗连续编号
+	UINT uiLevel = 0;
+	while (uiLevel + 1 < m_vecLevels.size() && m_vecLevels[uiLevel + 1].uiFirstPage <= uiPage)
+		++uiLevel;
+
+	const Level& level = m_vecLevels[uiLevel];
+	UINT uiLocal = uiPage - level.uiFirstPage;
+
+	PageRect rect;
+	rect.uiLevel = uiLevel;
+	rect.uiX = (uiLocal % level.uiPageCountX) * m_uiPageWidth;
+	rect.uiY = (uiLocal / level.uiPageCountX) * m_uiPageHeight;
+	rect.uiWidth = std::min(m_uiPageWidth, level.uiWidth - rect.uiX);
+	rect.uiHeight = std::min(m_uiPageHeight, level.uiHeight - rect.uiY);
+	return rect;
+}
+
+void VirtualTexture::BeginFeedback()
+{
+	++m_uiRound;
+}
+
+UINT VirtualTexture::GetPage(UINT uiLevel, UINT uiX, UINT uiY) const
+{
+	const Level& level = m_vecLevels[uiLevel];
+	return level.uiFirstPage + std::min(uiY, level.uiPageCountY - 1) * level.uiPageCountX + std::min(uiX, level.uiPageCountX - 1);
+}
+
+void VirtualTexture::RequestPage(UINT uiPage)
+{
+	//反馈中的值由着色器写入，越界时忽略
+	if (uiPage >= m_vecPages.size())
+		return;
+
+	PageRect rect = GetPageRect(uiPage);
+	UINT uiX = rect.uiX / m_uiPageWidth;
+	UINT uiY = rect.uiY / m_uiPageHeight;
+	for (UINT i = rect.uiLevel; i < m_vecLevels.size(); ++i)
+	{
+		const Level& level = m_vecLevels[i];
+		for (int nOffsetY = -1; nOffsetY <= 1; ++nOffsetY)
+		{
+			UINT uiNeighborY = (uiY + level.uiPageCountY + nOffsetY) % level.uiPageCountY;
+			for (int nOffsetX = -1; nOffsetX <= 1; ++nOffsetX)
+			{
+				UINT uiNeighborX = (uiX + level.uiPageCountX + nOffsetX) % level.uiPageCountX;
+				Page& page = m_vecPages[level.uiFirstPage + uiNeighborY * level.uiPageCountX + uiNeighborX];
+				page.uiLastRequestRound = m_uiRound;
+
+				//移出页表后槽位尚未被替换的页数据仍然有效，直接放回页表
+				if (page.uiRetireRound != 0)
+				{
+					page.uiRetireRound = 0;
+					m_bPageTableDirty = true;
+				}
+			}
+		}
+
+		//更粗一级的一页覆盖该级的2x2页
+		if (i + 1 < m_vecLevels.size())
+		{
+			uiX = std::min(uiX / 2, m_vecLevels[i + 1].uiPageCountX - 1);
+			uiY = std::min(uiY / 2, m_vecLevels[i + 1].uiPageCountY - 1);
+		}
+	}
+}
+
+std::vector<VirtualTexture::PageLoad> VirtualTexture::CollectPageLoads(UINT uiMaxLoadCount)
+{
+	std::vector<PageLoad> vecLoads;
+
+	//先加载粗的级别，使可用的最细级别逐级变细
+	std::vector<UINT> vecMissingPages;
+	for (UINT i = static_cast<UINT>(m_vecLevels.size()); i-- > 0 && vecMissingPages.size() < uiMaxLoadCount;)
+	{
+		const Level& level = m_vecLevels[i];
+		UINT uiEnd = level.uiFirstPage + level.uiPageCountX * level.uiPageCountY;
+		for (UINT uiPage = level.uiFirstPage; uiPage < uiEnd && vecMissingPages.size() < uiMaxLoadCount; ++uiPage)
+		{
+			const Page& page = m_vecPages[uiPage];
+			if (page.uiLastRequestRound == m_uiRound && page.uiSlot == INVALID_INDEX)
+				vecMissingPages.push_back(uiPage);
+		}
+	}
+	if (vecMissingPages.empty())
+		return vecLoads;
+
+	//可用的槽位：空槽位优先，其次是移出页表已过保护期的页，按移出的先后
+	std::vector<UINT> vecFreeSlots;
+	std::vector<UINT> vecRetiredSlots;
+	std::vector<UINT> vecVictimSlots;
+	size_t uiRetiringCount = 0;	//仍在保护期内，之后的轮次才能替换
+	for (UINT uiSlot = 0; uiSlot < m_vecSlots.size(); ++uiSlot)
+	{
+		UINT uiPage = m_vecSlots[uiSlot];
+		if (uiPage == INVALID_INDEX)
+		{
+			vecFreeSlots.push_back(uiSlot);
+			continue;
+		}
+
+		const Page& page = m_vecPages[uiPage];
+		if (page.uiRetireRound != 0)
+		{
+			if (page.uiRetireRound + m_uiGuardRounds <= m_uiRound)
+				vecRetiredSlots.push_back(uiSlot);
+			else
+				++uiRetiringCount;
+		}
+		else if (!page.bLoading && page.uiLastRequestRound + m_uiGuardRounds < m_uiRound)
+			vecVictimSlots.push_back(uiSlot);
+	}
+	std::sort(vecRetiredSlots.begin(), vecRetiredSlots.end(), [this](UINT uiSlot0, UINT uiSlot1)
+	{
+		return m_vecPages[m_vecSlots[uiSlot0]].uiRetireRound < m_vecPages[m_vecSlots[uiSlot1]].uiRetireRound;
+	});
+
+	size_t uiNextFree = 0;
+	size_t uiNextRetired = 0;
+	for (UINT uiPage : vecMissingPages)
+	{
+		PageLoad load;
+		load.uiPage = uiPage;
+		load.uiEvictedPage = INVALID_INDEX;
+		if (uiNextFree < vecFreeSlots.size())
+			load.uiSlot = vecFreeSlots[uiNextFree++];
+		else if (uiNextRetired < vecRetiredSlots.size())
+		{
+			load.uiSlot = vecRetiredSlots[uiNextRetired++];
+			load.uiEvictedPage = m_vecSlots[load.uiSlot];
+			m_vecPages[load.uiEvictedPage].uiSlot = INVALID_INDEX;
+			m_vecPages[load.uiEvictedPage].uiRetireRound = 0;
+			++m_uiTotalEvictionCount;
+		}
+		else
+			break;
+
+		m_vecSlots[load.uiSlot] = uiPage;
+		m_vecPages[uiPage].uiSlot = load.uiSlot;
+		m_vecPages[uiPage].bLoading = true;
+		++m_uiTotalLoadCount;
+		vecLoads.push_back(load);
+	}
+
+	//槽位仍然不够时，把最久未被请求的页移出页表，保护期内的页空出槽位后也可以使用
+	size_t uiShortage = vecMissingPages.size() - vecLoads.size();
+	uiShortage -= std::min(uiShortage, uiRetiringCount);
+	size_t uiVictimCount = std::min(vecVictimSlots.size(), uiShortage);
+	std::partial_sort(vecVictimSlots.begin(), vecVictimSlots.begin() + uiVictimCount, vecVictimSlots.end(), [this](UINT uiSlot0, UINT uiSlot1)
+	{
+		return m_vecPages[m_vecSlots[uiSlot0]].uiLastRequestRound < m_vecPages[m_vecSlots[uiSlot1]].uiLastRequestRound;
+	});
+	for (size_t i = 0; i < uiVictimCount; ++i)
+	{
+		m_vecPages[m_vecSlots[vecVictimSlots[i]]].uiRetireRound = m_uiRound;
+		m_bPageTableDirty = true;
+	}
+
+	return vecLoads;
+}
+
+void VirtualTexture::CompleteLoad(UINT uiPage)
+{
+	m_vecPages[uiPage].bLoading = false;
+	m_bPageTableDirty = true;
+}
+
+bool VirtualTexture::UpdatePageTable()
+{
+	if (!m_bPageTableDirty)
+		return false;
+	m_bPageTableDirty = false;
+
+	const UINT uiWidth = GetPageTableWidth();
+	const UINT uiHeight = GetPageTableHeight();
+
+	//从mip tail向细的级别逐级检查覆盖该处的页，遇到不在页表中的页时停止，三线性过滤会同时读取更粗的一级
+	std::vector<UCHAR> vecLevels(m_vecPageTable.size());
+	for (UINT y = 0; y < uiHeight; ++y)
+	{
+		for (UINT x = 0; x < uiWidth; ++x)
+		{
+			UINT uiLevel = GetPagedLevelCount();
+			while (uiLevel > 0 && m_vecPages[GetPage(uiLevel - 1, x >> (uiLevel - 1), y >> (uiLevel - 1))].IsInPageTable())
+				--uiLevel;
+			vecLevels[y * uiWidth + x] = static_cast<UCHAR>(uiLevel);
+		}
+	}
+
+	//各级页的边界都在level 0页的边界上，在边缘处双线性过滤读取的相邻页由相邻的texel覆盖，取3x3范围内最粗的级别
+	for (UINT y = 0; y < uiHeight; ++y)
+	{
+		for (UINT x = 0; x < uiWidth; ++x)
+		{
+			UCHAR uiLevel = 0;
+			for (int nOffsetY = -1; nOffsetY <= 1; ++nOffsetY)
+			{
+				UINT uiNeighborY = (y + uiHeight + nOffsetY) % uiHeight;
+				for (int nOffsetX = -1; nOffsetX <= 1; ++nOffsetX)
+					uiLevel = std::max(uiLevel, vecLevels[uiNeighborY * uiWidth + (x + uiWidth + nOffsetX) % uiWidth]);
+			}
+			m_vecPageTable[y * uiWidth + x] = uiLevel;
+		}
+	}
+	return true;
+}
+
+VirtualTexture::Stats VirtualTexture::GetStats() const
+{
+	Stats stats;
+	stats.uiPageCount = GetPageCount();
+	stats.uiSlotCount = GetSlotCount();
+	stats.uiTotalLoadCount = m_uiTotalLoadCount;
+	stats.uiTotalEvictionCount = m_uiTotalEvictionCount;
+
+	for (const Page& page : m_vecPages)
+	{
+		bool bResident = page.uiSlot != INVALID_INDEX && !page.bLoading;
+		stats.uiResidentCount += bResident ? 1 : 0;
+		stats.uiLoadingCount += page.bLoading ? 1 : 0;
+		stats.uiRetiringCount += (page.uiRetireRound != 0) ? 1 : 0;
+		if (page.uiLastRequestRound == m_uiRound && m_uiRound > 0)
+		{
+			++stats.uiRequestedCount;
+			stats.uiMissingCount += bResident ? 0 : 1;
+		}
+	}
+	return stats;
+}
@@ -0,0 +1,110 @@
+#pragma once
+#include "Core.h"
+
+//稀疏纹理的页表与物理页缓存，只做CPU端的记录，页的绑定与数据的拷贝由调用者完成
+//mip tail之前的各级按页驻留，mip tail整体常驻；缓存的槽位数固定，显存占用不超过槽位数 * 页大小
+//每轮反馈先BeginFeedback，再用RequestPage标记着色器写回的页，最后CollectPageLoads得到需要加载的页
+//着色器按页表采样，页表中只有已驻留的页；缓存已满时先把最久未被请求的页移出页表，
+//uiGuardRounds轮之后（使用旧页表的in flight的帧都已完成）其槽位才会被新的页替换
+class VirtualTexture
+{
+public:
+	static constexpr UINT INVALID_INDEX = UINT_MAX;
+
+	struct PageLoad
+	{
+		UINT uiPage;
+		UINT uiSlot;
+		UINT uiEvictedPage;	//槽位原先驻留的页，需解除其绑定；空槽位时为INVALID_INDEX
+	};
+
+	struct PageRect
+	{
+		UINT uiLevel;
+		UINT uiX;
+		UINT uiY;
+		UINT uiWidth;	//边缘的页截止到该级的边缘
+		UINT uiHeight;
+	};
+
+	struct Level
+	{
+		UINT uiWidth;
+		UINT uiHeight;
+		UINT uiPageCountX;
+		UINT uiPageCountY;
+		UINT uiFirstPage;
+	};
+
+	struct Stats
+	{
+		UINT uiPageCount = 0;
+		UINT uiSlotCount = 0;
+		UINT uiResidentCount = 0;
+		UINT uiLoadingCount = 0;
+		UINT uiRetiringCount = 0;	//已移出页表、等待槽位被替换的页
+		UINT uiRequestedCount = 0;	//本轮请求的页
+		UINT uiMissingCount = 0;	//本轮请求但未驻留的页
+		uint64_t uiTotalLoadCount = 0;
+		uint64_t uiTotalEvictionCount = 0;
+	};
+
+	VirtualTexture();
+
+	//uiPagedLevelCount为按页驻留的级数（即mip tail的第一级）
+	void Init(UINT uiWidth, UINT uiHeight, UINT uiPagedLevelCount, UINT uiPageWidth, UINT uiPageHeight, UINT uiSlotCount, UINT uiGuardRounds);
+	bool IsValid() const { return !m_vecPages.empty(); }
+
+	UINT GetPagedLevelCount() const { return static_cast<UINT>(m_vecLevels.size()); }
+	UINT GetPageCount() const { return static_cast<UINT>(m_vecPages.size()); }
+	UINT GetSlotCount() const { return static_cast<UINT>(m_vecSlots.size()); }
+	const Level& GetLevel(UINT uiLevel) const { return m_vecLevels[uiLevel]; }
+	PageRect GetPageRect(UINT uiPage) const;
+
+	void BeginFeedback();
+	//标记该页、同一级上相邻的8页（双线性过滤会跨过页的边缘）以及更粗各级上覆盖它们的页；相邻的页按REPEAT寻址回绕
+	void RequestPage(UINT uiPage);
+
+	//本轮请求但未驻留的页，最粗的级别优先，最多uiMaxLoadCount个；返回的页处于加载中，数据就绪后调用CompleteLoad
+	//没有可替换的槽位时返回的数量少于缺页数，同时把可替换的页移出页表，之后的轮次再使用其槽位
+	std::vector<PageLoad> CollectPageLoads(UINT uiMaxLoadCount);
+	void CompleteLoad(UINT uiPage);
+
+	//页表为level 0上每页一个texel，值为该处及相邻各处从该级到mip tail都已驻留的最细级别，没有时为GetPagedLevelCount()
+	UINT GetPageTableWidth() const { return m_vecLevels[0].uiPageCountX; }
+	UINT GetPageTableHeight() const { return m_vecLevels[0].uiPageCountY; }
+	//页表中的页发生变化时重建并返回true
+	bool UpdatePageTable();
+	const std::vector<UCHAR>& GetPageTable() const { return m_vecPageTable; }
+
+	Stats GetStats() const;
+
+private:
+	struct Page
+	{
+		UINT uiSlot = INVALID_INDEX;
+		bool bLoading = false;
+		uint64_t uiLastRequestRound = 0;	//0表示从未被请求
+		uint64_t uiRetireRound = 0;	//移出页表的轮次，0表示仍在页表中
+
+		bool IsInPageTable() const { return uiSlot != INVALID_INDEX && !bLoading && uiRetireRound == 0; }
+	};
+
+	//第uiLevel级上(x, y)处的页，超出该级的页数时取最后一页
+	UINT GetPage(UINT uiLevel, UINT uiX, UINT uiY) const;
+
+private:
+	UINT m_uiPageWidth;
+	UINT m_uiPageHeight;
+	UINT m_uiGuardRounds;
+
+	std::vector<Level> m_vecLevels;
+	std::vector<Page> m_vecPages;
+	std::vector<UINT> m_vecSlots;	//槽位上驻留或正在加载的页，空槽位为INVALID_INDEX
+	std::vector<UCHAR> m_vecPageTable;
+	bool m_bPageTableDirty;
+
+	uint64_t m_uiRound;
+	uint64_t m_uiTotalLoadCount;
+	uint64_t m_uiTotalEvictionCount;
+};
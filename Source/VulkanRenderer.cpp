@@ -1,9 +1,18 @@
 #include "Core.h"
 #include "VulkanRenderer.h"
 #include "VulkanUtils.h"
+#include "VertexHashTable.h"
+#include "ObjParallelParser.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "TextureMipmap.h"
+#include "KTX2File.h"
+#include "TextureDecoder.h"
+#include "PixelConvert.h"
 #include "Log.h"
 
 #include <chrono>
+#include <bit>
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -12,6 +21,7 @@
 #include "glm/vec4.hpp"
 #include "glm/mat4x4.hpp"
 #include "glm/gtc/matrix_transform.hpp"
+#include "glm/gtc/packing.hpp"
 
 #define TINYGLTF_IMPLEMENTATION
 #define STB_IMAGE_IMPLEMENTATION
@@ -19,6 +29,7 @@
 // #define TINYGLTF_NOEXCEPTION // optional. disable exception handling.
 
 #include "tiny_gltf.h"
+#include "GLTFAccessorView.h"
 
 #define TINYOBJLOADER_IMPLEMENTATION
 #include <tiny_obj_loader.h>
@@ -27,6 +38,14 @@
 #include "UI/UI.h"
 static UI g_UI;
 
+//稀疏纹理每帧最多绑定并拷贝的页数，以及同时在后台读取的页数
+static constexpr UINT VIRTUAL_TEXTURE_MAX_UPLOADS_PER_FRAME = 16;
+static constexpr UINT VIRTUAL_TEXTURE_MAX_PENDING_READS = 64;
+//估计反馈时每帧最多投影的三角形数
+static constexpr size_t TEXTURE_FEEDBACK_MAX_TRIANGLES = 65536;
+//流式纹理每帧最多开始流入的纹理数，每张重建一次image
+static constexpr UINT TEXTURE_STREAMING_MAX_STREAM_INS_PER_FRAME = 2;
+
 
 VulkanRenderer::VulkanRenderer()
 {
@@ -46,6 +65,7 @@ VulkanRenderer::VulkanRenderer()
 		{ VK_SHADER_STAGE_VERTEX_BIT,	"./Assert/Shader/vert.spv" },
 		{ VK_SHADER_STAGE_FRAGMENT_BIT,	"./Assert/Shader/frag.spv" },
 	};
+	m_VirtualTextureFragShaderPath = "./Assert/Shader/frag_vt.spv";
 
 	//m_TexturePath = "./Assert/Texture/Earth/8081_earthmap4k.jpg";
 	//m_TexturePath = "./Assert/Texture/Earth2/8k_earth_daymap.jpg";
@@ -54,11 +74,60 @@ VulkanRenderer::VulkanRenderer()
 
 	m_ModelPath = "./Assert/Model/viking_room.obj";
 
+	m_bParallelOBJLoad = true;
+	m_bUseMeshCache = true;
+	m_VertexFormat = VertexFormat::Float;
+	m_bOptimizeMesh = true;
+	m_bOptimizeOverdraw = true;
+
+	m_bGenerateLOD = true;
+	m_bEnableLOD = true;
+	m_fLODPixelError = 1.f;
+
+	m_pMeshData = std::make_unique<MeshData>();
+	m_fModelLoadProgress = 0.f;
+	m_szModelLoadStage = "";
+	m_bPendingMeshDataRefused = false;
+
+	m_VertexBuffer = VK_NULL_HANDLE;
+	m_IndexBuffer = VK_NULL_HANDLE;
+	m_uiMeshGeometry = GeometryPool::INVALID_HANDLE;
+	m_bDirectGeometryWrite = false;
+	m_bDefragmentGeometryPending = false;
+
+	m_StagingBuffer = VK_NULL_HANDLE;
+
+	m_uiDynamicUniformAlignment = 0;
+
 	m_uiMipmapLevel = 1;
+	m_TextureFormat = VK_FORMAT_R8G8B8A8_SRGB;
+	m_bDecodedTextureRefused = false;
+
+	m_bEnableVirtualTexture = true;
+	m_uiVirtualTextureCacheSize = 64 * 1024 * 1024;
+	m_bVirtualTexture = false;
+	m_uiVirtualTexturePageSize = 0;
+	m_uiVirtualTextureStagingPageSize = 0;
+	m_VirtualTextureBindSemaphore = VK_NULL_HANDLE;
+	m_bVirtualTextureBindPending = false;
+	m_VirtualTextureStagingBuffer = VK_NULL_HANDLE;
+	m_uiVirtualTextureStagingFrameSize = 0;
+	m_VirtualTexturePageTableImage = VK_NULL_HANDLE;
+	m_VirtualTexturePageTableView = VK_NULL_HANDLE;
+	m_VirtualTexturePageTableSampler = VK_NULL_HANDLE;
+	m_VirtualTextureConstantBuffer = VK_NULL_HANDLE;
+	m_VirtualTextureFeedbackBuffer = VK_NULL_HANDLE;
+	m_uiVirtualTextureFeedbackFrameSize = 0;
+
+	m_TextureManager.SetBudget(256 * 1024 * 1024);
+	m_uiSceneTexture = TextureManager::INVALID_HANDLE;
+	m_TextureImage = VK_NULL_HANDLE;
+	m_TextureImageView = VK_NULL_HANDLE;
 
 	m_bViewportAndScissorIsDynamic = false;
 
 	m_uiCurFrameIdx = 0;
+	m_uiTotalFrameCount = 0;
 
 	m_uiFPS = 0;
 	m_uiFrameCounter = 0;
@@ -71,6 +140,12 @@ VulkanRenderer::~VulkanRenderer()
 
 void VulkanRenderer::Init()
 {
+	//没有烘焙的.ktx2时才需要解码源图像
+	std::filesystem::path cookedTexturePath = m_TexturePath;
+	cookedTexturePath.replace_extension(".ktx2");
+	if (!std::filesystem::exists(cookedTexturePath))
+		m_TextureDecodeFuture = TextureDecoder::DecodeAsync(m_TexturePath, m_ThreadPool);
+
 	InitWindow();
 	CreateInstance();
 	CreateWindowSurface();
@@ -78,6 +153,7 @@ void VulkanRenderer::Init()
 	CreateLogicalDevice();
 
 	CreateTransferCommandPool();
+	CreateStagingBufferRing();
 
 	CreateSwapChain();
 	CreateRenderPass();
@@ -87,21 +163,28 @@ void VulkanRenderer::Init()
 	CreateSwapChainFrameBuffers();
 
 
-	CreateShader();
 	CreateUniformBuffers();
+	//模型可能在Init之前已同步加载，按其SubMesh数预留，异步加载的模型更大时由UpdateUniformBuffer按帧扩容
+	CreateDynamicUniformBuffers(std::max<UINT>(64, static_cast<UINT>(m_pMeshData->GetSubMeshCount())));
 
 
-	CreateTextureSampler();
-
 	CreateTextureImageAndFillData();
 	CreateTextureImageView();
+	CreateTextureSampler();
+	//稀疏纹理使用另一个片元着色器，需在纹理创建之后
+	CreateShader();
 
 	CreateDescriptorSetLayout();
 	CreateDescriptorPool();
 	CreateDescriptorSets();
 
-	CreateVertexBuffer();
-	CreateIndexBuffer();
+	//所有网格共用的顶点/索引缓冲
+	m_GeometryPool.Init(GeometryPool::DEFAULT_VERTEX_CAPACITY, GeometryPool::DEFAULT_INDEX_CAPACITY);
+	CreateGeometryBuffers(GeometryPool::DEFAULT_VERTEX_CAPACITY, GeometryPool::DEFAULT_INDEX_CAPACITY);
+	CreateMeshGeometry();
+
+	//纹理与网格的上传录制在同一批次中一次提交，渲染在同一队列上排在其后，无需等待
+	SubmitUploadBatch();
 
 	CreateCommandPool();
 	CreateCommandBuffer();
@@ -122,6 +205,7 @@ void VulkanRenderer::Loop()
 		glfwPollEvents();
 
 		static std::chrono::time_point<std::chrono::high_resolution_clock> lastTimestamp = std::chrono::high_resolution_clock::now();
+		static std::chrono::time_point<std::chrono::high_resolution_clock> lastMemoryLogTimestamp = lastTimestamp;
 
 		Render();
 
@@ -133,15 +217,27 @@ void VulkanRenderer::Loop()
 			m_uiFPS = static_cast<uint32_t>((float)m_uiFrameCounter * (1000.0f / fpsTimer));
 			m_uiFrameCounter = 0;
 			lastTimestamp = nowTimestamp;
+
+			//预算随其他进程的占用变化，每秒重新查询一次
+			m_MemoryAllocator.UpdateBudget();
+			if (nowTimestamp - lastMemoryLogTimestamp > std::chrono::seconds(10))
+			{
+				LogMemoryStats();
+				lastMemoryLogTimestamp = nowTimestamp;
+			}
 		}
 	}
 
-	//ȴGPUǰִɣԴδռʱ
+	//等待GPU将当前的命令执行完成，资源未被占用时才能销毁
 	vkDeviceWaitIdle(m_LogicalDevice);
 }
 
 void VulkanRenderer::Clean()
 {
+	//等待未完成的异步加载，其中会访问渲染器的加载选项
+	if (m_ModelLoadFuture.valid())
+		m_ModelLoadFuture.wait();
+
 	g_UI.Clean();
 
 	for (const auto& shaderModule : m_mapShaderModule)
@@ -151,7 +247,7 @@ void VulkanRenderer::Clean()
 
 	vkDestroyImageView(m_LogicalDevice, m_DepthImageView, nullptr);
 	vkDestroyImage(m_LogicalDevice, m_DepthImage, nullptr);
-	vkFreeMemory(m_LogicalDevice, m_DepthImageMemory, nullptr);
+	m_MemoryAllocator.Free(m_DepthImageAllocation);
 
 	for (const auto& frameBuffer : m_vecSwapChainFrameBuffers)
 	{
@@ -168,32 +264,26 @@ void VulkanRenderer::Clean()
 	//	vkDestroyImage(m_LogicalDevice, image, nullptr);
 	//}
 
-	//SwapChain
+	//清理SwapChain
 	vkDestroySwapchainKHR(m_LogicalDevice, m_SwapChain, nullptr);
 
 	vkDestroySampler(m_LogicalDevice, m_TextureSampler, nullptr);
 	vkDestroyImageView(m_LogicalDevice, m_TextureImageView, nullptr);
 	vkDestroyImage(m_LogicalDevice, m_TextureImage, nullptr);
-	vkFreeMemory(m_LogicalDevice, m_TextureImageMemory, nullptr);
+	m_MemoryAllocator.Free(m_TextureImageAllocation);
+	DestroyVirtualTexture();
+	ReleaseRetiredResources(true);
+	DestroyStreamedTextures();
 
 	vkDestroyDescriptorPool(m_LogicalDevice, m_DescriptorPool, nullptr);
 
 	vkDestroyDescriptorSetLayout(m_LogicalDevice, m_DescriptorSetLayout, nullptr);
-	for (size_t i = 0; i < m_vecSwapChainImages.size(); ++i)
-	{
-		vkFreeMemory(m_LogicalDevice, m_vecUniformBufferMemories[i], nullptr);
-		vkDestroyBuffer(m_LogicalDevice, m_vecUniformBuffers[i], nullptr);
-	}
+	DestroyUniformBuffers();
+	DestroyDynamicUniformBuffers();
 
 
-	vkFreeMemory(m_LogicalDevice, m_VertexBufferMemory, nullptr);
-	vkDestroyBuffer(m_LogicalDevice, m_VertexBuffer, nullptr);
-
-	if (m_Indices.size() > 0)
-	{
-		vkFreeMemory(m_LogicalDevice, m_IndexBufferMemory, nullptr);
-		vkDestroyBuffer(m_LogicalDevice, m_IndexBuffer, nullptr);
-	}
+	DestroyMeshGeometry();
+	DestroyGeometryBuffers();
 
 	for (int i = 0; i < m_vecSwapChainImages.size(); ++i)
 	{
@@ -202,8 +292,13 @@ void VulkanRenderer::Clean()
 		vkDestroyFence(m_LogicalDevice, m_vecInFlightFences[i], nullptr);
 	}
 
+	m_StagingBufferRing.Destroy();
+	vkDestroyBuffer(m_LogicalDevice, m_StagingBuffer, nullptr);
+	m_MemoryAllocator.Free(m_StagingBufferAllocation);
+
 	vkDestroyCommandPool(m_LogicalDevice, m_CommandPool, nullptr);
 	vkDestroyCommandPool(m_LogicalDevice, m_TransferCommandPool, nullptr);
+	vkDestroyCommandPool(m_LogicalDevice, m_UploadCommandPool, nullptr);
 
 	if (m_bEnableValidationLayer)
 	{
@@ -215,6 +310,8 @@ void VulkanRenderer::Clean()
 	vkDestroyRenderPass(m_LogicalDevice, m_RenderPass, nullptr);
 
 	vkDestroySurfaceKHR(m_Instance, m_WindowSurface, nullptr);
+
+	m_MemoryAllocator.Destroy();
 	vkDestroyDevice(m_LogicalDevice, nullptr);
 
 	vkDestroyInstance(m_Instance, nullptr);
@@ -223,21 +320,57 @@ void VulkanRenderer::Clean()
 	glfwTerminate();
 }
 
-void VulkanRenderer::LoadOBJ(const std::filesystem::path& modelPath)
+bool VulkanRenderer::LoadOBJ(const std::filesystem::path& modelPath, MeshData& meshData)
+{
+	bool bSuccess = m_bParallelOBJLoad ? LoadOBJParallel(modelPath, meshData) : LoadOBJByTinyObj(modelPath, meshData);
+	//并行解析只支持常见的语法，失败时由tinyobj重新加载
+	if (!bSuccess && m_bParallelOBJLoad)
+	{
+		Log::Warn(std::format("Parallel obj parse of {} failed, fall back to tinyobj", modelPath.string()));
+		meshData.vecVertices.clear();
+		meshData.vecIndices.clear();
+		bSuccess = LoadOBJByTinyObj(modelPath, meshData);
+	}
+	if (!bSuccess)
+		return false;
+
+	//OBJ的所有面合并为一个绘制区间
+	meshData.vecSubMeshes.clear();
+	meshData.vecSubMeshes.push_back({ 0, static_cast<UINT>(meshData.vecIndices.size()), 0, static_cast<UINT>(meshData.vecVertices.size()) });
+	return true;
+}
+
+bool VulkanRenderer::LoadOBJByTinyObj(const std::filesystem::path& modelPath, MeshData& meshData)
 {
-	tinyobj::attrib_t attr;	//洢ж㡢ߡUV
+	auto startTimestamp = std::chrono::high_resolution_clock::now();
+
+	tinyobj::attrib_t attr;	//存储所有顶点、法线、UV坐标
 	std::vector<tinyobj::shape_t> vecShapes;
 	std::vector<tinyobj::material_t> vecMaterials;
 	std::string strWarning;
 	std::string strError;
 
 	bool res = tinyobj::LoadObj(&attr, &vecShapes, &vecMaterials, &strWarning, &strError, modelPath.string().c_str());
-	ASSERT(res, std::format("Load obj file {} failed", modelPath.string().c_str()));
+	if (!res)
+	{
+		Log::Error(std::format("Load obj file {} failed : {}", modelPath.string(), strError));
+		return false;
+	}
+
+	auto parseTimestamp = std::chrono::high_resolution_clock::now();
+
+	meshData.vecVertices.clear();
+	meshData.vecIndices.clear();
 
-	m_Vertices.clear();
-	m_Indices.clear();
+	size_t uiCornerCount = 0;
+	for (const auto& shape : vecShapes)
+		uiCornerCount += shape.mesh.indices.size();
 
-	std::unordered_map<Vertex3D, uint32_t> mapUniqueVertices;
+	//唯一顶点数至少为position数量，以此预分配哈希表与顶点数组，避免加载过程中反复扩容
+	size_t uiExpectedVertexCount = std::min(attr.vertices.size() / 3, uiCornerCount);
+	VertexHashTable<Vertex3D> uniqueVertices(uiExpectedVertexCount);
+	meshData.vecVertices.reserve(uiExpectedVertexCount);
+	meshData.vecIndices.reserve(uiCornerCount);
 
 	for (const auto& shape : vecShapes)
 	{
@@ -249,21 +382,359 @@ void VulkanRenderer::LoadOBJ(const std::filesystem::path& modelPath)
 				attr.vertices[3 * static_cast<uint64_t>(index.vertex_index) + 1],
 				attr.vertices[3 * static_cast<uint64_t>(index.vertex_index) + 2],
 			};
-			vert.texCoord = {
-				attr.texcoords[2 * static_cast<uint64_t>(index.texcoord_index) + 0],
-				1.f - attr.texcoords[2 * static_cast<uint64_t>(index.texcoord_index) + 1],
-			};
+			if (index.texcoord_index >= 0)
+			{
+				vert.texCoord = {
+					attr.texcoords[2 * static_cast<uint64_t>(index.texcoord_index) + 0],
+					1.f - attr.texcoords[2 * static_cast<uint64_t>(index.texcoord_index) + 1],
+				};
+			}
+			if (index.normal_index >= 0)
+			{
+				vert.normal = {
+					attr.normals[3 * static_cast<uint64_t>(index.normal_index) + 0],
+					attr.normals[3 * static_cast<uint64_t>(index.normal_index) + 1],
+					attr.normals[3 * static_cast<uint64_t>(index.normal_index) + 2],
+				};
+			}
 			vert.color = glm::vec3(1.f, 1.f, 1.f);
 
-			m_Vertices.push_back(vert);
-			m_Indices.push_back(static_cast<uint32_t>(m_Indices.size()));
+			meshData.vecIndices.push_back(uniqueVertices.Insert(vert, meshData.vecVertices));
+		}
+	}
+
+	auto endTimestamp = std::chrono::high_resolution_clock::now();
+
+	double dParseTime = std::chrono::duration<double, std::milli>(parseTimestamp - startTimestamp).count();
+	double dDedupTime = std::chrono::duration<double, std::milli>(endTimestamp - parseTimestamp).count();
+	double dDedupRatio = meshData.vecVertices.empty() ? 0.0 : static_cast<double>(uiCornerCount) / static_cast<double>(meshData.vecVertices.size());
+	Log::Info(std::format("Load obj {} : {} corners -> {} unique vertices, dedup ratio {:.2f}x, parse {:.2f} ms, dedup {:.2f} ms",
+		modelPath.string(), uiCornerCount, meshData.vecVertices.size(), dDedupRatio, dParseTime, dDedupTime));
+	return true;
+}
+
+bool VulkanRenderer::LoadOBJParallel(const std::filesystem::path& modelPath, MeshData& meshData)
+{
+	auto startTimestamp = std::chrono::high_resolution_clock::now();
+
+	meshData.vecVertices.clear();
+	meshData.vecIndices.clear();
+
+	ObjParallelParser parser(m_ThreadPool);
+	bool res = parser.Parse(modelPath, meshData.vecVertices, meshData.vecIndices);
+	if (!res)
+	{
+		Log::Error(std::format("Load obj file {} failed", modelPath.string()));
+		return false;
+	}
+
+	auto endTimestamp = std::chrono::high_resolution_clock::now();
+
+	double dTotalTime = std::chrono::duration<double, std::milli>(endTimestamp - startTimestamp).count();
+	double dDedupRatio = meshData.vecVertices.empty() ? 0.0 : static_cast<double>(parser.GetCornerCount()) / static_cast<double>(meshData.vecVertices.size());
+	Log::Info(std::format("Load obj {} (parallel, {} threads, {} chunks) : {} corners -> {} vertices, dedup ratio {:.2f}x, parse {:.2f} ms, assemble {:.2f} ms, merge {:.2f} ms, total {:.2f} ms",
+		modelPath.string(), m_ThreadPool.GetThreadCount(), parser.GetChunkCount(), parser.GetCornerCount(), meshData.vecVertices.size(), dDedupRatio,
+		parser.GetParseTime(), parser.GetAssembleTime(), parser.GetMergeTime(), dTotalTime));
+	return true;
+}
+
+void VulkanRenderer::BenchmarkOBJLoad(const std::filesystem::path& modelPath)
+{
+	//两种路径各跑一次，结果写入临时的MeshData，不影响当前模型
+	auto MeasureLoad = [this, &modelPath](bool bParallel)
+	{
+		MeshData meshData;
+		auto startTimestamp = std::chrono::high_resolution_clock::now();
+		if (bParallel)
+			LoadOBJParallel(modelPath, meshData);
+		else
+			LoadOBJByTinyObj(modelPath, meshData);
+		auto endTimestamp = std::chrono::high_resolution_clock::now();
+		return std::chrono::duration<double, std::milli>(endTimestamp - startTimestamp).count();
+	};
+
+	double dOtherTime = MeasureLoad(!m_bParallelOBJLoad);
+	double dChosenTime = MeasureLoad(m_bParallelOBJLoad);
+
+	double dTinyObjTime = m_bParallelOBJLoad ? dOtherTime : dChosenTime;
+	double dParallelTime = m_bParallelOBJLoad ? dChosenTime : dOtherTime;
+	Log::Info(std::format("Obj load benchmark {} : tinyobj {:.2f} ms, parallel {:.2f} ms, speedup {:.2f}x",
+		modelPath.string(), dTinyObjTime, dParallelTime, dParallelTime > 0.0 ? dTinyObjTime / dParallelTime : 0.0));
+}
+
+void VulkanRenderer::BenchmarkMeshOptimize(const std::filesystem::path& modelPath)
+{
+	MeshData sourceMeshData;
+	const auto& extensionName = modelPath.extension().string();
+	bool bLoaded = false;
+	if (extensionName == ".obj")
+		bLoaded = LoadOBJ(modelPath, sourceMeshData);
+	else if (extensionName == ".gltf" || extensionName == ".glb")
+		bLoaded = LoadGLTF(modelPath, sourceMeshData);
+	if (!bLoaded)
+	{
+		Log::Error(std::format("Load model {} failed, skip benchmark", modelPath.string()));
+		return;
+	}
+
+	const UINT uiIterationCount = 10;
+
+	//每次从未优化的数据开始，三步依次执行，与OptimizeMesh的顺序相同；不生成LOD，只重排LOD0
+	MeshOptimizer::VertexCacheStats aryStats[4];	//优化前、顶点缓存、overdraw、顶点读取之后
+	double aryStageTimes[3] = {};
+	const std::vector<SubMesh>& vecSubMeshes = sourceMeshData.vecSubMeshes;
+	std::vector<std::vector<UINT>> vecSubMeshClusters(vecSubMeshes.size());	//顶点缓存一步输出的簇边界，供overdraw一步使用
+	for (UINT uiIteration = 0; uiIteration < uiIterationCount; ++uiIteration)
+	{
+		std::vector<Vertex3D> vecVertices = sourceMeshData.vecVertices;
+		std::vector<UINT> vecIndices = sourceMeshData.vecIndices;
+		const bool bRecordStats = (uiIteration == 0);
+
+		auto AnalyzeVertexCache = [&](MeshOptimizer::VertexCacheStats& stats)
+		{
+			for (const auto& subMesh : vecSubMeshes)
+				stats += MeshOptimizer::AnalyzeVertexCache(vecIndices.data() + subMesh.uiFirstIndex, subMesh.uiIndexCount, subMesh.uiVertexCount);
+		};
+		auto MeasureStage = [&](UINT uiStage, const std::function<void(size_t uiSubMesh, UINT* pIndices, Vertex3D* pVertices)>& stage)
+		{
+			auto startTimestamp = std::chrono::high_resolution_clock::now();
+			for (size_t i = 0; i < vecSubMeshes.size(); ++i)
+			{
+				const SubMesh& subMesh = vecSubMeshes[i];
+				UINT* pIndices = vecIndices.data() + subMesh.uiFirstIndex;
+				if (MeshOptimizer::IsIndexRangeValid(pIndices, subMesh.uiIndexCount, subMesh.uiVertexCount))
+					stage(i, pIndices, vecVertices.data() + subMesh.uiVertexOffset);
+			}
+			auto endTimestamp = std::chrono::high_resolution_clock::now();
+			aryStageTimes[uiStage] += std::chrono::duration<double, std::milli>(endTimestamp - startTimestamp).count();
+
+			if (bRecordStats)
+				AnalyzeVertexCache(aryStats[uiStage + 1]);
+		};
+
+		if (bRecordStats)
+			AnalyzeVertexCache(aryStats[0]);
+
+		MeasureStage(0, [&](size_t uiSubMesh, UINT* pIndices, Vertex3D*)
+		{
+			const SubMesh& subMesh = vecSubMeshes[uiSubMesh];
+			MeshOptimizer::OptimizeVertexCache(pIndices, subMesh.uiIndexCount, subMesh.uiVertexCount, MeshOptimizer::DEFAULT_CACHE_SIZE,
+				&vecSubMeshClusters[uiSubMesh]);
+		});
+		MeasureStage(1, [&](size_t uiSubMesh, UINT* pIndices, Vertex3D* pVertices)
+		{
+			const SubMesh& subMesh = vecSubMeshes[uiSubMesh];
+			MeshOptimizer::OptimizeOverdraw(pIndices, subMesh.uiIndexCount, pVertices, subMesh.uiVertexCount, vecSubMeshClusters[uiSubMesh]);
+		});
+		MeasureStage(2, [&](size_t uiSubMesh, UINT* pIndices, Vertex3D* pVertices)
+		{
+			const SubMesh& subMesh = vecSubMeshes[uiSubMesh];
+			MeshOptimizer::OptimizeVertexFetch(pVertices, subMesh.uiVertexCount, pIndices, subMesh.uiIndexCount);
+		});
+	}
+
+	Log::Info(std::format("Mesh optimize benchmark {} ({} runs, {} submeshes, {} triangles) : original ACMR {:.3f} ATVR {:.3f}",
+		modelPath.string(), uiIterationCount, sourceMeshData.vecSubMeshes.size(), aryStats[0].uiTriangleCount,
+		aryStats[0].GetACMR(), aryStats[0].GetATVR()));
+	const char* aryStageNames[3] = { "vertex cache", "overdraw", "vertex fetch" };
+	for (UINT i = 0; i < 3; ++i)
+	{
+		Log::Info(std::format("    {} : ACMR {:.3f} ATVR {:.3f}, {:.3f} ms",
+			aryStageNames[i], aryStats[i + 1].GetACMR(), aryStats[i + 1].GetATVR(), aryStageTimes[i] / uiIterationCount));
+	}
+}
+
+void VulkanRenderer::BenchmarkUniformBufferUpdate(UINT uiIterations)
+{
+	//对比每帧vkMapMemory + memcpy + vkUnmapMemory与写入持久映射地址的CPU开销
+	//使用与Uniform Buffer相同内存类型的独立内存，避免改写in flight的帧正在读取的数据
+	const auto& uniformBufferAllocation = m_vecUniformBufferAllocations[0];
+
+	VkMemoryAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = sizeof(PerFrameConstants);
+	allocInfo.memoryTypeIndex = uniformBufferAllocation.uiMemoryTypeIndex;
+
+	VkDeviceMemory memory;
+	VULKAN_ASSERT(vkAllocateMemory(m_LogicalDevice, &allocInfo, nullptr, &memory), "Allocate benchmark memory failed");
+
+	PerFrameConstants ubo{};
+	void* pData = nullptr;
+
+	auto mapStartTimestamp = std::chrono::high_resolution_clock::now();
+	for (UINT i = 0; i < uiIterations; ++i)
+	{
+		vkMapMemory(m_LogicalDevice, memory, 0, sizeof(ubo), 0, &pData);
+		memcpy(pData, &ubo, sizeof(ubo));
+		vkUnmapMemory(m_LogicalDevice, memory);
+	}
+	auto mapEndTimestamp = std::chrono::high_resolution_clock::now();
+
+	vkMapMemory(m_LogicalDevice, memory, 0, VK_WHOLE_SIZE, 0, &pData);
+	auto persistentStartTimestamp = std::chrono::high_resolution_clock::now();
+	for (UINT i = 0; i < uiIterations; ++i)
+	{
+		memcpy(pData, &ubo, sizeof(ubo));
+		//防止写入被合并为一次
+		std::atomic_signal_fence(std::memory_order_seq_cst);
+	}
+	auto persistentEndTimestamp = std::chrono::high_resolution_clock::now();
+	vkUnmapMemory(m_LogicalDevice, memory);
+
+	vkFreeMemory(m_LogicalDevice, memory, nullptr);
+
+	double dMapTime = std::chrono::duration<double, std::micro>(mapEndTimestamp - mapStartTimestamp).count() / uiIterations;
+	double dPersistentTime = std::chrono::duration<double, std::micro>(persistentEndTimestamp - persistentStartTimestamp).count() / uiIterations;
+	Log::Info(std::format("Uniform buffer update benchmark ({} iterations, {} bytes) : map/unmap {:.3f} us, persistent {:.3f} us per update",
+		uiIterations, sizeof(ubo), dMapTime, dPersistentTime));
+}
+
+void VulkanRenderer::BenchmarkTextureDecode(const std::vector<std::filesystem::path>& vecTexturePaths)
+{
+	auto MeasureTime = [](const auto& func)
+	{
+		auto startTimestamp = std::chrono::high_resolution_clock::now();
+		func();
+		auto endTimestamp = std::chrono::high_resolution_clock::now();
+		return std::chrono::duration<double, std::milli>(endTimestamp - startTimestamp).count();
+	};
+	auto ToMBps = [](size_t uiBytes, double dTime) { return dTime > 0.0 ? uiBytes / (1024.0 * 1024.0) / (dTime / 1000.0) : 0.0; };
+
+	//解码：逐张串行与线程池上同时解码，吞吐量按解码出的像素数据计算
+	double dSerialTime = MeasureTime([&]()
+	{
+		for (const auto& path : vecTexturePaths)
+			TextureDecoder::Decode(path);
+	});
+	std::vector<TextureDecoder::Image> vecImages;
+	double dParallelTime = MeasureTime([&]() { vecImages = TextureDecoder::DecodeParallel(vecTexturePaths, m_ThreadPool); });
+	std::erase_if(vecImages, [](const TextureDecoder::Image& image) { return !image.IsValid(); });
+	if (vecImages.empty())
+		return;
+
+	size_t uiDecodedSize = 0;
+	size_t uiRGBA8Size = 0;
+	size_t uiMaxRGBA8Size = 0;
+	for (const auto& image : vecImages)
+	{
+		uiDecodedSize += image.GetDecodedSize();
+		uiRGBA8Size += image.GetRGBA8Size();
+		uiMaxRGBA8Size = std::max(uiMaxRGBA8Size, image.GetRGBA8Size());
+	}
+	Log::Info(std::format("Texture decode benchmark : {} images, {:.1f} MB decoded, {} threads, SIMD {}",
+		vecImages.size(), uiDecodedSize / (1024.0 * 1024.0), m_ThreadPool.GetThreadCount(),
+		PixelConvert::GetSimdLevelName(PixelConvert::GetSupportedSimdLevel())));
+	Log::Info(std::format("    decode : serial {:.1f} MB/s, parallel {:.1f} MB/s, speedup {:.2f}x",
+		ToMBps(uiDecodedSize, dSerialTime), ToMBps(uiDecodedSize, dParallelTime), dParallelTime > 0.0 ? dSerialTime / dParallelTime : 0.0));
+
+	//单线程下各指令集版本的吞吐量，按输出的RGBA8数据计算
+	std::vector<UCHAR> vecPixels(uiMaxRGBA8Size);
+	std::vector<float> vecLinear(uiMaxRGBA8Size);
+	const auto supportedLevel = PixelConvert::GetSupportedSimdLevel();
+	for (UINT uiLevel = 0; uiLevel <= static_cast<UINT>(supportedLevel); ++uiLevel)
+	{
+		auto level = static_cast<PixelConvert::SimdLevel>(uiLevel);
+		double dExpandTime = 0.0;
+		double dDecodeSRGBTime = 0.0;
+		double dEncodeSRGBTime = 0.0;
+		for (const auto& image : vecImages)
+		{
+			size_t uiPixelCount = static_cast<size_t>(image.uiWidth) * image.uiHeight;
+			dExpandTime += MeasureTime([&]() { PixelConvert::ExpandToRGBA8(image.pPixels.get(), vecPixels.data(), uiPixelCount, image.uiChannel, level); });
+			dDecodeSRGBTime += MeasureTime([&]() { PixelConvert::SRGBToLinear(vecPixels.data(), vecLinear.data(), uiPixelCount, level); });
+			dEncodeSRGBTime += MeasureTime([&]() { PixelConvert::LinearToSRGB(vecLinear.data(), vecPixels.data(), uiPixelCount, level); });
+		}
+		Log::Info(std::format("    {} : expand to RGBA8 {:.1f} MB/s, sRGB to linear {:.1f} MB/s, linear to sRGB {:.1f} MB/s",
+			PixelConvert::GetSimdLevelName(level), ToMBps(uiRGBA8Size, dExpandTime), ToMBps(uiRGBA8Size, dDecodeSRGBTime), ToMBps(uiRGBA8Size, dEncodeSRGBTime)));
+	}
+
+	//写入暂存内存：先展开到堆上再memcpy，与直接展开到映射的暂存内存
+	//使用与暂存环相同内存类型的独立内存，不影响in flight的上传
+	VkMemoryAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = uiMaxRGBA8Size;
+	allocInfo.memoryTypeIndex = m_StagingBufferAllocation.uiMemoryTypeIndex;
+
+	VkDeviceMemory memory;
+	VULKAN_ASSERT(vkAllocateMemory(m_LogicalDevice, &allocInfo, nullptr, &memory), "Allocate benchmark memory failed");
+	void* pMappedData = nullptr;
+	vkMapMemory(m_LogicalDevice, memory, 0, VK_WHOLE_SIZE, 0, &pMappedData);
+
+	double dCopyTime = 0.0;
+	double dDirectTime = 0.0;
+	for (const auto& image : vecImages)
+	{
+		dCopyTime += MeasureTime([&]()
+		{
+			std::vector<UCHAR> vecRGBA8(image.GetRGBA8Size());
+			image.ExpandRowsToRGBA8(0, image.uiHeight, vecRGBA8.data(), &m_ThreadPool);
+			memcpy(pMappedData, vecRGBA8.data(), vecRGBA8.size());
+		});
+		dDirectTime += MeasureTime([&]() { image.ExpandRowsToRGBA8(0, image.uiHeight, static_cast<UCHAR*>(pMappedData), &m_ThreadPool); });
+	}
+
+	vkUnmapMemory(m_LogicalDevice, memory);
+	vkFreeMemory(m_LogicalDevice, memory, nullptr);
+
+	Log::Info(std::format("    to staging memory : expand + memcpy {:.1f} MB/s, expand in place {:.1f} MB/s",
+		ToMBps(uiRGBA8Size, dCopyTime), ToMBps(uiRGBA8Size, dDirectTime)));
+}
+
+std::string VulkanRenderer::GetMemoryHeapName(UINT uiHeapIndex) const
+{
+	std::string strName = VulkanUtils::GetMemoryHeapNameByFlags(m_MemoryAllocator.GetHeapFlags(uiHeapIndex));
+	return strName.empty() ? "Host" : strName;
+}
+
+void VulkanRenderer::LogMemoryStats() const
+{
+	for (UINT i = 0; i < m_MemoryAllocator.GetHeapCount(); ++i)
+	{
+		auto heapStats = m_MemoryAllocator.GetHeapStats(i);
+		if (heapStats.uiAllocationCount == 0)
+			continue;
+
+		std::string strCategories;
+		for (UINT uiCategory = 0; uiCategory < static_cast<UINT>(MemoryCategory::Count); ++uiCategory)
+		{
+			VkDeviceSize uiBytes = m_MemoryAllocator.GetCategoryBytes(i, static_cast<MemoryCategory>(uiCategory));
+			if (uiBytes > 0)
+				strCategories += std::format(", {} {:.1f}", GetMemoryCategoryName(static_cast<MemoryCategory>(uiCategory)), uiBytes / (1024.0 * 1024.0));
 		}
+
+		auto budget = m_MemoryAllocator.GetHeapBudget(i);
+		Log::Info(std::format("Memory heap{} ({}) : usage {:.1f} / budget {:.1f} MB, allocated {:.1f} / reserved {:.1f} MB{}",
+			i, GetMemoryHeapName(i), budget.uiUsage / (1024.0 * 1024.0), budget.uiBudget / (1024.0 * 1024.0),
+			heapStats.uiUsedBytes / (1024.0 * 1024.0), heapStats.uiReservedBytes / (1024.0 * 1024.0), strCategories));
 	}
 }
 
-void VulkanRenderer::LoadGLTF(const std::filesystem::path& modelPath)
+bool VulkanRenderer::LoadGLTF(const std::filesystem::path& modelPath, MeshData& meshData)
 {
+	auto startTimestamp = std::chrono::high_resolution_clock::now();
+
 	tinygltf::Model model;
+	if (!ReadGLTFFile(modelPath, model))
+	{
+		Log::Error(std::format("Load gltf file {} failed", modelPath.string()));
+		return false;
+	}
+
+	auto parseTimestamp = std::chrono::high_resolution_clock::now();
+
+	IngestGLTF(model, meshData);
+
+	auto endTimestamp = std::chrono::high_resolution_clock::now();
+
+	Log::Info(std::format("Load gltf {} : {} submeshes, {} vertices, {} indices, parse {:.2f} ms, ingest {:.2f} ms",
+		modelPath.string(), meshData.vecSubMeshes.size(), meshData.vecVertices.size(), meshData.vecIndices.size(),
+		std::chrono::duration<double, std::milli>(parseTimestamp - startTimestamp).count(),
+		std::chrono::duration<double, std::milli>(endTimestamp - parseTimestamp).count()));
+	return true;
+}
+
+bool VulkanRenderer::ReadGLTFFile(const std::filesystem::path& modelPath, tinygltf::Model& model)
+{
 	tinygltf::TinyGLTF loader;
 
 	std::string err;
@@ -281,8 +752,130 @@ void VulkanRenderer::LoadGLTF(const std::filesystem::path& modelPath)
 	if (!err.empty())
 		Log::Error(std::format("Load gltf error: {}", err.c_str()));
 
-	ASSERT(ret, "Load gltf failed");
+	return ret;
+}
+
+void VulkanRenderer::IngestGLTF(const tinygltf::Model& model, MeshData& meshData)
+{
+	meshData.vecVertices.clear();
+	meshData.vecIndices.clear();
+	meshData.vecSubMeshes.clear();
+
+	auto IsTriangleList = [](const tinygltf::Primitive& primitive)
+	{
+		return primitive.mode == TINYGLTF_MODE_TRIANGLES || primitive.mode == -1;
+	};
+
+	auto FindAttribute = [&model](const tinygltf::Primitive& primitive, const char* szName)
+	{
+		auto iter = primitive.attributes.find(szName);
+		return iter == primitive.attributes.end() ? GLTFAccessorView() : GLTFAccessorView(model, iter->second);
+	};
+
+	//先按accessor的count统计顶点与索引总数，一次性预分配，避免逐个push_back时反复扩容
+	size_t uiTotalVertexCount = 0;
+	size_t uiTotalIndexCount = 0;
+	size_t uiTotalSubMeshCount = 0;
+	for (const auto& mesh : model.meshes)
+	{
+		for (const auto& primitive : mesh.primitives)
+		{
+			auto iter = primitive.attributes.find("POSITION");
+			if (!IsTriangleList(primitive) || iter == primitive.attributes.end())
+				continue;
+
+			size_t uiVertexCount = model.accessors[iter->second].count;
+			++uiTotalSubMeshCount;
+			uiTotalVertexCount += uiVertexCount;
+			uiTotalIndexCount += (primitive.indices >= 0) ? model.accessors[primitive.indices].count : uiVertexCount;
+		}
+	}
+	meshData.vecVertices.reserve(uiTotalVertexCount);
+	meshData.vecIndices.reserve(uiTotalIndexCount);
+	meshData.vecSubMeshes.reserve(uiTotalSubMeshCount);
+
+	for (const auto& mesh : model.meshes)
+	{
+		for (const auto& primitive : mesh.primitives)
+		{
+			if (!IsTriangleList(primitive))
+			{
+				Log::Warn(std::format("Gltf mesh {} has unsupport primitive mode {}, skipped", mesh.name, primitive.mode));
+				continue;
+			}
+
+			GLTFAccessorView positions = FindAttribute(primitive, "POSITION");
+			if (!positions.IsValid())
+			{
+				Log::Warn(std::format("Gltf mesh {} has no valid POSITION, skipped", mesh.name));
+				continue;
+			}
+			const size_t uiVertexCount = positions.GetCount();
+
+			//属性数量与POSITION不一致时视为缺失
+			auto CheckCount = [uiVertexCount](GLTFAccessorView view) { return view.GetCount() >= uiVertexCount ? view : GLTFAccessorView(); };
+			GLTFAccessorView normals = CheckCount(FindAttribute(primitive, "NORMAL"));
+			GLTFAccessorView texCoords = CheckCount(FindAttribute(primitive, "TEXCOORD_0"));
+			GLTFAccessorView colors = CheckCount(FindAttribute(primitive, "COLOR_0"));
+
+			GLTFAccessorView indices(model, primitive.indices);
+			if (primitive.indices >= 0 && (!indices.IsValid() || !indices.IsIndexType()))
+			{
+				Log::Warn(std::format("Gltf mesh {} has invalid index accessor, skipped", mesh.name));
+				continue;
+			}
+
+			SubMesh subMesh{};
+			subMesh.uiFirstIndex = static_cast<UINT>(meshData.vecIndices.size());
+			subMesh.uiVertexOffset = static_cast<UINT>(meshData.vecVertices.size());
+			subMesh.uiVertexCount = static_cast<UINT>(uiVertexCount);
 
+			for (size_t i = 0; i < uiVertexCount; ++i)
+			{
+				Vertex3D vert{};
+				vert.pos = positions.ReadVec3(i);
+				vert.normal = normals.IsValid() ? normals.ReadVec3(i) : glm::vec3(0.f);
+				vert.texCoord = texCoords.IsValid() ? texCoords.ReadVec2(i) : glm::vec2(0.f);
+				vert.color = colors.IsValid() ? colors.ReadVec3(i) : glm::vec3(1.f);
+
+				meshData.vecVertices.push_back(vert);
+			}
+
+			//索引保持primitive内的局部值，由SubMesh::uiVertexOffset在绘制时定位
+			if (indices.IsValid())
+			{
+				//越界的索引会让GPU读取其他primitive甚至缓冲之外的顶点，整个primitive跳过
+				bool bIndexValid = true;
+				for (size_t i = 0; i < indices.GetCount(); ++i)
+				{
+					UINT uiIndex = indices.ReadIndex(i);
+					bIndexValid = bIndexValid && uiIndex < uiVertexCount;
+					meshData.vecIndices.push_back(uiIndex);
+				}
+				if (!bIndexValid)
+				{
+					Log::Warn(std::format("Gltf mesh {} has index out of vertex count {}, skipped", mesh.name, uiVertexCount));
+					meshData.vecVertices.resize(subMesh.uiVertexOffset);
+					meshData.vecIndices.resize(subMesh.uiFirstIndex);
+					continue;
+				}
+			}
+			else
+			{
+				//无索引的primitive按顶点顺序生成索引，便于与其他primitive统一绘制
+				for (size_t i = 0; i < uiVertexCount; ++i)
+					meshData.vecIndices.push_back(static_cast<UINT>(i));
+			}
+
+			subMesh.uiIndexCount = static_cast<UINT>(meshData.vecIndices.size()) - subMesh.uiFirstIndex;
+			meshData.vecSubMeshes.push_back(subMesh);
+		}
+	}
+}
+
+void VulkanRenderer::IngestGLTFLegacy(tinygltf::Model& model, MeshData& meshData)
+{
+	//原先的glTF读取方式，仅保留作为BenchmarkGLTFLoad的对照
 	for (auto& mesh : model.meshes)
 	{
 		for (auto& primitive : mesh.primitives)
@@ -300,12 +893,12 @@ void VulkanRenderer::LoadGLTF(const std::filesystem::path& modelPath)
 
 				point.color = { 1.0, 0.0, 0.0 };
 
-				m_Vertices.push_back(point);
+				meshData.vecVertices.push_back(point);
 			}
 		}
 
-		uint32_t indexStart = static_cast<uint32_t>(m_Indices.size());
-		uint32_t vertexStart = static_cast<uint32_t>(m_Vertices.size());
+		uint32_t indexStart = static_cast<uint32_t>(meshData.vecIndices.size());
+		uint32_t vertexStart = static_cast<uint32_t>(meshData.vecVertices.size());
 
 		for (auto& primitive : mesh.primitives)
 		{
@@ -320,7 +913,7 @@ void VulkanRenderer::LoadGLTF(const std::filesystem::path& modelPath)
 				uint32_t* buf = new uint32_t[accessor.count];
 				memcpy(buf, &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(uint32_t));
 				for (size_t index = 0; index < accessor.count; index++) {
-					m_Indices.push_back(buf[index] + vertexStart);
+					meshData.vecIndices.push_back(buf[index] + vertexStart);
 				}
 				delete[] buf;
 				break;
@@ -329,7 +922,7 @@ void VulkanRenderer::LoadGLTF(const std::filesystem::path& modelPath)
 				uint16_t* buf = new uint16_t[accessor.count];
 				memcpy(buf, &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(uint16_t));
 				for (size_t index = 0; index < accessor.count; index++) {
-					m_Indices.push_back(buf[index] + vertexStart);
+					meshData.vecIndices.push_back(buf[index] + vertexStart);
 				}
 				delete[] buf;
 				break;
@@ -338,64 +931,488 @@ void VulkanRenderer::LoadGLTF(const std::filesystem::path& modelPath)
 				uint8_t* buf = new uint8_t[accessor.count];
 				memcpy(buf, &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(uint8_t));
 				for (size_t index = 0; index < accessor.count; index++) {
-					m_Indices.push_back(buf[index] + vertexStart);
+					meshData.vecIndices.push_back(buf[index] + vertexStart);
 				}
 				delete[] buf;
 				break;
 			}
 			default:
-				ASSERT(false, "Unsupport index component type");
-				return;
+				Log::Warn(std::format("Gltf mesh {} has unsupport index component type {}, skipped", mesh.name, accessor.componentType));
+				break;
 			}
 		}
 	}
 }
 
-void VulkanRenderer::LoadModel(const std::filesystem::path& modelPath)
+void VulkanRenderer::BenchmarkGLTFLoad(const std::filesystem::path& modelPath)
 {
-	const auto& extensionName = modelPath.extension().string();
-	if (extensionName == ".obj")
-		LoadOBJ(modelPath);
-	else if (extensionName == ".gltf" || extensionName == ".glb")
-		LoadGLTF(modelPath);
-	else
-		ASSERT(false, "Unsupport model type");
+	tinygltf::Model model;
+	if (!ReadGLTFFile(modelPath, model))
+	{
+		Log::Error(std::format("Load gltf file {} failed, skip benchmark", modelPath.string()));
+		return;
+	}
+
+	const UINT uiIterationCount = 20;
+
+	MeshData meshData;
+	auto MeasureIngest = [&meshData, uiIterationCount](const std::function<void()>& ingest)
+	{
+		double dTotalTime = 0.0;
+		for (UINT i = 0; i < uiIterationCount; ++i)
+		{
+			meshData.vecVertices.clear();
+			meshData.vecIndices.clear();
+			meshData.vecSubMeshes.clear();
+
+			auto startTimestamp = std::chrono::high_resolution_clock::now();
+			ingest();
+			auto endTimestamp = std::chrono::high_resolution_clock::now();
+			dTotalTime += std::chrono::duration<double, std::milli>(endTimestamp - startTimestamp).count();
+		}
+		return dTotalTime / uiIterationCount;
+	};
+
+	double dLegacyTime = MeasureIngest([this, &model, &meshData]() { IngestGLTFLegacy(model, meshData); });
+	size_t uiLegacyVertexCount = meshData.vecVertices.size();
+	size_t uiLegacyIndexCount = meshData.vecIndices.size();
+
+	double dViewTime = MeasureIngest([this, &model, &meshData]() { IngestGLTF(model, meshData); });
+
+	Log::Info(std::format("Gltf ingest benchmark {} ({} runs) : legacy {:.3f} ms ({} vertices, {} indices, position only), "
+		"accessor view {:.3f} ms ({} vertices, {} indices, position/normal/uv/color), speedup {:.2f}x",
+		modelPath.string(), uiIterationCount,
+		dLegacyTime, uiLegacyVertexCount, uiLegacyIndexCount,
+		dViewTime, meshData.vecVertices.size(), meshData.vecIndices.size(),
+		dViewTime > 0.0 ? dLegacyTime / dViewTime : 0.0));
 }
 
-void VulkanRenderer::FrameBufferResizeCallBack(GLFWwindow* pWindow, int nWidth, int nHeight)
+void VulkanRenderer::LoadModel(const std::filesystem::path& modelPath)
 {
-	auto vulkanRenderer = reinterpret_cast<VulkanRenderer*>(glfwGetWindowUserPointer(pWindow));
-	if (vulkanRenderer)
-		vulkanRenderer->m_bFrameBufferResized = true;
+	//加载失败时保留当前（可能为空的）模型
+	if (auto pMeshData = BuildMeshData(modelPath))
+		m_pMeshData = std::move(pMeshData);
 }
 
-void VulkanRenderer::InitWindow()
+void VulkanRenderer::LoadModelAsync(const std::filesystem::path& modelPath)
 {
-	glfwInit();
-	ASSERT(glfwVulkanSupported(), "GLFW version not support vulkan");
+	if (IsModelLoading())
+	{
+		Log::Warn(std::format("Model {} is still loading, ignore request for {}", m_LoadingModelPath.string(), modelPath.string()));
+		return;
+	}
 
-	glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-	glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
+	//等待显存预算的模型被新的加载请求取代
+	if (m_pPendingMeshData)
+	{
+		Log::Info(std::format("Drop model {} waiting for memory budget", m_LoadingModelPath.string()));
+		m_pPendingMeshData.reset();
+	}
 
-	m_pWindow = glfwCreateWindow(m_uiWindowWidth, m_uiWindowHeight, m_strWindowTitle.c_str(), nullptr, nullptr);
-	glfwMakeContextCurrent(m_pWindow);
+	m_LoadingModelPath = modelPath;
+	m_fModelLoadProgress = 0.f;
+	m_szModelLoadStage = "Queued";
+	m_ModelLoadStartTime = std::chrono::high_resolution_clock::now();
 
-	glfwSetWindowUserPointer(m_pWindow, this);
-	glfwSetFramebufferSizeCallback(m_pWindow, FrameBufferResizeCallBack);
+	//解析使用独立线程而不是m_ThreadPool，并行OBJ解析会在线程池上ParallelFor，占用其中的worker等待可能死锁
+	m_ModelLoadFuture = std::async(std::launch::async, [this, modelPath]() { return BuildMeshData(modelPath); });
 }
 
-void VulkanRenderer::QueryGLFWExtensions()
+void VulkanRenderer::SetModelLoadProgress(const char* szStage, float fProgress)
 {
-	const char** ppGLFWEntensions = nullptr;
-	UINT uiCount = 0;
-	ppGLFWEntensions = glfwGetRequiredInstanceExtensions(&uiCount);
-
-	m_vecChosedExtensions = std::vector<const char*>(ppGLFWEntensions, ppGLFWEntensions + uiCount);
+	m_szModelLoadStage = szStage;
+	m_fModelLoadProgress = fProgress;
 }
 
-void VulkanRenderer::QueryValidationLayerExtensions()
+std::unique_ptr<MeshData> VulkanRenderer::BuildMeshData(const std::filesystem::path& modelPath)
 {
-	m_vecChosedExtensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+	auto startTimestamp = std::chrono::high_resolution_clock::now();
+
+	auto pMeshData = std::make_unique<MeshData>();
+	pMeshData->vertexFormat = m_VertexFormat;
+
+	SetModelLoadProgress("Read cache", 0.05f);
+	if (m_bUseMeshCache && pMeshData->cache.Load(modelPath, pMeshData->vertexFormat, pMeshData->GetVertexStride(), GetMeshCacheFlags()))
+	{
+		//缓存命中，顶点与索引保留在映射区域中，上传时直接拷贝进Staging Buffer
+		auto endTimestamp = std::chrono::high_resolution_clock::now();
+		Log::Info(std::format("Load mesh cache {} : {} submeshes, {} vertices, {} index bytes, {:.2f} ms",
+			MeshCache::GetCachePath(modelPath).string(), pMeshData->GetSubMeshCount(), pMeshData->GetVertexCount(), pMeshData->GetIndexDataSize(),
+			std::chrono::duration<double, std::milli>(endTimestamp - startTimestamp).count()));
+
+		SetModelLoadProgress("Done", 1.f);
+		return pMeshData;
+	}
+
+	//文件缺失或损坏时返回nullptr，由调用者保留当前模型
+	SetModelLoadProgress("Parse", 0.1f);
+	const auto& extensionName = modelPath.extension().string();
+	bool bLoaded = false;
+	if (extensionName == ".obj")
+		bLoaded = LoadOBJ(modelPath, *pMeshData);
+	else if (extensionName == ".gltf" || extensionName == ".glb")
+		bLoaded = LoadGLTF(modelPath, *pMeshData);
+	else
+		Log::Error(std::format("Unsupport model type {}", modelPath.string()));
+
+	if (!bLoaded)
+	{
+		SetModelLoadProgress("Failed", 1.f);
+		return nullptr;
+	}
+
+	if (m_bGenerateLOD)
+	{
+		SetModelLoadProgress("Generate LOD", 0.4f);
+		GenerateMeshLODs(*pMeshData);
+	}
+
+	if (m_bOptimizeMesh)
+	{
+		SetModelLoadProgress("Optimize", 0.6f);
+		OptimizeMesh(*pMeshData);
+	}
+
+	SetModelLoadProgress("Encode", 0.85f);
+	EncodeVertexBuffer(*pMeshData);
+	PackIndexBuffer(*pMeshData);
+
+	SetModelLoadProgress("Write cache", 0.9f);
+	if (m_bUseMeshCache && !MeshCache::Write(modelPath, pMeshData->vertexFormat, pMeshData->GetVertexStride(), GetMeshCacheFlags(),
+		pMeshData->GetVertexData(), pMeshData->GetVertexCount(), pMeshData->quantization, pMeshData->vecPackedIndices, pMeshData->vecSubMeshes))
+		Log::Warn(std::format("Write mesh cache for {} failed", modelPath.string()));
+
+	SetModelLoadProgress("Done", 1.f);
+	return pMeshData;
+}
+
+void VulkanRenderer::PollModelLoad()
+{
+	if (IsModelLoading() && m_ModelLoadFuture.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+	{
+		std::unique_ptr<MeshData> pMeshData = m_ModelLoadFuture.get();
+		if (!pMeshData || pMeshData->GetVertexCount() == 0)
+		{
+			Log::Warn(std::format("Async load of {} produced no vertices, keep current model", m_LoadingModelPath.string()));
+			return;
+		}
+		m_pPendingMeshData = std::move(pMeshData);
+		m_bPendingMeshDataRefused = false;
+	}
+	if (!m_pPendingMeshData)
+		return;
+	const MeshData* pMeshData = m_pPendingMeshData.get();
+
+	//旧模型的区间要等in flight的帧执行完才归还，新模型只能放入当前的空闲区间，不足时需要扩容，扩容超出DeviceLocal堆的预算时放弃替换
+	VkDeviceSize uiRequiredSize = static_cast<VkDeviceSize>(pMeshData->GetVertexStride()) * pMeshData->GetVertexCount() + pMeshData->GetIndexDataSize();
+	VkDeviceSize uiAvailableSize = (m_GeometryPool.GetVertexCapacity() - m_GeometryPool.GetVertexUsedSize())
+		+ (m_GeometryPool.GetIndexCapacity() - m_GeometryPool.GetIndexUsedSize());
+	//几何池可能位于DEVICE_LOCAL | HOST_VISIBLE的类型中，按其实际的内存类型检查
+	UINT uiGeometryTypeIndex = m_VertexBufferAllocation.uiMemoryTypeIndex;
+	//超出时保留加载结果，之后每帧重试：旧模型的区间归还、其他资源释放或预算每秒更新后即可放入
+	if (uiRequiredSize > uiAvailableSize && !m_MemoryAllocator.IsWithinBudget(uiGeometryTypeIndex, uiRequiredSize - uiAvailableSize))
+	{
+		if (!m_bPendingMeshDataRefused)
+		{
+			Log::Warn(std::format("Model {} needs {:.1f} MB of device local memory and exceeds the memory budget, keep current model until usage drops",
+				m_LoadingModelPath.string(), uiRequiredSize / (1024.0 * 1024.0)));
+			LogMemoryStats();
+		}
+		m_bPendingMeshDataRefused = true;
+		return;
+	}
+
+	auto swapTimestamp = std::chrono::high_resolution_clock::now();
+
+	//在帧边界替换：旧模型的区间可能仍被in flight的帧读取，不等待GPU，放入待回收列表，每帧都经过一次fence等待之后再归还
+	//新模型的上传异步执行，之后提交的帧在同一队列上（或经由所有权转移的semaphore）排在其后
+	RetireMeshGeometry();
+
+	m_pMeshData = std::move(m_pPendingMeshData);
+	m_bPendingMeshDataRefused = false;
+	CreateMeshGeometry();
+	SubmitUploadBatch();
+
+	auto endTimestamp = std::chrono::high_resolution_clock::now();
+	Log::Info(std::format("Swap in model {} : load {:.2f} ms, upload {:.2f} ms",
+		m_LoadingModelPath.string(),
+		std::chrono::duration<double, std::milli>(swapTimestamp - m_ModelLoadStartTime).count(),
+		std::chrono::duration<double, std::milli>(endTimestamp - swapTimestamp).count()));
+}
+
+void VulkanRenderer::GenerateMeshLODs(MeshData& meshData)
+{
+	auto startTimestamp = std::chrono::high_resolution_clock::now();
+
+	//每级目标为上一级三角形数的一半，单级误差不超过包围球半径的LOD_MAX_RELATIVE_ERROR
+	//简化幅度不足LOD_MIN_REDUCTION或三角形过少时停止，避免生成几乎相同的层级
+	constexpr float LOD_REDUCTION = 0.5f;
+	constexpr float LOD_MIN_REDUCTION = 0.15f;
+	constexpr float LOD_MAX_RELATIVE_ERROR = 0.05f;
+	constexpr size_t LOD_MIN_TRIANGLE_COUNT = 64;
+
+	std::array<size_t, SubMesh::MAX_LOD_COUNT + 1> aryTriangleCounts{};
+
+	//按submesh重新排列索引，使每个submesh的LOD0与各级LOD连续存放
+	std::vector<UINT> vecIndices;
+	vecIndices.reserve(meshData.vecIndices.size() * 2);
+	std::vector<UINT> vecLODIndices;
+
+	for (auto& subMesh : meshData.vecSubMeshes)
+	{
+		const Vertex3D* pVertices = meshData.vecVertices.data() + subMesh.uiVertexOffset;
+
+		//包围盒中心到最远顶点的距离作为包围球
+		glm::vec3 minPos = (subMesh.uiVertexCount > 0) ? pVertices[0].pos : glm::vec3(0.f);
+		glm::vec3 maxPos = minPos;
+		for (UINT i = 0; i < subMesh.uiVertexCount; ++i)
+		{
+			minPos = glm::min(minPos, pVertices[i].pos);
+			maxPos = glm::max(maxPos, pVertices[i].pos);
+		}
+		subMesh.boundCenter = (minPos + maxPos) * 0.5f;
+		subMesh.fBoundRadius = 0.f;
+		for (UINT i = 0; i < subMesh.uiVertexCount; ++i)
+			subMesh.fBoundRadius = std::max(subMesh.fBoundRadius, glm::length(pVertices[i].pos - subMesh.boundCenter));
+
+		const UINT* pSrcIndices = meshData.vecIndices.data() + subMesh.uiFirstIndex;
+		subMesh.uiFirstIndex = static_cast<UINT>(vecIndices.size());
+		vecIndices.insert(vecIndices.end(), pSrcIndices, pSrcIndices + subMesh.uiIndexCount);
+		subMesh.uiLODCount = 0;
+		aryTriangleCounts[0] += subMesh.uiIndexCount / 3;
+
+		if (!MeshOptimizer::IsIndexRangeValid(pSrcIndices, subMesh.uiIndexCount, subMesh.uiVertexCount))
+			continue;
+
+		//每级从上一级继续简化，误差逐级累加作为相对LOD0误差的上界
+		SubMeshLOD prevLOD = subMesh.GetLOD(0);
+		while (subMesh.uiLODCount < SubMesh::MAX_LOD_COUNT)
+		{
+			size_t uiTargetIndexCount = static_cast<size_t>(prevLOD.uiIndexCount / 3 * LOD_REDUCTION) * 3;
+			if (uiTargetIndexCount < LOD_MIN_TRIANGLE_COUNT * 3)
+				break;
+
+			vecLODIndices.resize(prevLOD.uiIndexCount);
+			float fError = 0.f;
+			size_t uiLODIndexCount = MeshSimplifier::Simplify(vecLODIndices.data(), vecIndices.data() + prevLOD.uiFirstIndex, prevLOD.uiIndexCount,
+				pVertices, subMesh.uiVertexCount, uiTargetIndexCount, subMesh.fBoundRadius * LOD_MAX_RELATIVE_ERROR, &fError);
+			if (uiLODIndexCount > prevLOD.uiIndexCount * (1.f - LOD_MIN_REDUCTION))
+				break;
+
+			SubMeshLOD& lod = subMesh.aryLODs[subMesh.uiLODCount++];
+			lod.uiFirstIndex = static_cast<UINT>(vecIndices.size());
+			lod.uiIndexCount = static_cast<UINT>(uiLODIndexCount);
+			lod.uiIndexByteOffset = 0;
+			lod.fError = prevLOD.fError + fError;
+			vecIndices.insert(vecIndices.end(), vecLODIndices.begin(), vecLODIndices.begin() + uiLODIndexCount);
+
+			aryTriangleCounts[subMesh.uiLODCount] += uiLODIndexCount / 3;
+			prevLOD = lod;
+		}
+	}
+	meshData.vecIndices.swap(vecIndices);
+
+	auto endTimestamp = std::chrono::high_resolution_clock::now();
+
+	std::string strTriangleCounts;
+	for (size_t i = 0; i < aryTriangleCounts.size() && (i == 0 || aryTriangleCounts[i] > 0); ++i)
+		strTriangleCounts += std::format("{}{}", (i == 0) ? "" : " / ", aryTriangleCounts[i]);
+	Log::Info(std::format("Generate mesh LOD : triangles {}, {:.2f} ms", strTriangleCounts,
+		std::chrono::duration<double, std::milli>(endTimestamp - startTimestamp).count()));
+}
+
+void VulkanRenderer::OptimizeMesh(MeshData& meshData)
+{
+	auto startTimestamp = std::chrono::high_resolution_clock::now();
+
+	MeshOptimizer::VertexCacheStats statsBefore;
+	MeshOptimizer::VertexCacheStats statsAfter;
+
+	//各submesh的顶点经fetch重排后可能减少（去掉未引用的顶点），重新紧凑排列
+	std::vector<Vertex3D> vecOptimizedVertices;
+	vecOptimizedVertices.reserve(meshData.vecVertices.size());
+
+	std::vector<UINT> vecClusters;
+	for (auto& subMesh : meshData.vecSubMeshes)
+	{
+		UINT* pIndices = meshData.vecIndices.data() + subMesh.uiFirstIndex;
+		Vertex3D* pVertices = meshData.vecVertices.data() + subMesh.uiVertexOffset;
+		UINT uiVertexCount = subMesh.uiVertexCount;
+		UINT uiTotalIndexCount = subMesh.GetTotalIndexCount();
+
+		if (MeshOptimizer::IsIndexRangeValid(pIndices, uiTotalIndexCount, uiVertexCount))
+		{
+			statsBefore += MeshOptimizer::AnalyzeVertexCache(pIndices, subMesh.uiIndexCount, uiVertexCount);
+
+			//每级LOD单独做三角形重排，顶点按包含全部LOD的整个区间重排，各级LOD的顶点都是LOD0的子集
+			for (UINT uiLevel = 0; uiLevel <= subMesh.uiLODCount; ++uiLevel)
+			{
+				SubMeshLOD lod = subMesh.GetLOD(uiLevel);
+				UINT* pLODIndices = meshData.vecIndices.data() + lod.uiFirstIndex;
+				MeshOptimizer::OptimizeVertexCache(pLODIndices, lod.uiIndexCount, uiVertexCount,
+					MeshOptimizer::DEFAULT_CACHE_SIZE, m_bOptimizeOverdraw ? &vecClusters : nullptr);
+				if (m_bOptimizeOverdraw)
+					MeshOptimizer::OptimizeOverdraw(pLODIndices, lod.uiIndexCount, pVertices, uiVertexCount, vecClusters);
+			}
+			uiVertexCount = static_cast<UINT>(MeshOptimizer::OptimizeVertexFetch(pVertices, uiVertexCount, pIndices, uiTotalIndexCount));
+
+			statsAfter += MeshOptimizer::AnalyzeVertexCache(pIndices, subMesh.uiIndexCount, uiVertexCount);
+		}
+		else
+			Log::Warn(std::format("Submesh at index {} references vertices out of range, skip optimization", subMesh.uiFirstIndex));
+
+		subMesh.uiVertexOffset = static_cast<UINT>(vecOptimizedVertices.size());
+		subMesh.uiVertexCount = uiVertexCount;
+		vecOptimizedVertices.insert(vecOptimizedVertices.end(), pVertices, pVertices + uiVertexCount);
+	}
+	meshData.vecVertices.swap(vecOptimizedVertices);
+
+	auto endTimestamp = std::chrono::high_resolution_clock::now();
+
+	Log::Info(std::format("Optimize mesh : ACMR {:.3f} -> {:.3f}, ATVR {:.3f} -> {:.3f}, overdraw {}, {:.2f} ms",
+		statsBefore.GetACMR(), statsAfter.GetACMR(), statsBefore.GetATVR(), statsAfter.GetATVR(),
+		m_bOptimizeOverdraw ? "on" : "off",
+		std::chrono::duration<double, std::milli>(endTimestamp - startTimestamp).count()));
+}
+
+UINT VulkanRenderer::GetMeshCacheFlags() const
+{
+	UINT uiFlags = 0;
+	if (m_bOptimizeMesh)
+		uiFlags |= MeshCache::FLAG_OPTIMIZED;
+	if (m_bOptimizeMesh && m_bOptimizeOverdraw)
+		uiFlags |= MeshCache::FLAG_OPTIMIZED_OVERDRAW;
+	if (m_bGenerateLOD)
+		uiFlags |= MeshCache::FLAG_LOD;
+	return uiFlags;
+}
+
+void VulkanRenderer::EncodeVertexBuffer(MeshData& meshData)
+{
+	meshData.vecPackedVertices.clear();
+	meshData.quantization = VertexQuantization();
+
+	if (meshData.vertexFormat != VertexFormat::Packed || meshData.vecVertices.empty())
+		return;
+
+	//以包围盒中心与半边长作为量化区间，使位置落在snorm16的[-1, 1]内
+	glm::vec3 minPos = meshData.vecVertices[0].pos;
+	glm::vec3 maxPos = meshData.vecVertices[0].pos;
+	for (const auto& vertex : meshData.vecVertices)
+	{
+		minPos = glm::min(minPos, vertex.pos);
+		maxPos = glm::max(maxPos, vertex.pos);
+	}
+	meshData.quantization.center = (minPos + maxPos) * 0.5f;
+	meshData.quantization.extent = glm::max((maxPos - minPos) * 0.5f, glm::vec3(1e-6f));
+
+	const glm::vec3 invExtent = 1.f / meshData.quantization.extent;
+
+	meshData.vecPackedVertices.resize(meshData.vecVertices.size());
+	for (size_t i = 0; i < meshData.vecVertices.size(); ++i)
+	{
+		const Vertex3D& vertex = meshData.vecVertices[i];
+		PackedVertex3D& packed = meshData.vecPackedVertices[i];
+
+		glm::vec3 normalizedPos = (vertex.pos - meshData.quantization.center) * invExtent;
+		packed.pos[0] = glm::packSnorm1x16(normalizedPos.x);
+		packed.pos[1] = glm::packSnorm1x16(normalizedPos.y);
+		packed.pos[2] = glm::packSnorm1x16(normalizedPos.z);
+		packed.pos[3] = 0;
+
+		packed.color[0] = glm::packUnorm1x8(vertex.color.r);
+		packed.color[1] = glm::packUnorm1x8(vertex.color.g);
+		packed.color[2] = glm::packUnorm1x8(vertex.color.b);
+		packed.color[3] = 255;
+
+		packed.texCoord[0] = glm::packHalf1x16(vertex.texCoord.x);
+		packed.texCoord[1] = glm::packHalf1x16(vertex.texCoord.y);
+
+		packed.normal[0] = glm::packSnorm1x8(vertex.normal.x);
+		packed.normal[1] = glm::packSnorm1x8(vertex.normal.y);
+		packed.normal[2] = glm::packSnorm1x8(vertex.normal.z);
+		packed.normal[3] = 0;
+	}
+
+	Log::Info(std::format("Encode packed vertex buffer : {} vertices, {} bytes, {} bytes as float",
+		meshData.vecPackedVertices.size(), meshData.vecPackedVertices.size() * sizeof(PackedVertex3D), meshData.vecVertices.size() * sizeof(Vertex3D)));
+}
+
+void VulkanRenderer::PackIndexBuffer(MeshData& meshData)
+{
+	meshData.vecPackedIndices.clear();
+
+	size_t uiIndexCount = 0;
+	size_t uiIndex16Count = 0;
+	for (auto& subMesh : meshData.vecSubMeshes)
+	{
+		//索引为区间内的局部值，最大值为uiVertexCount - 1；0xFFFF保留给primitive restart
+		subMesh.indexType = (subMesh.uiVertexCount <= 0xFFFF) ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+
+		//区间起点按4字节对齐，两种索引类型都可以从缓冲起点绑定后用firstIndex定位
+		//LOD0与各级LOD在vecIndices中连续，整体打包后LOD的字节偏移按相对LOD0的索引数换算
+		UINT uiTotalIndexCount = subMesh.GetTotalIndexCount();
+		size_t uiByteOffset = (meshData.vecPackedIndices.size() + sizeof(uint32_t) - 1) & ~(sizeof(uint32_t) - 1);
+		subMesh.uiIndexByteOffset = static_cast<UINT>(uiByteOffset);
+		for (UINT i = 0; i < subMesh.uiLODCount; ++i)
+			subMesh.aryLODs[i].uiIndexByteOffset = static_cast<UINT>(uiByteOffset + static_cast<size_t>(subMesh.aryLODs[i].uiFirstIndex - subMesh.uiFirstIndex) * subMesh.GetIndexSize());
+		meshData.vecPackedIndices.resize(uiByteOffset + static_cast<size_t>(uiTotalIndexCount) * subMesh.GetIndexSize());
+
+		const UINT* pSrc = meshData.vecIndices.data() + subMesh.uiFirstIndex;
+		UCHAR* pDst = meshData.vecPackedIndices.data() + uiByteOffset;
+		if (subMesh.indexType == VK_INDEX_TYPE_UINT16)
+		{
+			for (UINT i = 0; i < uiTotalIndexCount; ++i)
+			{
+				uint16_t uiIndex = static_cast<uint16_t>(pSrc[i]);
+				memcpy(pDst + i * sizeof(uint16_t), &uiIndex, sizeof(uint16_t));
+			}
+			uiIndex16Count += uiTotalIndexCount;
+		}
+		else
+			memcpy(pDst, pSrc, static_cast<size_t>(uiTotalIndexCount) * sizeof(uint32_t));
+
+		uiIndexCount += uiTotalIndexCount;
+	}
+
+	Log::Info(std::format("Pack index buffer : {} indices ({} as uint16), {} bytes, {} bytes as uint32",
+		uiIndexCount, uiIndex16Count, meshData.vecPackedIndices.size(), uiIndexCount * sizeof(uint32_t)));
+}
+
+void VulkanRenderer::FrameBufferResizeCallBack(GLFWwindow* pWindow, int nWidth, int nHeight)
+{
+	auto vulkanRenderer = reinterpret_cast<VulkanRenderer*>(glfwGetWindowUserPointer(pWindow));
+	if (vulkanRenderer)
+		vulkanRenderer->m_bFrameBufferResized = true;
+}
+
+void VulkanRenderer::InitWindow()
+{
+	glfwInit();
+	ASSERT(glfwVulkanSupported(), "GLFW version not support vulkan");
+
+	glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+	glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
+
+	m_pWindow = glfwCreateWindow(m_uiWindowWidth, m_uiWindowHeight, m_strWindowTitle.c_str(), nullptr, nullptr);
+	glfwMakeContextCurrent(m_pWindow);
+
+	glfwSetWindowUserPointer(m_pWindow, this);
+	glfwSetFramebufferSizeCallback(m_pWindow, FrameBufferResizeCallBack);
+}
+
+void VulkanRenderer::QueryGLFWExtensions()
+{
+	const char** ppGLFWEntensions = nullptr;
+	UINT uiCount = 0;
+	ppGLFWEntensions = glfwGetRequiredInstanceExtensions(&uiCount);
+
+	m_vecChosedExtensions = std::vector<const char*>(ppGLFWEntensions, ppGLFWEntensions + uiCount);
+}
+
+void VulkanRenderer::QueryValidationLayerExtensions()
+{
+	m_vecChosedExtensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
 }
 
 void VulkanRenderer::QueryAllValidExtensions()
@@ -501,7 +1518,7 @@ VKAPI_ATTR VkBool32 VKAPI_CALL VulkanRenderer::debugCallBack(VkDebugUtilsMessage
 
 VkResult VulkanRenderer::CreateDebugUtilsMessengerEXT(VkInstance instance, const VkDebugUtilsMessengerCreateInfoEXT* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkDebugUtilsMessengerEXT* pDebugMessenger)
 {
-	//ExtensionĺֱʹãҪȷװһ㣬ʹvkGetInstanceProcAddrжϸúǷ
+	//属于Extension的函数，不能直接使用，需要先封装一层，使用vkGetInstanceProcAddr判断该函数是否可用
 	auto func = (PFN_vkCreateDebugUtilsMessengerEXT)vkGetInstanceProcAddr(instance, "vkCreateDebugUtilsMessengerEXT");
 	if (func)
 		return func(instance, pCreateInfo, pAllocator, pDebugMessenger);
@@ -511,7 +1528,7 @@ VkResult VulkanRenderer::CreateDebugUtilsMessengerEXT(VkInstance instance, const
 
 void VulkanRenderer::DestoryDebugUtilsMessengerEXT(VkInstance instance, VkDebugUtilsMessengerEXT debugMessenger, const VkAllocationCallbacks* pAllocator)
 {
-	//ExtensionĺֱʹãҪȷװһ㣬ʹvkGetInstanceProcAddrжϸúǷ
+	//属于Extension的函数，不能直接使用，需要先封装一层，使用vkGetInstanceProcAddr判断该函数是否可用
 	auto func = (PFN_vkDestroyDebugUtilsMessengerEXT)vkGetInstanceProcAddr(instance, "vkDestroyDebugUtilsMessengerEXT");
 	if (func)
 		func(instance, debugMessenger, pAllocator);
@@ -551,7 +1568,7 @@ void VulkanRenderer::CreateInstance()
 	appInfo.applicationVersion = VK_MAKE_VERSION(1, 3, 0);
 	appInfo.pEngineName = nullptr;
 	appInfo.engineVersion = VK_MAKE_VERSION(1, 3, 0);
-	appInfo.apiVersion = VK_API_VERSION_1_0;
+	appInfo.apiVersion = VK_API_VERSION_1_1;	//查询显存预算的vkGetPhysicalDeviceMemoryProperties2自1.1起为核心功能
 
 	VkInstanceCreateInfo createInfo{};
 	createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -625,16 +1642,31 @@ void VulkanRenderer::QueryAllValidPhysicalDevice()
 			nIdx++;
 		}
 
+		//寻找不含图形功能的传输队列族，优先只有传输功能的（DMA引擎），其次是异步计算队列族
+		//上传按行分块copy图像，要求队列族的图像传输粒度为1
+		nIdx = 0;
+		for (const auto& queueFamily : info.vecQueueFamilies)
+		{
+			const auto& granularity = queueFamily.minImageTransferGranularity;
+			if (!(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) && (queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT)
+				&& granularity.width == 1 && granularity.height == 1 && granularity.depth == 1)
+			{
+				if (!info.transferFamilyIdx.has_value() || !(queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT))
+					info.transferFamilyIdx = nIdx;
+			}
+			nIdx++;
+		}
+
 		nIdx = 0;
 		VkBool32 bPresentSupport = false;
 		vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice, nIdx, m_WindowSurface, &bPresentSupport);
 		if (bPresentSupport)
 			info.presentFamilyIdx = nIdx;
 
-		//ȡӲֵ֧capabilityImage޵Ϣ
+		//获取硬件支持的capability，包含Image数量上下限等信息
 		vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physicalDevice, m_WindowSurface, &info.swapChainSupportInfo.capabilities);
 
-		//ȡӲֵ֧Surface Formatб
+		//获取硬件支持的Surface Format列表
 		UINT uiFormatCount = 0;
 		vkGetPhysicalDeviceSurfaceFormatsKHR(physicalDevice, m_WindowSurface, &uiFormatCount, nullptr);
 		if (uiFormatCount > 0)
@@ -643,7 +1675,7 @@ void VulkanRenderer::QueryAllValidPhysicalDevice()
 			vkGetPhysicalDeviceSurfaceFormatsKHR(physicalDevice, m_WindowSurface, &uiFormatCount, info.swapChainSupportInfo.vecSurfaceFormats.data());
 		}
 
-		//ȡӲֵ֧Present Modeб
+		//获取硬件支持的Present Mode列表
 		UINT uiPresentModeCount = 0;
 		vkGetPhysicalDeviceSurfacePresentModesKHR(physicalDevice, m_WindowSurface, &uiPresentModeCount, nullptr);
 		if (uiPresentModeCount > 0)
@@ -672,29 +1704,29 @@ int VulkanRenderer::RatePhysicalDevice(PhysicalDeviceInfo& deviceInfo)
 {
 	int nScore = 0;
 
-	//ǷǶԿ
+	//检查是否是独立显卡
 	if (deviceInfo.properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU)
 		nScore += 1000;
 
-	//ֵ֧ͼߴ,ԽԽ
+	//检查支持的最大图像尺寸,越大越好
 	nScore += deviceInfo.properties.limits.maxImageDimension2D;
 
-	//Ƿּ֧ɫ
+	//检查是否支持几何着色器
 	if (!deviceInfo.features.geometryShader)
 		return 0;
 
-	//Ƿ֧Graphic Family, Present FamilyIndexһ
+	//检查是否支持Graphic Family, Present Family且Index一致
 	if (!deviceInfo.IsGraphicAndPresentQueueFamilySame())
 		return 0;
 
-	//Ƿָ֧Extension(Swap Chain)
+	//检查是否支持指定的Extension(Swap Chain等)
 	bool bExtensionSupport = checkDeviceExtensionSupport(deviceInfo);
 	if (!bExtensionSupport)
 		return 0;
 
-	////Swap ChainǷҪ
+	////检查Swap Chain是否满足要求
 	//bool bSwapChainAdequate = false;
-	//if (bExtensionSupport) //ȷ֧SwapChain
+	//if (bExtensionSupport) //首先确认支持SwapChain
 	//{
 	//	SwapChainSupportDetails details = querySwapChainSupport(device);
 	//	bSwapChainAdequate = !details.vecSurfaceFormats.empty() && !details.vecPresentModes.empty();
@@ -702,7 +1734,7 @@ int VulkanRenderer::RatePhysicalDevice(PhysicalDeviceInfo& deviceInfo)
 	//if (!bSwapChainAdequate)
 	//	return false;
 
-	////Ƿָ֧Թ
+	////检查是否支持各向异性过滤
 	//if (!deviceFeatures.samplerAnisotropy)
 	//	return false;
 
@@ -754,20 +1786,40 @@ void VulkanRenderer::CreateLogicalDevice()
 	queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
 	queueCreateInfo.queueFamilyIndex = physicalDeviceInfo.graphicFamilyIdx.value();
 	queueCreateInfo.queueCount = 1;
-	queueCreateInfo.pQueuePriorities = &queuePriority; //QueueȼΧ[0.f, 1.f]CommandBufferִ˳
+	queueCreateInfo.pQueuePriorities = &queuePriority; //Queue的优先级，范围[0.f, 1.f]，控制CommandBuffer的执行顺序
 	vecQueueCreateInfo.push_back(queueCreateInfo);
 
+	//有独立的传输队列族时额外创建一个队列，上传在其上与渲染并行执行
+	if (physicalDeviceInfo.transferFamilyIdx.has_value())
+	{
+		queueCreateInfo.queueFamilyIndex = physicalDeviceInfo.transferFamilyIdx.value();
+		vecQueueCreateInfo.push_back(queueCreateInfo);
+	}
+
 	VkPhysicalDeviceFeatures deviceFeatures{};
-	//deviceFeatures.samplerAnisotropy = VK_TRUE; //øԹˣ
-	//deviceFeatures.sampleRateShading = VK_TRUE;	//Sample Rate ShaingMSAA
+	deviceFeatures.textureCompressionBC = physicalDeviceInfo.features.textureCompressionBC;	//烘焙的纹理为BC格式
+	//超过页缓存的纹理使用稀疏纹理
+	deviceFeatures.sparseBinding = physicalDeviceInfo.features.sparseBinding;
+	deviceFeatures.sparseResidencyImage2D = physicalDeviceInfo.features.sparseResidencyImage2D;
+	deviceFeatures.fragmentStoresAndAtomics = physicalDeviceInfo.features.fragmentStoresAndAtomics;	//稀疏纹理的片元着色器写回请求的页
+	//deviceFeatures.samplerAnisotropy = VK_TRUE; //启用各向异性过滤，用于纹理采样
+	//deviceFeatures.sampleRateShading = VK_TRUE;	//启用Sample Rate Shaing，用于MSAA抗锯齿
+
+	//VK_EXT_memory_budget为可选扩展，支持时额外启用，用于查询各堆的预算
+	std::vector<const char*> vecEnabledExtensions = m_vecDeviceExtensions;
+	bool bMemoryBudgetSupported = (physicalDeviceInfo.properties.apiVersion >= VK_API_VERSION_1_1)
+		&& std::any_of(physicalDeviceInfo.vecAvaliableDeviceExtensions.begin(), physicalDeviceInfo.vecAvaliableDeviceExtensions.end(),
+			[](const VkExtensionProperties& extension) { return strcmp(extension.extensionName, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0; });
+	if (bMemoryBudgetSupported)
+		vecEnabledExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
 
 	VkDeviceCreateInfo createInfo{};
 	createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
 	createInfo.queueCreateInfoCount = static_cast<UINT>(vecQueueCreateInfo.size());
 	createInfo.pQueueCreateInfos = vecQueueCreateInfo.data();
 	createInfo.pEnabledFeatures = &deviceFeatures;
-	createInfo.enabledExtensionCount = static_cast<UINT>(m_vecDeviceExtensions.size()); //ע⣡˴extension봴Instanceʱͬ
-	createInfo.ppEnabledExtensionNames = m_vecDeviceExtensions.data();
+	createInfo.enabledExtensionCount = static_cast<UINT>(vecEnabledExtensions.size()); //注意！此处的extension与创建Instance时不同
+	createInfo.ppEnabledExtensionNames = vecEnabledExtensions.data();
 	if (m_bEnableValidationLayer)
 	{
 		createInfo.enabledLayerCount = static_cast<UINT>(m_vecChosedValidationLayers.size());
@@ -783,13 +1835,27 @@ void VulkanRenderer::CreateLogicalDevice()
 
 	vkGetDeviceQueue(m_LogicalDevice, physicalDeviceInfo.graphicFamilyIdx.value(), 0, &m_GraphicQueue);
 	vkGetDeviceQueue(m_LogicalDevice, physicalDeviceInfo.presentFamilyIdx.value(), 0, &m_PresentQueue);
+
+	if (physicalDeviceInfo.transferFamilyIdx.has_value())
+	{
+		vkGetDeviceQueue(m_LogicalDevice, physicalDeviceInfo.transferFamilyIdx.value(), 0, &m_TransferQueue);
+		Log::Info(std::format("Use dedicated transfer queue family {} for uploads", physicalDeviceInfo.transferFamilyIdx.value()));
+	}
+	else
+	{
+		m_TransferQueue = m_GraphicQueue;
+	}
+
+	m_MemoryAllocator.Init(m_PhysicalDevice, m_LogicalDevice, physicalDeviceInfo.memoryProperties, physicalDeviceInfo.properties.limits, bMemoryBudgetSupported);
+	Log::Info(std::format("Memory budget : {}", bMemoryBudgetSupported ? "VK_EXT_memory_budget" : "estimated from heap size"));
+	ChooseGeometryUploadStrategy();
 }
 
 VkSurfaceFormatKHR VulkanRenderer::ChooseSwapChainSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& vecAvailableFormats)
 {
 	ASSERT(vecAvailableFormats.size() > 0, "No avaliable swap chain surface format");
 
-	//ҵ֧sRGBʽformatû򷵻صһ
+	//找到支持sRGB格式的format，如果没有则返回第一个
 	for (const auto& format : vecAvailableFormats)
 	{
 		if (format.format == VK_FORMAT_B8G8R8A8_SRGB && format.colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR)
@@ -805,7 +1871,7 @@ VkSurfaceFormatKHR VulkanRenderer::ChooseUISwapChainSurfaceFormat(const std::vec
 {
 	ASSERT(vecAvailableFormats.size() > 0, "No avaliable UI swap chain surface format");
 
-	//ҵ֧UNORMʽformatû򷵻صһ
+	//找到支持UNORM格式的format，如果没有则返回第一个
 	for (const auto& format : vecAvailableFormats)
 	{
 		if (format.format == VK_FORMAT_B8G8R8A8_UNORM && format.colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR)
@@ -821,7 +1887,7 @@ VkPresentModeKHR VulkanRenderer::ChooseSwapChainPresentMode(const std::vector<Vk
 {
 	ASSERT(vecAvailableModes.size() > 0, "No avaliable swap chain present mode");
 
-	//ѡMAILBOXFIFO
+	//优先选择MAILBOX，其次FIFO
 	for (const auto& mode : vecAvailableModes)
 	{
 		if (mode == VK_PRESENT_MODE_MAILBOX_KHR)
@@ -883,21 +1949,21 @@ void VulkanRenderer::CreateSwapChain()
 	createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
 	createInfo.presentMode = m_SwapChainPresentMode;
 
-	//ѡԿʱȷGraphicFamilyPresentFamilyһ
+	//挑选显卡时已确保GraphicFamily与PresentFamily一致
 	createInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
 	createInfo.queueFamilyIndexCount = 0;
 	createInfo.pQueueFamilyIndices = nullptr;
 
-	//νTransform
-	createInfo.preTransform = physicalDeviceInfo.swapChainSupportInfo.capabilities.currentTransform; //κTransform
+	//设置如何进行Transform
+	createInfo.preTransform = physicalDeviceInfo.swapChainSupportInfo.capabilities.currentTransform; //不做任何Transform
 
-	//ǷAlphaͨ
-	createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR; //Alphaͨ
+	//设置是否启用Alpha通道
+	createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR; //不启用Alpha通道
 
-	//Ƿ޳
+	//设置是否启用隐藏面剔除
 	createInfo.clipped = VK_TRUE;
 
-	//oldSwapChainwindow resizeʱ
+	//oldSwapChain用于window resize时
 	createInfo.oldSwapchain = VK_NULL_HANDLE;
 
 	VULKAN_ASSERT(vkCreateSwapchainKHR(m_LogicalDevice, &createInfo, nullptr, &m_SwapChain), "Create swap chain failed");
@@ -950,7 +2016,8 @@ void VulkanRenderer::CreateSwapChainFrameBuffers()
 		VK_IMAGE_TILING_OPTIMAL, 
 		VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, 
 		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-		m_DepthImage, m_DepthImageMemory);
+		MemoryCategory::Depth,
+		m_DepthImage, m_DepthImageAllocation);
 
 	m_DepthImageView = CreateImageView(m_DepthImage, m_DepthFormat, VK_IMAGE_ASPECT_DEPTH_BIT, 1);
 
@@ -962,7 +2029,7 @@ void VulkanRenderer::CreateSwapChainFrameBuffers()
 	for (size_t i = 0; i < m_vecSwapChainImageViews.size(); ++i)
 	{
 		std::vector<VkImageView> vecImageViewAttachments = {
-			m_vecSwapChainImageViews[i], //Ǳdepthǵһ
+			m_vecSwapChainImageViews[i], //潜规则：depth不能是第一个
 			m_DepthImageView,
 		};
 
@@ -981,7 +2048,7 @@ void VulkanRenderer::CreateSwapChainFrameBuffers()
 
 VkFormat VulkanRenderer::ChooseDepthFormat(bool bCheckSamplingSupport)
 {
-	//ָʽStencil Component
+	//后两种格式包含Stencil Component
 	std::vector<VkFormat> vecFormats = {
 		VK_FORMAT_D32_SFLOAT_S8_UINT,
 		VK_FORMAT_D32_SFLOAT,
@@ -1015,30 +2082,30 @@ void VulkanRenderer::CreateRenderPass()
 {
 	std::array<VkAttachmentDescription, 2> attachmentDescriptions = {};
 
-	//Color Attachment Description, Reference
+	//设置Color Attachment Description, Reference
 	attachmentDescriptions[0].format = m_SwapChainFormat;
-	attachmentDescriptions[0].samples = VK_SAMPLE_COUNT_1_BIT; //ʹöز
-	attachmentDescriptions[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR; //RenderPassʼǰ
-	attachmentDescriptions[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE; //RenderPasspresent
+	attachmentDescriptions[0].samples = VK_SAMPLE_COUNT_1_BIT; //不使用多重采样
+	attachmentDescriptions[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR; //RenderPass开始前清除
+	attachmentDescriptions[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE; //RenderPass结束后保留其内容用来present
 	attachmentDescriptions[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 	attachmentDescriptions[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 	attachmentDescriptions[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	//attachmentDescriptions[0].finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR; //presentĲ
-	attachmentDescriptions[0].finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL; //UIrenderpasspresent
+	//attachmentDescriptions[0].finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR; //适用于present的布局
+	attachmentDescriptions[0].finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL; //让UI的renderpass负责present
 
 	VkAttachmentReference colorAttachmentRef{};
 	colorAttachmentRef.attachment = 0;
 	colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
-	//Depth Attachment Description, Reference
+	//设置Depth Attachment Description, Reference
 	attachmentDescriptions[1].format = ChooseDepthFormat(false);
-	attachmentDescriptions[1].samples = VK_SAMPLE_COUNT_1_BIT; //ʹöز
-	attachmentDescriptions[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR; //RenderPassʼǰ
-	attachmentDescriptions[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE; //RenderPassҪ
+	attachmentDescriptions[1].samples = VK_SAMPLE_COUNT_1_BIT; //不使用多重采样
+	attachmentDescriptions[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR; //RenderPass开始前清除
+	attachmentDescriptions[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE; //RenderPass结束后不再需要
 	attachmentDescriptions[1].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 	attachmentDescriptions[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 	attachmentDescriptions[1].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	attachmentDescriptions[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL; //depth stencilĲ
+	attachmentDescriptions[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL; //适用于depth stencil的布局
 
 	VkAttachmentReference depthAttachmentRef{};
 	depthAttachmentRef.attachment = 1;
@@ -1090,6 +2157,36 @@ void VulkanRenderer::CreateTransferCommandPool()
 	commandPoolCreateInfo.queueFamilyIndex = physicalDeviceInfo.graphicFamilyIdx.value();
 
 	VULKAN_ASSERT(vkCreateCommandPool(m_LogicalDevice, &commandPoolCreateInfo, nullptr, &m_TransferCommandPool), "Create transfer command pool failed");
+
+	commandPoolCreateInfo.queueFamilyIndex = physicalDeviceInfo.transferFamilyIdx.value_or(physicalDeviceInfo.graphicFamilyIdx.value());
+	VULKAN_ASSERT(vkCreateCommandPool(m_LogicalDevice, &commandPoolCreateInfo, nullptr, &m_UploadCommandPool), "Create upload command pool failed");
+}
+
+void VulkanRenderer::CreateStagingBufferRing()
+{
+	//环的大小只影响上传分块与等待的频率，超出HOST_VISIBLE堆的预算时逐次减半
+	VkDeviceSize uiRingSize = StagingBufferRing::DEFAULT_SIZE;
+	CreateBuffer(uiRingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, m_StagingBuffer);
+	VkMemoryRequirements memoryRequirements;
+	vkGetBufferMemoryRequirements(m_LogicalDevice, m_StagingBuffer, &memoryRequirements);
+	UINT uiMemoryTypeIndex = FindSuitableMemoryTypeIndex(memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	while (uiRingSize > StagingBufferRing::MIN_SIZE && !m_MemoryAllocator.IsWithinBudget(uiMemoryTypeIndex, uiRingSize))
+		uiRingSize /= 2;
+	if (uiRingSize != StagingBufferRing::DEFAULT_SIZE)
+	{
+		Log::Warn(std::format("Staging ring shrinks to {} MB to stay within the host visible memory budget", uiRingSize >> 20));
+		vkDestroyBuffer(m_LogicalDevice, m_StagingBuffer, nullptr);
+		CreateBuffer(uiRingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, m_StagingBuffer);
+	}
+	AllocateBufferMemory(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 0, MemoryCategory::Staging,
+		m_StagingBuffer, m_StagingBufferAllocation);
+	vkBindBufferMemory(m_LogicalDevice, m_StagingBuffer, m_StagingBufferAllocation.memory, m_StagingBufferAllocation.offset);
+
+	const auto& physicalDeviceInfo = m_mapPhysicalDeviceInfo.at(m_PhysicalDevice);
+	m_StagingBufferRing.Init(m_LogicalDevice,
+		m_TransferQueue, m_UploadCommandPool, physicalDeviceInfo.transferFamilyIdx.value_or(physicalDeviceInfo.graphicFamilyIdx.value()),
+		m_GraphicQueue, m_TransferCommandPool, physicalDeviceInfo.graphicFamilyIdx.value(),
+		m_StagingBuffer, m_StagingBufferAllocation.pMappedData, uiRingSize);
 }
 
 VkCommandBuffer VulkanRenderer::BeginSingleTimeCommand()
@@ -1105,7 +2202,7 @@ VkCommandBuffer VulkanRenderer::BeginSingleTimeCommand()
 
 	VkCommandBufferBeginInfo beginInfo{};
 	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT; //ֻύһΣԸŻ
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT; //告诉驱动只提交一次，以更好优化
 
 	vkBeginCommandBuffer(singleTimeCommandBuffer, &beginInfo);
 
@@ -1121,9 +2218,9 @@ void VulkanRenderer::EndSingleTimeCommand(VkCommandBuffer commandBuffer)
 	submitInfo.commandBufferCount = 1;
 	submitInfo.pCommandBuffers = &commandBuffer;
 
-	//ϸ˵ҪһtransferQueueһgraphicQueuepresentQueuetransferܣPick PhysicalDeviceȷһ£
+	//单次命令仍在图形队列上执行（如depth的layout转换），大批量上传走m_TransferQueue上的暂存环
 	vkQueueSubmit(m_GraphicQueue, 1, &submitInfo, VK_NULL_HANDLE);
-	vkQueueWaitIdle(m_GraphicQueue); //ҲʹFence + vkWaitForFenceͬsubmit
+	vkQueueWaitIdle(m_GraphicQueue); //这里也可以使用Fence + vkWaitForFence，可以同步多个submit操作
 
 	vkFreeCommandBuffers(m_LogicalDevice, m_TransferCommandPool, 1, &commandBuffer);
 }
@@ -1131,15 +2228,15 @@ void VulkanRenderer::EndSingleTimeCommand(VkCommandBuffer commandBuffer)
 std::vector<char> VulkanRenderer::ReadShaderFile(const std::filesystem::path& filepath)
 {
 	ASSERT(std::filesystem::exists(filepath), std::format("Shader file path {} not exist", filepath.string()));
-	//ļĩβͳƳ
+	//光标置于文件末尾，方便统计长度
 	std::ifstream file(filepath, std::ios::ate | std::ios::binary);
 	ASSERT(file.is_open(), std::format("Open shader file {} failed", filepath.string()));
 
-	//tellgȡǰļдλ
+	//tellg获取当前文件读写位置
 	size_t fileSize = static_cast<size_t>(file.tellg());
 	std::vector<char> vecBuffer(fileSize);
 
-	//ָصļͷ
+	//指针回到文件开头
 	file.seekg(0);
 	file.read(vecBuffer.data(), fileSize);
 
@@ -1168,166 +2265,279 @@ void VulkanRenderer::CreateShader()
 
 	for (const auto& spvPath : m_mapShaderPath)
 	{
-		auto shaderModule = CreateShaderModule(ReadShaderFile(spvPath.second));
+		bool bVirtualTextureFrag = m_bVirtualTexture && spvPath.first == VK_SHADER_STAGE_FRAGMENT_BIT;
+		auto shaderModule = CreateShaderModule(ReadShaderFile(bVirtualTextureFrag ? m_VirtualTextureFragShaderPath : spvPath.second));
 
 		m_mapShaderModule[spvPath.first] = shaderModule;
 	}
 }
 
-UINT VulkanRenderer::FindSuitableMemoryTypeIndex(UINT typeFilter, VkMemoryPropertyFlags properties)
+UINT VulkanRenderer::FindSuitableMemoryTypeIndex(UINT typeFilter, VkMemoryPropertyFlags requiredFlags, VkMemoryPropertyFlags preferredFlags)
+{
+	UINT uiIndex = TryFindSuitableMemoryTypeIndex(typeFilter, requiredFlags, preferredFlags);
+	ASSERT(uiIndex != UINT32_MAX, "Find no suitable memory type");
+	return uiIndex;
+}
+
+UINT VulkanRenderer::TryFindSuitableMemoryTypeIndex(UINT typeFilter, VkMemoryPropertyFlags requiredFlags, VkMemoryPropertyFlags preferredFlags)
+{
+	const auto& memoryProperties = m_mapPhysicalDeviceInfo.at(m_PhysicalDevice).memoryProperties;
+
+	//满足requiredFlags的类型中，代价为缺少的preferredFlags位数加上多出的其他位数，取代价最小的
+	//多出的位也计入代价，避免如Staging Buffer占用有限的DEVICE_LOCAL | HOST_VISIBLE内存
+	UINT uiBestIndex = UINT32_MAX;
+	UINT uiBestCost = UINT32_MAX;
+	for (UINT i = 0; i < memoryProperties.memoryTypeCount; ++i)
+	{
+		if (!(typeFilter & (1 << i)))
+			continue;
+
+		VkMemoryPropertyFlags flags = memoryProperties.memoryTypes[i].propertyFlags;
+		if ((flags & requiredFlags) != requiredFlags)
+			continue;
+		//PROTECTED的内存只能用于protected资源
+		if ((flags & VK_MEMORY_PROPERTY_PROTECTED_BIT) && !(requiredFlags & VK_MEMORY_PROPERTY_PROTECTED_BIT))
+			continue;
+
+		UINT uiCost = std::popcount(static_cast<UINT>(preferredFlags & ~flags))
+			+ std::popcount(static_cast<UINT>(flags & ~(requiredFlags | preferredFlags)));
+		if (uiCost < uiBestCost)
+		{
+			uiBestIndex = i;
+			uiBestCost = uiCost;
+		}
+	}
+	return uiBestIndex;
+}
+
+void VulkanRenderer::ChooseGeometryUploadStrategy()
 {
+	//未开启Resizable BAR时，CPU可见的显存只有256MB的窗口，留给Uniform Buffer等少量数据
+	constexpr VkDeviceSize uiLegacyBarSize = 256ull << 20;
+
 	const auto& memoryProperties = m_mapPhysicalDeviceInfo.at(m_PhysicalDevice).memoryProperties;
+	const VkMemoryPropertyFlags rebarFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
 
+	m_bDirectGeometryWrite = false;
 	for (UINT i = 0; i < memoryProperties.memoryTypeCount; ++i)
 	{
-		if (typeFilter & (1 << i))
+		if ((memoryProperties.memoryTypes[i].propertyFlags & rebarFlags) != rebarFlags)
+			continue;
+
+		UINT uiHeapIndex = memoryProperties.memoryTypes[i].heapIndex;
+		VkDeviceSize uiHeapSize = memoryProperties.memoryHeaps[uiHeapIndex].size;
+		if (uiHeapSize > uiLegacyBarSize
+			&& m_MemoryAllocator.IsWithinBudget(i, GeometryPool::DEFAULT_VERTEX_CAPACITY + GeometryPool::DEFAULT_INDEX_CAPACITY))
 		{
-			if ((memoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
-				return i;
+			m_bDirectGeometryWrite = true;
+			Log::Info(std::format("Geometry upload : direct write to host visible device local memory (type {}, heap{} {} MB)",
+				i, uiHeapIndex, uiHeapSize >> 20));
+			return;
 		}
 	}
 
-	ASSERT(false, "Find no suitable memory type");
-	return 0;
+	Log::Info("Geometry upload : staging copy (no host visible device local heap larger than 256 MB)");
 }
 
-void VulkanRenderer::AllocateBufferMemory(VkMemoryPropertyFlags propertyFlags, VkBuffer& buffer, VkDeviceMemory& bufferMemory)
+void VulkanRenderer::AllocateBufferMemory(VkMemoryPropertyFlags requiredFlags, VkMemoryPropertyFlags preferredFlags, MemoryCategory category, VkBuffer& buffer, MemoryAllocation& bufferAllocation)
 {
-	//MemoryRequirementsĲ£
-	//memoryRequirements.size			ڴĴС
-	//memoryRequirements.alignment		ڴĶ뷽ʽBufferusageflags
-	//memoryRequirements.memoryTypeBits ʺϸBufferڴͣλֵ
+	//MemoryRequirements的参数如下：
+	//memoryRequirements.size			所需内存的大小
+	//memoryRequirements.alignment		所需内存的对齐方式，由Buffer的usage和flags参数决定
+	//memoryRequirements.memoryTypeBits 适合该Buffer的内存类型（位值）
 
 	VkMemoryRequirements memoryRequirements;
 	vkGetBufferMemoryRequirements(m_LogicalDevice, buffer, &memoryRequirements);
 
-	VkMemoryAllocateInfo memoryAllocInfo{};
-	memoryAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	memoryAllocInfo.allocationSize = memoryRequirements.size;
-	//Կвͬ͵ڴ棬ͬ͵ڴĲЧʸͬҪѰʺϵڴ
-	memoryAllocInfo.memoryTypeIndex = FindSuitableMemoryTypeIndex(memoryRequirements.memoryTypeBits, propertyFlags);
+	//显卡有不同类型的内存，不同类型的内存所允许的操作与效率各不相同，需要根据需求寻找最适合的内存类型
+	UINT uiMemoryTypeIndex = FindSuitableMemoryTypeIndex(memoryRequirements.memoryTypeBits, requiredFlags, preferredFlags);
 
-	VULKAN_ASSERT(vkAllocateMemory(m_LogicalDevice, &memoryAllocInfo, nullptr, &bufferMemory), "Allocate buffer memory failed");
+	//从分配器的大块显存中子分配，避免每个资源一次vkAllocateMemory（驱动对分配次数有maxMemoryAllocationCount限制）
+	bool bSuccess = m_MemoryAllocator.Allocate(memoryRequirements, uiMemoryTypeIndex, MemoryResourceType::Linear, category, bufferAllocation);
+	ASSERT(bSuccess, "Allocate buffer memory failed");
 }
 
-void VulkanRenderer::CreateBufferAndBindMemory(VkDeviceSize deviceSize, VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags propertyFlags, VkBuffer& buffer, VkDeviceMemory& bufferMemory)
+void VulkanRenderer::CreateBuffer(VkDeviceSize deviceSize, VkBufferUsageFlags usageFlags, VkBuffer& buffer)
 {
 	VkBufferCreateInfo BufferCreateInfo{};
 	BufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-	BufferCreateInfo.size = deviceSize;	//ҪBufferĴС
-	BufferCreateInfo.usage = usageFlags;	//ʹĿģVertexBufferIndexBuffer
-	BufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE; //BufferԱQueueFamilyѡռģʽ
-	BufferCreateInfo.flags = 0;	//ûڴϡ̶ȣ0ΪĬֵ
+	BufferCreateInfo.size = deviceSize;	//要创建的Buffer的大小
+	BufferCreateInfo.usage = usageFlags;	//使用目的，比如用作VertexBuffer或IndexBuffer或其他
+	BufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE; //Buffer可以被多个QueueFamily共享，这里选择独占模式
+	BufferCreateInfo.flags = 0;	//用来配置缓存的内存稀疏程度，0为默认值
 
 	VULKAN_ASSERT(vkCreateBuffer(m_LogicalDevice, &BufferCreateInfo, nullptr, &buffer), "Create buffer failed");
+}
 
-	AllocateBufferMemory(propertyFlags, buffer, bufferMemory);
+void VulkanRenderer::CreateBufferAndBindMemory(VkDeviceSize deviceSize, VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags requiredFlags, VkMemoryPropertyFlags preferredFlags, MemoryCategory category, VkBuffer& buffer, MemoryAllocation& bufferAllocation)
+{
+	CreateBuffer(deviceSize, usageFlags, buffer);
+
+	AllocateBufferMemory(requiredFlags, preferredFlags, category, buffer, bufferAllocation);
 
-	vkBindBufferMemory(m_LogicalDevice, buffer, bufferMemory, 0);
+	vkBindBufferMemory(m_LogicalDevice, buffer, bufferAllocation.memory, bufferAllocation.offset);
 }
 
 void VulkanRenderer::CreateUniformBuffers()
 {
-	VkDeviceSize uniformBufferSize = sizeof(UniformBufferObject);
-
 	m_vecUniformBuffers.resize(m_vecSwapChainImages.size());
-	m_vecUniformBufferMemories.resize(m_vecSwapChainImages.size());
+	m_vecUniformBufferAllocations.resize(m_vecSwapChainImages.size());
+	m_PerFrameConstantsWriter.Resize(m_vecSwapChainImages.size());
 
-	//ΪȾÿһ֡ͼ񴴽Uniform Buffer
+	//与动态Uniform Buffer相同，持久映射，优先放在DEVICE_LOCAL | HOST_VISIBLE的内存中
 	for (size_t i = 0; i < m_vecSwapChainImages.size(); ++i)
 	{
-		CreateBufferAndBindMemory(uniformBufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			m_vecUniformBuffers[i], m_vecUniformBufferMemories[i]);
+		CreateBufferAndBindMemory(sizeof(PerFrameConstants), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, MemoryCategory::Uniform,
+			m_vecUniformBuffers[i], m_vecUniformBufferAllocations[i]);
 	}
 }
 
-void VulkanRenderer::CreateDynamicUniformBuffers()
+void VulkanRenderer::DestroyUniformBuffers()
 {
-	auto physicalDeviceProperties = m_mapPhysicalDeviceInfo.at(m_PhysicalDevice).properties;
-	size_t minUboAlignment = physicalDeviceProperties.limits.minUniformBufferOffsetAlignment;
-	size_t dynamicAlignment = sizeof(glm::mat4) * 3; //model + view + proj
-	if (minUboAlignment > 0) {
-		dynamicAlignment = (dynamicAlignment + minUboAlignment - 1) & ~(minUboAlignment - 1);
+	for (size_t i = 0; i < m_vecUniformBuffers.size(); ++i)
+	{
+		vkDestroyBuffer(m_LogicalDevice, m_vecUniformBuffers[i], nullptr);
+		m_MemoryAllocator.Free(m_vecUniformBufferAllocations[i]);
 	}
+	m_vecUniformBuffers.clear();
+	m_vecUniformBufferAllocations.clear();
+}
 
-	size_t bufferSize = 9 * dynamicAlignment;
-
-	m_vecDynamicUniformBuffers.resize(m_vecSwapChainImages.size());
-	m_vecDynamicUniformBufferMemories.resize(m_vecSwapChainImages.size());
+void VulkanRenderer::CreateDynamicUniformBuffers(UINT uiObjectCount)
+{
+	//动态偏移需是minUniformBufferOffsetAlignment的整数倍，每个槽位按其对齐，槽位中只有每个物体自己的PerDrawConstants
+	const auto& limits = m_mapPhysicalDeviceInfo.at(m_PhysicalDevice).properties.limits;
+	VkDeviceSize uiMinUboAlignment = std::max<VkDeviceSize>(limits.minUniformBufferOffsetAlignment, 1);
+	m_uiDynamicUniformAlignment = (sizeof(PerDrawConstants) + uiMinUboAlignment - 1) / uiMinUboAlignment * uiMinUboAlignment;
+
+	m_vecDynamicUniformBuffers.resize(m_vecSwapChainImages.size(), VK_NULL_HANDLE);
+	m_vecDynamicUniformBufferAllocations.resize(m_vecSwapChainImages.size());
+	m_vecDynamicUniformCapacities.resize(m_vecSwapChainImages.size(), 0);
+	m_vecPerDrawConstantsWriters.resize(m_vecSwapChainImages.size());
+
+	//为并行渲染的每一帧图像创建独立的Uniform Buffer
+	for (UINT i = 0; i < static_cast<UINT>(m_vecSwapChainImages.size()); ++i)
+		CreateDynamicUniformBuffer(i, uiObjectCount);
+
+	UINT uiUniformTypeIndex = m_vecDynamicUniformBufferAllocations[0].uiMemoryTypeIndex;
+	Log::Info(std::format("Dynamic uniform buffers : {} objects x {} bytes per frame, memory type {} ({})", m_vecDynamicUniformCapacities[0], m_uiDynamicUniformAlignment,
+		uiUniformTypeIndex, GetMemoryHeapName(m_MemoryAllocator.GetHeapIndex(uiUniformTypeIndex))));
+}
 
-	auto propertyFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
-	auto usageFlags = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+void VulkanRenderer::CreateDynamicUniformBuffer(UINT uiFrameIdx, UINT uiObjectCount)
+{
+	m_vecDynamicUniformCapacities[uiFrameIdx] = std::max<UINT>(uiObjectCount, 1);
+	m_vecPerDrawConstantsWriters[uiFrameIdx].Resize(m_vecDynamicUniformCapacities[uiFrameIdx]);
+
+	//内存由分配器在创建时持久映射，每帧更新直接写入映射地址，不再vkMapMemory/vkUnmapMemory
+	//有DEVICE_LOCAL | HOST_VISIBLE的内存时优先使用，shader直接从显存读取；非COHERENT时由UpdateUniformBuffer负责Flush
+	CreateBufferAndBindMemory(m_uiDynamicUniformAlignment * m_vecDynamicUniformCapacities[uiFrameIdx], VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, MemoryCategory::Uniform,
+		m_vecDynamicUniformBuffers[uiFrameIdx], m_vecDynamicUniformBufferAllocations[uiFrameIdx]);
+}
 
-	for (size_t i = 0; i < m_vecSwapChainImages.size(); ++i)
+void VulkanRenderer::DestroyDynamicUniformBuffers()
+{
+	for (size_t i = 0; i < m_vecDynamicUniformBuffers.size(); ++i)
 	{
-		VkBufferCreateInfo BufferCreateInfo{};
-		BufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-		BufferCreateInfo.size = bufferSize;
-		BufferCreateInfo.usage = usageFlags;
-		BufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-		BufferCreateInfo.flags = 0;
+		vkDestroyBuffer(m_LogicalDevice, m_vecDynamicUniformBuffers[i], nullptr);
+		m_MemoryAllocator.Free(m_vecDynamicUniformBufferAllocations[i]);
+	}
+	m_vecDynamicUniformBuffers.clear();
+	m_vecDynamicUniformBufferAllocations.clear();
+	m_vecDynamicUniformCapacities.clear();
+	m_vecPerDrawConstantsWriters.clear();
+}
+
+void VulkanRenderer::ReserveDynamicUniformBuffer(UINT uiFrameIdx, UINT uiObjectCount)
+{
+	if (uiObjectCount <= m_vecDynamicUniformCapacities[uiFrameIdx])
+		return;
 
-		VULKAN_ASSERT(vkCreateBuffer(m_LogicalDevice, &BufferCreateInfo, nullptr, &m_vecDynamicUniformBuffers[i]), "Create dynamic uniform buffer failed");
+	//在该帧的fence等待之后调用，只有这一帧的缓冲需要重建，不必等待GPU空闲；其余各帧轮到自己时再扩容
+	UINT uiCapacity = std::max(uiObjectCount, m_vecDynamicUniformCapacities[uiFrameIdx] * 2);
+	vkDestroyBuffer(m_LogicalDevice, m_vecDynamicUniformBuffers[uiFrameIdx], nullptr);
+	m_MemoryAllocator.Free(m_vecDynamicUniformBufferAllocations[uiFrameIdx]);
+	CreateDynamicUniformBuffer(uiFrameIdx, uiCapacity);
+	WriteDynamicUniformBufferDescriptor(uiFrameIdx);
 
-		AllocateBufferMemory(propertyFlags, m_vecDynamicUniformBuffers[i], m_vecDynamicUniformBufferMemories[i]);
+	Log::Info(std::format("Grow dynamic uniform buffer of frame {} to {} objects", uiFrameIdx, uiCapacity));
+}
 
-		vkBindBufferMemory(m_LogicalDevice, m_vecDynamicUniformBuffers[i], m_vecDynamicUniformBufferMemories[i], 0);
-	}
+void VulkanRenderer::WriteDynamicUniformBufferDescriptor(UINT uiFrameIdx)
+{
+	//range为单个物体的大小，绘制时的动态偏移加在offset上
+	VkDescriptorBufferInfo bufferInfo{};
+	bufferInfo.buffer = m_vecDynamicUniformBuffers[uiFrameIdx];
+	bufferInfo.offset = 0;
+	bufferInfo.range = sizeof(PerDrawConstants);
+
+	VkWriteDescriptorSet uboWrite{};
+	uboWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	uboWrite.dstSet = m_vecDescriptorSets[uiFrameIdx];
+	uboWrite.dstBinding = 2;
+	uboWrite.dstArrayElement = 0;
+	uboWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+	uboWrite.descriptorCount = 1;
+	uboWrite.pBufferInfo = &bufferInfo;
+
+	vkUpdateDescriptorSets(m_LogicalDevice, 1, &uboWrite, 0, nullptr);
 }
 
 void VulkanRenderer::CreateTextureSampler()
 {
 	VkSamplerCreateInfo createInfo{};
 	createInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-	//ùǷʱĲnearestlinearcubic
+	//设置过采样与欠采样时的采样方法，可以是nearest，linear，cubic等
 	createInfo.magFilter = VK_FILTER_LINEAR;
 	createInfo.minFilter = VK_FILTER_LINEAR;
 
-	//߽ʱѰַģʽrepeatmirrorclamp to edgeclamp to border
+	//设置纹理采样超出边界时的寻址模式，可以是repeat，mirror，clamp to edge，clamp to border等
 	createInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
 	createInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
 	createInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
 
-	//ǷԹˣӲһ֧AnisotropyҪȷӲָ֧preperty
+	//设置是否开启各向异性过滤，你的硬件不一定支持Anisotropy，需要确认硬件支持该preperty
 	createInfo.anisotropyEnable = VK_FALSE;
 	auto& physicalDeviceProperties = m_mapPhysicalDeviceInfo.at(m_PhysicalDevice).properties;
 	createInfo.maxAnisotropy = physicalDeviceProperties.limits.maxSamplerAnisotropy;
 
-	//ѰַģʽΪclamp to borderʱɫ
+	//设置寻址模式为clamp to border时的填充颜色
 	createInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
 
-	//ΪtrueΪ[0, texWidth), [0, texHeight)
-	//ΪfalseΪͳ[0, 1), [0, 1)
+	//如果为true，则坐标为[0, texWidth), [0, texHeight)
+	//如果为false，则坐标为传统的[0, 1), [0, 1)
 	createInfo.unnormalizedCoordinates = VK_FALSE;
 
-	//ǷȽԱȽϽĲͨڰٷֱڽ˲Shadow Map PCS
+	//设置是否开启比较与对比较结果的操作，通常用于百分比邻近滤波（Shadow Map PCS）
 	createInfo.compareEnable = VK_FALSE;
 	createInfo.compareOp = VK_COMPARE_OP_ALWAYS;
 
-	//mipmapز
+	//设置mipmap相关参数
 	createInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
 	createInfo.mipLodBias = 0.f;
 	createInfo.minLod = 0.f;
-	createInfo.maxLod = 0.f;
+	//不限制上限，可用的级别由imageView决定，占位纹理替换为完整的mip链后无需重建采样器
+	createInfo.maxLod = VK_LOD_CLAMP_NONE;
 
 	VULKAN_ASSERT(vkCreateSampler(m_LogicalDevice, &createInfo, nullptr, &m_TextureSampler), "Create texture sampler failed");
 }
 
-void VulkanRenderer::AllocateImageMemory(VkMemoryPropertyFlags propertyFlags, VkImage& image, VkDeviceMemory& imageMemory)
+void VulkanRenderer::AllocateImageMemory(VkMemoryPropertyFlags propertyFlags, VkImageTiling tiling, MemoryCategory category, VkImage& image, MemoryAllocation& imageAllocation)
 {
 	VkMemoryRequirements memoryRequirements;
 	vkGetImageMemoryRequirements(m_LogicalDevice, image, &memoryRequirements);
 
-	VkMemoryAllocateInfo allocInfo{};
-	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocInfo.allocationSize = memoryRequirements.size;
-	allocInfo.memoryTypeIndex = FindSuitableMemoryTypeIndex(memoryRequirements.memoryTypeBits, propertyFlags);
+	UINT uiMemoryTypeIndex = FindSuitableMemoryTypeIndex(memoryRequirements.memoryTypeBits, propertyFlags);
 
-	VULKAN_ASSERT(vkAllocateMemory(m_LogicalDevice, &allocInfo, nullptr, &imageMemory), "Allocate image memory failed");
+	//OPTIMAL tiling的Image与Buffer分开存放，不必考虑bufferImageGranularity
+	MemoryResourceType resourceType = (tiling == VK_IMAGE_TILING_OPTIMAL) ? MemoryResourceType::Optimal : MemoryResourceType::Linear;
+	bool bSuccess = m_MemoryAllocator.Allocate(memoryRequirements, uiMemoryTypeIndex, resourceType, category, imageAllocation);
+	ASSERT(bSuccess, "Allocate image memory failed");
 }
 
-void VulkanRenderer::CreateImageAndBindMemory(uint32_t uiWidth, uint32_t uiHeight, uint32_t uiMipLevel, VkSampleCountFlagBits sampleCount, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags propertyFlags, VkImage& image, VkDeviceMemory& imageMemory)
+void VulkanRenderer::CreateImage(uint32_t uiWidth, uint32_t uiHeight, uint32_t uiMipLevel, VkSampleCountFlagBits sampleCount, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkImage& image)
 {
 	VkImageCreateInfo imageCreateInfo{};
 	imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -1346,10 +2556,35 @@ void VulkanRenderer::CreateImageAndBindMemory(uint32_t uiWidth, uint32_t uiHeigh
 	imageCreateInfo.flags = 0;
 
 	VULKAN_ASSERT(vkCreateImage(m_LogicalDevice, &imageCreateInfo, nullptr, &image), "Create image failed");
+}
+
+void VulkanRenderer::CreateImageAndBindMemory(uint32_t uiWidth, uint32_t uiHeight, uint32_t uiMipLevel, VkSampleCountFlagBits sampleCount, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags propertyFlags, MemoryCategory category, VkImage& image, MemoryAllocation& imageAllocation)
+{
+	CreateImage(uiWidth, uiHeight, uiMipLevel, sampleCount, format, tiling, usage, image);
+
+	AllocateImageMemory(propertyFlags, tiling, category, image, imageAllocation);
+
+	vkBindImageMemory(m_LogicalDevice, image, imageAllocation.memory, imageAllocation.offset);
+}
+
+bool VulkanRenderer::IsImageWithinBudget(VkImage image, VkMemoryPropertyFlags propertyFlags)
+{
+	//按驱动给出的实际大小（含对齐与压缩格式的填充）检查，而不是按像素数估算
+	VkMemoryRequirements memoryRequirements;
+	vkGetImageMemoryRequirements(m_LogicalDevice, image, &memoryRequirements);
+	UINT uiMemoryTypeIndex = FindSuitableMemoryTypeIndex(memoryRequirements.memoryTypeBits, propertyFlags);
+	return m_MemoryAllocator.IsWithinBudget(uiMemoryTypeIndex, memoryRequirements.size);
+}
 
-	AllocateImageMemory(propertyFlags, image, imageMemory);
+bool VulkanRenderer::CheckFormatSupportLinearBlit(VkFormat format)
+{
+	VkFormatProperties formatProperties;
+	vkGetPhysicalDeviceFormatProperties(m_PhysicalDevice, format, &formatProperties);
 
-	vkBindImageMemory(m_LogicalDevice, image, imageMemory, 0);
+	//生成mipmap时同一image既是blit的src又是dst，并使用线性过滤
+	const VkFormatFeatureFlags requiredFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT
+		| VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+	return (formatProperties.optimalTilingFeatures & requiredFeatures) == requiredFeatures;
 }
 
 bool VulkanRenderer::CheckFormatHasStencilComponent(VkFormat format)
@@ -1367,190 +2602,1397 @@ void VulkanRenderer::ChangeImageLayout(VkImage image, VkFormat format, uint32_t
 {
 	VkCommandBuffer singleTimeCommandBuffer = BeginSingleTimeCommand();
 
+	RecordChangeImageLayout(singleTimeCommandBuffer, image, format, uiMipLevel, oldLayout, newLayout);
+
+	EndSingleTimeCommand(singleTimeCommandBuffer);
+}
+
+void VulkanRenderer::RecordChangeImageLayout(VkCommandBuffer commandBuffer, VkImage image, VkFormat format, uint32_t uiMipLevel, VkImageLayout oldLayout, VkImageLayout newLayout)
+{
 	VkImageMemoryBarrier barrier{};
 	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-	//ͼ񲼾ֵת
+	//用于图像布局的转换
 	barrier.oldLayout = oldLayout;
 	barrier.newLayout = newLayout;
-	//ڴQueue FamilyȨʹʱΪIGNORED
+	//用于传递Queue Family的所有权，不使用时设为IGNORED
 	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
 	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-	//ָĿͼ÷Χ
+	//指定目标图像及作用范围
 	barrier.image = image;
 	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 	barrier.subresourceRange.baseMipLevel = 0;
 	barrier.subresourceRange.levelCount = uiMipLevel;
 	barrier.subresourceRange.baseArrayLayer = 0;
 	barrier.subresourceRange.layerCount = 1;
-	//ָbarrier֮ǰ뷢Դͣbarrier֮ȴԴ
-	//ҪoldLayoutnewLayout
+	//指定barrier之前必须发生的资源操作类型，和barrier之后必须等待的资源操作类型
+	//需要根据oldLayout和newLayout的类型来决定
 	barrier.srcAccessMask = 0;
 	barrier.dstAccessMask = 0;
 
-	if (newLayout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL)
+	if (newLayout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL)
+	{
+		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+		if (CheckFormatHasStencilComponent(format))
+		{
+			barrier.subresourceRange.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
+		}
+	}
+	else
+	{
+		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	}
+
+	VkPipelineStageFlags srcStage;
+	VkPipelineStageFlags dstStage;
+	if ((oldLayout == VK_IMAGE_LAYOUT_UNDEFINED) && (newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL))
+	{
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		srcStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT; //传输的写入操作不需要等待任何对象，因此指定一个最早出现的管线阶段
+		dstStage = VK_PIPELINE_STAGE_TRANSFER_BIT; //传输的写入操作必须在传输阶段进行（伪阶段，表示传输发生）
+	}
+	else if ((oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) && (newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL))
+	{
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		srcStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		dstStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+	}
+	else if ((oldLayout == VK_IMAGE_LAYOUT_UNDEFINED) && (newLayout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL))
+	{
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT
+			| VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		srcStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+		dstStage = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+	}
+	else
+	{
+		ASSERT(false, "Unsupport image layout change type");
+	}
+
+	vkCmdPipelineBarrier(commandBuffer,
+		srcStage,		//发生在barrier之前的管线阶段
+		dstStage,		//发生在barrier之后的管线阶段
+		0,				//若设置为VK_DEPENDENCY_BY_REGION_BIT，则允许按区域部分读取资源
+		0, nullptr,		//Memory Barrier及数量
+		0, nullptr,		//Buffer Memory Barrier及数量
+		1, &barrier);	//Image Memory Barrier及数量
+}
+
+void VulkanRenderer::TransferImageDataByStageBuffer(const void* pData, VkDeviceSize imageSize, VkImage& image, UINT uiWidth, UINT uiHeight, UINT uiMipLevel, UINT uiBlockDim)
+{
+	const UINT uiBlockRowCount = (uiHeight + uiBlockDim - 1) / uiBlockDim;
+	const VkDeviceSize uiRowPitch = imageSize / uiBlockRowCount;
+	TransferImageRowsByStageBuffer(image, uiWidth, uiHeight, uiRowPitch, uiMipLevel, uiBlockDim,
+		[pData, uiRowPitch](UINT uiFirstRow, UINT uiRowCount, UCHAR* pDst)
+		{
+			memcpy(pDst, static_cast<const UCHAR*>(pData) + uiRowPitch * uiFirstRow, static_cast<size_t>(uiRowPitch * uiRowCount));
+		});
+}
+
+void VulkanRenderer::TransferImageRowsByStageBuffer(VkImage& image, UINT uiWidth, UINT uiHeight, VkDeviceSize uiRowPitch, UINT uiMipLevel, UINT uiBlockDim,
+	const std::function<void(UINT uiFirstRow, UINT uiRowCount, UCHAR* pDst)>& WriteRows)
+{
+	//压缩格式的bufferOffset需是块大小（最大16字节）的整数倍
+	const VkDeviceSize uiCopyAlignment = std::max<VkDeviceSize>(16,
+		m_mapPhysicalDeviceInfo.at(m_PhysicalDevice).properties.limits.optimalBufferCopyOffsetAlignment);
+
+	//按行分块写入暂存环，超过环单次分配上限的图像分多次copy；压缩格式以一行块为单位
+	const UINT uiBlockRowCount = (uiHeight + uiBlockDim - 1) / uiBlockDim;
+	const UINT uiMaxRowCount = static_cast<UINT>(std::max<VkDeviceSize>(1, m_StagingBufferRing.GetMaxAllocationSize() / uiRowPitch));
+
+	UINT uiRowCount = 0;
+	for (UINT uiRow = 0; uiRow < uiBlockRowCount; uiRow += uiRowCount)
+	{
+		uiRowCount = std::min(uiMaxRowCount, uiBlockRowCount - uiRow);
+		VkDeviceSize uiChunkSize = uiRowPitch * uiRowCount;
+
+		VkDeviceSize uiStagingOffset = 0;
+		void* pStagingData = nullptr;
+		VkCommandBuffer commandBuffer = m_StagingBufferRing.Allocate(uiChunkSize, uiCopyAlignment, uiStagingOffset, pStagingData);
+		WriteRows(uiRow, uiRowCount, static_cast<UCHAR*>(pStagingData));
+
+		VkBufferImageCopy region{};
+		//指定要复制的数据在buffer中的偏移量
+		region.bufferOffset = uiStagingOffset;
+		//指定数据在memory中的存放方式，用于对齐
+		//若都为0，则数据在memory中会紧凑存放
+		region.bufferRowLength = 0;
+		region.bufferImageHeight = 0;
+		//指定数据被复制到image的哪一部分
+		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.imageSubresource.mipLevel = uiMipLevel;
+		region.imageSubresource.baseArrayLayer = 0;
+		region.imageSubresource.layerCount = 1;
+		//最后一行块可以超出图像的边缘，extent截止到图像边缘
+		UINT uiTexelRow = uiRow * uiBlockDim;
+		region.imageOffset = { 0, static_cast<int32_t>(uiTexelRow), 0 };
+		region.imageExtent = { uiWidth, std::min(uiRowCount * uiBlockDim, uiHeight - uiTexelRow), 1 };
+		vkCmdCopyBufferToImage(commandBuffer, m_StagingBufferRing.GetBuffer(), image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+	}
+}
+
+bool VulkanRenderer::OpenCookedTexture(const std::filesystem::path& texturePath, KTX2File& textureFile)
+{
+	if (!textureFile.Open(texturePath))
+		return false;
+
+	VkFormat format = textureFile.GetFormat();
+	VkFormatProperties formatProperties;
+	vkGetPhysicalDeviceFormatProperties(m_PhysicalDevice, format, &formatProperties);
+	if (!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT))
+	{
+		Log::Warn(std::format("Cooked texture {} uses format {} which the device cannot sample", texturePath.string(), static_cast<int>(format)));
+		textureFile.Close();
+		return false;
+	}
+	return true;
+}
+
+bool VulkanRenderer::CreateTextureImageFromKTX2(const KTX2File& textureFile, UINT uiFirstLevel, VkImage& image, MemoryAllocation& imageAllocation, VkImageView& imageView,
+	UINT uiUploadLevelCount)
+{
+	VkFormat format = textureFile.GetFormat();
+	UINT uiWidth = TextureMipmap::GetMipLevelSize(textureFile.GetWidth(), uiFirstLevel);
+	UINT uiHeight = TextureMipmap::GetMipLevelSize(textureFile.GetHeight(), uiFirstLevel);
+	UINT uiLevelCount = textureFile.GetLevelCount() - uiFirstLevel;
+	uiUploadLevelCount = std::min(uiUploadLevelCount, uiLevelCount);
+
+	//TRANSFER_SRC用于驻留级别变化时向新image拷贝仍驻留的各级
+	CreateImage(uiWidth, uiHeight, uiLevelCount,
+		VK_SAMPLE_COUNT_1_BIT,
+		format,
+		VK_IMAGE_TILING_OPTIMAL,
+		VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+		image);
+	if (!IsImageWithinBudget(image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT))
+	{
+		vkDestroyImage(m_LogicalDevice, image, nullptr);
+		image = VK_NULL_HANDLE;
+		return false;
+	}
+	AllocateImageMemory(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_IMAGE_TILING_OPTIMAL, MemoryCategory::Texture, image, imageAllocation);
+	vkBindImageMemory(m_LogicalDevice, image, imageAllocation.memory, imageAllocation.offset);
+
+	if (uiUploadLevelCount > 0)
+	{
+		RecordChangeImageLayout(m_StagingBufferRing.GetCommandBuffer(), image, format, uiUploadLevelCount,
+			VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+
+		//各级mip已在烘焙时生成并压缩，从映射的文件直接拷贝进暂存环
+		for (UINT i = 0; i < uiUploadLevelCount; ++i)
+		{
+			TransferImageDataByStageBuffer(textureFile.GetLevelData(uiFirstLevel + i), textureFile.GetLevelSize(uiFirstLevel + i), image,
+				TextureMipmap::GetMipLevelSize(uiWidth, i), TextureMipmap::GetMipLevelSize(uiHeight, i), i, textureFile.GetBlockDim());
+		}
+
+		VkImageSubresourceRange subresourceRange{};
+		subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		subresourceRange.baseMipLevel = 0;
+		subresourceRange.levelCount = uiUploadLevelCount;
+		subresourceRange.baseArrayLayer = 0;
+		subresourceRange.layerCount = 1;
+		m_StagingBufferRing.FinishImage(image, subresourceRange,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			VK_ACCESS_SHADER_READ_BIT,
+			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+	}
+
+	imageView = CreateImageView(image, format, VK_IMAGE_ASPECT_COLOR_BIT, uiLevelCount);
+	return true;
+}
+
+UINT VulkanRenderer::CreateStreamedTexture(const std::filesystem::path& texturePath)
+{
+	auto startTimestamp = std::chrono::high_resolution_clock::now();
+
+	auto pTexture = std::make_unique<StreamedTexture>();
+	if (!OpenCookedTexture(texturePath, pTexture->file))
+		return TextureManager::INVALID_HANDLE;
+
+	const KTX2File& textureFile = pTexture->file;
+	std::vector<VkDeviceSize> vecLevelSizes(textureFile.GetLevelCount());
+	for (UINT i = 0; i < textureFile.GetLevelCount(); ++i)
+		vecLevelSizes[i] = textureFile.GetLevelSize(i);
+
+	//初始级别的image超出显存预算时不加入纹理管理，由调用者改为占位纹理
+	UINT uiInitialLevel = TextureManager::GetInitialLevel(textureFile.GetWidth(), textureFile.GetHeight(), textureFile.GetLevelCount());
+	if (!CreateTextureImageFromKTX2(textureFile, uiInitialLevel, pTexture->image, pTexture->allocation, pTexture->imageView))
+	{
+		Log::Warn(std::format("Cooked texture {} exceeds the device local memory budget", texturePath.string()));
+		LogMemoryStats();
+		return TextureManager::INVALID_HANDLE;
+	}
+
+	UINT uiTexture = m_TextureManager.AddTexture(textureFile.GetWidth(), textureFile.GetHeight(), vecLevelSizes);
+	const TextureManager::TextureInfo& info = m_TextureManager.GetTextureInfo(uiTexture);
+
+	auto endTimestamp = std::chrono::high_resolution_clock::now();
+	Log::Info(std::format("Load cooked texture {} : {}x{}, format {}, {} mip levels, level {} resident ({:.2f} of {:.2f} MB), {:.2f} ms",
+		texturePath.string(), textureFile.GetWidth(), textureFile.GetHeight(), static_cast<int>(textureFile.GetFormat()), textureFile.GetLevelCount(),
+		info.uiResidentLevel, info.GetSize(info.uiResidentLevel) / (1024.0 * 1024.0), info.GetSize(0) / (1024.0 * 1024.0),
+		std::chrono::duration<double, std::milli>(endTimestamp - startTimestamp).count()));
+
+	m_vecStreamedTextures.push_back(std::move(pTexture));
+	return uiTexture;
+}
+
+void VulkanRenderer::UpdateTextureStreaming()
+{
+	if (m_vecStreamedTextures.empty())
+		return;
+
+	m_TextureManager.BeginFrame();
+
+	EstimateTextureUsage();
+
+	std::vector<TextureManager::ResidencyChange> vecChanges = m_TextureManager.CollectChanges(TEXTURE_STREAMING_MAX_STREAM_INS_PER_FRAME);
+	if (vecChanges.empty())
+		return;
+
+	//流入只从映射的文件上传新的一级，丢弃不需要上传；仍驻留的各级由本帧在render pass之前从旧image拷贝
+	//新image超出显存预算时撤销该变化，纹理保持当前的级别，之后每帧重新请求，占用下降后即可流入
+	bool bUpload = false;
+	for (const auto& change : vecChanges)
+	{
+		StreamedTexture& texture = *m_vecStreamedTextures[change.uiTexture];
+		UINT uiUploadLevelCount = change.bEvict ? 0 : change.uiPreviousLevel - change.uiResidentLevel;
+		VkImage image = VK_NULL_HANDLE;
+		MemoryAllocation allocation;
+		VkImageView imageView = VK_NULL_HANDLE;
+		if (!CreateTextureImageFromKTX2(texture.file, change.uiResidentLevel, image, allocation, imageView, uiUploadLevelCount))
+		{
+			m_TextureManager.CancelChange(change);
+			if (!texture.bBudgetRefused)
+				Log::Warn(std::format("Texture {} level {} exceeds the device local memory budget, defer until usage drops", change.uiTexture, change.uiResidentLevel));
+			texture.bBudgetRefused = true;
+			continue;
+		}
+		texture.bBudgetRefused = false;
+		bUpload = bUpload || uiUploadLevelCount > 0;
+
+		UINT uiKeptLevel = std::max(change.uiResidentLevel, change.uiPreviousLevel);
+		PendingTextureCopy copy;
+		copy.srcImage = texture.image;
+		copy.dstImage = image;
+		copy.uiSrcBaseLevel = uiKeptLevel - change.uiPreviousLevel;
+		copy.uiDstBaseLevel = uiKeptLevel - change.uiResidentLevel;
+		copy.uiLevelCount = texture.file.GetLevelCount() - uiKeptLevel;
+		copy.uiWidth = TextureMipmap::GetMipLevelSize(texture.file.GetWidth(), uiKeptLevel);
+		copy.uiHeight = TextureMipmap::GetMipLevelSize(texture.file.GetHeight(), uiKeptLevel);
+		m_vecPendingTextureCopies.push_back(copy);
+
+		//本帧的拷贝排在之前各帧的采样之后，旧image等本帧执行完之后才销毁；descriptorSet在各帧的fence等待之后改写
+		m_vecRetiredTextureImages.push_back({ texture.image, texture.allocation, texture.imageView, m_uiTotalFrameCount });
+		texture.image = image;
+		texture.allocation = allocation;
+		texture.imageView = imageView;
+		m_TextureManager.CompleteChange(change.uiTexture);
+	}
+
+	//上传与本帧的绘制在同一队列上，排在本帧之前提交
+	if (bUpload)
+		SubmitUploadBatch();
+}
+
+void VulkanRenderer::RecordPendingTextureCopies(VkCommandBuffer commandBuffer)
+{
+	for (const auto& pending : m_vecPendingTextureCopies)
+	{
+		//旧image可能仍被之前的帧采样，拷贝等待其fragment shader完成；新image上传的一级已由上传批次转为SHADER_READ_ONLY
+		std::array<VkImageMemoryBarrier, 2> aryBarriers{};
+		for (auto& barrier : aryBarriers)
+		{
+			barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		}
+		aryBarriers[0].image = pending.srcImage;
+		aryBarriers[0].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, pending.uiSrcBaseLevel, pending.uiLevelCount, 0, 1 };
+		aryBarriers[0].oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		aryBarriers[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		aryBarriers[0].srcAccessMask = 0;
+		aryBarriers[0].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		aryBarriers[1].image = pending.dstImage;
+		aryBarriers[1].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, pending.uiDstBaseLevel, pending.uiLevelCount, 0, 1 };
+		aryBarriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		aryBarriers[1].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		aryBarriers[1].srcAccessMask = 0;
+		aryBarriers[1].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+			0, nullptr, 0, nullptr, static_cast<UINT>(aryBarriers.size()), aryBarriers.data());
+
+		//两个image格式相同，压缩格式的尺寸到达该级边缘时不必为块的整数倍
+		std::vector<VkImageCopy> vecRegions(pending.uiLevelCount);
+		for (UINT i = 0; i < pending.uiLevelCount; ++i)
+		{
+			VkImageCopy& region = vecRegions[i];
+			region.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, pending.uiSrcBaseLevel + i, 0, 1 };
+			region.srcOffset = { 0, 0, 0 };
+			region.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, pending.uiDstBaseLevel + i, 0, 1 };
+			region.dstOffset = { 0, 0, 0 };
+			region.extent = { TextureMipmap::GetMipLevelSize(pending.uiWidth, i), TextureMipmap::GetMipLevelSize(pending.uiHeight, i), 1 };
+		}
+		vkCmdCopyImage(commandBuffer, pending.srcImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, pending.dstImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			static_cast<UINT>(vecRegions.size()), vecRegions.data());
+
+		//旧image已退役，之后不再被采样，保持TRANSFER_SRC直到销毁
+		VkImageMemoryBarrier barrier = aryBarriers[1];
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+			0, nullptr, 0, nullptr, 1, &barrier);
+	}
+	m_vecPendingTextureCopies.clear();
+}
+
+void VulkanRenderer::EstimateTextureUsage()
+{
+	if (m_uiSceneTexture == TextureManager::INVALID_HANDLE)
+		return;
+
+	//整个纹理只需一个级别：取可见三角形中最细的，没有可见三角形时不请求，该纹理按LRU可被丢弃
+	const KTX2File& textureFile = m_vecStreamedTextures[m_uiSceneTexture]->file;
+	const float fTextureLevelOffset = 0.5f * std::log2(static_cast<float>(textureFile.GetWidth()) * static_cast<float>(textureFile.GetHeight()));
+	float fMinLevel = std::numeric_limits<float>::infinity();
+	ForEachVisibleTriangleUV([&fMinLevel](float fUVLevel, const glm::vec2&, const glm::vec2&)
+	{
+		//UV退化的三角形无法估计
+		if (std::isfinite(fUVLevel))
+			fMinLevel = std::min(fMinLevel, fUVLevel);
+	});
+	if (std::isinf(fMinLevel))
+		return;
+
+	float fLevel = fMinLevel + fTextureLevelOffset;
+	UINT uiLevel = (fLevel > 0.f) ? std::min(static_cast<UINT>(fLevel), textureFile.GetLevelCount() - 1) : 0;
+	m_TextureManager.RequestLevel(m_uiSceneTexture, uiLevel);
+}
+
+void VulkanRenderer::ReleaseRetiredResources(bool bAll)
+{
+	//替换之前录制的帧可能仍在使用旧的资源，每帧都经过一次fence等待之后才能销毁
+	const uint64_t uiFrameInFlightCount = m_vecSwapChainImages.size();
+	auto IsReleasable = [this, bAll, uiFrameInFlightCount](uint64_t uiRetireFrame)
+	{
+		return bAll || m_uiTotalFrameCount >= uiRetireFrame + uiFrameInFlightCount;
+	};
+
+	std::erase_if(m_vecRetiredTextureImages, [this, &IsReleasable](RetiredTextureImage& retired)
+	{
+		if (!IsReleasable(retired.uiRetireFrame))
+			return false;
+
+		vkDestroyImageView(m_LogicalDevice, retired.imageView, nullptr);
+		vkDestroyImage(m_LogicalDevice, retired.image, nullptr);
+		m_MemoryAllocator.Free(retired.allocation);
+		return true;
+	});
+
+	std::erase_if(m_vecRetiredGeometries, [this, &IsReleasable](const RetiredGeometry& retired)
+	{
+		if (!IsReleasable(retired.uiRetireFrame))
+			return false;
+
+		m_GeometryPool.Free(retired.uiHandle);
+		return true;
+	});
+
+	std::erase_if(m_vecRetiredBuffers, [this, &IsReleasable](RetiredBuffer& retired)
+	{
+		if (!IsReleasable(retired.uiRetireFrame))
+			return false;
+
+		vkDestroyBuffer(m_LogicalDevice, retired.buffer, nullptr);
+		m_MemoryAllocator.Free(retired.allocation);
+		return true;
+	});
+}
+
+void VulkanRenderer::DestroyStreamedTextures()
+{
+	for (auto& pTexture : m_vecStreamedTextures)
+	{
+		vkDestroyImageView(m_LogicalDevice, pTexture->imageView, nullptr);
+		vkDestroyImage(m_LogicalDevice, pTexture->image, nullptr);
+		m_MemoryAllocator.Free(pTexture->allocation);
+	}
+	m_vecStreamedTextures.clear();
+	m_vecPendingTextureCopies.clear();
+	m_uiSceneTexture = TextureManager::INVALID_HANDLE;
+}
+
+void VulkanRenderer::CreateTextureImageAndFillData()
+{
+	//优先使用TextureCooker烘焙出的同名.ktx2，无需解码
+	std::filesystem::path cookedPath = m_TexturePath;
+	cookedPath.replace_extension(".ktx2");
+	if (std::filesystem::exists(cookedPath))
+	{
+		//超过页缓存的纹理按页驻留；其余的（或设备不支持稀疏纹理时）按mip流式加载，显存占用由纹理预算限制
+		std::error_code errorCode;
+		bool bExceedCache = m_bEnableVirtualTexture && std::filesystem::file_size(cookedPath, errorCode) > m_uiVirtualTextureCacheSize;
+		if (bExceedCache && CreateVirtualTexture(cookedPath))
+			return;
+		m_uiSceneTexture = CreateStreamedTexture(cookedPath);
+		if (m_uiSceneTexture != TextureManager::INVALID_HANDLE)
+		{
+			//image的level 0即驻留的最细级别，硬件按其尺寸计算LOD；采样器的LOD范围按完整的mip链
+			m_TextureFormat = m_vecStreamedTextures[m_uiSceneTexture]->file.GetFormat();
+			m_uiMipmapLevel = m_vecStreamedTextures[m_uiSceneTexture]->file.GetLevelCount();
+			return;
+		}
+	}
+
+	m_TextureFormat = VK_FORMAT_R8G8B8A8_SRGB;
+
+	//解码通常已在Init开始时提交；.ktx2加载失败时才在这里提交
+	if (!m_TextureDecodeFuture.valid())
+		m_TextureDecodeFuture = TextureDecoder::DecodeAsync(m_TexturePath, m_ThreadPool);
+
+	//不等待解码，首帧先使用1x1的白色纹理，解码完成后由PollTextureDecode替换
+	static constexpr UCHAR aryWhitePixel[4] = { 255, 255, 255, 255 };
+	m_uiMipmapLevel = 1;
+	CreateImageAndBindMemory(1, 1, 1,
+		VK_SAMPLE_COUNT_1_BIT,
+		VK_FORMAT_R8G8B8A8_SRGB,
+		VK_IMAGE_TILING_OPTIMAL,
+		VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		MemoryCategory::Texture,
+		m_TextureImage, m_TextureImageAllocation);
+	RecordChangeImageLayout(m_StagingBufferRing.GetCommandBuffer(), m_TextureImage, VK_FORMAT_R8G8B8A8_SRGB, 1,
+		VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+	TransferImageDataByStageBuffer(aryWhitePixel, sizeof(aryWhitePixel), m_TextureImage, 1, 1);
+	m_StagingBufferRing.FinishImage(m_TextureImage, { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 },
+		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		VK_ACCESS_SHADER_READ_BIT,
+		VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+}
+
+void VulkanRenderer::PollTextureDecode()
+{
+	if (m_TextureDecodeFuture.valid() && m_TextureDecodeFuture.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+	{
+		TextureDecoder::Image image = m_TextureDecodeFuture.get();
+		if (!image.IsValid())
+		{
+			Log::Error(std::format("Decode image {} failed, keep placeholder texture", m_TexturePath.string()));
+			return;
+		}
+		Log::Info(std::format("Decode texture {} : {} channels, decode {:.2f} ms", m_TexturePath.string(), image.uiChannel, image.dDecodeTime));
+		m_DecodedTexture = std::move(image);
+	}
+	if (!m_DecodedTexture.IsValid())
+		return;
+
+	auto uploadStartTimestamp = std::chrono::high_resolution_clock::now();
+
+	//超出显存预算时保留解码结果与占位纹理，之后每帧重试
+	VkImage textureImage = VK_NULL_HANDLE;
+	MemoryAllocation textureImageAllocation;
+	UINT uiMipLevel = 0;
+	if (!CreateDecodedTextureImage(m_DecodedTexture, textureImage, textureImageAllocation, uiMipLevel))
+	{
+		if (!m_bDecodedTextureRefused)
+		{
+			Log::Warn(std::format("Texture {} exceeds the device local memory budget, keep placeholder texture until usage drops", m_TexturePath.string()));
+			LogMemoryStats();
+		}
+		m_bDecodedTextureRefused = true;
+		return;
+	}
+	m_DecodedTexture = {};
+	m_bDecodedTextureRefused = false;
+	//上传异步执行，mip链由本帧的CommandBuffer生成，二者都排在使用新image的绘制之前
+	SubmitUploadBatch();
+
+	//占位纹理可能仍被in flight的帧采样，延后销毁；各帧的descriptorSet在其fence等待之后由RefreshTextureDescriptor切换
+	m_vecRetiredTextureImages.push_back({ m_TextureImage, m_TextureImageAllocation, m_TextureImageView, m_uiTotalFrameCount });
+	m_TextureImage = textureImage;
+	m_TextureImageAllocation = textureImageAllocation;
+	m_uiMipmapLevel = uiMipLevel;
+	CreateTextureImageView();
+
+	auto uploadEndTimestamp = std::chrono::high_resolution_clock::now();
+	Log::Info(std::format("Swap in texture {} : record upload {:.2f} ms", m_TexturePath.string(),
+		std::chrono::duration<double, std::milli>(uploadEndTimestamp - uploadStartTimestamp).count()));
+}
+
+bool VulkanRenderer::CreateDecodedTextureImage(const TextureDecoder::Image& image, VkImage& textureImage, MemoryAllocation& textureImageAllocation, UINT& uiMipLevel)
+{
+	UINT uiTexWidth = image.uiWidth;
+	UINT uiTexHeight = image.uiHeight;
+
+	//完整的mip链，缩小采样时不再因欠采样产生走样，也减少纹理缓存的抖动
+	uiMipLevel = TextureMipmap::GetMipLevelCount(uiTexWidth, uiTexHeight);
+	bool bBlitMipmap = CheckFormatSupportLinearBlit(VK_FORMAT_R8G8B8A8_SRGB);
+
+	CreateImage(uiTexWidth, uiTexHeight, uiMipLevel,
+		VK_SAMPLE_COUNT_1_BIT,
+		VK_FORMAT_R8G8B8A8_SRGB,
+		VK_IMAGE_TILING_OPTIMAL,
+		VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+		textureImage);
+	if (!IsImageWithinBudget(textureImage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT))
+	{
+		vkDestroyImage(m_LogicalDevice, textureImage, nullptr);
+		textureImage = VK_NULL_HANDLE;
+		return false;
+	}
+	AllocateImageMemory(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_IMAGE_TILING_OPTIMAL, MemoryCategory::Texture, textureImage, textureImageAllocation);
+	vkBindImageMemory(m_LogicalDevice, textureImage, textureImageAllocation.memory, textureImageAllocation.offset);
+
+	Log::Info(std::format("Texture {}x{} : {} mip levels generated by {}", uiTexWidth, uiTexHeight, uiMipLevel,
+		bBlitMipmap ? "GPU blit" : "CPU box filter"));
+
+	//layout转换与copy都录制在当前的上传批次中，由调用者统一提交
+	//copy之前，将layout从初始的undefined转为transfer dst；GPU生成mipmap时只上传level 0
+	RecordChangeImageLayout(m_StagingBufferRing.GetCommandBuffer(), textureImage,
+		VK_FORMAT_R8G8B8A8_SRGB,				//image format
+		bBlitMipmap ? 1 : uiMipLevel,			//mipmap level
+		VK_IMAGE_LAYOUT_UNDEFINED,				//src layout
+		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);	//dst layout
+
+	//GPU生成mip时，展开为RGBA8与写入暂存内存合并为一步，不再经过整图的中转缓冲
+	//CPU生成mip需要完整的RGBA8原图，先展开到内存中
+	std::vector<UCHAR> vecPixels;
+	if (bBlitMipmap)
+	{
+		TransferImageRowsByStageBuffer(textureImage, uiTexWidth, uiTexHeight, static_cast<VkDeviceSize>(uiTexWidth) * 4, 0, 1,
+			[this, &image](UINT uiFirstRow, UINT uiRowCount, UCHAR* pDst)
+			{
+				image.ExpandRowsToRGBA8(uiFirstRow, uiRowCount, pDst, &m_ThreadPool);
+			});
+	}
+	else
+	{
+		vecPixels.resize(image.GetRGBA8Size());
+		image.ExpandRowsToRGBA8(0, uiTexHeight, vecPixels.data(), &m_ThreadPool);
+		TransferImageDataByStageBuffer(vecPixels.data(), vecPixels.size(), textureImage, uiTexWidth, uiTexHeight);
+	}
+
+	VkImageSubresourceRange subresourceRange{};
+	subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	subresourceRange.baseMipLevel = 0;
+	subresourceRange.baseArrayLayer = 0;
+	subresourceRange.layerCount = 1;
+
+	if (bBlitMipmap)
+	{
+		//blit需要图形队列，上传可能在传输队列上执行，level 0转为transfer src后交给图形队列
+		subresourceRange.levelCount = 1;
+		m_StagingBufferRing.FinishImage(textureImage, subresourceRange,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			VK_ACCESS_TRANSFER_READ_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+		//整条mip链录制在下一帧的CommandBuffer中，在render pass之前执行，不再单独提交并等待队列空闲
+		m_vecPendingMipmapGenerations.push_back({ textureImage, uiTexWidth, uiTexHeight, uiMipLevel });
+	}
+	else
+	{
+		//格式不支持线性blit，在CPU上生成其余各级并随level 0一起上传
+		auto vecLevels = TextureMipmap::GenerateRGBA8(vecPixels.data(), uiTexWidth, uiTexHeight, true);
+		for (size_t i = 0; i < vecLevels.size(); ++i)
+		{
+			auto& level = vecLevels[i];
+			TransferImageDataByStageBuffer(level.vecPixels.data(), level.vecPixels.size(), textureImage, level.uiWidth, level.uiHeight, static_cast<UINT>(i) + 1);
+		}
+
+		//上传可能在传输队列上执行，layout转换与所有权转移由暂存环一并完成
+		subresourceRange.levelCount = uiMipLevel;
+		m_StagingBufferRing.FinishImage(textureImage, subresourceRange,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			VK_ACCESS_SHADER_READ_BIT,
+			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+	}
+	return true;
+}
+
+void VulkanRenderer::RecordPendingMipmapGenerations(VkCommandBuffer commandBuffer)
+{
+	for (const auto& pending : m_vecPendingMipmapGenerations)
+		RecordGenerateMipmaps(commandBuffer, pending.image, pending.uiWidth, pending.uiHeight, pending.uiMipLevel);
+	m_vecPendingMipmapGenerations.clear();
+}
+
+void VulkanRenderer::RecordGenerateMipmaps(VkCommandBuffer commandBuffer, VkImage image, UINT uiWidth, UINT uiHeight, UINT uiMipLevel)
+{
+	VkImageMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = image;
+	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = 1;
+
+	//其余各级的内容会被blit整体覆盖，直接从undefined转为transfer dst
+	if (uiMipLevel > 1)
+	{
+		barrier.subresourceRange.baseMipLevel = 1;
+		barrier.subresourceRange.levelCount = uiMipLevel - 1;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+			0, nullptr, 0, nullptr, 1, &barrier);
+	}
+
+	barrier.subresourceRange.levelCount = 1;
+	for (UINT i = 1; i < uiMipLevel; ++i)
+	{
+		//由上一级（transfer src）线性缩小到这一级
+		VkImageBlit blit{};
+		blit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, i - 1, 0, 1 };
+		blit.srcOffsets[1] = { static_cast<int32_t>(TextureMipmap::GetMipLevelSize(uiWidth, i - 1)),
+			static_cast<int32_t>(TextureMipmap::GetMipLevelSize(uiHeight, i - 1)), 1 };
+		blit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, i, 0, 1 };
+		blit.dstOffsets[1] = { static_cast<int32_t>(TextureMipmap::GetMipLevelSize(uiWidth, i)),
+			static_cast<int32_t>(TextureMipmap::GetMipLevelSize(uiHeight, i)), 1 };
+		vkCmdBlitImage(commandBuffer,
+			image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			1, &blit, VK_FILTER_LINEAR);
+
+		//上一级不再被读取，转为shader readonly
+		VkImageMemoryBarrier aryBarriers[2]{ barrier, barrier };
+		aryBarriers[0].subresourceRange.baseMipLevel = i - 1;
+		aryBarriers[0].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		aryBarriers[0].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		aryBarriers[0].srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		aryBarriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+		//这一级写入完成后作为下一次blit的src
+		aryBarriers[1].subresourceRange.baseMipLevel = i;
+		aryBarriers[1].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		aryBarriers[1].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		aryBarriers[1].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		aryBarriers[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+			0, nullptr, 0, nullptr, 2, aryBarriers);
+	}
+
+	//最后一级只作为dst（或只有一级时的level 0）
+	barrier.subresourceRange.baseMipLevel = uiMipLevel - 1;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+		0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+bool VulkanRenderer::CreateVirtualTexture(const std::filesystem::path& texturePath)
+{
+	auto startTimestamp = std::chrono::high_resolution_clock::now();
+
+	const auto& physicalDeviceInfo = m_mapPhysicalDeviceInfo.at(m_PhysicalDevice);
+	const auto& graphicFamily = physicalDeviceInfo.vecQueueFamilies[physicalDeviceInfo.graphicFamilyIdx.value()];
+	if (!physicalDeviceInfo.features.sparseBinding || !physicalDeviceInfo.features.sparseResidencyImage2D
+		|| !(graphicFamily.queueFlags & VK_QUEUE_SPARSE_BINDING_BIT) || !physicalDeviceInfo.features.fragmentStoresAndAtomics)
+	{
+		Log::Warn("Device does not support sparse residency images or fragment shader stores, virtual texture disabled");
+		return false;
+	}
+
+	//片元着色器由ShaderCompileToSpv.bat编译，未编译时改为流式纹理
+	if (!std::filesystem::exists(m_VirtualTextureFragShaderPath))
+	{
+		Log::Warn(std::format("{} not found, run ShaderCompileToSpv.bat to compile it, virtual texture disabled", m_VirtualTextureFragShaderPath.string()));
+		return false;
+	}
+
+	if (!m_VirtualTextureFile.Open(texturePath))
+		return false;
+
+	VkFormat format = m_VirtualTextureFile.GetFormat();
+	const VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	UINT uiFormatPropertyCount = 0;
+	vkGetPhysicalDeviceSparseImageFormatProperties(m_PhysicalDevice, format, VK_IMAGE_TYPE_2D, VK_SAMPLE_COUNT_1_BIT,
+		usage, VK_IMAGE_TILING_OPTIMAL, &uiFormatPropertyCount, nullptr);
+	if (uiFormatPropertyCount == 0)
+	{
+		Log::Warn(std::format("Format {} does not support sparse residency, virtual texture disabled", static_cast<int>(format)));
+		m_VirtualTextureFile.Close();
+		return false;
+	}
+
+	const UINT uiWidth = m_VirtualTextureFile.GetWidth();
+	const UINT uiHeight = m_VirtualTextureFile.GetHeight();
+	const UINT uiLevelCount = m_VirtualTextureFile.GetLevelCount();
+
+	VkImageCreateInfo imageCreateInfo{};
+	imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageCreateInfo.flags = VK_IMAGE_CREATE_SPARSE_BINDING_BIT | VK_IMAGE_CREATE_SPARSE_RESIDENCY_BIT;	//不绑定整个image，按页绑定
+	imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageCreateInfo.extent = { uiWidth, uiHeight, 1 };
+	imageCreateInfo.mipLevels = uiLevelCount;
+	imageCreateInfo.arrayLayers = 1;
+	imageCreateInfo.format = format;
+	imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	imageCreateInfo.usage = usage;
+	imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	VULKAN_ASSERT(vkCreateImage(m_LogicalDevice, &imageCreateInfo, nullptr, &m_TextureImage), "Create sparse image failed");
+
+	//alignment即稀疏块（页）的字节数，imageGranularity为一页的texel尺寸
+	VkMemoryRequirements memoryRequirements;
+	vkGetImageMemoryRequirements(m_LogicalDevice, m_TextureImage, &memoryRequirements);
+
+	UINT uiRequirementCount = 0;
+	vkGetImageSparseMemoryRequirements(m_LogicalDevice, m_TextureImage, &uiRequirementCount, nullptr);
+	std::vector<VkSparseImageMemoryRequirements> vecSparseRequirements(uiRequirementCount);
+	vkGetImageSparseMemoryRequirements(m_LogicalDevice, m_TextureImage, &uiRequirementCount, vecSparseRequirements.data());
+
+	const VkSparseImageMemoryRequirements* pColorRequirements = nullptr;
+	bool bMetadata = false;
+	for (const auto& requirements : vecSparseRequirements)
+	{
+		if (requirements.formatProperties.aspectMask & VK_IMAGE_ASPECT_COLOR_BIT)
+			pColorRequirements = &requirements;
+		if (requirements.formatProperties.aspectMask & VK_IMAGE_ASPECT_METADATA_BIT)
+			bMetadata = true;
+	}
+
+	//mip tail整体常驻，作为缺页时的兜底；没有mip tail（烘焙时未生成完整mip链）或整张纹理都在mip tail中时不使用稀疏纹理
+	//按页驻留的级数受着色器中常量数组的长度限制
+	if (!pColorRequirements || bMetadata || pColorRequirements->imageMipTailFirstLod == 0 || pColorRequirements->imageMipTailFirstLod >= uiLevelCount
+		|| pColorRequirements->imageMipTailFirstLod > VirtualTextureConstants::MAX_LEVEL_COUNT)
+	{
+		Log::Warn(std::format("Sparse memory requirements of {} are not supported, virtual texture disabled", texturePath.string()));
+		vkDestroyImage(m_LogicalDevice, m_TextureImage, nullptr);
+		m_TextureImage = VK_NULL_HANDLE;
+		m_VirtualTextureFile.Close();
+		return false;
+	}
+
+	const VkExtent3D pageExtent = pColorRequirements->formatProperties.imageGranularity;
+	const UINT uiPagedLevelCount = pColorRequirements->imageMipTailFirstLod;
+	m_uiVirtualTexturePageSize = memoryRequirements.alignment;
+	const UINT uiSlotCount = static_cast<UINT>(std::max<VkDeviceSize>(1, m_uiVirtualTextureCacheSize / m_uiVirtualTexturePageSize));
+
+	UINT uiMemoryTypeIndex = FindSuitableMemoryTypeIndex(memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	//页缓存与mip tail在创建时一次性申请，之后换页只复用槽位，不再申请显存；超出预算时改为流式纹理
+	if (!m_MemoryAllocator.IsWithinBudget(uiMemoryTypeIndex, m_uiVirtualTexturePageSize * uiSlotCount + pColorRequirements->imageMipTailSize))
+	{
+		Log::Warn(std::format("Virtual texture page cache of {:.2f} MB exceeds the device local memory budget, virtual texture disabled",
+			m_uiVirtualTexturePageSize * uiSlotCount / (1024.0 * 1024.0)));
+		vkDestroyImage(m_LogicalDevice, m_TextureImage, nullptr);
+		m_TextureImage = VK_NULL_HANDLE;
+		m_VirtualTextureFile.Close();
+		return false;
+	}
+
+	VkMemoryRequirements cacheRequirements = memoryRequirements;
+	cacheRequirements.size = m_uiVirtualTexturePageSize * uiSlotCount;
+	bool bSuccess = m_MemoryAllocator.Allocate(cacheRequirements, uiMemoryTypeIndex, MemoryResourceType::Optimal, MemoryCategory::Texture, m_VirtualTextureCacheAllocation);
+	ASSERT(bSuccess, "Allocate virtual texture page cache failed");
+
+	VkMemoryRequirements mipTailRequirements = memoryRequirements;
+	mipTailRequirements.size = pColorRequirements->imageMipTailSize;
+	bSuccess = m_MemoryAllocator.Allocate(mipTailRequirements, uiMemoryTypeIndex, MemoryResourceType::Optimal, MemoryCategory::Texture, m_VirtualTextureMipTailAllocation);
+	ASSERT(bSuccess, "Allocate virtual texture mip tail failed");
+
+	VkSemaphoreCreateInfo semaphoreCreateInfo{};
+	semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	VULKAN_ASSERT(vkCreateSemaphore(m_LogicalDevice, &semaphoreCreateInfo, nullptr, &m_VirtualTextureBindSemaphore), "Create virtual texture bind semaphore failed");
+
+	//mip tail按不透明的内存区间绑定，上传的提交在GPU上等待绑定完成，CPU不等待
+	VkSparseMemoryBind mipTailBind{};
+	mipTailBind.resourceOffset = pColorRequirements->imageMipTailOffset;
+	mipTailBind.size = pColorRequirements->imageMipTailSize;
+	mipTailBind.memory = m_VirtualTextureMipTailAllocation.memory;
+	mipTailBind.memoryOffset = m_VirtualTextureMipTailAllocation.offset;
+
+	VkSparseImageOpaqueMemoryBindInfo opaqueBindInfo{};
+	opaqueBindInfo.image = m_TextureImage;
+	opaqueBindInfo.bindCount = 1;
+	opaqueBindInfo.pBinds = &mipTailBind;
+
+	VkBindSparseInfo bindSparseInfo{};
+	bindSparseInfo.sType = VK_STRUCTURE_TYPE_BIND_SPARSE_INFO;
+	bindSparseInfo.imageOpaqueBindCount = 1;
+	bindSparseInfo.pImageOpaqueBinds = &opaqueBindInfo;
+	bindSparseInfo.signalSemaphoreCount = 1;
+	bindSparseInfo.pSignalSemaphores = &m_VirtualTextureBindSemaphore;
+	VULKAN_ASSERT(vkQueueBindSparse(m_GraphicQueue, 1, &bindSparseInfo, VK_NULL_HANDLE), "Bind sparse mip tail failed");
+	m_StagingBufferRing.AddWaitSemaphore(m_VirtualTextureBindSemaphore, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+	//只上传mip tail，各级的页在运行时按需拷贝；之后image始终处于GENERAL，页拷贝与采样无需再转换layout
+	//layout转换的src阶段与semaphore等待的阶段相同，构成依赖链，转换发生在绑定完成之后
+	VkImageMemoryBarrier mipTailBarrier{};
+	mipTailBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	mipTailBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	mipTailBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	mipTailBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	mipTailBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	mipTailBarrier.image = m_TextureImage;
+	mipTailBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, uiLevelCount, 0, 1 };
+	mipTailBarrier.srcAccessMask = 0;
+	mipTailBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	vkCmdPipelineBarrier(m_StagingBufferRing.GetCommandBuffer(), VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+		0, nullptr, 0, nullptr, 1, &mipTailBarrier);
+	for (UINT i = uiPagedLevelCount; i < uiLevelCount; ++i)
+	{
+		TransferImageDataByStageBuffer(m_VirtualTextureFile.GetLevelData(i), m_VirtualTextureFile.GetLevelSize(i), m_TextureImage,
+			TextureMipmap::GetMipLevelSize(uiWidth, i), TextureMipmap::GetMipLevelSize(uiHeight, i), i, m_VirtualTextureFile.GetBlockDim());
+	}
+
+	VkImageSubresourceRange subresourceRange{};
+	subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	subresourceRange.baseMipLevel = 0;
+	subresourceRange.levelCount = uiLevelCount;
+	subresourceRange.baseArrayLayer = 0;
+	subresourceRange.layerCount = 1;
+	m_StagingBufferRing.FinishImage(m_TextureImage, subresourceRange,
+		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		VK_IMAGE_LAYOUT_GENERAL,
+		VK_ACCESS_SHADER_READ_BIT,
+		VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+
+	//in flight的帧仍可能使用旧的页表，移出页表的页要过这些帧之后才能替换
+	m_VirtualTexture.Init(uiWidth, uiHeight, uiPagedLevelCount, pageExtent.width, pageExtent.height, uiSlotCount,
+		static_cast<UINT>(m_vecSwapChainImages.size()) + 1);
+	const UINT uiPageTableWidth = m_VirtualTexture.GetPageTableWidth();
+	const UINT uiPageTableHeight = m_VirtualTexture.GetPageTableHeight();
+
+	//页数据由后台读取，帧开始时拷贝进该帧的暂存区间，变化后的页表放在页数据之后
+	const VkDeviceSize uiCopyAlignment = std::max<VkDeviceSize>(16, physicalDeviceInfo.properties.limits.optimalBufferCopyOffsetAlignment);
+	VkDeviceSize uiPageDataSize = m_VirtualTextureFile.GetRegionSize(pageExtent.width, pageExtent.height);
+	m_uiVirtualTextureStagingPageSize = (uiPageDataSize + uiCopyAlignment - 1) / uiCopyAlignment * uiCopyAlignment;
+	VkDeviceSize uiPageTableSize = static_cast<VkDeviceSize>(uiPageTableWidth) * uiPageTableHeight;
+	m_uiVirtualTextureStagingFrameSize = m_uiVirtualTextureStagingPageSize * VIRTUAL_TEXTURE_MAX_UPLOADS_PER_FRAME
+		+ (uiPageTableSize + uiCopyAlignment - 1) / uiCopyAlignment * uiCopyAlignment;
+	CreateBufferAndBindMemory(m_uiVirtualTextureStagingFrameSize * m_vecSwapChainImages.size(),
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 0, MemoryCategory::Staging,
+		m_VirtualTextureStagingBuffer, m_VirtualTextureStagingAllocation);
+
+	//页表初始只有mip tail，着色器用texelFetch读取，不需要过滤
+	CreateImageAndBindMemory(uiPageTableWidth, uiPageTableHeight, 1, VK_SAMPLE_COUNT_1_BIT, VK_FORMAT_R8_UINT, VK_IMAGE_TILING_OPTIMAL,
+		VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MemoryCategory::Texture,
+		m_VirtualTexturePageTableImage, m_VirtualTexturePageTableAllocation);
+	RecordChangeImageLayout(m_StagingBufferRing.GetCommandBuffer(), m_VirtualTexturePageTableImage, VK_FORMAT_R8_UINT, 1,
+		VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+	TransferImageDataByStageBuffer(m_VirtualTexture.GetPageTable().data(), uiPageTableSize, m_VirtualTexturePageTableImage,
+		uiPageTableWidth, uiPageTableHeight, 0, 1);
+	m_StagingBufferRing.FinishImage(m_VirtualTexturePageTableImage, { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 },
+		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		VK_IMAGE_LAYOUT_GENERAL,
+		VK_ACCESS_SHADER_READ_BIT,
+		VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+	m_VirtualTexturePageTableView = CreateImageView(m_VirtualTexturePageTableImage, VK_FORMAT_R8_UINT, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+
+	VkSamplerCreateInfo samplerCreateInfo{};
+	samplerCreateInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerCreateInfo.magFilter = VK_FILTER_NEAREST;
+	samplerCreateInfo.minFilter = VK_FILTER_NEAREST;
+	samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerCreateInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+	VULKAN_ASSERT(vkCreateSampler(m_LogicalDevice, &samplerCreateInfo, nullptr, &m_VirtualTexturePageTableSampler), "Create page table sampler failed");
+
+	//各级的页划分在创建后不再变化，所有帧共用
+	VirtualTextureConstants constants{};
+	constants.uiPagedLevelCount = uiPagedLevelCount;
+	for (UINT i = 0; i < uiPagedLevelCount; ++i)
+	{
+		const VirtualTexture::Level& level = m_VirtualTexture.GetLevel(i);
+		constants.aryLevelPageScales[i] = glm::vec4(static_cast<float>(level.uiWidth) / pageExtent.width,
+			static_cast<float>(level.uiHeight) / pageExtent.height, 0.f, 0.f);
+		constants.aryLevelPages[i] = glm::uvec4(level.uiPageCountX, level.uiPageCountY, level.uiFirstPage, 0);
+	}
+	CreateBufferAndBindMemory(sizeof(VirtualTextureConstants), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 0, MemoryCategory::Uniform,
+		m_VirtualTextureConstantBuffer, m_VirtualTextureConstantAllocation);
+	memcpy(m_VirtualTextureConstantAllocation.pMappedData, &constants, sizeof(constants));
+
+	//反馈由CPU读取，优先使用带缓存的内存
+	const VkDeviceSize uiStorageAlignment = physicalDeviceInfo.properties.limits.minStorageBufferOffsetAlignment;
+	VkDeviceSize uiFeedbackSize = sizeof(UINT) * m_VirtualTexture.GetPageCount();
+	m_uiVirtualTextureFeedbackFrameSize = (uiFeedbackSize + uiStorageAlignment - 1) / uiStorageAlignment * uiStorageAlignment;
+	CreateBufferAndBindMemory(m_uiVirtualTextureFeedbackFrameSize * m_vecSwapChainImages.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, VK_MEMORY_PROPERTY_HOST_CACHED_BIT, MemoryCategory::Staging,
+		m_VirtualTextureFeedbackBuffer, m_VirtualTextureFeedbackAllocation);
+	memset(m_VirtualTextureFeedbackAllocation.pMappedData, 0, static_cast<size_t>(m_uiVirtualTextureFeedbackFrameSize * m_vecSwapChainImages.size()));
+
+	m_bVirtualTexture = true;
+	m_TextureFormat = format;
+	m_uiMipmapLevel = uiLevelCount;
+
+	auto endTimestamp = std::chrono::high_resolution_clock::now();
+	Log::Info(std::format("Create virtual texture {} : {}x{}, format {}, page {}x{} ({} KB), {} paged levels / {} pages, cache {} pages ({:.2f} MB), mip tail {:.2f} KB, {:.2f} ms",
+		texturePath.string(), uiWidth, uiHeight, static_cast<int>(format), pageExtent.width, pageExtent.height, m_uiVirtualTexturePageSize / 1024,
+		uiPagedLevelCount, m_VirtualTexture.GetPageCount(), uiSlotCount, cacheRequirements.size / (1024.0 * 1024.0),
+		pColorRequirements->imageMipTailSize / 1024.0, std::chrono::duration<double, std::milli>(endTimestamp - startTimestamp).count()));
+	return true;
+}
+
+void VulkanRenderer::UpdateVirtualTexture(UINT uiFrameIdx)
+{
+	if (!m_bVirtualTexture)
+		return;
+
+	GatherVirtualTextureFeedback(uiFrameIdx);
+
+	auto MakePageBind = [this](UINT uiPage, VkDeviceMemory memory, VkDeviceSize uiMemoryOffset)
 	{
-		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
-		if (CheckFormatHasStencilComponent(format))
+		VirtualTexture::PageRect rect = m_VirtualTexture.GetPageRect(uiPage);
+		VkSparseImageMemoryBind bind{};
+		bind.subresource = { VK_IMAGE_ASPECT_COLOR_BIT, rect.uiLevel, 0 };
+		bind.offset = { static_cast<int32_t>(rect.uiX), static_cast<int32_t>(rect.uiY), 0 };
+		bind.extent = { rect.uiWidth, rect.uiHeight, 1 };	//边缘的页截止到该级的边缘
+		bind.memory = memory;
+		bind.memoryOffset = uiMemoryOffset;
+		return bind;
+	};
+
+	//读取完成的页绑定到其槽位，数据拷贝进本帧的暂存区间，在本帧的render pass之前拷贝进image
+	std::vector<VkSparseImageMemoryBind> vecBinds;
+	std::vector<UINT> vecUploadedPages;
+	const VkDeviceSize uiFrameStagingOffset = m_uiVirtualTextureStagingFrameSize * uiFrameIdx;
+	UCHAR* pFrameStagingData = static_cast<UCHAR*>(m_VirtualTextureStagingAllocation.pMappedData) + uiFrameStagingOffset;
+	for (auto iter = m_vecVirtualTextureReads.begin(); iter != m_vecVirtualTextureReads.end() && vecUploadedPages.size() < VIRTUAL_TEXTURE_MAX_UPLOADS_PER_FRAME;)
+	{
+		if (iter->future.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
 		{
-			barrier.subresourceRange.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
+			++iter;
+			continue;
 		}
+		iter->future.get();
+
+		const auto& load = iter->load;
+		vecBinds.push_back(MakePageBind(load.uiPage, m_VirtualTextureCacheAllocation.memory,
+			m_VirtualTextureCacheAllocation.offset + m_uiVirtualTexturePageSize * load.uiSlot));
+
+		VirtualTexture::PageRect rect = m_VirtualTexture.GetPageRect(load.uiPage);
+		VkDeviceSize uiStagingOffset = m_uiVirtualTextureStagingPageSize * vecUploadedPages.size();
+		memcpy(pFrameStagingData + uiStagingOffset, iter->pData.get(), static_cast<size_t>(m_VirtualTextureFile.GetRegionSize(rect.uiWidth, rect.uiHeight)));
+
+		VkBufferImageCopy region{};
+		region.bufferOffset = uiFrameStagingOffset + uiStagingOffset;
+		region.bufferRowLength = 0;
+		region.bufferImageHeight = 0;
+		region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, rect.uiLevel, 0, 1 };
+		region.imageOffset = { static_cast<int32_t>(rect.uiX), static_cast<int32_t>(rect.uiY), 0 };
+		region.imageExtent = { rect.uiWidth, rect.uiHeight, 1 };
+		m_vecVirtualTextureCopies.push_back(region);
+
+		vecUploadedPages.push_back(load.uiPage);
+		iter = m_vecVirtualTextureReads.erase(iter);
 	}
-	else
+
+	//分配新的读取，被替换的页立即解除绑定，其槽位要等新页读取完成后才会重新绑定
+	UINT uiMaxLoadCount = VIRTUAL_TEXTURE_MAX_PENDING_READS - static_cast<UINT>(m_vecVirtualTextureReads.size());
+	std::vector<VirtualTexture::PageLoad> vecLoads = m_VirtualTexture.CollectPageLoads(uiMaxLoadCount);
+	for (const auto& load : vecLoads)
 	{
-		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		if (load.uiEvictedPage != VirtualTexture::INVALID_INDEX)
+			vecBinds.push_back(MakePageBind(load.uiEvictedPage, VK_NULL_HANDLE, 0));
 	}
 
-	VkPipelineStageFlags srcStage;
-	VkPipelineStageFlags dstStage;
-	if ((oldLayout == VK_IMAGE_LAYOUT_UNDEFINED) && (newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL))
+	//本帧的提交在GPU上等待绑定完成，CPU不等待；被解除绑定的页已在之前的轮次移出页表，in flight的帧不会再采样
+	if (!vecBinds.empty())
 	{
-		barrier.srcAccessMask = 0;
-		barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-		srcStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT; //дҪȴκζָһֵĹ߽׶
-		dstStage = VK_PIPELINE_STAGE_TRANSFER_BIT; //дڴ׶νУα׶Σʾ䷢
+		VkSparseImageMemoryBindInfo imageBindInfo{};
+		imageBindInfo.image = m_TextureImage;
+		imageBindInfo.bindCount = static_cast<UINT>(vecBinds.size());
+		imageBindInfo.pBinds = vecBinds.data();
+
+		VkBindSparseInfo bindSparseInfo{};
+		bindSparseInfo.sType = VK_STRUCTURE_TYPE_BIND_SPARSE_INFO;
+		bindSparseInfo.imageBindCount = 1;
+		bindSparseInfo.pImageBinds = &imageBindInfo;
+		bindSparseInfo.signalSemaphoreCount = 1;
+		bindSparseInfo.pSignalSemaphores = &m_VirtualTextureBindSemaphore;
+		VULKAN_ASSERT(vkQueueBindSparse(m_GraphicQueue, 1, &bindSparseInfo, VK_NULL_HANDLE), "Bind sparse pages failed");
+		m_bVirtualTextureBindPending = true;
 	}
-	else if ((oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) && (newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL))
+
+	//拷贝与本帧的绘制在同一CommandBuffer中，且排在其前
+	for (UINT uiPage : vecUploadedPages)
+		m_VirtualTexture.CompleteLoad(uiPage);
+
+	//页表与页数据在同一次拷贝中更新，本帧的采样看到的页表与驻留的页一致
+	if (m_VirtualTexture.UpdatePageTable())
 	{
-		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-		srcStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-		dstStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		const std::vector<UCHAR>& vecPageTable = m_VirtualTexture.GetPageTable();
+		VkDeviceSize uiStagingOffset = m_uiVirtualTextureStagingPageSize * VIRTUAL_TEXTURE_MAX_UPLOADS_PER_FRAME;
+		memcpy(pFrameStagingData + uiStagingOffset, vecPageTable.data(), vecPageTable.size());
+
+		VkBufferImageCopy region{};
+		region.bufferOffset = uiFrameStagingOffset + uiStagingOffset;
+		region.bufferRowLength = 0;
+		region.bufferImageHeight = 0;
+		region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+		region.imageOffset = { 0, 0, 0 };
+		region.imageExtent = { m_VirtualTexture.GetPageTableWidth(), m_VirtualTexture.GetPageTableHeight(), 1 };
+		m_VirtualTexturePageTableCopy = region;
 	}
-	else if ((oldLayout == VK_IMAGE_LAYOUT_UNDEFINED) && (newLayout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL))
+
+	//页数据从映射的文件中读取，缺页时可能阻塞在磁盘IO上，放在工作线程中进行
+	for (const auto& load : vecLoads)
 	{
-		barrier.srcAccessMask = 0;
-		barrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT
-			| VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-		srcStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-		dstStage = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+		VirtualTexturePageRead read;
+		read.load = load;
+		read.pData = std::make_unique<UCHAR[]>(static_cast<size_t>(m_uiVirtualTextureStagingPageSize));
+
+		VirtualTexture::PageRect rect = m_VirtualTexture.GetPageRect(load.uiPage);
+		UCHAR* pData = read.pData.get();
+		read.future = m_ThreadPool.Submit([this, rect, pData]()
+		{
+			m_VirtualTextureFile.CopyRegion(rect.uiLevel, rect.uiX, rect.uiY, rect.uiWidth, rect.uiHeight, pData);
+		});
+		m_vecVirtualTextureReads.push_back(std::move(read));
 	}
-	else
+}
+
+void VulkanRenderer::GatherVirtualTextureFeedback(UINT uiFrameIdx)
+{
+	m_VirtualTexture.BeginFeedback();
+
+	//该帧的fence已signal，片元着色器写入的请求对CPU可见；读完清零供该帧下次使用
+	UCHAR* pFrameData = static_cast<UCHAR*>(m_VirtualTextureFeedbackAllocation.pMappedData) + m_uiVirtualTextureFeedbackFrameSize * uiFrameIdx;
+	const UINT* pRequested = reinterpret_cast<const UINT*>(pFrameData);
+	const UINT uiPageCount = m_VirtualTexture.GetPageCount();
+	for (UINT i = 0; i < uiPageCount; ++i)
 	{
-		ASSERT(false, "Unsupport image layout change type");
+		if (pRequested[i] != 0)
+			m_VirtualTexture.RequestPage(i);
 	}
+	memset(pFrameData, 0, sizeof(UINT) * uiPageCount);
+}
+
+void VulkanRenderer::ForEachVisibleTriangleUV(const std::function<void(float fUVLevel, const glm::vec2& uvMin, const glm::vec2& uvMax)>& VisitTriangle)
+{
+	if (!m_GeometryPool.IsValid(m_uiMeshGeometry))
+		return;
 
-	vkCmdPipelineBarrier(singleTimeCommandBuffer,
-		srcStage,		//barrier֮ǰĹ߽׶
-		dstStage,		//barrier֮Ĺ߽׶
-		0,				//ΪVK_DEPENDENCY_BY_REGION_BIT򲿷ֶȡԴ
-		0, nullptr,		//Memory Barrier
-		0, nullptr,		//Buffer Memory Barrier
-		1, &barrier);	//Image Memory Barrier
+	glm::mat4 proj = m_Camera.GetProjMatrix();
+	proj[1][1] *= -1.f;
+	const glm::mat4 mvp = proj * m_Camera.GetViewMatrix() * GetModelMatrix();
 
-	EndSingleTimeCommand(singleTimeCommandBuffer);
+	const float fScreenWidth = static_cast<float>(m_SwapChainExtent2D.width);
+	const float fScreenHeight = static_cast<float>(m_SwapChainExtent2D.height);
+
+	//Packed格式的位置为量化坐标，反量化已包含在模型矩阵中
+	const UCHAR* pVertexData = static_cast<const UCHAR*>(m_pMeshData->GetVertexData());
+	const UINT uiVertexStride = m_pMeshData->GetVertexStride();
+	const bool bPacked = (m_pMeshData->vertexFormat == VertexFormat::Packed);
+	auto FetchVertex = [&](UINT uiVertex, glm::vec4& clipPos, glm::vec2& uv)
+	{
+		const UCHAR* pVertex = pVertexData + static_cast<size_t>(uiVertex) * uiVertexStride;
+		glm::vec3 pos;
+		if (bPacked)
+		{
+			const PackedVertex3D* pPacked = reinterpret_cast<const PackedVertex3D*>(pVertex);
+			pos = { glm::unpackSnorm1x16(pPacked->pos[0]), glm::unpackSnorm1x16(pPacked->pos[1]), glm::unpackSnorm1x16(pPacked->pos[2]) };
+			uv = { glm::unpackHalf1x16(pPacked->texCoord[0]), glm::unpackHalf1x16(pPacked->texCoord[1]) };
+		}
+		else
+		{
+			const Vertex3D* pFloat = reinterpret_cast<const Vertex3D*>(pVertex);
+			pos = pFloat->pos;
+			uv = pFloat->texCoord;
+		}
+		clipPos = mvp * glm::vec4(pos, 1.f);
+	};
+
+	//使用各SubMesh最粗的一级LOD，UV覆盖范围与原网格基本一致；三角形过多时均匀抽样
+	const SubMesh* pSubMeshes = m_pMeshData->GetSubMeshData();
+	const size_t uiSubMeshCount = m_pMeshData->GetSubMeshCount();
+	size_t uiTriangleCount = 0;
+	for (size_t i = 0; i < uiSubMeshCount; ++i)
+		uiTriangleCount += pSubMeshes[i].GetLOD(pSubMeshes[i].uiLODCount).uiIndexCount / 3;
+	const UINT uiTriangleStep = static_cast<UINT>(std::max<size_t>(1, (uiTriangleCount + TEXTURE_FEEDBACK_MAX_TRIANGLES - 1) / TEXTURE_FEEDBACK_MAX_TRIANGLES));
+
+	for (size_t i = 0; i < uiSubMeshCount; ++i)
+	{
+		const SubMesh& subMesh = pSubMeshes[i];
+		if (subMesh.uiIndexCount == 0)
+			continue;
+
+		SubMeshLOD lod = subMesh.GetLOD(subMesh.uiLODCount);
+		const UCHAR* pIndexData = m_pMeshData->GetIndexData() + lod.uiIndexByteOffset;
+		auto GetIndex = [&](UINT uiIdx) -> UINT
+		{
+			return (subMesh.indexType == VK_INDEX_TYPE_UINT16) ? reinterpret_cast<const uint16_t*>(pIndexData)[uiIdx] : reinterpret_cast<const uint32_t*>(pIndexData)[uiIdx];
+		};
+
+		for (UINT uiTriangle = 0; uiTriangle < lod.uiIndexCount / 3; uiTriangle += uiTriangleStep)
+		{
+			glm::vec4 aryClipPos[3];
+			glm::vec2 aryUV[3];
+			for (UINT k = 0; k < 3; ++k)
+				FetchVertex(subMesh.uiVertexOffset + GetIndex(uiTriangle * 3 + k), aryClipPos[k], aryUV[k]);
+
+			//三个顶点都在同一个裁剪平面之外时不可见
+			auto AllOutside = [&aryClipPos](auto IsOutside)
+			{
+				return IsOutside(aryClipPos[0]) && IsOutside(aryClipPos[1]) && IsOutside(aryClipPos[2]);
+			};
+			if (AllOutside([](const glm::vec4& p) { return p.w <= 0.f; })
+				|| AllOutside([](const glm::vec4& p) { return p.x < -p.w; }) || AllOutside([](const glm::vec4& p) { return p.x > p.w; })
+				|| AllOutside([](const glm::vec4& p) { return p.y < -p.w; }) || AllOutside([](const glm::vec4& p) { return p.y > p.w; })
+				|| AllOutside([](const glm::vec4& p) { return p.z > p.w; }))
+				continue;
+
+			//跨过相机平面的三角形按覆盖整个屏幕估计
+			float fScreenArea = fScreenWidth * fScreenHeight;
+			bool bBackFace = false;
+			if (aryClipPos[0].w > 0.f && aryClipPos[1].w > 0.f && aryClipPos[2].w > 0.f)
+			{
+				glm::vec2 aryScreenPos[3];
+				for (UINT k = 0; k < 3; ++k)
+					aryScreenPos[k] = (glm::vec2(aryClipPos[k]) / aryClipPos[k].w * 0.5f + 0.5f) * glm::vec2(fScreenWidth, fScreenHeight);
+				glm::vec2 edge0 = aryScreenPos[1] - aryScreenPos[0];
+				glm::vec2 edge1 = aryScreenPos[2] - aryScreenPos[0];
+				//与光栅化相同的有向面积，frontFace为逆时针
+				float fSignedArea = -0.5f * (edge0.x * edge1.y - edge0.y * edge1.x);
+				fScreenArea = std::abs(fSignedArea);
+				bBackFace = fSignedArea < 0.f;
+			}
+
+			//按面积之比估计mip级别：硬件按导数最大的方向选择级别，不会比这里更细
+			//透视使同一三角形内各处的级别不同，整体偏细一级；背面通常被遮挡，偏粗一级
+			glm::vec2 uvEdge0 = aryUV[1] - aryUV[0];
+			glm::vec2 uvEdge1 = aryUV[2] - aryUV[0];
+			float fUVArea = 0.5f * std::abs(uvEdge0.x * uvEdge1.y - uvEdge0.y * uvEdge1.x);
+			float fUVLevel = 0.5f * std::log2(fUVArea / std::max(fScreenArea, 1e-6f)) - 1.f + (bBackFace ? 1.f : 0.f);
+
+			glm::vec2 uvMin = glm::min(glm::min(aryUV[0], aryUV[1]), aryUV[2]);
+			glm::vec2 uvMax = glm::max(glm::max(aryUV[0], aryUV[1]), aryUV[2]);
+			VisitTriangle(fUVLevel, uvMin, uvMax);
+		}
+	}
 }
 
-void VulkanRenderer::TransferImageDataByStageBuffer(void* pData, VkDeviceSize imageSize, VkImage& image, UINT uiWidth, UINT uiHeight)
+void VulkanRenderer::RecordVirtualTextureUploads(VkCommandBuffer commandBuffer)
 {
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
+	if (!m_vecVirtualTextureCopies.empty())
+	{
+		//前面的帧可能仍在采样该image，拷贝需等待其fragment shader完成
+		VkImageMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = m_TextureImage;
+		barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, m_uiMipmapLevel, 0, 1 };
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+			0, nullptr, 0, nullptr, 1, &barrier);
 
-	CreateBufferAndBindMemory(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		stagingBuffer, stagingBufferMemory);
+		vkCmdCopyBufferToImage(commandBuffer, m_VirtualTextureStagingBuffer, m_TextureImage, VK_IMAGE_LAYOUT_GENERAL,
+			static_cast<UINT>(m_vecVirtualTextureCopies.size()), m_vecVirtualTextureCopies.data());
 
-	void* imageData;
-	vkMapMemory(m_LogicalDevice, stagingBufferMemory, 0, imageSize, 0, &imageData);
-	memcpy(imageData, pData, static_cast<size_t>(imageSize));
-	vkUnmapMemory(m_LogicalDevice, stagingBufferMemory);
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+			0, nullptr, 0, nullptr, 1, &barrier);
 
-	VkCommandBuffer singleTimeCommandBuffer = BeginSingleTimeCommand();
+		m_vecVirtualTextureCopies.clear();
+	}
 
-	VkBufferImageCopy region{};
-	//ָҪƵbufferеƫ
-	region.bufferOffset = 0;
-	//ָmemoryеĴŷʽڶ
-	//Ϊ0memoryлմ
-	region.bufferRowLength = 0;
-	region.bufferImageHeight = 0;
-	//ָݱƵimageһ
-	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	region.imageSubresource.mipLevel = 0;
-	region.imageSubresource.baseArrayLayer = 0;
-	region.imageSubresource.layerCount = 1;
-	region.imageOffset = { 0, 0, 0 };
-	region.imageExtent = { uiWidth, uiHeight, 1 };
-	vkCmdCopyBufferToImage(singleTimeCommandBuffer, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+	if (m_VirtualTexturePageTableCopy.has_value())
+	{
+		//页表同样始终处于GENERAL
+		VkImageMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = m_VirtualTexturePageTableImage;
+		barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+			0, nullptr, 0, nullptr, 1, &barrier);
 
-	EndSingleTimeCommand(singleTimeCommandBuffer);
+		vkCmdCopyBufferToImage(commandBuffer, m_VirtualTextureStagingBuffer, m_VirtualTexturePageTableImage, VK_IMAGE_LAYOUT_GENERAL,
+			1, &m_VirtualTexturePageTableCopy.value());
 
-	vkDestroyBuffer(m_LogicalDevice, stagingBuffer, nullptr);
-	vkFreeMemory(m_LogicalDevice, stagingBufferMemory, nullptr);
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+			0, nullptr, 0, nullptr, 1, &barrier);
+
+		m_VirtualTexturePageTableCopy.reset();
+	}
 }
 
-void VulkanRenderer::CreateTextureImageAndFillData()
+void VulkanRenderer::RecordVirtualTextureFeedbackBarrier(VkCommandBuffer commandBuffer)
 {
-	int nTexWidth = 0;
-	int nTexHeight = 0;
-	int nTexChannel = 0;
-	stbi_uc* pixels = stbi_load(m_TexturePath.string().c_str(), &nTexWidth, &nTexHeight, &nTexChannel, STBI_rgb_alpha);
-	ASSERT(pixels, std::format("Stb load image {} failed", m_TexturePath.string()));
-
-	VkDeviceSize imageSize = (uint64_t)nTexWidth * (uint64_t)nTexHeight * 4;
+	if (!m_bVirtualTexture)
+		return;
 
-	CreateImageAndBindMemory(nTexWidth, nTexHeight, m_uiMipmapLevel,
-		VK_SAMPLE_COUNT_1_BIT,
-		VK_FORMAT_R8G8B8A8_SRGB,
-		VK_IMAGE_TILING_OPTIMAL,
-		VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-		m_TextureImage, m_TextureImageMemory);
+	//fence之后CPU读取片元着色器写入的请求
+	VkBufferMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.buffer = m_VirtualTextureFeedbackBuffer;
+	barrier.offset = 0;
+	barrier.size = VK_WHOLE_SIZE;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+		0, nullptr, 1, &barrier, 0, nullptr);
+}
 
-	//copy֮ǰlayoutӳʼundefinedתΪtransfer dst
-	ChangeImageLayout(m_TextureImage,
-		VK_FORMAT_R8G8B8A8_SRGB,				//image format
-		m_uiMipmapLevel,						//mipmap level
-		VK_IMAGE_LAYOUT_UNDEFINED,				//src layout
-		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);	//dst layout
+void VulkanRenderer::DestroyVirtualTexture()
+{
+	//工作线程可能仍在读取映射的文件
+	for (auto& read : m_vecVirtualTextureReads)
+		read.future.wait();
+	m_vecVirtualTextureReads.clear();
+	m_vecVirtualTextureCopies.clear();
+	m_VirtualTexturePageTableCopy.reset();
+
+	if (m_VirtualTextureStagingBuffer != VK_NULL_HANDLE)
+	{
+		vkDestroyBuffer(m_LogicalDevice, m_VirtualTextureStagingBuffer, nullptr);
+		m_VirtualTextureStagingBuffer = VK_NULL_HANDLE;
+	}
+	m_MemoryAllocator.Free(m_VirtualTextureStagingAllocation);
+	m_MemoryAllocator.Free(m_VirtualTextureCacheAllocation);
+	m_MemoryAllocator.Free(m_VirtualTextureMipTailAllocation);
 
-	TransferImageDataByStageBuffer(pixels, imageSize, m_TextureImage, static_cast<UINT>(nTexWidth), static_cast<UINT>(nTexHeight));
+	if (m_VirtualTexturePageTableSampler != VK_NULL_HANDLE)
+	{
+		vkDestroySampler(m_LogicalDevice, m_VirtualTexturePageTableSampler, nullptr);
+		m_VirtualTexturePageTableSampler = VK_NULL_HANDLE;
+	}
+	if (m_VirtualTexturePageTableView != VK_NULL_HANDLE)
+	{
+		vkDestroyImageView(m_LogicalDevice, m_VirtualTexturePageTableView, nullptr);
+		m_VirtualTexturePageTableView = VK_NULL_HANDLE;
+	}
+	if (m_VirtualTexturePageTableImage != VK_NULL_HANDLE)
+	{
+		vkDestroyImage(m_LogicalDevice, m_VirtualTexturePageTableImage, nullptr);
+		m_VirtualTexturePageTableImage = VK_NULL_HANDLE;
+	}
+	m_MemoryAllocator.Free(m_VirtualTexturePageTableAllocation);
 
-	//transfer֮󣬽layouttransfer dstתΪshader readonly
-	//ʹmipmap֮generateMipmapsнlayoutתΪshader readonly
+	if (m_VirtualTextureConstantBuffer != VK_NULL_HANDLE)
+	{
+		vkDestroyBuffer(m_LogicalDevice, m_VirtualTextureConstantBuffer, nullptr);
+		m_VirtualTextureConstantBuffer = VK_NULL_HANDLE;
+	}
+	m_MemoryAllocator.Free(m_VirtualTextureConstantAllocation);
 
-	ChangeImageLayout(m_TextureImage,
-		VK_FORMAT_R8G8B8A8_SRGB, 
-		m_uiMipmapLevel,
-		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 
-		VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	if (m_VirtualTextureFeedbackBuffer != VK_NULL_HANDLE)
+	{
+		vkDestroyBuffer(m_LogicalDevice, m_VirtualTextureFeedbackBuffer, nullptr);
+		m_VirtualTextureFeedbackBuffer = VK_NULL_HANDLE;
+	}
+	m_MemoryAllocator.Free(m_VirtualTextureFeedbackAllocation);
 
-	//generateMipmaps(m_TextureImage, VK_FORMAT_R8G8B8A8_SRGB, nTexWidth, nTexHeight, m_uiMipmapLevel);
+	if (m_VirtualTextureBindSemaphore != VK_NULL_HANDLE)
+	{
+		vkDestroySemaphore(m_LogicalDevice, m_VirtualTextureBindSemaphore, nullptr);
+		m_VirtualTextureBindSemaphore = VK_NULL_HANDLE;
+	}
+	m_bVirtualTextureBindPending = false;
 
-	stbi_image_free(pixels);
+	m_VirtualTextureFile.Close();
+	m_bVirtualTexture = false;
 }
 
 void VulkanRenderer::CreateTextureImageView()
 {
+	//流式纹理的imageView随其image一起创建
+	if (m_uiSceneTexture != TextureManager::INVALID_HANDLE)
+		return;
+
 	m_TextureImageView = CreateImageView(m_TextureImage,
-		VK_FORMAT_R8G8B8A8_SRGB,	//ʽΪsRGB
-		VK_IMAGE_ASPECT_COLOR_BIT,	//aspectFlagsΪCOLOR_BIT
+		m_TextureFormat,			//未烘焙时为sRGB的RGBA8
+		VK_IMAGE_ASPECT_COLOR_BIT,	//aspectFlags为COLOR_BIT
 		m_uiMipmapLevel
 	);
 }
 
 void VulkanRenderer::CreateDescriptorSetLayout()
 {
-	//UniformBufferObject Binding
+	//PerFrameConstants Binding
 	VkDescriptorSetLayoutBinding uboLayoutBinding{};
-	uboLayoutBinding.binding = 0; //ӦVertex Shaderеlayout(binding=0)
+	uboLayoutBinding.binding = 0; //对应Vertex Shader中的layout(binding=0)
 	uboLayoutBinding.descriptorCount = 1;
-	uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;	//ΪUniform Buffer
-	uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT; //ֻҪvertex stageЧ
+	uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT; //只需要在vertex stage生效
 	uboLayoutBinding.pImmutableSamplers = nullptr;
 
+	//PerDrawConstants Binding
+	VkDescriptorSetLayoutBinding dynamicUboLayoutBinding{};
+	dynamicUboLayoutBinding.binding = 2; //对应Vertex Shader中的layout(binding=2)
+	dynamicUboLayoutBinding.descriptorCount = 1;
+	dynamicUboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;	//类型为动态偏移的Uniform Buffer，每个物体一个偏移
+	dynamicUboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+	dynamicUboLayoutBinding.pImmutableSamplers = nullptr;
+
 	//CombinedImageSampler Binding
 	VkDescriptorSetLayoutBinding samplerLayoutBinding{};
-	samplerLayoutBinding.binding = 1; ////ӦFragment Shaderеlayout(binding=1)
+	samplerLayoutBinding.binding = 1; ////对应Fragment Shader中的layout(binding=1)
 	samplerLayoutBinding.descriptorCount = 1;
 	samplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT; //ֻfragment stage
+	samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT; //只用于fragment stage
 	samplerLayoutBinding.pImmutableSamplers = nullptr;
 
 	std::vector<VkDescriptorSetLayoutBinding> vecDescriptorLayoutBinding = {
 		uboLayoutBinding,
 		samplerLayoutBinding,
+		dynamicUboLayoutBinding,
 	};
 
+	//稀疏纹理的页表、各级的页划分与请求反馈，对应shader_vt.frag中的binding=3/4/5
+	if (m_bVirtualTexture)
+	{
+		VkDescriptorSetLayoutBinding pageTableLayoutBinding{};
+		pageTableLayoutBinding.binding = 3;
+		pageTableLayoutBinding.descriptorCount = 1;
+		pageTableLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		pageTableLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+		pageTableLayoutBinding.pImmutableSamplers = nullptr;
+
+		VkDescriptorSetLayoutBinding virtualTextureUboLayoutBinding{};
+		virtualTextureUboLayoutBinding.binding = 4;
+		virtualTextureUboLayoutBinding.descriptorCount = 1;
+		virtualTextureUboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		virtualTextureUboLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+		virtualTextureUboLayoutBinding.pImmutableSamplers = nullptr;
+
+		VkDescriptorSetLayoutBinding feedbackLayoutBinding{};
+		feedbackLayoutBinding.binding = 5;
+		feedbackLayoutBinding.descriptorCount = 1;
+		feedbackLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		feedbackLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+		feedbackLayoutBinding.pImmutableSamplers = nullptr;
+
+		vecDescriptorLayoutBinding.push_back(pageTableLayoutBinding);
+		vecDescriptorLayoutBinding.push_back(virtualTextureUboLayoutBinding);
+		vecDescriptorLayoutBinding.push_back(feedbackLayoutBinding);
+	}
+
 	VkDescriptorSetLayoutCreateInfo createInfo{};
 	createInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
 	createInfo.bindingCount = static_cast<UINT>(vecDescriptorLayoutBinding.size());
@@ -1566,6 +4008,11 @@ void VulkanRenderer::CreateDescriptorPool()
 	uboPoolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
 	uboPoolSize.descriptorCount = static_cast<UINT>(m_vecSwapChainImages.size());
 
+	//dynamic ubo
+	VkDescriptorPoolSize dynamicUboPoolSize{};
+	dynamicUboPoolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+	dynamicUboPoolSize.descriptorCount = static_cast<UINT>(m_vecSwapChainImages.size());
+
 	//sampler
 	VkDescriptorPoolSize samplerPoolSize{};
 	samplerPoolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
@@ -1573,9 +4020,21 @@ void VulkanRenderer::CreateDescriptorPool()
 
 	std::vector<VkDescriptorPoolSize> vecPoolSize = {
 		uboPoolSize,
+		dynamicUboPoolSize,
 		samplerPoolSize,
 	};
 
+	//稀疏纹理每帧多一个页表sampler、一个ubo和一个storage buffer
+	if (m_bVirtualTexture)
+	{
+		uboPoolSize.descriptorCount *= 2;
+		samplerPoolSize.descriptorCount *= 2;
+		VkDescriptorPoolSize storagePoolSize{};
+		storagePoolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		storagePoolSize.descriptorCount = static_cast<UINT>(m_vecSwapChainImages.size());
+		vecPoolSize = { uboPoolSize, dynamicUboPoolSize, samplerPoolSize, storagePoolSize };
+	}
+
 	VkDescriptorPoolCreateInfo poolCreateInfo{};
 	poolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
 	poolCreateInfo.poolSizeCount = static_cast<UINT>(vecPoolSize.size());
@@ -1598,13 +4057,13 @@ void VulkanRenderer::CreateDescriptorSets()
 	m_vecDescriptorSets.resize(m_vecSwapChainImages.size());
 	VULKAN_ASSERT(vkAllocateDescriptorSets(m_LogicalDevice, &allocInfo, m_vecDescriptorSets.data()), "Allocate desctiprot sets failed");
 
-	for (size_t i = 0; i < m_vecSwapChainImages.size(); ++i)
+	//ubo
+	for (size_t i = 0; i < m_vecDescriptorSets.size(); ++i)
 	{
-		//ubo
 		VkDescriptorBufferInfo bufferInfo{};
 		bufferInfo.buffer = m_vecUniformBuffers[i];
 		bufferInfo.offset = 0;
-		bufferInfo.range = sizeof(UniformBufferObject);
+		bufferInfo.range = sizeof(PerFrameConstants);
 
 		VkWriteDescriptorSet uboWrite{};
 		uboWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
@@ -1615,90 +4074,336 @@ void VulkanRenderer::CreateDescriptorSets()
 		uboWrite.descriptorCount = 1;
 		uboWrite.pBufferInfo = &bufferInfo;
 
-		//sampler
-		VkDescriptorImageInfo imageInfo{};
-		imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-		imageInfo.imageView = m_TextureImageView;
-		imageInfo.sampler = m_TextureSampler;
-
-		VkWriteDescriptorSet samplerWrite{};
-		samplerWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		samplerWrite.dstSet = m_vecDescriptorSets[i];
-		samplerWrite.dstBinding = 1;
-		samplerWrite.dstArrayElement = 0;
-		samplerWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-		samplerWrite.descriptorCount = 1;
-		samplerWrite.pImageInfo = &imageInfo;
-
-		std::vector<VkWriteDescriptorSet> vecDescriptorWrite = {
-			uboWrite,
-			samplerWrite,
-		};
+		vkUpdateDescriptorSets(m_LogicalDevice, 1, &uboWrite, 0, nullptr);
+	}
+
+	//dynamic ubo
+	for (UINT i = 0; i < static_cast<UINT>(m_vecSwapChainImages.size()); ++i)
+		WriteDynamicUniformBufferDescriptor(i);
 
-		vkUpdateDescriptorSets(m_LogicalDevice, static_cast<uint32_t>(vecDescriptorWrite.size()), vecDescriptorWrite.data(), 0, nullptr);
+	//sampler
+	m_vecTextureDescriptorViews.resize(m_vecSwapChainImages.size());
+	for (UINT i = 0; i < static_cast<UINT>(m_vecSwapChainImages.size()); ++i)
+		WriteTextureDescriptor(i);
+
+	if (m_bVirtualTexture)
+	{
+		for (UINT i = 0; i < static_cast<UINT>(m_vecSwapChainImages.size()); ++i)
+			WriteVirtualTextureDescriptors(i);
 	}
 }
 
-void VulkanRenderer::TransferBufferDataByStageBuffer(void* pData, VkDeviceSize bufferSize, VkBuffer& buffer)
+void VulkanRenderer::WriteVirtualTextureDescriptors(UINT uiFrameIdx)
 {
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
+	VkDescriptorImageInfo pageTableInfo{};
+	pageTableInfo.imageView = m_VirtualTexturePageTableView;
+	pageTableInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+	pageTableInfo.sampler = m_VirtualTexturePageTableSampler;
+
+	VkDescriptorBufferInfo constantInfo{};
+	constantInfo.buffer = m_VirtualTextureConstantBuffer;
+	constantInfo.offset = 0;
+	constantInfo.range = sizeof(VirtualTextureConstants);
+
+	//每帧写入各自的区间，CPU在该帧的fence之后读取
+	VkDescriptorBufferInfo feedbackInfo{};
+	feedbackInfo.buffer = m_VirtualTextureFeedbackBuffer;
+	feedbackInfo.offset = m_uiVirtualTextureFeedbackFrameSize * uiFrameIdx;
+	feedbackInfo.range = m_uiVirtualTextureFeedbackFrameSize;
+
+	std::array<VkWriteDescriptorSet, 3> aryWrites{};
+	for (auto& write : aryWrites)
+	{
+		write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write.dstSet = m_vecDescriptorSets[uiFrameIdx];
+		write.dstArrayElement = 0;
+		write.descriptorCount = 1;
+	}
+	aryWrites[0].dstBinding = 3;
+	aryWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	aryWrites[0].pImageInfo = &pageTableInfo;
+	aryWrites[1].dstBinding = 4;
+	aryWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	aryWrites[1].pBufferInfo = &constantInfo;
+	aryWrites[2].dstBinding = 5;
+	aryWrites[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	aryWrites[2].pBufferInfo = &feedbackInfo;
+
+	vkUpdateDescriptorSets(m_LogicalDevice, static_cast<UINT>(aryWrites.size()), aryWrites.data(), 0, nullptr);
+}
 
-	CreateBufferAndBindMemory(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		stagingBuffer, stagingBufferMemory);
+void VulkanRenderer::WriteTextureDescriptor(UINT uiFrameIdx)
+{
+	VkDescriptorImageInfo imageInfo{};
+	imageInfo.imageView = GetSceneTextureView();
+	imageInfo.imageLayout = m_bVirtualTexture ? VK_IMAGE_LAYOUT_GENERAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	imageInfo.sampler = m_TextureSampler;
+
+	VkWriteDescriptorSet samplerWrite{};
+	samplerWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	samplerWrite.dstSet = m_vecDescriptorSets[uiFrameIdx];
+	samplerWrite.dstBinding = 1;
+	samplerWrite.dstArrayElement = 0;
+	samplerWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	samplerWrite.descriptorCount = 1;
+	samplerWrite.pImageInfo = &imageInfo;
+
+	vkUpdateDescriptorSets(m_LogicalDevice, 1, &samplerWrite, 0, nullptr);
+	m_vecTextureDescriptorViews[uiFrameIdx] = imageInfo.imageView;
+}
 
-	void* imageData;
-	vkMapMemory(m_LogicalDevice, stagingBufferMemory, 0, bufferSize, 0, &imageData);
-	memcpy(imageData, pData, static_cast<size_t>(bufferSize));
-	vkUnmapMemory(m_LogicalDevice, stagingBufferMemory);
+void VulkanRenderer::RefreshTextureDescriptor(UINT uiFrameIdx)
+{
+	if (m_vecTextureDescriptorViews[uiFrameIdx] != GetSceneTextureView())
+		WriteTextureDescriptor(uiFrameIdx);
+}
 
-	VkCommandBuffer singleTimeCommandBuffer = BeginSingleTimeCommand();
+VkImageView VulkanRenderer::GetSceneTextureView() const
+{
+	return (m_uiSceneTexture != TextureManager::INVALID_HANDLE) ? m_vecStreamedTextures[m_uiSceneTexture]->imageView : m_TextureImageView;
+}
 
-	VkBufferCopy copyRegion{};
-	copyRegion.srcOffset = 0;
-	copyRegion.dstOffset = 0;
-	copyRegion.size = bufferSize;
-	vkCmdCopyBuffer(singleTimeCommandBuffer, stagingBuffer, buffer, 1, &copyRegion);
+void VulkanRenderer::TransferBufferDataByStageBuffer(const void* pData, VkDeviceSize bufferSize, VkBuffer& buffer, VkDeviceSize uiDstOffset)
+{
+	const VkDeviceSize uiCopyAlignment = std::max<VkDeviceSize>(4,
+		m_mapPhysicalDeviceInfo.at(m_PhysicalDevice).properties.limits.optimalBufferCopyOffsetAlignment);
 
-	EndSingleTimeCommand(singleTimeCommandBuffer);
+	//超过环单次分配上限的数据分块写入，环满时会等待最早的提交完成后复用其空间
+	VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+	for (VkDeviceSize uiCopied = 0; uiCopied < bufferSize;)
+	{
+		VkDeviceSize uiChunkSize = std::min(bufferSize - uiCopied, m_StagingBufferRing.GetMaxAllocationSize());
+
+		VkDeviceSize uiStagingOffset = 0;
+		void* pStagingData = nullptr;
+		commandBuffer = m_StagingBufferRing.Allocate(uiChunkSize, uiCopyAlignment, uiStagingOffset, pStagingData);
+		memcpy(pStagingData, static_cast<const UCHAR*>(pData) + uiCopied, static_cast<size_t>(uiChunkSize));
+
+		VkBufferCopy copyRegion{};
+		copyRegion.srcOffset = uiStagingOffset;
+		copyRegion.dstOffset = uiDstOffset + uiCopied;
+		copyRegion.size = uiChunkSize;
+		vkCmdCopyBuffer(commandBuffer, m_StagingBufferRing.GetBuffer(), buffer, 1, &copyRegion);
+
+		uiCopied += uiChunkSize;
+	}
+
+	if (commandBuffer == VK_NULL_HANDLE)
+		return;
+
+	//不再等待队列空闲，由barrier（独立传输队列时为所有权转移）保证之后的绘制在读取顶点/索引前copy已完成
+	m_StagingBufferRing.FinishBuffer(buffer, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+		uiDstOffset, bufferSize);
+}
+
+UploadToken VulkanRenderer::SubmitUploadBatch()
+{
+	return m_StagingBufferRing.Submit();
+}
+
+void VulkanRenderer::CreateGeometryBuffers(VkDeviceSize uiVertexCapacity, VkDeviceSize uiIndexCapacity)
+{
+	//创建device local的共用缓冲，作为上传的dst；TRANSFER_SRC用于Rebuild时复制到新缓冲
+	//HOST_VISIBLE时CPU直接写入映射地址，跳过暂存缓冲
+	CreateBuffer(uiVertexCapacity, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, m_VertexBuffer);
+	CreateBuffer(uiIndexCapacity, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, m_IndexBuffer);
+
+	//可用的内存类型由buffer的memoryTypeBits决定，两个缓冲都需放入同一类型才能统一按直接写入处理
+	VkMemoryRequirements vertexRequirements;
+	VkMemoryRequirements indexRequirements;
+	vkGetBufferMemoryRequirements(m_LogicalDevice, m_VertexBuffer, &vertexRequirements);
+	vkGetBufferMemoryRequirements(m_LogicalDevice, m_IndexBuffer, &indexRequirements);
+
+	//扩容后超出预算时不再直接写入，之后的网格改用暂存上传
+	VkMemoryPropertyFlags requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;	//具有性能最佳的DeviceLocal显存类型
+	VkMemoryPropertyFlags preferredFlags = 0;
+	if (m_bDirectGeometryWrite)
+	{
+		UINT uiTypeIndex = TryFindSuitableMemoryTypeIndex(vertexRequirements.memoryTypeBits & indexRequirements.memoryTypeBits,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+		if (uiTypeIndex != UINT32_MAX && m_MemoryAllocator.IsWithinBudget(uiTypeIndex, vertexRequirements.size + indexRequirements.size))
+		{
+			requiredFlags |= VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+			preferredFlags = VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+		}
+		else
+		{
+			m_bDirectGeometryWrite = false;
+			Log::Warn(std::format("Geometry pool of {} MB exceeds the host visible device local budget or its memory types, switch to staging copy",
+				(uiVertexCapacity + uiIndexCapacity) >> 20));
+		}
+	}
+
+	AllocateBufferMemory(requiredFlags, preferredFlags, MemoryCategory::Vertex, m_VertexBuffer, m_VertexBufferAllocation);
+	vkBindBufferMemory(m_LogicalDevice, m_VertexBuffer, m_VertexBufferAllocation.memory, m_VertexBufferAllocation.offset);
+	AllocateBufferMemory(requiredFlags, preferredFlags, MemoryCategory::Index, m_IndexBuffer, m_IndexBufferAllocation);
+	vkBindBufferMemory(m_LogicalDevice, m_IndexBuffer, m_IndexBufferAllocation.memory, m_IndexBufferAllocation.offset);
+}
+
+void VulkanRenderer::DestroyGeometryBuffers()
+{
+	if (m_VertexBuffer != VK_NULL_HANDLE)
+	{
+		vkDestroyBuffer(m_LogicalDevice, m_VertexBuffer, nullptr);
+		m_MemoryAllocator.Free(m_VertexBufferAllocation);
+		m_VertexBuffer = VK_NULL_HANDLE;
+	}
+
+	if (m_IndexBuffer != VK_NULL_HANDLE)
+	{
+		vkDestroyBuffer(m_LogicalDevice, m_IndexBuffer, nullptr);
+		m_MemoryAllocator.Free(m_IndexBufferAllocation);
+		m_IndexBuffer = VK_NULL_HANDLE;
+	}
+	m_vecPendingGeometryCopies.clear();
+}
+
+bool VulkanRenderer::RebuildGeometryBuffers(VkDeviceSize uiVertexCapacity, VkDeviceSize uiIndexCapacity)
+{
+	//写入旧缓冲的上传排在本帧之前提交，本帧的复制在图形队列上排在其后
+	SubmitUploadBatch();
+
+	//待回收的区间仍可能被in flight的帧使用（这些帧绑定的是旧缓冲），照常复制，之后从新的池中归还
+	std::vector<VkBufferCopy> vecVertexCopies;
+	std::vector<VkBufferCopy> vecIndexCopies;
+	if (!m_GeometryPool.Rebuild(uiVertexCapacity, uiIndexCapacity, vecVertexCopies, vecIndexCopies))
+	{
+		Log::Warn(std::format("Rebuild geometry pool failed : capacity {} / {} bytes is too small", uiVertexCapacity, uiIndexCapacity));
+		return false;
+	}
+
+	VkBuffer oldVertexBuffer = m_VertexBuffer;
+	VkBuffer oldIndexBuffer = m_IndexBuffer;
+	m_vecRetiredBuffers.push_back({ m_VertexBuffer, m_VertexBufferAllocation, m_uiTotalFrameCount });
+	m_vecRetiredBuffers.push_back({ m_IndexBuffer, m_IndexBufferAllocation, m_uiTotalFrameCount });
+
+	CreateGeometryBuffers(uiVertexCapacity, uiIndexCapacity);
+
+	//GPU上直接复制，旧缓冲此时归图形队列所有，因此录制在本帧的CommandBuffer中；之前提交的帧仍读取旧缓冲
+	if (!vecVertexCopies.empty() || !vecIndexCopies.empty())
+		m_vecPendingGeometryCopies.push_back({ oldVertexBuffer, m_VertexBuffer, oldIndexBuffer, m_IndexBuffer, std::move(vecVertexCopies), std::move(vecIndexCopies) });
+
+	Log::Info(std::format("Rebuild geometry pool : {} meshes, vertex {} / {} bytes, index {} / {} bytes",
+		m_GeometryPool.GetMeshCount(),
+		m_GeometryPool.GetVertexUsedSize(), m_GeometryPool.GetVertexCapacity(),
+		m_GeometryPool.GetIndexUsedSize(), m_GeometryPool.GetIndexCapacity()));
+	return true;
+}
+
+void VulkanRenderer::RecordPendingGeometryCopies(VkCommandBuffer commandBuffer)
+{
+	for (const auto& pending : m_vecPendingGeometryCopies)
+	{
+		//源区间可能刚由上传写入（已由FinishBuffer对VERTEX_INPUT可见），或由上一次重建的复制写入
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+			0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+		if (!pending.vecVertexCopies.empty())
+			vkCmdCopyBuffer(commandBuffer, pending.srcVertexBuffer, pending.dstVertexBuffer, static_cast<uint32_t>(pending.vecVertexCopies.size()), pending.vecVertexCopies.data());
+		if (!pending.vecIndexCopies.empty())
+			vkCmdCopyBuffer(commandBuffer, pending.srcIndexBuffer, pending.dstIndexBuffer, static_cast<uint32_t>(pending.vecIndexCopies.size()), pending.vecIndexCopies.data());
+
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+			0, 1, &barrier, 0, nullptr, 0, nullptr);
+	}
+	m_vecPendingGeometryCopies.clear();
+}
+
+void VulkanRenderer::DefragmentGeometry()
+{
+	m_bDefragmentGeometryPending = false;
+	RebuildGeometryBuffers(m_GeometryPool.GetVertexCapacity(), m_GeometryPool.GetIndexCapacity());
+}
+
+UINT VulkanRenderer::AllocateGeometry(VkDeviceSize uiVertexSize, UINT uiVertexStride, VkDeviceSize uiIndexSize)
+{
+	UINT uiHandle = m_GeometryPool.Allocate(uiVertexSize, uiVertexStride, uiIndexSize);
+	if (uiHandle != GeometryPool::INVALID_HANDLE)
+		return uiHandle;
+
+	//空闲总量足够时先整理碎片，否则把不足的一方容量翻倍直到能容纳
+	VkDeviceSize uiVertexCapacity = m_GeometryPool.GetVertexCapacity();
+	VkDeviceSize uiIndexCapacity = m_GeometryPool.GetIndexCapacity();
+	bool bGrow = false;
+	while (true)
+	{
+		if (bGrow)
+		{
+			if (m_GeometryPool.GetVertexUsedSize() + uiVertexSize > uiVertexCapacity / 2)
+				uiVertexCapacity *= 2;
+			if (m_GeometryPool.GetIndexUsedSize() + uiIndexSize > uiIndexCapacity / 2)
+				uiIndexCapacity *= 2;
+		}
+
+		if (RebuildGeometryBuffers(uiVertexCapacity, uiIndexCapacity))
+		{
+			uiHandle = m_GeometryPool.Allocate(uiVertexSize, uiVertexStride, uiIndexSize);
+			if (uiHandle != GeometryPool::INVALID_HANDLE)
+				return uiHandle;
+		}
 
-	vkDestroyBuffer(m_LogicalDevice, stagingBuffer, nullptr);
-	vkFreeMemory(m_LogicalDevice, stagingBufferMemory, nullptr);
+		ASSERT(!bGrow || uiVertexCapacity < (1ull << 40), "Geometry pool grow failed");
+		bGrow = true;
+	}
 }
 
-void VulkanRenderer::CreateVertexBuffer()
+void VulkanRenderer::CreateMeshGeometry()
 {
-	Log::Info(std::format("Vertex count : {}", m_Vertices.size()));
+	Log::Info(std::format("Vertex count : {}", m_pMeshData->GetVertexCount()));
+	Log::Info(std::format("Index buffer size : {} bytes", m_pMeshData->GetIndexDataSize()));
 
-	ASSERT(m_Vertices.size() > 0, "Vertex data empty");
+	//模型仍在异步加载时先不分配，由PollModelLoad在加载完成后分配
+	if (m_pMeshData->GetVertexCount() == 0)
+		return;
 
-	VkDeviceSize verticesSize = sizeof(m_Vertices[0]) * m_Vertices.size();
+	VkDeviceSize verticesSize = static_cast<VkDeviceSize>(m_pMeshData->GetVertexStride()) * m_pMeshData->GetVertexCount();
+	VkDeviceSize indicesSize = m_pMeshData->GetIndexDataSize();
 
-	//device localvertexBufferMemoryΪtransferdst
-	CreateBufferAndBindMemory(verticesSize,
-		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, //;ΪtransferdstԼvertexBuffer
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,	//ѵDeviceLocalԴ
-		m_VertexBuffer, m_VertexBufferMemory);
+	m_uiMeshGeometry = AllocateGeometry(verticesSize, m_pMeshData->GetVertexStride(), indicesSize);
+	const GeometryRange& geometry = m_GeometryPool.GetRange(m_uiMeshGeometry);
 
-	TransferBufferDataByStageBuffer(m_Vertices.data(), verticesSize, m_VertexBuffer);
+	//只上传并转移本网格的区间
+	WriteGeometryData(m_pMeshData->GetVertexData(), verticesSize, m_VertexBuffer, m_VertexBufferAllocation, geometry.uiVertexByteOffset);
+	if (indicesSize > 0)
+		WriteGeometryData(m_pMeshData->GetIndexData(), indicesSize, m_IndexBuffer, m_IndexBufferAllocation, geometry.uiIndexByteOffset);
 }
 
-void VulkanRenderer::CreateIndexBuffer()
+void VulkanRenderer::WriteGeometryData(const void* pData, VkDeviceSize uiSize, VkBuffer& buffer, const MemoryAllocation& allocation, VkDeviceSize uiDstOffset)
 {
-	Log::Info(std::format("Index count : {}", m_Indices.size()));
+	if (allocation.pMappedData == nullptr)
+	{
+		TransferBufferDataByStageBuffer(pData, uiSize, buffer, uiDstOffset);
+		return;
+	}
+
+	//缓冲位于HOST_VISIBLE的显存中，直接写入；该区间尚未被任何绘制引用，不需要等待GPU
+	//之后的vkQueueSubmit保证主机写入对设备可见，不需要额外的barrier
+	memcpy(static_cast<UCHAR*>(allocation.pMappedData) + uiDstOffset, pData, static_cast<size_t>(uiSize));
+	m_MemoryAllocator.Flush(allocation, uiDstOffset, uiSize);
+}
 
-	if (m_Indices.size() == 0)
+void VulkanRenderer::RetireMeshGeometry()
+{
+	if (!m_GeometryPool.IsValid(m_uiMeshGeometry))
 		return;
 
-	VkDeviceSize indicesSize = sizeof(m_Indices[0]) * m_Indices.size();
+	m_vecRetiredGeometries.push_back({ m_uiMeshGeometry, m_uiTotalFrameCount });
+	m_uiMeshGeometry = GeometryPool::INVALID_HANDLE;
+}
 
-	CreateBufferAndBindMemory(indicesSize,
-		VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-		m_IndexBuffer, m_IndexBufferMemory);
+void VulkanRenderer::DestroyMeshGeometry()
+{
+	if (!m_GeometryPool.IsValid(m_uiMeshGeometry))
+		return;
 
-	TransferBufferDataByStageBuffer(m_Indices.data(), indicesSize, m_IndexBuffer);
+	m_GeometryPool.Free(m_uiMeshGeometry);
+	m_uiMeshGeometry = GeometryPool::INVALID_HANDLE;
 }
 
 void VulkanRenderer::CreateCommandPool()
@@ -1728,7 +4433,7 @@ void VulkanRenderer::CreateCommandBuffer()
 
 void VulkanRenderer::CreateGraphicPipeline()
 {
-	/****************************ɱ̹*******************************/
+	/****************************可编程管线*******************************/
 
 	ASSERT(m_mapShaderModule.find(VK_SHADER_STAGE_VERTEX_BIT) != m_mapShaderModule.end(), "No vertex shader module");
 	ASSERT(m_mapShaderModule.find(VK_SHADER_STAGE_FRAGMENT_BIT) != m_mapShaderModule.end(), "No fragment shader module");
@@ -1737,23 +4442,23 @@ void VulkanRenderer::CreateGraphicPipeline()
 	vertShaderStageCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 	vertShaderStageCreateInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
 	vertShaderStageCreateInfo.module = m_mapShaderModule.at(VK_SHADER_STAGE_VERTEX_BIT); //Bytecode
-	vertShaderStageCreateInfo.pName = "main"; //Ҫinvokeĺ
+	vertShaderStageCreateInfo.pName = "main"; //要invoke的函数
 
 	VkPipelineShaderStageCreateInfo fragShaderStageCreateInfo{};
 	fragShaderStageCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 	fragShaderStageCreateInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
 	fragShaderStageCreateInfo.module = m_mapShaderModule.at(VK_SHADER_STAGE_FRAGMENT_BIT); //Bytecode
-	fragShaderStageCreateInfo.pName = "main"; //Ҫinvokeĺ
+	fragShaderStageCreateInfo.pName = "main"; //要invoke的函数
 
 	VkPipelineShaderStageCreateInfo shaderStageCreateInfos[] = {
 		vertShaderStageCreateInfo,
 		fragShaderStageCreateInfo,
 	};
 
-	/*****************************̶*******************************/
+	/*****************************固定管线*******************************/
 
 	//-----------------------Dynamic State--------------------------//
-	//һὫViewportScissorΪdynamicԷʱ޸
+	//一般会将Viewport和Scissor设为dynamic，以方便随时修改
 	VkPipelineDynamicStateCreateInfo dynamicStateCreateInfo{};
 	dynamicStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
 	if (m_bViewportAndScissorIsDynamic)
@@ -1767,8 +4472,9 @@ void VulkanRenderer::CreateGraphicPipeline()
 	}
 
 	//-----------------------Vertex Input State--------------------------//
-	auto bindingDescription = Vertex3D::GetBindingDescription();
-	auto attributeDescriptions = Vertex3D::GetAttributeDescriptions();
+	//按当前模型的顶点格式选择顶点输入布局
+	auto bindingDescription = (m_VertexFormat == VertexFormat::Packed) ? PackedVertex3D::GetBindingDescription() : Vertex3D::GetBindingDescription();
+	auto attributeDescriptions = (m_VertexFormat == VertexFormat::Packed) ? PackedVertex3D::GetAttributeDescriptions() : Vertex3D::GetAttributeDescriptions();
 	VkPipelineVertexInputStateCreateInfo vertexInputCreateInfo{};
 	vertexInputCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
 	vertexInputCreateInfo.vertexBindingDescriptionCount = 1;
@@ -1788,10 +4494,10 @@ void VulkanRenderer::CreateGraphicPipeline()
 	viewportStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
 	viewportStateCreateInfo.viewportCount = 1;
 	viewportStateCreateInfo.scissorCount = 1;
-	//ûаViewportScissorΪdynamic stateҪڴ˴ָʹ÷õViewportǲɱģ
+	//如果没有把Viewport和Scissor设为dynamic state，则需要在此处指定（使用这种设置方法，设置的Viewport是不可变的）
 	if (!m_bViewportAndScissorIsDynamic)
 	{
-		//ViewportΧΪ[0,0][width,height]
+		//设置Viewport，范围为[0,0]到[width,height]
 		VkViewport viewport{};
 		viewport.x = 0.f;
 		viewport.y = 0.f;
@@ -1800,7 +4506,7 @@ void VulkanRenderer::CreateGraphicPipeline()
 		viewport.minDepth = 0.f;
 		viewport.maxDepth = 1.f;
 
-		//òüScissor Rectangle
+		//设置裁剪区域Scissor Rectangle
 		VkRect2D scissor{};
 		scissor.offset = { 0,0 };
 		VkExtent2D ScissorExtent;
@@ -1815,13 +4521,13 @@ void VulkanRenderer::CreateGraphicPipeline()
 	//-----------------------Raserization State--------------------------//
 	VkPipelineRasterizationStateCreateInfo rasterizationStateCreateInfo{};
 	rasterizationStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-	rasterizationStateCreateInfo.depthClampEnable = VK_FALSE;	//󣬳ԶƽĲֻᱻضԶƽϣǶ
-	rasterizationStateCreateInfo.rasterizerDiscardEnable = VK_FALSE;	//󣬽ֹͼԪդ
-	rasterizationStateCreateInfo.polygonMode = VK_POLYGON_MODE_FILL;	//ͼԪģʽFILLLINEPOINT
-	rasterizationStateCreateInfo.lineWidth = 1.f;	//ָդ߶ο
-	rasterizationStateCreateInfo.cullMode = VK_CULL_MODE_NONE;	//޳ģʽNONEFRONTBACKFRONT_AND_BACK
-	rasterizationStateCreateInfo.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE; //򣬿˳ʱcwʱccw
-	rasterizationStateCreateInfo.depthBiasEnable = VK_FALSE; //ƫƣһShaodw MapбӰ
+	rasterizationStateCreateInfo.depthClampEnable = VK_FALSE;	//开启后，超过远近平面的部分会被截断在远近平面上，而不是丢弃
+	rasterizationStateCreateInfo.rasterizerDiscardEnable = VK_FALSE;	//开启后，禁止所有图元经过光栅化器
+	rasterizationStateCreateInfo.polygonMode = VK_POLYGON_MODE_FILL;	//图元模式，可以是FILL、LINE、POINT
+	rasterizationStateCreateInfo.lineWidth = 1.f;	//指定光栅化后的线段宽度
+	rasterizationStateCreateInfo.cullMode = VK_CULL_MODE_NONE;	//剔除模式，可以是NONE、FRONT、BACK、FRONT_AND_BACK
+	rasterizationStateCreateInfo.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE; //顶点序，可以是顺时针cw或逆时针ccw
+	rasterizationStateCreateInfo.depthBiasEnable = VK_FALSE; //深度偏移，一般用于Shaodw Map中避免阴影痤疮
 	rasterizationStateCreateInfo.depthBiasConstantFactor = 0.f;
 	rasterizationStateCreateInfo.depthBiasClamp = 0.f;
 	rasterizationStateCreateInfo.depthBiasSlopeFactor = 0.f;
@@ -1829,7 +4535,7 @@ void VulkanRenderer::CreateGraphicPipeline()
 	//-----------------------Multisample State--------------------------//
 	VkPipelineMultisampleStateCreateInfo multisamplingStateCreateInfo{};
 	multisamplingStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-	multisamplingStateCreateInfo.sampleShadingEnable = (VkBool32)(m_uiMipmapLevel > 1);
+	multisamplingStateCreateInfo.sampleShadingEnable = VK_FALSE;	//单采样，且未启用sampleRateShading
 	multisamplingStateCreateInfo.minSampleShading = 0.8f;
 	multisamplingStateCreateInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
 	multisamplingStateCreateInfo.minSampleShading = 1.f;
@@ -1920,7 +4626,7 @@ void VulkanRenderer::CreateSyncObjects()
 
 	VkFenceCreateInfo fenceCreateInfo{};
 	fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-	fenceCreateInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT; //ֵΪsignaled
+	fenceCreateInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT; //初值为signaled
 
 	for (int i = 0; i < m_vecSwapChainImages.size(); ++i)
 	{
@@ -1948,8 +4654,42 @@ void VulkanRenderer::SetupCamera()
 	);
 }
 
+glm::mat4 VulkanRenderer::GetModelMatrix() const
+{
+	glm::mat4 model = glm::translate(glm::mat4(1.f), { 0.f, 0.f, 0.f });
+	if (m_pMeshData->vertexFormat == VertexFormat::Packed)
+	{
+		//Packed格式的位置是量化后的[-1, 1]坐标，反量化并入模型矩阵
+		const auto& quantization = m_pMeshData->GetVertexQuantization();
+		model = model * glm::translate(glm::mat4(1.f), quantization.center) * glm::scale(glm::mat4(1.f), quantization.extent);
+	}
+	return model;
+}
+
+UINT VulkanRenderer::SelectSubMeshLOD(const SubMesh& subMesh) const
+{
+	if (!m_bEnableLOD || subMesh.uiLODCount == 0)
+		return 0;
+
+	//模型矩阵为单位矩阵，包围球直接在世界空间中与相机比较；相机位于包围球内时使用LOD0
+	float fDistance = glm::length(m_Camera.GetPosition() - subMesh.boundCenter) - subMesh.fBoundRadius;
+	if (fDistance <= 0.f)
+		return 0;
+
+	//距离fDistance处单位长度在屏幕上的像素数，proj[1][1] = 1 / tan(fov / 2)
+	float fPixelsPerUnit = m_Camera.GetProjMatrix()[1][1] * 0.5f * static_cast<float>(m_SwapChainExtent2D.height) / fDistance;
+
+	//选择投影误差仍不超过阈值的最粗一级
+	UINT uiLevel = 0;
+	while (uiLevel < subMesh.uiLODCount && subMesh.aryLODs[uiLevel].fError * fPixelsPerUnit <= m_fLODPixelError)
+		++uiLevel;
+	return uiLevel;
+}
+
 void VulkanRenderer::RecordCommandBuffer(VkCommandBuffer& commandBuffer, UINT uiIdx)
 {
+	m_aryLODStats.fill({});
+
 	VkCommandBufferBeginInfo commandBufferBeginInfo{};
 	commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 	commandBufferBeginInfo.flags = 0;
@@ -1957,6 +4697,12 @@ void VulkanRenderer::RecordCommandBuffer(VkCommandBuffer& commandBuffer, UINT ui
 
 	VULKAN_ASSERT(vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo), "Begin command buffer failed");
 
+	//拷贝不能在render pass内录制
+	RecordVirtualTextureUploads(commandBuffer);
+	RecordPendingMipmapGenerations(commandBuffer);
+	RecordPendingTextureCopies(commandBuffer);
+	RecordPendingGeometryCopies(commandBuffer);
+
 	VkRenderPassBeginInfo renderPassBeginInfo{};
 	renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
 	renderPassBeginInfo.renderPass = m_RenderPass;
@@ -1990,29 +4736,67 @@ void VulkanRenderer::RecordCommandBuffer(VkCommandBuffer& commandBuffer, UINT ui
 		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 	}
 
+	//模型异步加载完成前只清屏
+	if (!m_GeometryPool.IsValid(m_uiMeshGeometry))
+	{
+		vkCmdEndRenderPass(commandBuffer);
+		VULKAN_ASSERT(vkEndCommandBuffer(commandBuffer), "End command buffer failed");
+		return;
+	}
+
 	VkBuffer vertexBuffers[] = {
 		m_VertexBuffer,
 	};
 	VkDeviceSize offsets[]{ 0 };
 	vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
 
-	vkCmdBindDescriptorSets(commandBuffer,
-		VK_PIPELINE_BIND_POINT_GRAPHICS, //descriptorSetPipelineУҪָGraphic PipelineCompute Pipeline
-		m_GraphicPipelineLayout, //PipelineLayoutָdescriptorSetLayout
-		0,	//descriptorSetеһԪص± 
-		1,	//descriptorSetԪصĸ
-		&m_vecDescriptorSets[uiIdx],
-		0, nullptr	//ָ̬descriptorƫ
-	);
-	if (m_Indices.size() > 0)
+	//顶点/索引缓冲由所有网格共用，整个场景只绑定一次，模型在其中的位置由几何池的区间给出
+	const GeometryRange& geometry = m_GeometryPool.GetRange(m_uiMeshGeometry);
+
+	//逐个SubMesh绘制，vertexOffset会加到每个索引上，因此各区间的索引可以保持局部值
+	//索引类型相同的相邻区间共用一次vkCmdBindIndexBuffer，firstIndex由字节偏移换算
+	//每帧按相机距离为每个SubMesh选择LOD，各级LOD共用顶点，只切换索引区间
+	//每个SubMesh作为一个物体，其变换位于动态Uniform Buffer的第i个槽位
+	//所有物体共用本帧的descriptorSet，逐个绘制时只更换动态偏移
+	VkIndexType boundIndexType = VK_INDEX_TYPE_MAX_ENUM;
+	const SubMesh* pSubMeshes = m_pMeshData->GetSubMeshData();
+	for (size_t i = 0; i < m_pMeshData->GetSubMeshCount(); ++i)
 	{
-		vkCmdBindIndexBuffer(commandBuffer, m_IndexBuffer, 0, VK_INDEX_TYPE_UINT32);
-		vkCmdDrawIndexed(commandBuffer, static_cast<UINT>(m_Indices.size()), 1, 0, 0, 0);
+		const SubMesh& subMesh = pSubMeshes[i];
+
+		UINT uiDynamicOffset = static_cast<UINT>(i * m_uiDynamicUniformAlignment);
+		vkCmdBindDescriptorSets(commandBuffer,
+			VK_PIPELINE_BIND_POINT_GRAPHICS, //descriptorSet并非Pipeline独有，因此需要指定是用于Graphic Pipeline还是Compute Pipeline
+			m_GraphicPipelineLayout, //PipelineLayout中指定了descriptorSetLayout
+			0,	//descriptorSet数组中第一个元素的下标 
+			1,	//descriptorSet数组中元素的个数
+			&m_vecDescriptorSets[m_uiCurFrameIdx],	//与UpdateUniformBuffer写入的缓冲一致，按帧而非SwapChain图像索引
+			1, &uiDynamicOffset	//指定动态descriptor的偏移
+		);
+		if (subMesh.uiIndexCount > 0)
+		{
+			for (UINT uiLevel = 0; uiLevel <= subMesh.uiLODCount; ++uiLevel)
+				m_aryLODStats[uiLevel].uiTriangleCount += subMesh.GetLOD(uiLevel).uiIndexCount / 3;
+
+			UINT uiLevel = SelectSubMeshLOD(subMesh);
+			SubMeshLOD lod = subMesh.GetLOD(uiLevel);
+			m_aryLODStats[uiLevel].uiDrawTriangleCount += lod.uiIndexCount / 3;
+			m_aryLODStats[uiLevel].uiDrawSubMeshCount++;
+
+			if (subMesh.indexType != boundIndexType)
+			{
+				vkCmdBindIndexBuffer(commandBuffer, m_IndexBuffer, 0, subMesh.indexType);
+				boundIndexType = subMesh.indexType;
+			}
+			vkCmdDrawIndexed(commandBuffer, lod.uiIndexCount, 1, geometry.GetFirstIndex(lod.uiIndexByteOffset, subMesh.GetIndexSize()),
+				geometry.GetVertexOffset() + static_cast<int32_t>(subMesh.uiVertexOffset), 0);
+		}
+		else
+			vkCmdDraw(commandBuffer, subMesh.uiVertexCount, 1, geometry.GetVertexOffset() + subMesh.uiVertexOffset, 0);
 	}
-	else
-		vkCmdDraw(commandBuffer, static_cast<UINT>(m_Vertices.size()), 1, 0, 0);
 
 	vkCmdEndRenderPass(commandBuffer);
+	RecordVirtualTextureFeedbackBarrier(commandBuffer);
 
 	VULKAN_ASSERT(vkEndCommandBuffer(commandBuffer), "End command buffer failed");
 }
@@ -2030,34 +4814,71 @@ void VulkanRenderer::UpdateUniformBuffer(UINT uiIdx)
 	auto AxisY = glm::vec3(0.f, 1.f, 0.f);
 	auto AxisZ = glm::vec3(0.f, 0.f, 1.f);
 
-	UniformBufferObject ubo{};
-
 	glm::vec3 cameraPos = { 0.f, 0.f, 5.f };
 
-	ubo.model = glm::translate(glm::mat4(1.f), { 0.f, 0.f, 0.f });
-	//ubo.view = glm::lookAt(cameraPos, { 0.f, 0.f, 0.f }, {0.f, 1.f, 0.f});
-	ubo.view = m_Camera.GetViewMatrix();
-	ubo.proj = m_Camera.GetProjMatrix();
-	//OpenGLVulkanĲ - YǷ
-	ubo.proj[1][1] *= -1.f;
+	//每帧的数据，所有物体共用
+	PerFrameConstants perFrame{};
+	//perFrame.view = glm::lookAt(cameraPos, { 0.f, 0.f, 0.f }, {0.f, 1.f, 0.f});
+	perFrame.view = m_Camera.GetViewMatrix();
+	perFrame.proj = m_Camera.GetProjMatrix();
+	//OpenGL与Vulkan的差异 - Y坐标是反的
+	perFrame.proj[1][1] *= -1.f;
+
+	//只写入与上次内容相比变化的部分，相机不动时不写入
+	const auto& frameAllocation = m_vecUniformBufferAllocations[uiIdx];
+	size_t uiDirtyOffset = 0;
+	size_t uiDirtySize = 0;
+	if (m_PerFrameConstantsWriter.Write(uiIdx, perFrame, frameAllocation.pMappedData, uiDirtyOffset, uiDirtySize))
+		m_MemoryAllocator.Flush(frameAllocation, uiDirtyOffset, uiDirtySize);
+
+	//每次绘制的数据，每个物体写入自己的槽位，SubMesh目前没有单独的变换，共用模型矩阵
+	PerDrawConstants perDraw{};
+	perDraw.model = GetModelMatrix();
+
+	//替换后的模型物体更多时，在这里按帧扩容
+	UINT uiObjectCount = static_cast<UINT>(m_pMeshData->GetSubMeshCount());
+	ReserveDynamicUniformBuffer(uiIdx, uiObjectCount);
+	const auto& allocation = m_vecDynamicUniformBufferAllocations[uiIdx];
+	auto& perDrawWriter = m_vecPerDrawConstantsWriters[uiIdx];
+
+	size_t uiFlushBegin = SIZE_MAX;
+	size_t uiFlushEnd = 0;
+	for (UINT i = 0; i < uiObjectCount; ++i)
+	{
+		size_t uiSlotOffset = i * m_uiDynamicUniformAlignment;
+		if (perDrawWriter.Write(i, perDraw,
+			static_cast<UCHAR*>(allocation.pMappedData) + uiSlotOffset, uiDirtyOffset, uiDirtySize))
+		{
+			uiFlushBegin = std::min(uiFlushBegin, uiSlotOffset + uiDirtyOffset);
+			uiFlushEnd = uiSlotOffset + uiDirtyOffset + uiDirtySize;
+		}
+	}
 
-	void* uniformBufferData;
-	vkMapMemory(m_LogicalDevice, m_vecUniformBufferMemories[uiIdx], 0, sizeof(ubo), 0, &uniformBufferData);
-	memcpy(uniformBufferData, &ubo, sizeof(ubo));
-	vkUnmapMemory(m_LogicalDevice, m_vecUniformBufferMemories[uiIdx]);
+	//各槽位的变化合并为一次Flush；HOST_COHERENT的内存无需Flush，这里直接返回
+	if (uiFlushEnd > 0)
+		m_MemoryAllocator.Flush(allocation, uiFlushBegin, uiFlushEnd - uiFlushBegin);
 }
 
 void VulkanRenderer::Render()
 {
 	m_uiFrameCounter++;
 
+	PollModelLoad();
+	PollTextureDecode();
+	//在本帧录制任何命令之前整理，复制录制在本帧中，旧缓冲等之前提交的帧与本帧都执行完之后才销毁
+	if (m_bDefragmentGeometryPending)
+		DefragmentGeometry();
+	//回收已完成的上传占用的暂存空间与CommandBuffer
+	m_StagingBufferRing.Retire();
+
 	if (!ImGui::IsWindowHovered(ImGuiHoveredFlags_AnyWindow) && !ImGui::IsAnyItemActive())
 		m_Camera.Tick();
 
 	g_UI.StartNewFrame();
 
-	//ȴfenceֵΪsignaled
+	//等待fence的值变为signaled
 	vkWaitForFences(m_LogicalDevice, 1, &m_vecInFlightFences[m_uiCurFrameIdx], VK_TRUE, UINT64_MAX);
+	ReleaseRetiredResources(false);
 
 	uint32_t uiImageIdx;
 	VkResult res = vkAcquireNextImageKHR(m_LogicalDevice, m_SwapChain, UINT64_MAX,
@@ -2066,14 +4887,14 @@ void VulkanRenderer::Render()
 	{
 		if (res == VK_ERROR_OUT_OF_DATE_KHR)
 		{
-			//SwapChainWindowSurfaceݣ޷Ⱦ
-			//һ㷢windowߴıʱ
+			//SwapChain与WindowSurface不兼容，无法继续渲染
+			//一般发生在window尺寸改变时
 			RecreateSwapChain();
 			return;
 		}
 		else if (res == VK_SUBOPTIMAL_KHR)
 		{
-			//SwapChainȻãWindowSurfacepropertiesȫƥ
+			//SwapChain仍然可用，但是WindowSurface的properties不完全匹配
 		}
 		else
 		{
@@ -2081,29 +4902,38 @@ void VulkanRenderer::Render()
 		}
 	}
 
-	//fenceΪunsignaled
+	//重设fence为unsignaled
 	vkResetFences(m_LogicalDevice, 1, &m_vecInFlightFences[m_uiCurFrameIdx]);
 
 	//auto uiCommandBuffer = g_UI.FillCommandBuffer(*this, m_uiCurFrameIdx);
 
 	vkResetCommandBuffer(m_vecCommandBuffers[m_uiCurFrameIdx], 0);
 
+	//该帧的fence已signal，其Uniform Buffer不再被GPU读取
+	UpdateUniformBuffer(m_uiCurFrameIdx);
+	//同理，该帧的descriptorSet与稀疏纹理的暂存区间可以改写
+	UpdateVirtualTexture(m_uiCurFrameIdx);
+	UpdateTextureStreaming();
+	RefreshTextureDescriptor(m_uiCurFrameIdx);
+
 	RecordCommandBuffer(m_vecCommandBuffers[m_uiCurFrameIdx], uiImageIdx);
 
 	auto uiCommandBuffer = g_UI.FillCommandBuffer(m_uiCurFrameIdx);
 
-	UpdateUniformBuffer(m_uiCurFrameIdx);
-
 	VkSubmitInfo submitInfo{};
 	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
 	VkSemaphore waitSemaphores[] = {
 		m_vecImageAvailableSemaphores[m_uiCurFrameIdx],
+		m_VirtualTextureBindSemaphore,
 	};
+	//本帧之前提交的稀疏绑定需在页拷贝与采样之前完成
 	VkPipelineStageFlags waitStages[] = {
 		VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+		VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
 	};
-	submitInfo.waitSemaphoreCount = 1;
+	submitInfo.waitSemaphoreCount = m_bVirtualTextureBindPending ? 2 : 1;
+	m_bVirtualTextureBindPending = false;
 	submitInfo.pWaitSemaphores = waitSemaphores;
 	submitInfo.pWaitDstStageMask = waitStages;
 
@@ -2120,7 +4950,7 @@ void VulkanRenderer::Render()
 	submitInfo.signalSemaphoreCount = 1;
 	submitInfo.pSignalSemaphores = signalSemaphore;
 
-	//submit֮󣬻ὫfenceΪsignaled
+	//submit之后，会将fence置为signaled
 	VULKAN_ASSERT(vkQueueSubmit(m_GraphicQueue, 1, &submitInfo, m_vecInFlightFences[m_uiCurFrameIdx]), "Submit command buffer failed");
 
 	VkPresentInfoKHR presentInfo{};
@@ -2155,11 +4985,12 @@ void VulkanRenderer::Render()
 	}
 
 	m_uiCurFrameIdx = (m_uiCurFrameIdx + 1) % static_cast<UINT>(m_vecSwapChainImages.size());
+	++m_uiTotalFrameCount;
 }
 
 void VulkanRenderer::RecreateSwapChain()
 {
-	//⴦С
+	//特殊处理窗口最小化的情况
 	int nWidth = 0;
 	int nHeight = 0;
 	glfwGetFramebufferSize(m_pWindow, &nWidth, &nHeight);
@@ -2169,12 +5000,12 @@ void VulkanRenderer::RecreateSwapChain()
 		glfwWaitEvents();
 	}
 
-	//ȴԴռ
+	//等待资源结束占用
 	vkDeviceWaitIdle(m_LogicalDevice);
 
 	vkDestroyImageView(m_LogicalDevice, m_DepthImageView, nullptr);
 	vkDestroyImage(m_LogicalDevice, m_DepthImage, nullptr);
-	vkFreeMemory(m_LogicalDevice, m_DepthImageMemory, nullptr);
+	m_MemoryAllocator.Free(m_DepthImageAllocation);
 
 	for (const auto& frameBuffer : m_vecSwapChainFrameBuffers)
 	{
@@ -2191,7 +5022,7 @@ void VulkanRenderer::RecreateSwapChain()
 	//	vkDestroyImage(m_LogicalDevice, image, nullptr);
 	//}
 
-	//SwapChain
+	//清理SwapChain
 	vkDestroySwapchainKHR(m_LogicalDevice, m_SwapChain, nullptr);
 
 	CreateSwapChain();
@@ -5,30 +5,49 @@
 
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtx/hash.hpp>
+#include <atomic>
+#include <chrono>
 #include "glm/glm.hpp"
 
 #include "Core.h"
 #include "Camera.h"
+#include "ThreadPool.h"
+#include "TextureDecoder.h"
+#include "KTX2File.h"
+#include "VirtualTexture.h"
+#include "TextureManager.h"
+#include "MeshCache.h"
+#include "DeviceMemoryAllocator.h"
+#include "StagingBufferRing.h"
+#include "GeometryPool.h"
+#include "VertexFormat.h"
+#include "ShaderConstants.h"
+
+namespace tinygltf
+{
+	class Model;
+}
 
 struct Vertex3D
 {
 	glm::vec3 pos;
 	glm::vec3 color;
 	glm::vec2 texCoord;
+	glm::vec3 normal;
 
 	static VkVertexInputBindingDescription GetBindingDescription()
 	{
 		VkVertexInputBindingDescription bindingDescription{};
-		bindingDescription.binding = 0; //binding arrayеIdx
-		bindingDescription.stride = sizeof(Vertex3D);	//ռֽ
-		bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX; //ʣΪvertexinstance
+		bindingDescription.binding = 0; //在binding array中的Idx
+		bindingDescription.stride = sizeof(Vertex3D);	//所占字节数
+		bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX; //传输速率，分为vertex或instance
 
 		return bindingDescription;
 	}
 
-	static std::array<VkVertexInputAttributeDescription, 3> GetAttributeDescriptions()
+	static std::array<VkVertexInputAttributeDescription, 4> GetAttributeDescriptions()
 	{
-		std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions{};
+		std::array<VkVertexInputAttributeDescription, 4> attributeDescriptions{};
 		attributeDescriptions[0].binding = 0;
 		attributeDescriptions[0].location = 0; //layout (location = 0) in vec3 inPosition;
 		attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
@@ -44,20 +63,231 @@ struct Vertex3D
 		attributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
 		attributeDescriptions[2].offset = offsetof(Vertex3D, texCoord);
 
+		attributeDescriptions[3].binding = 0;
+		attributeDescriptions[3].location = 3; //layout (location = 3) in vec3 inNormal;
+		attributeDescriptions[3].format = VK_FORMAT_R32G32B32_SFLOAT;
+		attributeDescriptions[3].offset = offsetof(Vertex3D, normal);
+
 		return attributeDescriptions;
 	}
 
 	bool operator==(const Vertex3D& other) const
 	{
-		return (pos == other.pos) && (texCoord == other.texCoord) && (color == other.color);
+		return (pos == other.pos) && (texCoord == other.texCoord) && (color == other.color) && (normal == other.normal);
+	}
+};
+
+//Vertex3D的压缩版本，20字节，attribute的location与Vertex3D一一对应
+struct PackedVertex3D
+{
+	uint16_t pos[4];	//snorm16，按VertexQuantization反量化，w分量仅用于对齐
+	uint8_t color[4];	//unorm8
+	uint16_t texCoord[2];	//half float，保留超出[0,1]的平铺UV
+	uint8_t normal[4];	//snorm8
+
+	static VkVertexInputBindingDescription GetBindingDescription()
+	{
+		VkVertexInputBindingDescription bindingDescription{};
+		bindingDescription.binding = 0;
+		bindingDescription.stride = sizeof(PackedVertex3D);
+		bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+		return bindingDescription;
+	}
+
+	static std::array<VkVertexInputAttributeDescription, 4> GetAttributeDescriptions()
+	{
+		std::array<VkVertexInputAttributeDescription, 4> attributeDescriptions{};
+		attributeDescriptions[0].binding = 0;
+		attributeDescriptions[0].location = 0;
+		attributeDescriptions[0].format = VK_FORMAT_R16G16B16A16_SNORM;	//三分量16位格式支持较差，补齐为四分量
+		attributeDescriptions[0].offset = offsetof(PackedVertex3D, pos);
+
+		attributeDescriptions[1].binding = 0;
+		attributeDescriptions[1].location = 1;
+		attributeDescriptions[1].format = VK_FORMAT_R8G8B8A8_UNORM;
+		attributeDescriptions[1].offset = offsetof(PackedVertex3D, color);
+
+		attributeDescriptions[2].binding = 0;
+		attributeDescriptions[2].location = 2;
+		attributeDescriptions[2].format = VK_FORMAT_R16G16_SFLOAT;
+		attributeDescriptions[2].offset = offsetof(PackedVertex3D, texCoord);
+
+		attributeDescriptions[3].binding = 0;
+		attributeDescriptions[3].location = 3;
+		attributeDescriptions[3].format = VK_FORMAT_R8G8B8A8_SNORM;
+		attributeDescriptions[3].offset = offsetof(PackedVertex3D, normal);
+
+		return attributeDescriptions;
+	}
+};
+
+//简化后的一级LOD，与原网格共用顶点，只有索引区间不同
+struct SubMeshLOD
+{
+	UINT uiFirstIndex;
+	UINT uiIndexCount;
+	UINT uiIndexByteOffset;
+	float fError;	//相对原网格的几何误差（模型空间距离）
+};
+
+//每个glTF primitive对应一个绘制区间，区间内的索引是相对uiVertexOffset的局部索引
+//绘制时通过vkCmdDrawIndexed的vertexOffset定位顶点，加载时无需逐索引加上顶点基址
+//索引上传前按区间打包，顶点数不超过uint16范围的区间使用16位索引
+//各级LOD的索引紧接在LOD0之后，与LOD0使用相同的索引类型
+struct SubMesh
+{
+	static constexpr UINT MAX_LOD_COUNT = 4;	//不含LOD0
+
+	UINT uiFirstIndex;	//在32位索引数组MeshData::vecIndices中的起始位置
+	UINT uiIndexCount;
+	UINT uiVertexOffset;
+	UINT uiVertexCount;
+
+	UINT uiIndexByteOffset;	//在打包后的索引缓冲中的字节偏移
+	VkIndexType indexType;
+
+	//包围球，用于按屏幕上的投影大小选择LOD
+	glm::vec3 boundCenter;
+	float fBoundRadius;
+
+	UINT uiLODCount;	//简化得到的LOD数，aryLODs[i]为LOD i+1
+	SubMeshLOD aryLODs[MAX_LOD_COUNT];
+
+	UINT GetIndexSize() const { return indexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t); }
+
+	SubMeshLOD GetLOD(UINT uiLevel) const
+	{
+		return (uiLevel == 0) ? SubMeshLOD{ uiFirstIndex, uiIndexCount, uiIndexByteOffset, 0.f } : aryLODs[uiLevel - 1];
+	}
+
+	//LOD0与全部LOD的索引总数，它们在vecIndices中连续存放
+	UINT GetTotalIndexCount() const
+	{
+		return (uiLODCount == 0) ? uiIndexCount : aryLODs[uiLODCount - 1].uiFirstIndex + aryLODs[uiLODCount - 1].uiIndexCount - uiFirstIndex;
+	}
+};
+
+//各级LOD的三角形数，以及当前帧实际选中该级的submesh与三角形数
+struct MeshLODStats
+{
+	size_t uiTriangleCount = 0;
+	size_t uiDrawTriangleCount = 0;
+	UINT uiDrawSubMeshCount = 0;
+};
+
+//后台读取中的一页稀疏纹理，数据读入pData后在帧开始时绑定并拷贝进image
+struct VirtualTexturePageRead
+{
+	VirtualTexture::PageLoad load;
+	std::unique_ptr<UCHAR[]> pData;
+	std::future<void> future;
+};
+
+//按mip驻留流式加载的烘焙纹理，image只包含从驻留级别开始的各级，驻留级别变化时换为新的image
+//新image只从文件上传新流入的一级，仍驻留的各级在GPU上从旧image拷贝
+struct StreamedTexture
+{
+	KTX2File file;	//保持映射，流入时从中读取新的一级
+	VkImage image = VK_NULL_HANDLE;
+	MemoryAllocation allocation;
+	VkImageView imageView = VK_NULL_HANDLE;
+	bool bBudgetRefused = false;	//上一次重建因超出显存预算被撤销，避免每帧重复输出警告
+};
+
+//被替换的image，in flight的帧执行完之后才能销毁
+struct RetiredTextureImage
+{
+	VkImage image;
+	MemoryAllocation allocation;
+	VkImageView imageView;
+	uint64_t uiRetireFrame;
+};
+
+//被替换的模型在几何池中的区间，同样等in flight的帧执行完之后才归还
+struct RetiredGeometry
+{
+	UINT uiHandle;
+	uint64_t uiRetireFrame;
+};
+
+//几何池重建后被替换的顶点/索引缓冲，本帧从中复制之后，同样等in flight的帧执行完才销毁
+struct RetiredBuffer
+{
+	VkBuffer buffer;
+	MemoryAllocation allocation;
+	uint64_t uiRetireFrame;
+};
+
+//几何池重建时从旧缓冲复制到新缓冲的区间，录制在本帧的CommandBuffer中
+struct PendingGeometryCopy
+{
+	VkBuffer srcVertexBuffer;
+	VkBuffer dstVertexBuffer;
+	VkBuffer srcIndexBuffer;
+	VkBuffer dstIndexBuffer;
+	std::vector<VkBufferCopy> vecVertexCopies;
+	std::vector<VkBufferCopy> vecIndexCopies;
+};
+
+//流式纹理换为新image时仍驻留的各级，从旧image拷贝，录制在本帧的CommandBuffer中
+struct PendingTextureCopy
+{
+	VkImage srcImage;
+	VkImage dstImage;
+	UINT uiSrcBaseLevel;
+	UINT uiDstBaseLevel;
+	UINT uiLevelCount;
+	UINT uiWidth;	//第一级的尺寸
+	UINT uiHeight;
+};
+
+//GPU生成mip链的请求，录制在下一帧的CommandBuffer中
+struct PendingMipmapGeneration
+{
+	VkImage image;
+	UINT uiWidth;
+	UINT uiHeight;
+	UINT uiMipLevel;
+};
+
+//一次模型加载得到的全部CPU端数据，可在工作线程中独立构建，完成后整体交换进渲染器
+struct MeshData
+{
+	VertexFormat vertexFormat = VertexFormat::Float;
+
+	std::vector<Vertex3D> vecVertices;
+	std::vector<UINT> vecIndices;
+	std::vector<SubMesh> vecSubMeshes;
+
+	std::vector<PackedVertex3D> vecPackedVertices;
+	VertexQuantization quantization;
+	std::vector<UCHAR> vecPackedIndices;
+
+	MeshCache cache;
+
+	//网格缓存命中时顶点/索引直接来自内存映射区域，否则来自加载得到的数组
+	//Float格式直接上传vecVertices，Packed格式上传EncodeVertexBuffer编码后的数据
+	const void* GetVertexData() const
+	{
+		if (cache.IsLoaded())
+			return cache.GetVertexData();
+		return (vertexFormat == VertexFormat::Packed) ? static_cast<const void*>(vecPackedVertices.data()) : static_cast<const void*>(vecVertices.data());
 	}
+	size_t GetVertexCount() const { return cache.IsLoaded() ? cache.GetVertexCount() : vecVertices.size(); }
+	UINT GetVertexStride() const { return (vertexFormat == VertexFormat::Packed) ? sizeof(PackedVertex3D) : sizeof(Vertex3D); }
+	const VertexQuantization& GetVertexQuantization() const { return cache.IsLoaded() ? cache.GetVertexQuantization() : quantization; }
+	const UCHAR* GetIndexData() const { return cache.IsLoaded() ? cache.GetIndexData() : vecPackedIndices.data(); }
+	size_t GetIndexDataSize() const { return cache.IsLoaded() ? cache.GetIndexDataSize() : vecPackedIndices.size(); }
+	const SubMesh* GetSubMeshData() const { return cache.IsLoaded() ? cache.GetSubMeshes() : vecSubMeshes.data(); }
+	size_t GetSubMeshCount() const { return cache.IsLoaded() ? cache.GetSubMeshCount() : vecSubMeshes.size(); }
 };
 
 struct SwapChainSupportInfo
 {
-	VkSurfaceCapabilitiesKHR capabilities;	//SwapChainϢ
-	std::vector<VkSurfaceFormatKHR> vecSurfaceFormats;	//֧Щͼʽ
-	std::vector<VkPresentModeKHR> vecPresentModes;	//֧Щģʽ
+	VkSurfaceCapabilitiesKHR capabilities;	//SwapChain容量相关信息
+	std::vector<VkSurfaceFormatKHR> vecSurfaceFormats;	//支持哪些图像格式
+	std::vector<VkPresentModeKHR> vecPresentModes;	//支持哪些表现模式，如二缓、三缓等
 };
 
 struct PhysicalDeviceInfo
@@ -67,6 +297,7 @@ struct PhysicalDeviceInfo
 		nRateScore = 0;
 		graphicFamilyIdx = std::nullopt;
 		presentFamilyIdx = std::nullopt;
+		transferFamilyIdx = std::nullopt;
 	}
 
 	VkPhysicalDeviceProperties properties;
@@ -81,6 +312,7 @@ struct PhysicalDeviceInfo
 
 	std::optional<UINT> graphicFamilyIdx;
 	std::optional<UINT> presentFamilyIdx;
+	std::optional<UINT> transferFamilyIdx;	//不含图形功能的传输队列族（DMA引擎），没有时为空
 
 	bool HaveGraphicAndPresentQueueFamily()
 	{
@@ -105,7 +337,8 @@ namespace std
 		{
 			return ((hash<glm::vec3>()(vertex.pos) ^
 				(hash<glm::vec3>()(vertex.color) << 1)) >> 1) ^
-				(hash<glm::vec2>()(vertex.texCoord) << 1);
+				(hash<glm::vec2>()(vertex.texCoord) << 1) ^
+				(hash<glm::vec3>()(vertex.normal) << 2);
 		}
 	};
 }
@@ -122,11 +355,77 @@ public:
 	void Loop();
 	void Clean();
 
-	void LoadOBJ(const std::filesystem::path& modelPath);
-	void LoadGLTF(const std::filesystem::path& modelPath);
+	//文件无法读取时返回false
+	bool LoadOBJ(const std::filesystem::path& modelPath, MeshData& meshData);
+	bool LoadGLTF(const std::filesystem::path& modelPath, MeshData& meshData);
+
+	//同步加载，需在Init之前调用
 	void LoadModel(const std::filesystem::path& modelPath);
 
+	//在后台线程解析，完成后于帧开始时替换当前模型并上传，Init前后均可调用
+	void LoadModelAsync(const std::filesystem::path& modelPath);
+	bool IsModelLoading() const { return m_ModelLoadFuture.valid(); }
+	float GetModelLoadProgress() const { return m_fModelLoadProgress; }
+	const char* GetModelLoadStage() const { return m_szModelLoadStage; }
+	const std::filesystem::path& GetLoadingModelPath() const { return m_LoadingModelPath; }
+
+	void SetParallelOBJLoad(bool bParallel) { m_bParallelOBJLoad = bParallel; }
+	void SetUseMeshCache(bool bUse) { m_bUseMeshCache = bUse; }
+	void SetVertexFormat(VertexFormat format) { m_VertexFormat = format; }
+	void SetOptimizeMesh(bool bOptimize) { m_bOptimizeMesh = bOptimize; }
+	void SetOptimizeOverdraw(bool bOptimize) { m_bOptimizeOverdraw = bOptimize; }
+
+	//加载时生成LOD；运行时按投影误差选择LOD，误差阈值以像素为单位
+	void SetGenerateLOD(bool bGenerate) { m_bGenerateLOD = bGenerate; }
+	void SetEnableLOD(bool bEnable) { m_bEnableLOD = bEnable; }
+	bool IsLODEnabled() const { return m_bEnableLOD; }
+	void SetLODPixelError(float fPixelError) { m_fLODPixelError = fPixelError; }
+	float GetLODPixelError() const { return m_fLODPixelError; }
+	const std::array<MeshLODStats, SubMesh::MAX_LOD_COUNT + 1>& GetLODStats() const { return m_aryLODStats; }
+
+	//烘焙纹理超过页缓存大小时以稀疏纹理按页驻留（虚拟纹理），显存占用不超过页缓存，需在Init之前设置
+	void SetEnableVirtualTexture(bool bEnable) { m_bEnableVirtualTexture = bEnable; }
+	void SetVirtualTextureCacheSize(VkDeviceSize uiSize) { m_uiVirtualTextureCacheSize = uiSize; }
+	//当前纹理不是稀疏纹理时返回nullptr
+	const VirtualTexture* GetVirtualTexture() const { return m_bVirtualTexture ? &m_VirtualTexture : nullptr; }
+
+	//烘焙纹理先只上传低级别的mip，按屏幕上的需要逐级流入更细的级别，超出预算时丢弃最久未使用的级别
+	void SetTextureBudget(VkDeviceSize uiBudget) { m_TextureManager.SetBudget(uiBudget); }
+	const TextureManager& GetTextureManager() const { return m_TextureManager; }
+
+	const DeviceMemoryAllocator& GetMemoryAllocator() const { return m_MemoryAllocator; }
+	const GeometryPool& GetGeometryPool() const { return m_GeometryPool; }
+	//把几何池中的网格紧凑排列到新的缓冲中，消除释放网格留下的空洞
+	//重建会销毁正在录制的CommandBuffer使用的缓冲，这里只做标记，在下一帧开始录制之前执行
+	void RequestDefragmentGeometry() { m_bDefragmentGeometryPending = true; }
+	//堆的名称由其flags得到，如"Device Local"
+	std::string GetMemoryHeapName(UINT uiHeapIndex) const;
+	//输出各堆的预算与各用途的占用
+	void LogMemoryStats() const;
+
+	void BenchmarkOBJLoad(const std::filesystem::path& modelPath);
+	void BenchmarkGLTFLoad(const std::filesystem::path& modelPath);
+	//顶点缓存、overdraw、顶点读取三步重排各自的耗时与ACMR/ATVR，只用CPU，可在Init之前调用
+	void BenchmarkMeshOptimize(const std::filesystem::path& modelPath);
+	//需在Init之后调用
+	void BenchmarkUniformBufferUpdate(UINT uiIterations = 100000);
+	//纹理导入各阶段（解码、RGBA展开、sRGB转换、写入暂存内存）的吞吐量，需在Init之后调用
+	void BenchmarkTextureDecode(const std::vector<std::filesystem::path>& vecTexturePaths);
+
 private:
+	bool LoadOBJByTinyObj(const std::filesystem::path& modelPath, MeshData& meshData);
+	bool LoadOBJParallel(const std::filesystem::path& modelPath, MeshData& meshData);
+
+	bool ReadGLTFFile(const std::filesystem::path& modelPath, tinygltf::Model& model);
+	void IngestGLTF(const tinygltf::Model& model, MeshData& meshData);
+	void IngestGLTFLegacy(tinygltf::Model& model, MeshData& meshData);
+
+	//只读取渲染器的加载选项，可在工作线程中执行
+	std::unique_ptr<MeshData> BuildMeshData(const std::filesystem::path& modelPath);
+	void SetModelLoadProgress(const char* szStage, float fProgress);
+	void PollModelLoad();
+	void DefragmentGeometry();
+
 	static void FrameBufferResizeCallBack(GLFWwindow* pWindow, int nWidth, int nHeight);
 	void InitWindow();
 
@@ -187,6 +486,7 @@ private:
 	void CreateRenderPass();
 
 	void CreateTransferCommandPool();
+	void CreateStagingBufferRing();
 	VkCommandBuffer BeginSingleTimeCommand();
 	void EndSingleTimeCommand(VkCommandBuffer commandBuffer);
 
@@ -194,44 +494,122 @@ private:
 	VkShaderModule CreateShaderModule(const std::vector<char>& vecBytecode);
 	void CreateShader();
 
-	struct UniformBufferObject
-	{
-		glm::mat4* model;
-		glm::mat4* view;
-		glm::mat4* proj;
-	};
-	UINT FindSuitableMemoryTypeIndex(UINT typeFilter, VkMemoryPropertyFlags properties);
+	//在满足requiredFlags的类型中选择与preferredFlags最接近的，不需要的flags越少越好
+	UINT FindSuitableMemoryTypeIndex(UINT typeFilter, VkMemoryPropertyFlags requiredFlags, VkMemoryPropertyFlags preferredFlags = 0);
+	//没有满足requiredFlags的类型时返回UINT32_MAX
+	UINT TryFindSuitableMemoryTypeIndex(UINT typeFilter, VkMemoryPropertyFlags requiredFlags, VkMemoryPropertyFlags preferredFlags = 0);
+	//存在足够大的DEVICE_LOCAL | HOST_VISIBLE堆（Resizable BAR）时，几何池放在其中并由CPU直接写入
+	void ChooseGeometryUploadStrategy();
 
-	void AllocateBufferMemory(VkMemoryPropertyFlags propertyFlags, VkBuffer& buffer, VkDeviceMemory& bufferMemory);
+	void CreateBuffer(VkDeviceSize deviceSize, VkBufferUsageFlags usageFlags, VkBuffer& buffer);
+	void AllocateBufferMemory(VkMemoryPropertyFlags requiredFlags, VkMemoryPropertyFlags preferredFlags, MemoryCategory category, VkBuffer& buffer, MemoryAllocation& bufferAllocation);
 	void CreateBufferAndBindMemory(VkDeviceSize deviceSize, VkBufferUsageFlags usageFlags,
-		VkMemoryPropertyFlags propertyFlags, VkBuffer& buffer, VkDeviceMemory& bufferMemory);
+		VkMemoryPropertyFlags requiredFlags, VkMemoryPropertyFlags preferredFlags, MemoryCategory category, VkBuffer& buffer, MemoryAllocation& bufferAllocation);
 	void CreateUniformBuffers();
-
-	void CreateDynamicUniformBuffers();
+	void DestroyUniformBuffers();
+	void CreateDynamicUniformBuffers(UINT uiObjectCount);
+	void CreateDynamicUniformBuffer(UINT uiFrameIdx, UINT uiObjectCount);
+	void DestroyDynamicUniformBuffers();
+	//在该帧的fence等待之后调用，容量不足时只重建该帧的缓冲并改写其descriptorSet
+	void ReserveDynamicUniformBuffer(UINT uiFrameIdx, UINT uiObjectCount);
+	void WriteDynamicUniformBufferDescriptor(UINT uiFrameIdx);
 
 
 	void CreateTextureSampler();
 
-	void AllocateImageMemory(VkMemoryPropertyFlags propertyFlags, VkImage& image, VkDeviceMemory& bufferMemory);
+	void AllocateImageMemory(VkMemoryPropertyFlags propertyFlags, VkImageTiling tiling, MemoryCategory category, VkImage& image, MemoryAllocation& imageAllocation);
+	void CreateImage(uint32_t uiWidth, uint32_t uiHeight, uint32_t uiMipLevel,
+		VkSampleCountFlagBits sampleCount, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkImage& image);
+	//尚未绑定内存的image按其内存需求申请后是否仍在对应堆的预算内
+	bool IsImageWithinBudget(VkImage image, VkMemoryPropertyFlags propertyFlags);
 	void CreateImageAndBindMemory(uint32_t uiWidth, uint32_t uiHeight, uint32_t uiMipLevel,
 		VkSampleCountFlagBits sampleCount, VkFormat format,
-		VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties,
-		VkImage& image, VkDeviceMemory& imageMemory);
+		VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, MemoryCategory category,
+		VkImage& image, MemoryAllocation& imageAllocation);
+	bool CheckFormatSupportLinearBlit(VkFormat format);
 	bool CheckFormatHasStencilComponent(VkFormat format);
 	void ChangeImageLayout(VkImage image, VkFormat format, uint32_t uiMipLevel, VkImageLayout oldLayout, VkImageLayout newLayout);
-	void TransferImageDataByStageBuffer(void* pData, VkDeviceSize imageSize, VkImage& image,  UINT uiWidth, UINT uiHeight);
+	void RecordChangeImageLayout(VkCommandBuffer commandBuffer, VkImage image, VkFormat format, uint32_t uiMipLevel, VkImageLayout oldLayout, VkImageLayout newLayout);
+	//uiBlockDim为压缩格式块的边长，数据按块行紧凑排列
+	void TransferImageDataByStageBuffer(const void* pData, VkDeviceSize imageSize, VkImage& image,  UINT uiWidth, UINT uiHeight, UINT uiMipLevel = 0, UINT uiBlockDim = 1);
+	//WriteRows直接向映射的暂存内存写入[uiFirstRow, uiFirstRow + uiRowCount)块行，每块行uiRowPitch字节
+	void TransferImageRowsByStageBuffer(VkImage& image, UINT uiWidth, UINT uiHeight, VkDeviceSize uiRowPitch, UINT uiMipLevel, UINT uiBlockDim,
+		const std::function<void(UINT uiFirstRow, UINT uiRowCount, UCHAR* pDst)>& WriteRows);
+	//加载失败（文件无效或设备不支持其格式）时返回false，由调用者改为解码源图像
+	bool OpenCookedTexture(const std::filesystem::path& texturePath, KTX2File& textureFile);
+	//创建只包含uiFirstLevel及更粗各级的image，上传录制在当前的上传批次中；超出显存预算时不创建并返回false
+	//只上传前uiUploadLevelCount级，其余各级保持UNDEFINED，由调用者从其他image拷贝
+	bool CreateTextureImageFromKTX2(const KTX2File& textureFile, UINT uiFirstLevel, VkImage& image, MemoryAllocation& imageAllocation, VkImageView& imageView,
+		UINT uiUploadLevelCount = UINT_MAX);
+	//加入纹理管理，初始只驻留低级别的mip；失败时返回TextureManager::INVALID_HANDLE
+	UINT CreateStreamedTexture(const std::filesystem::path& texturePath);
+	//在该帧的fence等待之后调用：估计各纹理需要的级别，驻留变化的纹理立即换为新image，旧image在本帧拷贝后退役
+	void UpdateTextureStreaming();
+	//在render pass之前录制，拷贝之后新image的各级都为SHADER_READ_ONLY
+	void RecordPendingTextureCopies(VkCommandBuffer commandBuffer);
+	//按可见三角形的投影估计需要的mip级别
+	void EstimateTextureUsage();
+	//在该帧的fence等待之后调用，销毁已不被任何in flight的帧使用的image与几何区间；bAll用于GPU空闲时全部销毁
+	void ReleaseRetiredResources(bool bAll);
+	void DestroyStreamedTextures();
+	//设备不支持稀疏纹理或纹理没有mip tail时返回false，由调用者改为普通纹理
+	bool CreateVirtualTexture(const std::filesystem::path& texturePath);
+	//在该帧的fence等待之后调用：读取反馈，绑定读取完成的页并准备拷贝，提交新的读取，更新页表
+	//绑定signal m_VirtualTextureBindSemaphore，由本帧的提交等待
+	void UpdateVirtualTexture(UINT uiFrameIdx);
+	//读取该帧着色器写回的页请求后清零，该帧的命令已执行完成
+	void GatherVirtualTextureFeedback(UINT uiFrameIdx);
+	//对抽样的可见三角形调用VisitTriangle，fUVLevel为1x1纹理上的mip级别，加上0.5 * log2(宽 * 高)即为实际纹理上的级别
+	void ForEachVisibleTriangleUV(const std::function<void(float fUVLevel, const glm::vec2& uvMin, const glm::vec2& uvMax)>& VisitTriangle);
+	//在render pass之前录制本帧的页拷贝与页表的更新
+	void RecordVirtualTextureUploads(VkCommandBuffer commandBuffer);
+	//在render pass之后录制，该帧的fence signal后着色器写回的反馈对CPU可见
+	void RecordVirtualTextureFeedbackBarrier(VkCommandBuffer commandBuffer);
+	void DestroyVirtualTexture();
+	//没有可用的.ktx2时先创建1x1的占位纹理，源图像在后台解码
 	void CreateTextureImageAndFillData();
+	//解码完成后创建完整的纹理并替换占位纹理，解码失败时保留占位纹理
+	void PollTextureDecode();
+	//上传录制在当前的上传批次中，GPU生成的mip链加入m_vecPendingMipmapGenerations；超出显存预算时不创建并返回false
+	bool CreateDecodedTextureImage(const TextureDecoder::Image& image, VkImage& textureImage, MemoryAllocation& textureImageAllocation, UINT& uiMipLevel);
+	//在render pass之前录制
+	void RecordPendingMipmapGenerations(VkCommandBuffer commandBuffer);
+	//level 0为TRANSFER_SRC、其余各级内容未定义，逐级blit后所有层级转为SHADER_READ_ONLY
+	void RecordGenerateMipmaps(VkCommandBuffer commandBuffer, VkImage image, UINT uiWidth, UINT uiHeight, UINT uiMipLevel);
 	void CreateTextureImageView();
 
 	void CreateDescriptorSetLayout();
 	void CreateDescriptorPool();
 	void CreateDescriptorSets();
-
-
-	void TransferBufferDataByStageBuffer(void* pData, VkDeviceSize imageSize, VkBuffer& buffer);
-
-	void CreateVertexBuffer();
-	void CreateIndexBuffer();
+	void WriteTextureDescriptor(UINT uiFrameIdx);
+	//稀疏纹理的页表、常量与该帧的反馈区间，创建后不再变化
+	void WriteVirtualTextureDescriptors(UINT uiFrameIdx);
+	//纹理的image变化后，只改写该帧的descriptorSet
+	void RefreshTextureDescriptor(UINT uiFrameIdx);
+	VkImageView GetSceneTextureView() const;
+
+
+	void TransferBufferDataByStageBuffer(const void* pData, VkDeviceSize imageSize, VkBuffer& buffer, VkDeviceSize uiDstOffset = 0);
+
+	void GenerateMeshLODs(MeshData& meshData);
+	void OptimizeMesh(MeshData& meshData);
+	UINT GetMeshCacheFlags() const;
+	void EncodeVertexBuffer(MeshData& meshData);
+	void PackIndexBuffer(MeshData& meshData);
+
+	void CreateGeometryBuffers(VkDeviceSize uiVertexCapacity, VkDeviceSize uiIndexCapacity);
+	void DestroyGeometryBuffers();
+	//不等待设备空闲：复制录制在本帧的CommandBuffer中，旧缓冲由ReleaseRetiredResources销毁
+	bool RebuildGeometryBuffers(VkDeviceSize uiVertexCapacity, VkDeviceSize uiIndexCapacity);
+	//在render pass之前录制，多次重建按顺序复制
+	void RecordPendingGeometryCopies(VkCommandBuffer commandBuffer);
+	UINT AllocateGeometry(VkDeviceSize uiVertexSize, UINT uiVertexStride, VkDeviceSize uiIndexSize);
+	void CreateMeshGeometry();
+	//缓冲已映射时直接写入，否则经暂存缓冲上传
+	void WriteGeometryData(const void* pData, VkDeviceSize uiSize, VkBuffer& buffer, const MemoryAllocation& allocation, VkDeviceSize uiDstOffset);
+	//旧模型的区间放入待回收列表，由ReleaseRetiredResources归还
+	void RetireMeshGeometry();
+	void DestroyMeshGeometry();
 
 	void CreateCommandPool();
 	void CreateCommandBuffer();
@@ -241,6 +619,8 @@ private:
 	void CreateSyncObjects();
 
 
+	glm::mat4 GetModelMatrix() const;
+	UINT SelectSubMeshLOD(const SubMesh& subMesh) const;
 	void RecordCommandBuffer(VkCommandBuffer& commandBuffer, UINT uiIdx);
 	void UpdateUniformBuffer(UINT uiIdx);
 	void Render();
@@ -274,6 +654,12 @@ public:
 	VkCommandBuffer BeginSingleTimeCommandBuffer() { return BeginSingleTimeCommand(); }
 	void EndSingleTimeCommandBuffer(VkCommandBuffer commandBuffer) { return EndSingleTimeCommand(commandBuffer); }
 
+	//Transfer*ByStageBuffer与纹理的layout转换只录制到当前上传批次，SubmitUploadBatch一次提交且不等待
+	//返回的Token可用于查询或同步等待这一批上传完成
+	UploadToken SubmitUploadBatch();
+	bool IsUploadComplete(UploadToken token) { return m_StagingBufferRing.IsComplete(token); }
+	void WaitUpload(UploadToken token) { m_StagingBufferRing.Wait(token); }
+
 	VkFormat GetSwapChainFormat() { return m_SwapChainFormat; }
 
 	VkPipeline& GetPipeline() { return m_GraphicPipeline; }
@@ -311,6 +697,10 @@ private:
 	};
 	VkQueue m_GraphicQueue;
 	VkQueue m_PresentQueue;
+	VkQueue m_TransferQueue;	//没有独立的传输队列族时与m_GraphicQueue相同
+
+	//所有Buffer与Image的显存都从这里子分配
+	DeviceMemoryAllocator m_MemoryAllocator;
 
 	VkSwapchainKHR m_SwapChain;
 	VkSurfaceFormatKHR m_SwapChainSurfaceFormat;
@@ -323,7 +713,7 @@ private:
 	std::vector<VkImageView> m_vecSwapChainImageViews;
 
 	VkImage m_DepthImage;
-	VkDeviceMemory m_DepthImageMemory;
+	MemoryAllocation m_DepthImageAllocation;
 	VkImageView m_DepthImageView;
 	VkFormat m_DepthFormat;
 	std::vector<VkFramebuffer> m_vecSwapChainFrameBuffers;
@@ -331,38 +721,128 @@ private:
 	VkRenderPass m_RenderPass;
 
 	VkCommandPool m_TransferCommandPool;
+	VkCommandPool m_UploadCommandPool;	//属于m_TransferQueue的队列族，供暂存环录制上传命令
+
+	//所有上传共用的暂存环，避免每次上传都创建暂存缓冲并等待队列空闲
+	VkBuffer m_StagingBuffer;
+	MemoryAllocation m_StagingBufferAllocation;
+	StagingBufferRing m_StagingBufferRing;
 
 
 	std::unordered_map<VkShaderStageFlagBits, std::filesystem::path> m_mapShaderPath;
+	std::filesystem::path m_VirtualTextureFragShaderPath;	//稀疏纹理时替换m_mapShaderPath中的片元着色器
 	std::unordered_map<VkShaderStageFlagBits, VkShaderModule> m_mapShaderModule;
 
+	//每帧一个存放PerFrameConstants的Uniform Buffer
 	std::vector<VkBuffer> m_vecUniformBuffers;
-	std::vector<VkDeviceMemory> m_vecUniformBufferMemories;
+	std::vector<MemoryAllocation> m_vecUniformBufferAllocations;
+	ConstantBlockWriter<PerFrameConstants> m_PerFrameConstantsWriter;	//目标下标为帧
 
+	//每帧一个动态偏移的Uniform Buffer，每个物体占一个按minUniformBufferOffsetAlignment对齐的PerDrawConstants槽位
+	//所有物体共用同一个descriptorSet，绘制时通过pDynamicOffsets选择槽位
 	std::vector<VkBuffer> m_vecDynamicUniformBuffers;
-	std::vector<VkDeviceMemory> m_vecDynamicUniformBufferMemories;
+	std::vector<MemoryAllocation> m_vecDynamicUniformBufferAllocations;
+	VkDeviceSize m_uiDynamicUniformAlignment;
+	std::vector<UINT> m_vecDynamicUniformCapacities;	//各帧缓冲可容纳的物体数
+	std::vector<ConstantBlockWriter<PerDrawConstants>> m_vecPerDrawConstantsWriters;	//各帧一个，目标下标为物体
 
 	VkSampler m_TextureSampler;
 
-	UINT m_uiMipmapLevel;
+	UINT m_uiMipmapLevel;	//由纹理尺寸得到的完整mip链层数
 	std::filesystem::path m_TexturePath;
+	VkFormat m_TextureFormat;
+	//Init开始时提交到线程池，解码与窗口、设备的创建并行，由PollTextureDecode在完成后取出
+	std::future<TextureDecoder::Image> m_TextureDecodeFuture;
+	TextureDecoder::Image m_DecodedTexture;	//超出显存预算暂未创建的解码结果
+	bool m_bDecodedTextureRefused;
+	std::vector<PendingMipmapGeneration> m_vecPendingMipmapGenerations;
 	VkImage m_TextureImage;
-	VkDeviceMemory m_TextureImageMemory;
+	MemoryAllocation m_TextureImageAllocation;
 	VkImageView m_TextureImageView;
 
+	bool m_bEnableVirtualTexture;
+	VkDeviceSize m_uiVirtualTextureCacheSize;
+	bool m_bVirtualTexture;	//m_TextureImage为稀疏纹理，始终处于GENERAL layout
+	VirtualTexture m_VirtualTexture;
+	KTX2File m_VirtualTextureFile;	//保持映射，页数据从中读取
+	VkDeviceSize m_uiVirtualTexturePageSize;	//一页占用的显存，即稀疏块的大小
+	VkDeviceSize m_uiVirtualTextureStagingPageSize;	//一页数据在暂存缓冲中的跨度
+	MemoryAllocation m_VirtualTextureCacheAllocation;	//物理页缓存，第i个槽位位于i * m_uiVirtualTexturePageSize
+	MemoryAllocation m_VirtualTextureMipTailAllocation;
+	VkSemaphore m_VirtualTextureBindSemaphore;	//创建时由上传等待，之后由绑定所在帧的提交等待
+	bool m_bVirtualTextureBindPending;	//本帧的提交需等待m_VirtualTextureBindSemaphore
+	//每帧一段，页数据之后是页表，该帧的fence等待之后即可复用
+	VkBuffer m_VirtualTextureStagingBuffer;
+	MemoryAllocation m_VirtualTextureStagingAllocation;
+	VkDeviceSize m_uiVirtualTextureStagingFrameSize;
+	std::vector<VirtualTexturePageRead> m_vecVirtualTextureReads;
+	std::vector<VkBufferImageCopy> m_vecVirtualTextureCopies;	//本帧需录制的页拷贝
+	//R8_UINT，level 0每页一个texel，始终处于GENERAL layout
+	VkImage m_VirtualTexturePageTableImage;
+	MemoryAllocation m_VirtualTexturePageTableAllocation;
+	VkImageView m_VirtualTexturePageTableView;
+	VkSampler m_VirtualTexturePageTableSampler;
+	std::optional<VkBufferImageCopy> m_VirtualTexturePageTableCopy;	//页表变化时本帧需录制的拷贝
+	VkBuffer m_VirtualTextureConstantBuffer;
+	MemoryAllocation m_VirtualTextureConstantAllocation;
+	//每帧一段，每页一个uint，着色器把请求的页置1
+	VkBuffer m_VirtualTextureFeedbackBuffer;
+	MemoryAllocation m_VirtualTextureFeedbackAllocation;
+	VkDeviceSize m_uiVirtualTextureFeedbackFrameSize;
+	std::vector<VkImageView> m_vecTextureDescriptorViews;	//各帧descriptorSet当前使用的imageView
+
+	TextureManager m_TextureManager;
+	std::vector<std::unique_ptr<StreamedTexture>> m_vecStreamedTextures;	//下标为TextureManager中的句柄
+	std::vector<RetiredTextureImage> m_vecRetiredTextureImages;
+	std::vector<PendingTextureCopy> m_vecPendingTextureCopies;
+	std::vector<RetiredGeometry> m_vecRetiredGeometries;
+	std::vector<RetiredBuffer> m_vecRetiredBuffers;
+	std::vector<PendingGeometryCopy> m_vecPendingGeometryCopies;
+	UINT m_uiSceneTexture;	//模型使用的纹理在m_TextureManager中的句柄，不是流式纹理时为INVALID_HANDLE
+
 	VkDescriptorSetLayout m_DescriptorSetLayout;
 	VkDescriptorPool m_DescriptorPool;
 	std::vector<VkDescriptorSet> m_vecDescriptorSets;
 
 	std::filesystem::path m_ModelPath;
 
+	ThreadPool m_ThreadPool;
+	bool m_bParallelOBJLoad;
+
+	bool m_bUseMeshCache;
+
+	bool m_bOptimizeMesh;
+	bool m_bOptimizeOverdraw;
+
+	bool m_bGenerateLOD;
+	bool m_bEnableLOD;
+	float m_fLODPixelError;
+	std::array<MeshLODStats, SubMesh::MAX_LOD_COUNT + 1> m_aryLODStats;
+
+	VertexFormat m_VertexFormat;
+
+	//当前用于渲染的模型，异步加载完成后整体替换
+	std::unique_ptr<MeshData> m_pMeshData;
+
+	std::future<std::unique_ptr<MeshData>> m_ModelLoadFuture;
+	std::unique_ptr<MeshData> m_pPendingMeshData;	//加载完成但超出显存预算，等待占用下降后替换
+	bool m_bPendingMeshDataRefused;
+	std::filesystem::path m_LoadingModelPath;
+	std::atomic<float> m_fModelLoadProgress;
+	std::atomic<const char*> m_szModelLoadStage;
+	std::chrono::time_point<std::chrono::high_resolution_clock> m_ModelLoadStartTime;
+
+	//所有网格共用的顶点与索引缓冲，各网格的区间由m_GeometryPool分配，整个场景只绑定一次
 	VkBuffer m_VertexBuffer;
-	VkDeviceMemory m_VertexBufferMemory;
-	std::vector<Vertex3D> m_Vertices;
+	MemoryAllocation m_VertexBufferAllocation;
 
 	VkBuffer m_IndexBuffer;
-	VkDeviceMemory m_IndexBufferMemory;
-	std::vector<UINT> m_Indices;
+	MemoryAllocation m_IndexBufferAllocation;
+
+	GeometryPool m_GeometryPool;
+	UINT m_uiMeshGeometry;	//当前模型在几何池中的句柄
+	bool m_bDirectGeometryWrite;	//几何池位于HOST_VISIBLE的显存中，网格数据跳过暂存直接写入
+	bool m_bDefragmentGeometryPending;
 
 	VkCommandPool m_CommandPool;
 	std::vector<VkCommandBuffer> m_vecCommandBuffers;
@@ -377,4 +857,5 @@ private:
 	std::vector<VkFence> m_vecInFlightFences;
 
 	UINT m_uiCurFrameIdx;
+	uint64_t m_uiTotalFrameCount;	//已提交的帧数，作为资源回收的时间戳
 };
\ No newline at end of file
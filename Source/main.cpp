@@ -4,14 +4,22 @@ int main()
 {
     VulkanRenderer renderer;
 
+    //renderer.SetVertexFormat(VertexFormat::Packed);
     //renderer.LoadModel("./Assert/Model/teapot.gltf");
-    renderer.LoadModel("./Assert/Model/sphere.obj");
+    renderer.LoadModelAsync("./Assert/Model/sphere.obj");
     //renderer.LoadModel("./Assert/Model/sphere.gltf");
     //renderer.LoadModel("./Assert/Model/triangle.gltf");
     //renderer.LoadModel("./Assert/Model/vulkanscenemodels.gltf");
     //renderer.LoadModel("./Assert/Model/viking_room.obj");
+    //renderer.BenchmarkOBJLoad("./Assert/Model/viking_room.obj");
+    //renderer.BenchmarkGLTFLoad("./Assert/Model/teapot.gltf");
+    //renderer.BenchmarkGLTFLoad("./Assert/Model/sphere.gltf");
+    //renderer.BenchmarkMeshOptimize("./Assert/Model/viking_room.obj");
+    //renderer.BenchmarkMeshOptimize("./Assert/Model/teapot.gltf");
 
     renderer.Init();
+    //renderer.BenchmarkUniformBufferUpdate();
+    //renderer.BenchmarkTextureDecode({ "./Assert/Texture/viking_room.png", "./Assert/Texture/Earth/8081_earthmap4k.jpg" });
 
     renderer.Loop();
 
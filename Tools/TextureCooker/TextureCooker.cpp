@@ -0,0 +1,118 @@
+#include "Core.h"
+#include "BlockCompression.h"
+#include "KTX2File.h"
+#include "TextureMipmap.h"
+#include "ThreadPool.h"
+
+#include <chrono>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+//离线纹理烘焙：解码源图像，生成完整的mip链并逐级压缩为BC1/BC3，写出KTX2
+//渲染器加载同名的.ktx2时直接把各级数据拷贝进image，运行时不再解码
+//用法：TextureCooker <input> [output.ktx2] [--bc1 | --bc3] [--linear]
+//  未指定格式时，有半透明像素的图像使用BC3，否则使用BC1
+//  --linear用于法线、粗糙度等非颜色数据，mip在编码值上直接平均，格式为UNORM
+
+static void PrintUsage()
+{
+	Log::Info("Usage : TextureCooker <input> [output.ktx2] [--bc1 | --bc3] [--linear]");
+}
+
+static bool CookTexture(const std::filesystem::path& inputPath, const std::filesystem::path& outputPath,
+	std::optional<bool> forceBC3, bool bLinear, ThreadPool& threadPool)
+{
+	auto startTimestamp = std::chrono::high_resolution_clock::now();
+
+	int nWidth = 0;
+	int nHeight = 0;
+	int nChannel = 0;
+	stbi_uc* pixels = stbi_load(inputPath.string().c_str(), &nWidth, &nHeight, &nChannel, STBI_rgb_alpha);
+	if (!pixels)
+	{
+		Log::Error(std::format("Load image {} failed : {}", inputPath.string(), stbi_failure_reason()));
+		return false;
+	}
+
+	UINT uiWidth = static_cast<UINT>(nWidth);
+	UINT uiHeight = static_cast<UINT>(nHeight);
+	bool bBC3 = forceBC3.has_value() ? forceBC3.value()
+		: BlockCompression::HasTranslucentPixel(pixels, static_cast<size_t>(uiWidth) * uiHeight);
+
+	VkFormat format;
+	if (bBC3)
+		format = bLinear ? VK_FORMAT_BC3_UNORM_BLOCK : VK_FORMAT_BC3_SRGB_BLOCK;
+	else
+		format = bLinear ? VK_FORMAT_BC1_RGB_UNORM_BLOCK : VK_FORMAT_BC1_RGB_SRGB_BLOCK;
+
+	auto decodeTimestamp = std::chrono::high_resolution_clock::now();
+
+	auto vecMipLevels = TextureMipmap::GenerateRGBA8(pixels, uiWidth, uiHeight, !bLinear);
+
+	auto mipTimestamp = std::chrono::high_resolution_clock::now();
+
+	std::vector<std::vector<UCHAR>> vecLevels;
+	vecLevels.reserve(vecMipLevels.size() + 1);
+	vecLevels.push_back(BlockCompression::CompressRGBA8(pixels, uiWidth, uiHeight, bBC3, &threadPool));
+	for (const auto& level : vecMipLevels)
+		vecLevels.push_back(BlockCompression::CompressRGBA8(level.vecPixels.data(), level.uiWidth, level.uiHeight, bBC3, &threadPool));
+	stbi_image_free(pixels);
+
+	auto compressTimestamp = std::chrono::high_resolution_clock::now();
+
+	if (!KTX2File::Write(outputPath, format, uiWidth, uiHeight, vecLevels))
+	{
+		Log::Error(std::format("Write {} failed", outputPath.string()));
+		return false;
+	}
+
+	size_t uiCompressedSize = 0;
+	for (const auto& level : vecLevels)
+		uiCompressedSize += level.size();
+
+	auto ToMs = [](auto duration) { return std::chrono::duration<double, std::milli>(duration).count(); };
+	Log::Info(std::format("Cook {} -> {} : {}x{} {}, {} levels, {:.2f} MB (RGBA8 level 0 {:.2f} MB)",
+		inputPath.string(), outputPath.string(), uiWidth, uiHeight, bBC3 ? "BC3" : "BC1", vecLevels.size(),
+		uiCompressedSize / (1024.0 * 1024.0), static_cast<double>(uiWidth) * uiHeight * 4 / (1024.0 * 1024.0)));
+	Log::Info(std::format("    decode {:.1f} ms, mipmap {:.1f} ms, compress {:.1f} ms",
+		ToMs(decodeTimestamp - startTimestamp), ToMs(mipTimestamp - decodeTimestamp), ToMs(compressTimestamp - mipTimestamp)));
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<std::filesystem::path> vecPaths;
+	std::optional<bool> forceBC3;
+	bool bLinear = false;
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string strArg = argv[i];
+		if (strArg == "--bc1")
+			forceBC3 = false;
+		else if (strArg == "--bc3")
+			forceBC3 = true;
+		else if (strArg == "--linear")
+			bLinear = true;
+		else if (strArg.starts_with("--"))
+		{
+			Log::Error(std::format("Unknown option {}", strArg));
+			PrintUsage();
+			return 1;
+		}
+		else
+			vecPaths.push_back(strArg);
+	}
+
+	if (vecPaths.empty() || vecPaths.size() > 2)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	//默认输出到源图像旁的同名.ktx2，渲染器按此路径查找
+	std::filesystem::path outputPath = vecPaths.size() == 2 ? vecPaths[1] : std::filesystem::path(vecPaths[0]).replace_extension(".ktx2");
+
+	ThreadPool threadPool;
+	return CookTexture(vecPaths[0], outputPath, forceBC3, bLinear, threadPool) ? 0 : 1;
+}
@@ -49,4 +49,43 @@ project "VulkanRenderer"
 
     filter "configurations:Release"
         defines "NDEBUG"
-        optimize "On"
\ No newline at end of file
+        optimize "On"
+
+    filter {}
+
+--离线纹理烘焙工具，把源图像压缩为带完整mip链的BC1/BC3 KTX2
+project "TextureCooker"
+    kind "ConsoleApp"
+    language "C++"
+    cppdialect "c++latest"
+
+    targetdir "bin/%{cfg.buildcfg}"
+
+    files
+    {
+        "./Tools/TextureCooker/**.cpp",
+        "./Source/BlockCompression.*",
+        "./Source/KTX2File.*",
+        "./Source/MappedFile.*",
+        "./Source/TextureMipmap.*",
+        "./Source/PixelConvert.*",
+        "./Source/ThreadPool.*",
+        "./Source/Log.*",
+    }
+
+    includedirs --外部包含目录
+    {
+        "./Source",
+        "./Submodule/GLFW/include",
+        "./Submodule/spdlog/include",
+        "./Submodule/tinygltf", --stb_image.h
+        "D:/VulkanSDK/Include",
+    }
+
+    filter "configurations:Debug"
+        defines "DEBUG"
+        symbols "On"
+
+    filter "configurations:Release"
+        defines "NDEBUG"
+        optimize "On"